@@ -45,6 +45,52 @@
 //
 //
 // Revision History:
+//      4.0  17-Oct-2026: - Add read_catalog() to read mosaic catalog files
+//                        - Add fits_open(), fits_read_strip() and
+//                          fits_close() so a large image can be read in
+//                          row strips through one open file handle
+//                        - Add fits_expand() and fits_read_plane() to handle
+//                          NAXIS=3 cubes and multi-extension FITS files
+//                        - Open images with fits_open_image() so files with
+//                          an empty primary HDU use the first image HDU
+//                        - Add fits_read_tiles() to decompress tile
+//                          compressed images in parallel and
+//                          file_compressed() to detect compressed inputs
+//                        - Add fits_read_tiles() version that reads into a
+//                          caller buffer so buffers can be reused
+//                        - Add arena class for per item buffers and
+//                          versions of fits_read() and fits_read_plane()
+//                          that take their buffer from an arena
+//                        - Add fits_meta() and prescan() to read the headers
+//                          of a manifest in parallel with a sidecar cache
+//                        - read_lines() no longer opens the image files
+//                        - fits_expand() skips files the prescan found to
+//                          hold a single image
+//                        - Add per item options to read_lines() input files
+//                          (read_option())
+//                        - Add cpu_name(), cpu_path() and cpu_report() for
+//                          the --cpu-report options
+//                        - Add fits_read() into an Image2D and fits_write()
+//                          from an ImageView (image_class.h)
+//                        - Fix ArrayAlloc() and CArrayAlloc() sizes
+//                          overflowing int for very large arrays
+//                        - Add badpix_read() to read a bad pixel/star mask
+//                          (FITS or DS9 region file) into a BitMask, and the
+//                          badpix per item option
+//                        - Read images from standard input, named pipes and
+//                          shared memory (shm:<name>) into memory and open
+//                          them with the CFITSIO memory driver (mem_load(),
+//                          fits_open_any())
+//                        - Add fits_write() version that writes a tile
+//                          compressed (Rice/GZIP, quantized or lossless)
+//                          and/or cropped image, with the tiles compressed
+//                          in parallel, and pack_option()
+//                        - prescan() loads in memory images before the
+//                          parallel loop so astro_errno is not set by
+//                          several threads at once
+//                        - fits_expand() sets the dimensions of each HDU and
+//                          the radius of HDUs that differ in size from the
+//                          first image
 //      3.0  12-Jun-2018: - Update FITS data read/write routines to use 2D
 //                          functions and to compensate for row/col ordering
 //                        - Fix fits_read() to allocate a buffer based on the 
@@ -88,16 +134,30 @@
 //      1.0  19-Feb-2017: - Initial version
 //
 
-#define ASTRO_VER   "3.0/20180612"
+#define ASTRO_VER   "4.0/20261017"
 
+#include    <ctype.h>
+#include    <math.h>
 #include    <stdio.h>
+#include    <stdlib.h>
 #include    <string.h>
+#include    <strings.h>
 #include    <unistd.h>
+#include    <errno.h>
+#include    <fcntl.h>
+#include    <pthread.h>
+#include    <sys/mman.h>
+#include    <zlib.h>
 #include    <fstream>
 #include    <sstream>
+#include    <algorithm>
+#include    <map>
 #include    <magic.h>
 #include    <sys/stat.h>
 #include    <sys/types.h>
+#ifdef _OPENMP
+#include    <omp.h>
+#endif
 
 #include    "astro_class.h"
 #include    <fitsio.h>
@@ -160,6 +220,94 @@ void    astro::version()
     {
     printf("  -- Astro Class Include Version:  %s\n",ASTRO_H_VER);
     printf("  -- Astro Class Function Version:  %s\n",ASTRO_VER);
+    printf("  -- Image Class Include Version:  %s\n",IMAGE_H_VER);
+    }
+
+
+//
+// CPU_NAME() - Returns the CPU model of this machine
+//
+// Arguments: NONE
+//
+// Return Value:
+//      CPU model name ("unknown" if it can't be found)
+//
+
+std::string astro::cpu_name()
+    {
+    char    line[256];     /* Line of /proc/cpuinfo                          */
+    char    *p;            /* Start of the model name                        */
+    FILE    *fp;           /* /proc/cpuinfo file pointer                     */
+    std::string     cpu="unknown";
+
+    if ((fp=fopen("/proc/cpuinfo","r")) == NULL) return(cpu);
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+        {
+        if (strncmp(line, "model name", 10) || ((p=strchr(line, ':')) == NULL)) continue;
+        for (p++; *p == ' '; p++);
+        p[strcspn(p, "\t\n")]='\0';
+        cpu=std::string(p);
+        break;
+        }
+
+    fclose(fp);
+    return(cpu);
+    }
+
+
+//
+// CPU_PATH() - Returns the code path the CPU_CLONES functions run on this
+//              machine.  This is the same choice the loader makes: the
+//              widest instruction set in CPU_PATHS the CPU supports.
+//
+// Arguments: NONE
+//
+// Return Value:
+//      Name of the code path ("default" when built without multiversioning)
+//
+
+const char  *astro::cpu_path()
+    {
+#ifdef CPU_PATHS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return("avx512f");
+    if (__builtin_cpu_supports("avx2")) return("avx2");
+    return("sse2");
+#else
+    return("default");
+#endif
+    }
+
+
+//
+// CPU_REPORT() - Prints the CPU, the code paths built into the program and
+//                the one each of its multiversioned kernels runs
+//
+// Arguments:
+//      pname   - Program name
+//      kernels - NULL terminated list of kernel descriptions
+//
+// Return Value: NONE
+//
+
+void    astro::cpu_report(const char *pname, const char **kernels)
+    {
+    int     i;
+
+    printf("%s CPU report\n",pname);
+    printf("  CPU:          %s\n",cpu_name().c_str());
+#ifdef CPU_PATHS
+    __builtin_cpu_init();
+    printf("  Supports:     sse2%s%s%s\n",__builtin_cpu_supports("avx") ? " avx" : "",
+           __builtin_cpu_supports("avx2") ? " avx2" : "",__builtin_cpu_supports("avx512f") ? " avx512f" : "");
+    printf("  Built paths:  %s\n",CPU_PATHS);
+#else
+    printf("  Built paths:  default (no multiversioning with this compiler/system)\n");
+#endif
+    printf("  Active path:  %s\n",cpu_path());
+
+    for (i=0; kernels[i] != NULL; i++) printf("    %-28s %s\n",kernels[i],cpu_path());
     }
 
 
@@ -182,6 +330,8 @@ int    astro::file_type(std::string fname)
     magic_t     handle;
     const char  *type;
 
+    if (mem_name(fname.c_str())) return(ASTRO_BIN_FILE);
+
     handle=magic_open(MAGIC_NONE|MAGIC_COMPRESS);
     magic_load(handle,NULL);
     type = magic_file(handle,fname.c_str());
@@ -220,11 +370,337 @@ int    astro::file_type(std::string fname)
 
 bool    astro::file_exists(const char *fname)
     {
+    int     fd;
+    std::string seg;
+
+    if (!strncmp(fname, "shm:", 4))
+        {
+        seg=std::string(fname+4);
+        if (seg[0] != '/') seg="/"+seg;
+        if ((fd=shm_open(seg.c_str(), O_RDONLY, 0)) < 0) return(false);
+        close(fd);
+        return(true);
+        }
+    if (mem_name(fname)) return(true);
+
     std::ifstream infile(fname);
     return infile.good();
     }
 
 
+//
+// FILE_COMPRESSED() - This function will return true if the file is
+//                     compressed, either as a whole (gzip, bzip2, etc.) or
+//                     as a tile compressed FITS image (.fz).
+//
+// Arguments:
+//      fname   - Text string of filename
+//
+// Return Value:
+//      TRUE    - File is compressed
+//      FALSE   - File is not compressed (or can't be read)
+//
+
+bool    astro::file_compressed(std::string fname)
+    {
+    bool        ret=false;
+    magic_t     handle;
+    const char  *type;
+
+    if ((fname.size() > 3) && (fname.compare(fname.size()-3, 3, ".fz") == 0)) return(true);
+    if (mem_name(fname.c_str())) return(false);
+
+    handle=magic_open(MAGIC_NONE);
+    magic_load(handle,NULL);
+    type = magic_file(handle,fname.c_str());
+
+    if (type && strstr(type,"compressed data")) ret=true;
+
+    magic_close(handle);
+    return(ret);
+    }
+
+
+//
+// In memory images (standard input, named pipes and POSIX shared memory).
+//   A stream can only be read once, so it is read into memory the first time
+//   it is opened and every later open (header, planes, parallel tile bands)
+//   goes through the CFITSIO memory driver.  The table is shared by all
+//   astro instances and threads and is only changed while holding mem_lock.
+//
+
+struct  mem_img
+    {
+    void    *buf;          /* Image bytes (NULL while being read)            */
+    size_t  size;          /* Bytes in buf                                   */
+    int     shm;           /* buf is a mmap() of a shared memory segment     */
+    };
+
+static  std::map<std::string, mem_img>  mem_imgs;   /* Loaded images         */
+static  pthread_mutex_t mem_lock=PTHREAD_MUTEX_INITIALIZER; /* mem_imgs lock */
+static  pthread_cond_t  mem_cond=PTHREAD_COND_INITIALIZER;  /* Load finished */
+
+
+//
+// MEM_NAME() - Returns true if an image name is read into memory instead of
+//              being opened as a file.  These are "-" (standard input),
+//              "shm:<name>" (POSIX shared memory segment) and named pipes.
+//
+// Arguments:
+//      fname   - Text string of filename
+//
+// Return Value:
+//      TRUE    - Image is read into memory
+//      FALSE   - Regular file
+//
+
+bool    astro::mem_name(const char *fname)
+    {
+    struct stat st;
+
+    if (!strcmp(fname, "-") || !strncmp(fname, "shm:", 4)) return(true);
+    return(!stat(fname, &st) && S_ISFIFO(st.st_mode));
+    }
+
+
+//
+// MEM_READ() - Reads a stream to its end into a malloc() buffer
+//
+// Arguments:
+//      fd      - File descriptor of the stream
+//      m       - Receives the buffer and its size
+//
+// Return Value:
+//      ASTRO_SUCCESS   - Stream read
+//      ASTRO_FAILURE   - Read or allocation error
+//
+
+static  int     mem_read(int fd, mem_img *m)
+    {
+    size_t  cap=0;         /* Allocated size of the buffer                   */
+    ssize_t got;           /* Bytes of the last read                         */
+    char    *grow;         /* Resized buffer                                 */
+
+    m->buf=NULL;
+    m->size=0;
+    m->shm=0;
+
+    do
+        {
+        if (m->size == cap)
+            {
+            cap=cap ? 2*cap : 1<<20;
+            if ((grow=(char *) realloc(m->buf, cap)) == NULL)
+                {
+                free(m->buf);
+                m->buf=NULL;
+                return(ASTRO_FAILURE);
+                }
+            m->buf=grow;
+            }
+        if ((got=read(fd, (char *) m->buf+m->size, cap-m->size)) > 0) m->size+=got;
+        } while ((got > 0) || ((got < 0) && (errno == EINTR)));
+
+    if (got < 0)
+        {
+        free(m->buf);
+        m->buf=NULL;
+        return(ASTRO_FAILURE);
+        }
+
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// MEM_LOAD() - Reads an in memory image (see mem_name()) once.  Standard
+//              input and named pipes are read to their end, a shared memory
+//              segment is mapped read only (no copy).  A name that is being
+//              read by another thread is waited for.  The data must be a
+//              FITS file (uncompressed or tile compressed, not gzipped).
+//
+// Arguments:
+//      fname   - "-", "shm:<name>" or the path of a named pipe
+//
+// Return Value:
+//      ASTRO_SUCCESS   - Image in memory
+//      ASTRO_FAILURE   - Failure (astro_errno will be set with detailed code)
+//
+// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//
+
+int     astro::mem_load(const char *fname)
+    {
+    int         fd;
+    int         ret;
+    mem_img     m;
+    struct stat st;
+    std::string key(fname);
+    std::string seg;
+    std::map<std::string, mem_img>::iterator    e;
+
+    pthread_mutex_lock(&mem_lock);
+    while (((e=mem_imgs.find(key)) != mem_imgs.end()) && (e->second.buf == NULL)) pthread_cond_wait(&mem_cond, &mem_lock);
+    if (e != mem_imgs.end())
+        {
+        pthread_mutex_unlock(&mem_lock);
+        return(ASTRO_SUCCESS);
+        }
+    m.buf=NULL;
+    m.size=0;
+    m.shm=0;
+    mem_imgs[key]=m;
+    pthread_mutex_unlock(&mem_lock);
+
+//
+// Read or map it without holding the lock (a pipe may wait for its writer)
+//
+
+    ret=ASTRO_FAILURE;
+
+    if (!strncmp(fname, "shm:", 4))
+        {
+        seg=std::string(fname+4);
+        if (seg[0] != '/') seg="/"+seg;
+        if ((fd=shm_open(seg.c_str(), O_RDONLY, 0)) >= 0)
+            {
+            if (!fstat(fd, &st) && (st.st_size > 0))
+                {
+                m.size=(size_t)st.st_size;
+                if ((m.buf=mmap(NULL, m.size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) m.buf=NULL;
+                m.shm=1;
+                }
+            close(fd);
+            }
+        }
+    else if (!strcmp(fname, "-"))
+        {
+        mem_read(0, &m);
+        }
+    else if ((fd=open(fname, O_RDONLY)) >= 0)
+        {
+        mem_read(fd, &m);
+        close(fd);
+        }
+
+    if (m.buf && ((m.size < 2880) || strncmp((char *) m.buf, "SIMPLE  =", 9)))
+        {
+        if (astro_warn) printf("WARNING: astro::mem_load: %s Is Not a FITS Stream%s\n",fname,
+                               ((m.size > 1) && ((unsigned char *) m.buf)[0] == 0x1f) ? " (gzip is not supported)" : "");
+        if (m.shm) munmap(m.buf, m.size);
+        else free(m.buf);
+        m.buf=NULL;
+        }
+    else if (m.buf)
+        {
+        if (DEBUG) printf("DEBUG: astro::mem_load:%s %lu bytes\n",fname,(unsigned long)m.size);
+        ret=ASTRO_SUCCESS;
+        }
+    else if (astro_warn)
+        {
+        printf("WARNING: astro::mem_load: Can't Read %s (%s)\n",fname,strerror(errno));
+        }
+
+    pthread_mutex_lock(&mem_lock);
+    if (ret == ASTRO_SUCCESS) mem_imgs[key]=m;
+    else mem_imgs.erase(key);
+    pthread_cond_broadcast(&mem_cond);
+    pthread_mutex_unlock(&mem_lock);
+
+    if (ret != ASTRO_SUCCESS) set_astro_errno(ASTRO_ERR_OPEN);
+    return(ret);
+    }
+
+
+//
+// MEM_FREE() - Releases an in memory image once it is no longer needed.  A
+//              shared memory segment is only unmapped, removing it is left
+//              to the process that made it.
+//
+// Arguments:
+//      fname   - Name the image was loaded with
+//
+// Return Value: NONE
+//
+
+void    astro::mem_free(const char *fname)
+    {
+    std::map<std::string, mem_img>::iterator    e;
+
+    pthread_mutex_lock(&mem_lock);
+    if (((e=mem_imgs.find(std::string(fname))) != mem_imgs.end()) && e->second.buf)
+        {
+        if (e->second.shm) munmap(e->second.buf, e->second.size);
+        else free(e->second.buf);
+        mem_imgs.erase(e);
+        }
+    pthread_mutex_unlock(&mem_lock);
+    }
+
+
+//
+// FITS_OPEN_ANY() - Opens a FITS file for reading, or an in memory image
+//                   through the CFITSIO memory driver (loading it first if
+//                   needed).  With image set it moves to the first HDU with
+//                   an image, like fits_open_image().
+//
+// Arguments:
+//      fptr    - Receives the CFITSIO handle
+//      fname   - Text filename (or in memory image name, see mem_name())
+//      image   - 1 to move to the first image HDU, 0 to stay on the primary
+//      status  - CFITSIO status
+//
+// Return Value:
+//      CFITSIO status (0 for success)
+//
+
+int     astro::fits_open_any(fitsfile **fptr, const char *fname, int image, int *status)
+    {
+    int         h;
+    int         naxis=0;
+    int         hdutype;
+    int         nhdus=0;
+    mem_img     *m;
+
+    if (*status) return(*status);
+
+    if (!mem_name(fname))
+        {
+        if (image) return(fits_open_image(fptr, fname, READONLY, status));
+        return(fits_open_file(fptr, fname, READONLY, status));
+        }
+
+    if (mem_load(fname)) return(*status=FILE_NOT_OPENED);
+
+//
+// The table entry is not removed until mem_free(), and CFITSIO keeps the
+//   address of buf and size, so they are passed from the entry itself
+//
+
+    pthread_mutex_lock(&mem_lock);
+    m=&mem_imgs[std::string(fname)];
+    pthread_mutex_unlock(&mem_lock);
+
+    if (fits_open_memfile(fptr, fname, READONLY, &m->buf, &m->size, 0, NULL, status)) return(*status);
+    if (!image) return(0);
+
+    fits_get_img_dim(*fptr, &naxis, status);
+    if (naxis > 0) return(*status);
+
+    fits_get_num_hdus(*fptr, &nhdus, status);
+    for (h=2; (h <= nhdus) && !*status; h++)
+        {
+        if (fits_movabs_hdu(*fptr, h, &hdutype, status)) break;
+        if (hdutype == IMAGE_HDU) return(*status);
+        }
+
+    if (!*status) *status=NOT_IMAGE;
+    h=0;
+    fits_close_file(*fptr, &h);
+    return(*status);
+    }
+
+
 //
 //   READ_LINES() - Reads the contents of file and populates the file_rec
 //                  structure with the results.
@@ -242,8 +718,8 @@ bool    astro::file_exists(const char *fname)
 
 int     astro::read_lines(std::string fname, std::vector<file_rec> *rec)
     {
-    int         x, y;
     int         calc_rad;
+    size_t      pos;
     std::string token;
 
 //
@@ -342,39 +818,28 @@ int     astro::read_lines(std::string fname, std::vector<file_rec> *rec)
         f.keyword ="outi";
         std::getline(ss, token, ',');
 
-        if ((calc_rad==1) || (token.empty()))
-            {
-//
-// There is no radius specified, so either need to read it or calculate it
-//
-// Determine if it's a text file by trying to read the header
-//
-
-            if (fits_dims(f.name, &x, &y))
-                {
 //
-// It's not a binary FITS file, so set it to -1  and P2DFFT will calculate
-//  the size
+// If the radius column holds an option, there is no radius
 //
 
-                if (DEBUG) std::cout << "DEBUG: Provisional Header Radius: -1" << std::endl;
-                f.binary = 0;
-                f.radius = -1;
-                f.valid = 0;
-                }
+        pos=token.find_first_not_of(" \t");
+        if ((pos != std::string::npos) && !isdigit((unsigned char)token[pos]))
+            {
+            read_option(token, &f);
+            token.clear();
+            }
 
-            else
-                {
+        if ((calc_rad==1) || (token.empty()))
+            {
 //
-// Valid FITS header, now populate the structure.
+// There is no radius specified.  The file is not opened here, prescan()
+//   reads the headers of all files in parallel and sets the radius.
 //
 
-                f.binary=1;
-
-                if (DEBUG) std::cout << "DEBUG: Read Header Radius: " << x << " So " << (x-1)/2 << std::endl;
-                f.radius=(x-1)/2;
-                f.valid=1;
-                }
+            if (DEBUG) std::cout << "DEBUG: Provisional Header Radius: -1" << std::endl;
+            f.binary = 0;
+            f.radius = -1;
+            f.valid = 0;
             }
         else
             {
@@ -396,6 +861,14 @@ int     astro::read_lines(std::string fname, std::vector<file_rec> *rec)
             if (DEBUG) std::cout << "DEBUG: File Header Radius: " << f.radius << std::endl;
             }
         token.clear();
+
+//
+// Anything left on the line is per item options
+//
+
+        while (std::getline(ss, token, ',')) read_option(token, &f);
+
+        token.clear();
         rec->push_back(f);
         }
 
@@ -404,456 +877,2480 @@ int     astro::read_lines(std::string fname, std::vector<file_rec> *rec)
 
 
 //
-// FITS_DIMS() - Reads the FITS header of a file and returns the rows and
-//               columns in the file.  This routine currently assumes only
-//               two axes.
+// READ_OPTION() - Parses one per item option from an input file line and
+//                 sets it in the file_rec.  Options are a keyword, or
+//                 keyword=value:
 //
-//               PLEASE NOTE: FITS and C/C++ have different senses of 
-//               slowest and fastest varying dimensions (they are opposite).
-//               This function preserves FITS ordering of the dimensions.
+//                   mask=0|1|none  Same as -m 0 / -m 1, or no masking
+//                   fixed=<size>   Same as -f <size> (fixed=0 turns it off)
+//                   reverse        Same as -r
+//                   highpass       Same as -h
+//                   zero           Same as -z
+//                   center=<x>:<y> Image center (FITS pixels, 1 based)
+//                   rmin=<r>       First inner radius to calculate
+//                   rmax=<r>       Last radius to calculate
+//                   badpix=<file>  Bad pixel/star mask (see badpix_read()),
+//                                  badpix=none for no mask
+//
+//                 The keywords reverse, highpass and zero also take =0 or
+//                 =1.  Options that are not given use the command line.
 //
 // Arguments:
-//      fname   - Text string of filename to be read
-//      rows    - Number of rows (X dimension, fastest changing index)
-//      columns - Number of columns (Y dimension, slowest changing index)
+//      opt     - Option text
+//      f       - Pointer to the file_rec to set
 //
 // Return Value:
-//      ASTRO_SUCCESS  - Success getting values
-//      ASTRO_FAILURE  - Failure
+//      ASTRO_SUCCESS   - Option set
+//      ASTRO_FAILURE   - Unknown option or bad value (option ignored)
 //
-// Errors:  Function will set astro_errno with return code (see astro_class.h)
-//
-
-int     astro::fits_dims(std::string fname, int *rows, int *cols)
 
+int     astro::read_option(std::string opt, file_rec *f)
     {
-    int         status=0;
-    char        err_text[81];
-    char        *file;
-    long        naxes[2];
-    fitsfile    *dim_p=NULL;
+    int         v;
+    int         x, y;
+    size_t      a, b;
+    std::string key;
+    std::string val;
 
-    file=(char *) fname.c_str();
-    if (fits_open_file(&dim_p, file, READONLY, &status))
+    a=opt.find_first_not_of(" \t");
+    b=opt.find_last_not_of(" \t\r");
+    if (a == std::string::npos) return(ASTRO_SUCCESS);
+    opt=opt.substr(a, b-a+1);
+
+    if ((a=opt.find('=')) != std::string::npos)
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_dims:fits_open_file() Error %d: %s\n", status, err_text);
-        set_astro_errno(ASTRO_ERR_OPEN);
-        return(ASTRO_FAILURE);
+        key=opt.substr(0, a);
+        val=opt.substr(a+1);
         }
-
-    if (fits_get_img_size(dim_p, 2, naxes, &status))
+    else
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_dims:fits_get_img_size() Error %d: %s\n", status, err_text);
-        fits_close_file(dim_p, &status);
-        set_astro_errno(ASTRO_ERR_GET_SIZE);
-        return(ASTRO_FAILURE);
+        key=opt;
+        val="1";
         }
 
-    *rows=(int)naxes[0];
-    *cols=(int)naxes[1];
-
-    if (DEBUG) printf("DEBUG: rows =%d:cols=%d:\n",*rows,*cols);
+    v=atoi(val.c_str());
 
-    if (fits_close_file(dim_p, &status))
+    if (key == "mask")
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_dims:fits_close_file() Error %d: %s\n", status, err_text);
-        set_astro_errno(ASTRO_ERR_CLOSE);
-        return(ASTRO_FAILURE);
+        f->mask=(val == "none") ? 0 : ((v != 0) ? 2 : 1);
+        }
+    else if (key == "fixed")
+        {
+        f->fixed=v;
+        }
+    else if (key == "reverse")
+        {
+        f->reverse=(v != 0);
+        }
+    else if (key == "highpass")
+        {
+        f->highpass=(v != 0);
+        }
+    else if (key == "zero")
+        {
+        f->zero=(v != 0);
+        }
+    else if ((key == "center") && (sscanf(val.c_str(), "%d:%d", &x, &y) == 2) && (x > 0) && (y > 0))
+        {
+        f->x_ctr=x;
+        f->y_ctr=y;
+        }
+    else if ((key == "rmin") && (v > 0))
+        {
+        f->rmin=v;
+        }
+    else if ((key == "rmax") && (v > 0))
+        {
+        f->rmax=v;
+        }
+    else if ((key == "badpix") && !val.empty())
+        {
+        f->badpix=val;
+        }
+    else
+        {
+        if (astro_warn) printf("WARNING: astro::read_option: Invalid Option %s for %s\n",opt.c_str(),f->name.c_str());
+        set_astro_errno(ASTRO_ERR_OPTION);
+        return(ASTRO_FAILURE);
         }
 
+    if (DEBUG) std::cout << "DEBUG: Option " << key << "=" << val << " for " << f->name << std::endl;
+
     return(ASTRO_SUCCESS);
     }
 
 
 //
-// FITS_HEADER_READ() - Reads all fields of the FITS header and returns a
-//                      character array with the information (on record per
-//                      string)
+// REGION_SHAPE() - Sets (or with excl clears) the mask bits of the pixels
+//                  inside one DS9 region shape.  A pixel is inside when its
+//                  center is.  Angles are degrees counterclockwise from the
+//                  X axis, as DS9 writes them.
 //
 // Arguments:
-//      fname   - Test string with FITS filename to be read
-//      nkey    - Pointer to variable which will contain the number of keys
-//                (fields) in the header
+//      shape   - Shape name (circle, ellipse, box or polygon)
+//      a       - Shape values (image pixels, 1 based)
+//      excl    - Clear the bits instead of setting them (-shape)
+//      xnum    - X dimension of the image
+//      ynum    - Y dimension of the image
+//      bm      - Mask ([x][y], 1 based)
 //
 // Return Value:
-//      char ** - Array of strings (one string per header record/field)
-//
-// Errors:  Function will return NULL andset astro_errno with return code
-//          (see astro_class.h)
+//      ASTRO_SUCCESS   - Shape applied
+//      ASTRO_FAILURE   - Unknown shape or wrong number of values
 //
 
-char    **astro::fits_header_read(char *fname, int *nkeys)
+static int region_shape(const std::string &shape, const std::vector<double> &a, int excl, int xnum, int ynum, BitMask *bm)
     {
-    int         i, pos, status=0;
-    char        card[2048];
-    char        err_text[81];
-    char        **hdr_blk;
-    fitsfile    *hdr_p=NULL;
-
-    if (DEBUG) printf("DEBUG: astro::fits_header_read:Call fits_open_file()\n");
-
-    if (fits_open_file(&hdr_p, fname, READONLY, &status)) 
+    int     i, j, k, n;
+    int     in;            /* Pixel center is inside the shape               */
+    int     x_lo, x_hi, y_lo, y_hi; /* Pixels to test                        */
+    double  ext;           /* Half size of the square holding the shape      */
+    double  ca=1.0, sa=0.0;    /* Cosine and sine of the shape angle         */
+    double  dx, dy, u, v;
+
+    if ((shape == "circle") && (a.size() >= 3))
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_header_read:fits_open_file() Error %d: %s\n", status, err_text);
-        set_astro_errno(ASTRO_ERR_OPEN);
-        return(NULL);
+        ext=a[2];
         }
-         
-    if (DEBUG) printf("DEBUG: astro::fits_header_read:Call fits_get_hdrpos()\n");
-
-    if (fits_get_hdrpos(hdr_p, nkeys, &pos, &status))
+    else if (((shape == "ellipse") || (shape == "box")) && (a.size() >= 4))
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_header_read:fits_get_hdrpos() Error %d: %s\n", status, err_text);
-        fits_close_file(hdr_p, &status);
-        set_astro_errno(ASTRO_ERR_HDR_POS);
-        return(NULL);
+        if (a.size() >= 5)
+            {
+            ca=cos(a[4]*(PI/180.0));
+            sa=sin(a[4]*(PI/180.0));
+            }
+        ext=(shape == "box") ? 0.5*sqrt(a[2]*a[2]+a[3]*a[3]) : std::max(a[2], a[3]);
         }
-
-//
-// Allocate memory for return value
-//
-
-    if (DEBUG)
+    else if ((shape == "polygon") && (a.size() >= 6))
         {
-        printf("DEBUG: astro::fits_header_read:Call ArrayAlloc()\n");
+        ext=0.0;
+        for (k=0; k+1 < (int) a.size(); k+=2) ext=std::max(ext, std::max(fabs(a[k]-a[0]), fabs(a[k+1]-a[1])));
         }
-
-    if ((hdr_blk=CArrayAlloc(*nkeys, 2048))==NULL)
+    else
         {
-        if (astro_warn) printf("WARNING: astro::fits_header_read:CArrayAlloc() Error\n");
-        fits_close_file(hdr_p, &status);
-        set_astro_errno(ASTRO_ERR_MALLOC);
-        return(NULL);
+        return(ASTRO_FAILURE);
         }
 
-    if (DEBUG)
-        {
-        printf("DEBUG: astro::fits_header_read:Keys=%d, hdr_blk=%p,%p\n",*nkeys,hdr_blk,hdr_blk[0]);
-        printf("DEBUG: astro::fits_header_read:Start read_record loop\n");
-        }
+    x_lo=std::max(1, (int) floor(a[0]-ext));
+    x_hi=std::min(xnum, (int) ceil(a[0]+ext));
+    y_lo=std::max(1, (int) floor(a[1]-ext));
+    y_hi=std::min(ynum, (int) ceil(a[1]+ext));
 
-    for (i=1; i <= *nkeys; i++)
+    for (i=x_lo; i <= x_hi; i++)
         {
-        if (fits_read_record(hdr_p, i, card, &status))
+        for (j=y_lo; j <= y_hi; j++)
             {
-            fits_get_errstatus(status,err_text);
-            if (astro_warn) printf("WARNING: astro::fits_header_read:fits_read_record() Error %d: %s\n", status, err_text);
-            free(hdr_blk);
-            fits_close_file(hdr_p, &status);
-            set_astro_errno(ASTRO_ERR_RD_REC);
-            return(NULL);
-            }
+            dx=(double) i-a[0];
+            dy=(double) j-a[1];
+            u=dx*ca+dy*sa;
+            v=dy*ca-dx*sa;
 
-        if (DEBUG) printf("DEBUG: %d:**%s**\n",i,card);
-        strncpy(hdr_blk[i-1],card,2048);
-        }
+            if (shape == "circle")
+                {
+                in=(dx*dx+dy*dy <= a[2]*a[2]);
+                }
+            else if (shape == "ellipse")
+                {
+                in=((u*u)/(a[2]*a[2])+(v*v)/(a[3]*a[3]) <= 1.0);
+                }
+            else if (shape == "box")
+                {
+                in=((fabs(u) <= 0.5*a[2]) && (fabs(v) <= 0.5*a[3]));
+                }
+            else
+                {
+//
+// Polygon (even-odd rule)
+//
+                in=0;
+                n=(int) a.size()/2;
+                for (k=0; k < n; k++)
+                    {
+                    const double *p=&a[2*k];
+                    const double *q=&a[2*((k+n-1)%n)];
 
-    if (DEBUG) printf("DEBUG: astro::fits_header_read:Call fits_close_file()\n");
+                    if (((p[1] > j) != (q[1] > j)) && (i < (q[0]-p[0])*(j-p[1])/(q[1]-p[1])+p[0])) in=!in;
+                    }
+                }
 
-    if (fits_close_file(hdr_p, &status))
-        {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_header_read:fits_close_file() Error %d: %s\n", status, err_text);
-        free(hdr_blk);
-        set_astro_errno(ASTRO_ERR_CLOSE);
-        return(NULL);
+            if (in)
+                {
+                if (excl) bm->clear(i, j);
+                else bm->set(i, j);
+                }
+            }
         }
 
-    return(hdr_blk);
+    return(ASTRO_SUCCESS);
     }
 
 
 //
-// FITS_HEADER_WRITE() - Routine to write one or more keys to a FITS file
+// BADPIX_READ() - Reads a bad pixel/star mask for an image of xnum x ynum
+//                 pixels into a packed mask.  The file is either:
+//
+//                   <file>.reg - DS9 region file in image coordinates.  The
+//                                circle, ellipse, box and polygon shapes are
+//                                masked; a shape written -shape(...) (DS9
+//                                exclude) unmasks its pixels again.  Shapes
+//                                are applied in the order of the file.
+//                   FITS image - Of the same size as the image; pixels that
+//                                are not 0 (or are NaN) are masked.
+//
+//                 The mask has the [x][y] layout (1 based) of the mat arrays
+//                 of p2dfft, so bm->test(x, y) is pixel (x, y) of the image.
 //
 // Arguments:
-//      fname   - Text filename for FITS file to be written
-//      keys    - Array of strings with the key names to be written
-//      items   - Array of strings containing the value for each key
-//      num     - number of keys to be written
+//      fname   - Mask file name
+//      xnum    - X dimension of the image
+//      ynum    - Y dimension of the image
+//      bm      - Mask (allocated to xnum+1 x ynum+1)
 //
 // Return Value:
-//      ASTRO_SUCCESS - All keys written successfully
-//      ASTRO_FAILURE - Error writing one or more keys
+//      ASTRO_SUCCESS   - Success
+//      ASTRO_FAILURE   - Failure (astro_errno will be set with detailed code)
 //
 // Errors:  Function will set astro_errno with return code (see astro_class.h)
 //
 
-int    astro::fits_header_write(char *fname, char keys[][32], char items[][80], int num)
+int     astro::badpix_read(char *fname, int xnum, int ynum, BitMask *bm)
     {
-    int         i;
-    int         status=0;
-    char        err_text[81];
-    fitsfile    *fptr=NULL;
+    int         x, y;
+    int         line_num=0;
+    int         wcs=0;     /* Shapes are in sky coordinates (not supported)  */
+    int         excl;      /* Shape is a DS9 exclude shape                   */
+    size_t      n=strlen(fname);
+    size_t      a, b;
+    std::string line;
+    std::string item;
+    std::string shape;
+    std::vector<double> val;
+    Image2D<float>      img;
+
+    if (bm->alloc((long) xnum+1, (long) ynum+1))
+        {
+        if (astro_warn) printf("WARNING: astro::badpix_read: Mask alloc() Error\n");
+        set_astro_errno(ASTRO_ERR_MALLOC);
+        return(ASTRO_FAILURE);
+        }
 
 //
-// Open the file for read/write
+// Mask image
 //
 
-    if (DEBUG) printf("DEBUG: astro::fits_header_write:fits_open_file\n");
+    if ((n < 4) || (strcasecmp(fname+n-4, ".reg") != 0))
+        {
+        if (fits_read(fname, &img)) return(ASTRO_FAILURE);
 
-    if (fits_open_file(&fptr, fname, READWRITE, &status))
+        if ((img.cols() != xnum) || (img.rows() != ynum))
+            {
+            if (astro_warn) printf("WARNING: astro::badpix_read: Mask %s is %ldx%ld, Image is %dx%d\n",fname,img.cols(),img.rows(),xnum,ynum);
+            set_astro_errno(ASTRO_ERR_SIZE);
+            return(ASTRO_FAILURE);
+            }
+
+        for (y=0; y < ynum; y++)
+            {
+            for (x=0; x < xnum; x++)
+                {
+                if (!(img[y][x] == 0.0)) bm->set(x+1, y+1);
+                }
+            }
+
+        return(ASTRO_SUCCESS);
+        }
+
+//
+// DS9 region file.  Every line holds one or more items separated by ';' and
+//   anything after a '#' is a comment.
+//
+
+    std::ifstream   fs(fname);
+
+    if (!fs.good())
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_header_write:open() Error %d: %s\n",status,err_text);
+        if (astro_warn) printf("WARNING: astro::badpix_read: Filename Error %s\n",fname);
         set_astro_errno(ASTRO_ERR_OPEN);
         return(ASTRO_FAILURE);
         }
 
+    while (std::getline(fs, line))
+        {
+        line_num++;
+        if ((a=line.find('#')) != std::string::npos) line.erase(a);
+
+        std::istringstream  ss(line);
+
+        while (std::getline(ss, item, ';'))
+            {
+            a=item.find_first_not_of(" \t\r");
+            if (a == std::string::npos) continue;
+            item=item.substr(a);
+            for (a=0; a < item.size(); a++) item[a]=tolower((unsigned char) item[a]);
+
 //
-// Loop through the keys
+// Coordinate systems and global settings
 //
 
-    for (i=0; i<num; i++)
-        {
-        if (fits_write_key(fptr, TSTRING, keys[i], items[i], NULL, &status))
-            {
-            fits_get_errstatus(status,err_text);
-            if (astro_warn) printf("WARNING: astro::fits_header_write:fits_write_key() Error %d: %s\n", status, err_text);
-            set_astro_errno(ASTRO_ERR_KEY);
-            return(ASTRO_FAILURE);
+            if ((item.compare(0, 5, "image") == 0) || (item.compare(0, 8, "physical") == 0))
+                {
+                wcs=0;
+                continue;
+                }
+            if ((item.compare(0, 3, "fk4") == 0) || (item.compare(0, 3, "fk5") == 0) || (item.compare(0, 4, "icrs") == 0) ||
+                (item.compare(0, 8, "galactic") == 0) || (item.compare(0, 8, "ecliptic") == 0) || (item.compare(0, 3, "wcs") == 0) ||
+                (item.compare(0, 6, "linear") == 0))
+                {
+                wcs=1;
+                continue;
+                }
+            if (item.compare(0, 6, "global") == 0) continue;
+
+//
+// Shape: [+|-]name(value, value, ...)
+//
+
+            excl=(item[0] == '-');
+            if ((item[0] == '-') || (item[0] == '+')) item.erase(0, 1);
+
+            if (((a=item.find('(')) == std::string::npos) || ((b=item.find(')', a)) == std::string::npos))
+                {
+                if (astro_warn) printf("WARNING: astro::badpix_read: Can't Read Line %d of %s\n",line_num,fname);
+                set_astro_errno(ASTRO_ERR_REGION);
+                continue;
+                }
+
+            shape=item.substr(0, item.find_last_not_of(" \t", a-1)+1);
+            std::string         args=item.substr(a+1, b-a-1);
+            std::replace(args.begin(), args.end(), ',', ' ');
+            std::istringstream  vs(args);
+            double              d;
+
+            val.clear();
+            while (vs >> d) val.push_back(d);
+
+            if (wcs)
+                {
+                if (astro_warn) printf("WARNING: astro::badpix_read: Line %d of %s is not in image coordinates...Skipping\n",line_num,fname);
+                set_astro_errno(ASTRO_ERR_REGION);
+                continue;
+                }
+
+            if (region_shape(shape, val, excl, xnum, ynum, bm))
+                {
+                if (astro_warn) printf("WARNING: astro::badpix_read: Unknown Shape %s on Line %d of %s\n",shape.c_str(),line_num,fname);
+                set_astro_errno(ASTRO_ERR_REGION);
+                }
             }
         }
 
-    if (fits_close_file(fptr, &status))
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_META() - Reads the header information of a file into a file_rec:
+//               the dimensions, BITPIX and compression of the first image
+//               and the number of image planes in the whole file.  If the
+//               file is not a FITS file it is marked as a text file.
+//
+// Arguments:
+//      f       - Pointer to the file_rec to fill in
+//
+// Return Value:
+//      ASTRO_SUCCESS   - FITS header read
+//      ASTRO_FAILURE   - Not a FITS file (f->binary is set to 0)
+//
+
+int     astro::fits_meta(file_rec *f)
+    {
+    int         h;
+    int         status=0;
+    int         nhdus=0;
+    int         naxis;
+    int         bitpix;
+    int         hdutype;
+    long        naxes[3];
+    fitsfile    *fptr=NULL;
+
+    f->binary=0;
+    f->nimg=0;
+
+    if (fits_open_any(&fptr, f->name.c_str(), 0, &status)) return(ASTRO_FAILURE);
+
+    f->binary=1;
+    fits_get_num_hdus(fptr, &nhdus, &status);
+
+    for (h=1; (h <= nhdus) && !status; h++)
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_header_write:fits_close_file() Error %d: %s\n", status, err_text);
-        set_astro_errno(ASTRO_ERR_CLOSE);
-        return(ASTRO_FAILURE);
+        naxis=0;
+        naxes[0]=naxes[1]=naxes[2]=1;
+        if (fits_movabs_hdu(fptr, h, &hdutype, &status)) break;
+        if (hdutype != IMAGE_HDU) continue;
+        if (fits_get_img_param(fptr, 3, &bitpix, &naxis, naxes, &status)) break;
+        if ((naxis < 2) || (naxes[0] < 1) || (naxes[1] < 1)) continue;
+        if (f->nimg == 0)
+            {
+            f->xnum=(int)naxes[0];
+            f->ynum=(int)naxes[1];
+            f->bitpix=bitpix;
+            f->compressed=fits_is_compressed_image(fptr, &status);
+            }
+        f->nimg+=(naxis > 2) ? (int)naxes[2] : 1;
         }
 
+    status=0;
+    fits_close_file(fptr, &status);
     return(ASTRO_SUCCESS);
     }
 
 
 //
-// FITS_READ() - Reads the image data from a 2D binary FITS file and returns
-//               it in one dimensional array.   All the data read will be
-//               converted to floating point format regardless of it's 
-//               encoding in the FITS file.   
+// PRESCAN() - Reads the header information of every entry of a file_rec
+//             list in parallel (see fits_meta()) and sets the radius of the
+//             entries that do not have one.  The information is kept in a
+//             sidecar file so later runs only read the headers of files
+//             that changed (by modification time or size).  The sidecar is
+//             a text file with one tab separated line per file:
 //
-//               PLEASE NOTE:  The sense of indices will be preserved.  The
-//               fastest varying index will be rows and the slowest varying
-//               index will be columns.  This is opposite of how C/C++ usually
-//               manages these.
+//               name mtime size binary xnum ynum bitpix compressed nimg
 //
-//               PLEASE ALSO NOTE:  FITS files will start data at index 1,
-//               not zero.  Size will be set to the number of entries, but
-//               this means the array in C will go from [0...size], instead
-//               [0...size-1].
+//             CFITSIO must be re-entrant to read the headers in parallel.
+//             If it is not, they are read one at a time.  In memory images
+//             (standard input, pipes and shared memory) are loaded first,
+//             one at a time, so astro_errno is only set outside the
+//             parallel loop (the threads share it).
 //
 // Arguments:
-//      fname   - Text filename for FITS file to be read
-//      size    - Pointer to variable that will be set to the number of data
-//                entries in the return array.
+//      rec     - Pointer to vector (array) of file_rec structs (astro_class.h)
+//      meta    - Name of the sidecar file (empty for no sidecar)
 //
 // Return Value:
-//      float * - pointer to base of one dimensional array with image data
-//                NOTE: <FIX>
-//
-// Errors:  Function will return NULL and set astro_errno with return code
-//          (see astro_class.h)
+//      Number of entries found unchanged in the sidecar
 //
 
-float   *astro::fits_read(char *fname, int *size)
+int     astro::prescan(std::vector<file_rec> *rec, std::string meta)
     {
-    int         i, xnum, ynum, status=0;
-    long        nelements, fpixel[2];
-    char        err_text[81];
-    float       *data;
-    fitsfile    *p=NULL;
+    int         i;
+    int         n;
+    int         hits=0;
+    FILE        *fp;
+    std::string line;
+    std::map<std::string, file_rec>     cache;
 
 //
-// Get Actual size of data in file.  Don't set astro_errno here because 
-//   fits_dims() will set it appropriately if there is a problem.
+// Load the sidecar, if there is one
 //
 
-    if (fits_dims(fname, &xnum, &ynum))
+    std::ifstream   fs(meta.c_str());
+
+    while (!meta.empty() && std::getline(fs, line))
         {
-        if (astro_warn) printf("WARNING: astro::fits_read:fits_dims() Error\n");
-        return(NULL);
+        file_rec    c;
+        std::istringstream  ss(line);
+
+        if (!std::getline(ss, c.name, '\t')) continue;
+        if (ss >> c.mtime >> c.bytes >> c.binary >> c.xnum >> c.ynum >> c.bitpix >> c.compressed >> c.nimg) cache[c.name]=c;
         }
 
-        if (DEBUG) printf("DEBUG: astro::fits_read:dims xnum=%d, ynum=%d\n",xnum,ynum);
+    if (DEBUG) printf("DEBUG: astro::prescan() %u cached entries\n",(unsigned int)cache.size());
 
 //
-// Open the file for reading
+// In memory images are not in the sidecar.  They are read here once, before
+//   the parallel loop, because loading them sets astro_errno on failure.
 //
 
-    if (fits_open_file(&p, fname, READONLY, &status)) 
+    n=(int)rec->size();
+
+    for (i=0; i < n; i++)
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_read:fits_open_file() Error %d: %s\n",status,err_text);
-        set_astro_errno(ASTRO_ERR_OPEN);
+        file_rec    *f=&(*rec)[i];
+
+        if (!f->region && mem_name(f->name.c_str())) fits_meta(f);
+        }
+
+//
+// Read the headers that are not cached.  The cache is only read here, so it
+//   can be shared by the threads.  fits_meta() of a file does not change
+//   astro_errno.
+//
+
+#pragma omp parallel for schedule(dynamic) reduction(+:hits) if (fits_is_reentrant())
+    for (i=0; i < n; i++)
+        {
+        file_rec        *f=&(*rec)[i];
+        struct stat     st;
+        std::map<std::string, file_rec>::const_iterator     c;
+
+        if (f->region || mem_name(f->name.c_str())) continue;
+
+        if (stat(f->name.c_str(), &st)) continue;
+
+        c=cache.find(f->name);
+        if ((c != cache.end()) && (c->second.mtime == (long)st.st_mtime) && (c->second.bytes == (long)st.st_size))
+            {
+            f->binary=c->second.binary;
+            f->xnum=c->second.xnum;
+            f->ynum=c->second.ynum;
+            f->bitpix=c->second.bitpix;
+            f->compressed=c->second.compressed;
+            f->nimg=c->second.nimg;
+            hits++;
+            }
+        else
+            {
+            fits_meta(f);
+            }
+        f->mtime=(long)st.st_mtime;
+        f->bytes=(long)st.st_size;
+        }
+
+//
+// Set the radius from the header the same way it used to be done when the
+//   manifest was read
+//
+
+    for (i=0; i < n; i++)
+        {
+        file_rec    *f=&(*rec)[i];
+
+        if (!f->valid && f->binary && (f->xnum > 0))
+            {
+            f->radius=(f->xnum-1)/2;
+            f->valid=1;
+            if (DEBUG) std::cout << "DEBUG: Read Header Radius: " << f->xnum << " So " << f->radius << std::endl;
+            }
+        }
+
+//
+// Write the sidecar with the current information
+//
+
+    if (!meta.empty())
+        {
+        if ((fp=fopen(meta.c_str(),"w")) == NULL)
+            {
+            if (astro_warn) printf("WARNING: astro::prescan: Can't Write %s\n",meta.c_str());
+            }
+        else
+            {
+            for (i=0; i < n; i++)
+                {
+                file_rec    *f=&(*rec)[i];
+
+                if (f->mtime == 0) continue;
+                fprintf(fp,"%s\t%ld\t%ld\t%d\t%d\t%d\t%d\t%d\t%d\n",f->name.c_str(),f->mtime,f->bytes,f->binary,f->xnum,f->ynum,f->bitpix,f->compressed,f->nimg);
+                }
+            fclose(fp);
+            }
+        }
+
+    return(hits);
+    }
+
+
+//
+//   READ_CATALOG() - Reads a catalog of regions within a single large mosaic
+//                    image and populates the file_rec structure with one
+//                    entry per region.  The format of each line is:
+//
+//                      x_center,y_center,radius,output_prefix
+//
+//                    The center is in FITS pixel coordinates (1 based).
+//                    Blank lines, lines starting with # and a header line
+//                    (first field not numeric) are ignored.  The name field
+//                    of each record is left empty and must be set to the
+//                    mosaic file name by the caller.
+//
+// Arguments:
+//      fname   - String with catalog file name to be read
+//      rec     - Pointer to vector (array) of file_rec structs (astro_class.h)
+//
+// Return Value:
+//      ASTRO_SUCCESS   - Success
+//      ASTRO_FAILURE   - Failure (astro_errno will be set with detailed code)
+//
+// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//
+
+int     astro::read_catalog(std::string fname, std::vector<file_rec> *rec)
+    {
+    int         line_num=0;
+    size_t      pos;
+    std::string line;
+    std::string token;
+
+    std::ifstream   fs(fname.c_str());
+
+    if (!fs.good())
+        {
+        if (astro_warn) printf("WARNING: astro::read_catalog: Filename Error\n");
+        set_astro_errno(ASTRO_ERR_OPEN);
+        return(ASTRO_FAILURE);
+        }
+
+    while (std::getline(fs, line))
+        {
+        line_num++;
+
+//
+// Ignore blank lines, comments and a header line
+//
+
+        if (line.empty() || (line[0] == '#')) continue;
+        pos=line.find_first_not_of(" \t\r");
+        if ((pos == std::string::npos) || !isdigit((unsigned char)line[pos])) continue;
+
+        file_rec            f;
+        std::istringstream  ss(line);
+
+        std::getline(ss, token, ',');
+        f.x_ctr=atoi(token.c_str());
+        std::getline(ss, token, ',');
+        f.y_ctr=atoi(token.c_str());
+        std::getline(ss, token, ',');
+        f.radius=atoi(token.c_str());
+        std::getline(ss, f.result, ',');
+
+//
+// Strip whitespace from the prefix (CSV files often have a space after
+//   the comma or a trailing carriage return)
+//
+
+        f.result.erase(0, f.result.find_first_not_of(" \t"));
+        f.result.erase(f.result.find_last_not_of(" \t\r\n")+1);
+
+        if ((f.x_ctr < 1) || (f.y_ctr < 1) || (f.radius < 2) || (f.radius > (MAX_DIM-1)/2) || f.result.empty())
+            {
+            if (astro_warn) printf("WARNING: astro::read_catalog: Invalid Entry on Line %d\n",line_num);
+            set_astro_errno(ASTRO_ERR_CATALOG);
+            continue;
+            }
+
+        f.keyword="outi";
+        f.binary=1;
+        f.region=1;
+        f.valid=1;
+
+        if (DEBUG) std::cout << "DEBUG: Catalog X: " << f.x_ctr << " Y: " << f.y_ctr << " Radius: " << f.radius << " Result: " << f.result << std::endl;
+
+        rec->push_back(f);
+        }
+
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_DIMS() - Reads the FITS header of a file and returns the rows and
+//               columns in the file.  This routine currently assumes only
+//               two axes (the first plane of a cube is used).  If the
+//               primary HDU is empty, the first image extension is used.
+//
+//               PLEASE NOTE: FITS and C/C++ have different senses of 
+//               slowest and fastest varying dimensions (they are opposite).
+//               This function preserves FITS ordering of the dimensions.
+//
+// Arguments:
+//      fname   - Text string of filename to be read
+//      rows    - Number of rows (X dimension, fastest changing index)
+//      columns - Number of columns (Y dimension, slowest changing index)
+//
+// Return Value:
+//      ASTRO_SUCCESS  - Success getting values
+//      ASTRO_FAILURE  - Failure
+//
+// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//
+
+int     astro::fits_dims(std::string fname, int *rows, int *cols)
+
+    {
+    int         status=0;
+    char        err_text[81];
+    char        *file;
+    long        naxes[2];
+    fitsfile    *dim_p=NULL;
+
+    file=(char *) fname.c_str();
+    if (fits_open_any(&dim_p, file, 1, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_dims:fits_open_image() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_OPEN);
+        return(ASTRO_FAILURE);
+        }
+
+    if (fits_get_img_size(dim_p, 2, naxes, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_dims:fits_get_img_size() Error %d: %s\n", status, err_text);
+        fits_close_file(dim_p, &status);
+        set_astro_errno(ASTRO_ERR_GET_SIZE);
+        return(ASTRO_FAILURE);
+        }
+
+    *rows=(int)naxes[0];
+    *cols=(int)naxes[1];
+
+    if (DEBUG) printf("DEBUG: rows =%d:cols=%d:\n",*rows,*cols);
+
+    if (fits_close_file(dim_p, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_dims:fits_close_file() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_CLOSE);
+        return(ASTRO_FAILURE);
+        }
+
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_EXPAND() - Expands the binary FITS entries of a file_rec list so that
+//                 every image plane is its own entry.  A file with NAXIS=3
+//                 gives one entry per plane and a multi-extension file gives
+//                 one entry per image HDU.  The result prefix of each new
+//                 entry has _h<hdu> and/or _p<plane> added so the output
+//                 files do not collide.  Files with a single 2D image are
+//                 left as they are.  Text files, mosaic regions and entries
+//                 that already have an HDU are not changed.  Each entry gets
+//                 the dimensions of its HDU, and an HDU whose size differs
+//                 from the header the radius was taken from gets the radius
+//                 that fits it.
+//
+// Arguments:
+//      rec     - Pointer to vector (array) of file_rec structs (astro_class.h)
+//
+// Return Value:
+//      Number of entries added to the list
+//
+
+int     astro::fits_expand(std::vector<file_rec> *rec)
+    {
+    int         h, p;
+    int         added=0;
+    int         status;
+    int         nhdus;
+    int         naxis;
+    int         bitpix;
+    int         hdutype;
+    long        naxes[3];
+    char        tag[32];
+    fitsfile    *fptr;
+    unsigned    int         it;
+    std::vector<int>        hdus;
+    std::vector<int>        planes;
+    std::vector<int>        xs, ys;
+    std::vector<file_rec>   out;
+
+    for (it=0; it < rec->size(); it++)
+        {
+        file_rec    f=(*rec)[it];
+
+        status=0;
+        fptr=NULL;
+        if (!f.binary || f.region || f.hdu || (f.nimg == 1) || fits_open_any(&fptr, f.name.c_str(), 0, &status))
+            {
+            out.push_back(f);
+            continue;
+            }
+
+//
+// Find all the image HDUs and the number of planes in each
+//
+
+        hdus.clear();
+        planes.clear();
+        xs.clear();
+        ys.clear();
+        fits_get_num_hdus(fptr, &nhdus, &status);
+
+        for (h=1; (h <= nhdus) && !status; h++)
+            {
+            naxis=0;
+            naxes[0]=naxes[1]=naxes[2]=1;
+            if (fits_movabs_hdu(fptr, h, &hdutype, &status)) break;
+            if (hdutype != IMAGE_HDU) continue;
+            if (fits_get_img_param(fptr, 3, &bitpix, &naxis, naxes, &status)) break;
+            if ((naxis < 2) || (naxes[0] < 1) || (naxes[1] < 1)) continue;
+            hdus.push_back(h);
+            planes.push_back((naxis > 2) ? (int)naxes[2] : 1);
+            xs.push_back((int)naxes[0]);
+            ys.push_back((int)naxes[1]);
+            }
+
+        fits_close_file(fptr, &status);
+
+        if ((hdus.size() == 0) || ((hdus.size() == 1) && (hdus[0] == 1) && (planes[0] == 1)))
+            {
+            out.push_back(f);
+            continue;
+            }
+
+        for (h=0; h < (int)hdus.size(); h++)
+            {
+            for (p=1; p <= planes[h]; p++)
+                {
+                file_rec    g=f;
+
+                g.hdu=hdus[h];
+                g.plane=p;
+                g.xnum=xs[h];
+                g.ynum=ys[h];
+                if ((xs[h] != f.xnum) || (ys[h] != f.ynum))
+                    {
+                    g.radius=(std::min(xs[h], ys[h])-1)/2;
+                    g.valid=1;
+                    }
+                if (hdus.size() > 1)
+                    {
+                    sprintf(tag,"_h%d",hdus[h]);
+                    g.result+=tag;
+                    }
+                if (planes[h] > 1)
+                    {
+                    sprintf(tag,"_p%d",p);
+                    g.result+=tag;
+                    }
+                if (DEBUG) std::cout << "DEBUG: Expand " << g.name << " HDU " << g.hdu << " Plane " << g.plane << " Result " << g.result << std::endl;
+                out.push_back(g);
+                added++;
+                }
+            }
+        added--;
+        }
+
+    rec->swap(out);
+    return(added);
+    }
+
+
+//
+// FITS_HEADER_READ() - Reads all fields of the FITS header and returns a
+//                      character array with the information (on record per
+//                      string)
+//
+// Arguments:
+//      fname   - Test string with FITS filename to be read
+//      nkey    - Pointer to variable which will contain the number of keys
+//                (fields) in the header
+//
+// Return Value:
+//      char ** - Array of strings (one string per header record/field)
+//
+// Errors:  Function will return NULL andset astro_errno with return code
+//          (see astro_class.h)
+//
+
+char    **astro::fits_header_read(char *fname, int *nkeys)
+    {
+    int         i, pos, status=0;
+    char        card[2048];
+    char        err_text[81];
+    char        **hdr_blk;
+    fitsfile    *hdr_p=NULL;
+
+    if (DEBUG) printf("DEBUG: astro::fits_header_read:Call fits_open_file()\n");
+
+    if (fits_open_any(&hdr_p, fname, 0, &status)) 
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_header_read:fits_open_file() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_OPEN);
         return(NULL);
         }
          
-    if (DEBUG) printf("DEBUG: astro::fits_read:fits_file_open\n");
+    if (DEBUG) printf("DEBUG: astro::fits_header_read:Call fits_get_hdrpos()\n");
+
+    if (fits_get_hdrpos(hdr_p, nkeys, &pos, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_header_read:fits_get_hdrpos() Error %d: %s\n", status, err_text);
+        fits_close_file(hdr_p, &status);
+        set_astro_errno(ASTRO_ERR_HDR_POS);
+        return(NULL);
+        }
 
 //
-// Allocate memory for the data reading buffer based on the size dimensions
+// Allocate memory for return value
 //
 
-    if ((data=(float *)malloc((xnum*ynum)*sizeof(float *)))==NULL)
+    if (DEBUG)
+        {
+        printf("DEBUG: astro::fits_header_read:Call ArrayAlloc()\n");
+        }
+
+    if ((hdr_blk=CArrayAlloc(*nkeys, 2048))==NULL)
+        {
+        if (astro_warn) printf("WARNING: astro::fits_header_read:CArrayAlloc() Error\n");
+        fits_close_file(hdr_p, &status);
+        set_astro_errno(ASTRO_ERR_MALLOC);
+        return(NULL);
+        }
+
+    if (DEBUG)
+        {
+        printf("DEBUG: astro::fits_header_read:Keys=%d, hdr_blk=%p,%p\n",*nkeys,hdr_blk,hdr_blk[0]);
+        printf("DEBUG: astro::fits_header_read:Start read_record loop\n");
+        }
+
+    for (i=1; i <= *nkeys; i++)
+        {
+        if (fits_read_record(hdr_p, i, card, &status))
+            {
+            fits_get_errstatus(status,err_text);
+            if (astro_warn) printf("WARNING: astro::fits_header_read:fits_read_record() Error %d: %s\n", status, err_text);
+            free(hdr_blk);
+            fits_close_file(hdr_p, &status);
+            set_astro_errno(ASTRO_ERR_RD_REC);
+            return(NULL);
+            }
+
+        if (DEBUG) printf("DEBUG: %d:**%s**\n",i,card);
+        strncpy(hdr_blk[i-1],card,2048);
+        }
+
+    if (DEBUG) printf("DEBUG: astro::fits_header_read:Call fits_close_file()\n");
+
+    if (fits_close_file(hdr_p, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_header_read:fits_close_file() Error %d: %s\n", status, err_text);
+        free(hdr_blk);
+        set_astro_errno(ASTRO_ERR_CLOSE);
+        return(NULL);
+        }
+
+    return(hdr_blk);
+    }
+
+
+//
+// FITS_HEADER_WRITE() - Routine to write one or more keys to a FITS file
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be written
+//      keys    - Array of strings with the key names to be written
+//      items   - Array of strings containing the value for each key
+//      num     - number of keys to be written
+//
+// Return Value:
+//      ASTRO_SUCCESS - All keys written successfully
+//      ASTRO_FAILURE - Error writing one or more keys
+//
+// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//
+
+int    astro::fits_header_write(char *fname, char keys[][32], char items[][80], int num)
+    {
+    int         i;
+    int         status=0;
+    char        err_text[81];
+    fitsfile    *fptr=NULL;
+
+//
+// Open the file for read/write
+//
+
+    if (DEBUG) printf("DEBUG: astro::fits_header_write:fits_open_file\n");
+
+    if (fits_open_file(&fptr, fname, READWRITE, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_header_write:open() Error %d: %s\n",status,err_text);
+        set_astro_errno(ASTRO_ERR_OPEN);
+        return(ASTRO_FAILURE);
+        }
+
+//
+// Loop through the keys
+//
+
+    for (i=0; i<num; i++)
+        {
+        if (fits_write_key(fptr, TSTRING, keys[i], items[i], NULL, &status))
+            {
+            fits_get_errstatus(status,err_text);
+            if (astro_warn) printf("WARNING: astro::fits_header_write:fits_write_key() Error %d: %s\n", status, err_text);
+            set_astro_errno(ASTRO_ERR_KEY);
+            return(ASTRO_FAILURE);
+            }
+        }
+
+    if (fits_close_file(fptr, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_header_write:fits_close_file() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_CLOSE);
+        return(ASTRO_FAILURE);
+        }
+
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_READ() - Reads the image data from a 2D binary FITS file and returns
+//               it in one dimensional array.   All the data read will be
+//               converted to floating point format regardless of it's 
+//               encoding in the FITS file.   
+//
+//               PLEASE NOTE:  The sense of indices will be preserved.  The
+//               fastest varying index will be rows and the slowest varying
+//               index will be columns.  This is opposite of how C/C++ usually
+//               manages these.
+//
+//               PLEASE ALSO NOTE:  FITS files will start data at index 1,
+//               not zero.  Size will be set to the number of entries, but
+//               this means the array in C will go from [0...size], instead
+//               [0...size-1].
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be read
+//      size    - Pointer to variable that will be set to the number of data
+//                entries in the return array.
+//
+// Return Value:
+//      float * - pointer to base of one dimensional array with image data
+//                NOTE: <FIX>
+//
+// Errors:  Function will return NULL and set astro_errno with return code
+//          (see astro_class.h)
+//
+
+float   *astro::fits_read(char *fname, int *size)
+    {
+    int         i, xnum, ynum, status=0;
+    long        nelements, fpixel[2];
+    char        err_text[81];
+    float       *data;
+    fitsfile    *p=NULL;
+
+//
+// Get Actual size of data in file.  Don't set astro_errno here because 
+//   fits_dims() will set it appropriately if there is a problem.
+//
+
+    if (fits_dims(fname, &xnum, &ynum))
+        {
+        if (astro_warn) printf("WARNING: astro::fits_read:fits_dims() Error\n");
+        return(NULL);
+        }
+
+        if (DEBUG) printf("DEBUG: astro::fits_read:dims xnum=%d, ynum=%d\n",xnum,ynum);
+
+//
+// Open the file for reading
+//
+
+    if (fits_open_any(&p, fname, 1, &status)) 
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_read:fits_open_image() Error %d: %s\n",status,err_text);
+        set_astro_errno(ASTRO_ERR_OPEN);
+        return(NULL);
+        }
+         
+    if (DEBUG) printf("DEBUG: astro::fits_read:fits_file_open\n");
+
+//
+// Allocate memory for the data reading buffer based on the size dimensions
+//
+
+    if ((data=(float *)malloc((xnum*ynum)*sizeof(float *)))==NULL)
+        {
+        if (astro_warn) printf("WARNING: astro::fits_read:malloc() Error\n");
+        fits_close_file(p, &status);
+        set_astro_errno(ASTRO_ERR_MALLOC);
+        return(NULL);
+        }
+
+    for (i=0; i< (xnum*ynum) ; i++) data[i]=0.0;
+
+    if (DEBUG) printf("DEBUG: astro::fits_read:malloc %zu (%d x %d x float size) bytes\n",xnum*ynum*sizeof(float),xnum,ynum);
+
+    fpixel[0]=fpixel[1]=(long) 1;
+    nelements=(long)(xnum*ynum);
+
+    if (fits_read_pix(p, TFLOAT, fpixel, nelements, NULL, data, NULL, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_read:fits_read_pix() Error %d: %s\n",status,err_text);
+        free(data);
+        fits_close_file(p, &status);
+        set_astro_errno(ASTRO_ERR_READPIX);
+        return(NULL);
+        }
+
+    if (fits_close_file(p, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_read:fits_close_file() Error %d: %s\n", status, err_text);
+        free(data);
+        set_astro_errno(ASTRO_ERR_CLOSE);
+        return(NULL);
+        }
+    *size=xnum*ynum;
+    return(data);
+    }
+
+
+//
+// FITS_READ() - Reads a 2D binary FITS file into an Image2D.  The rows of
+//               the image are the FITS rows (NAXIS2), so img[y-1][x-1] is
+//               pixel (x, y) of the file.
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be read
+//      img     - Image (allocated to the size of the file)
+//
+// Return Value:
+//      ASTRO_SUCCESS   - Success
+//      ASTRO_FAILURE   - Failure (astro_errno will be set with detailed code)
+//
+
+int     astro::fits_read(char *fname, Image2D<float> *img)
+    {
+    int         r;
+    int         xnum, ynum;
+    int         status=0;
+    long        fpixel[2];
+    char        err_text[81];
+    fitsfile    *p;
+
+    if (!(p=fits_open(fname, &xnum, &ynum))) return(ASTRO_FAILURE);
+
+    if (img->alloc(ynum, xnum))
+        {
+        if (astro_warn) printf("WARNING: astro::fits_read:Image2D alloc() Error\n");
+        fits_close_file(p, &status);
+        set_astro_errno(ASTRO_ERR_MALLOC);
+        return(ASTRO_FAILURE);
+        }
+
+    for (r=0; r < ynum; r++)
+        {
+        fpixel[0]=1;
+        fpixel[1]=r+1;
+        if (fits_read_pix(p, TFLOAT, fpixel, (long)xnum, NULL, (*img)[r], NULL, &status))
+            {
+            fits_get_errstatus(status,err_text);
+            if (astro_warn) printf("WARNING: astro::fits_read:fits_read_pix() Error %d: %s\n",status,err_text);
+            fits_close_file(p, &status);
+            set_astro_errno(ASTRO_ERR_READPIX);
+            return(ASTRO_FAILURE);
+            }
+        }
+
+    fits_close_file(p, &status);
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_READ() - Same as above, but the buffer is taken from an arena (see
+//               ARENA below) and is released by the next reset() of the
+//               arena instead of with free().
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be read
+//      mem     - Arena for the data buffer
+//      size    - Pointer to variable that will be set to the number of data
+//                entries in the return array.
+//
+// Return Value:
+//      float * - pointer to base of one dimensional array with image data
+//
+// Errors:  Function will return NULL and set astro_errno with return code
+//          (see astro_class.h)
+//
+
+float   *astro::fits_read(char *fname, arena *mem, int *size)
+    {
+    int         xnum, ynum;
+    long        cap;
+    float       *data;
+
+    if (fits_dims(fname, &xnum, &ynum))
+        {
+        if (astro_warn) printf("WARNING: astro::fits_read:fits_dims() Error\n");
+        return(NULL);
+        }
+
+    cap=(long)xnum*ynum;
+    if ((data=mem->floats(cap))==NULL)
+        {
+        if (astro_warn) printf("WARNING: astro::fits_read:arena Error\n");
+        set_astro_errno(ASTRO_ERR_MALLOC);
+        return(NULL);
+        }
+
+    if (fits_read_tiles(fname, 1, &data, &cap, &xnum, &ynum, size)) return(NULL);
+
+    return(data);
+    }
+
+
+//
+// FITS_OPEN() - Opens a 2D binary FITS file for reading and returns the file
+//               handle and the image dimensions.  This is used with
+//               fits_read_strip() when an image is too large to be read as a
+//               whole or only parts of it are needed.
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be opened
+//      xnum    - Number of rows (X dimension, fastest changing index)
+//      ynum    - Number of columns (Y dimension, slowest changing index)
+//
+// Return Value:
+//      fitsfile * - CFITSIO file handle (close with fits_close())
+//
+// Errors:  Function will return NULL and set astro_errno with return code
+//          (see astro_class.h)
+//
+
+fitsfile    *astro::fits_open(char *fname, int *xnum, int *ynum)
+    {
+    int         status=0;
+    long        naxes[2];
+    char        err_text[81];
+    fitsfile    *p=NULL;
+
+    if (fits_open_any(&p, fname, 1, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_open:fits_open_image() Error %d: %s\n",status,err_text);
+        set_astro_errno(ASTRO_ERR_OPEN);
+        return(NULL);
+        }
+
+    if (fits_get_img_size(p, 2, naxes, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_open:fits_get_img_size() Error %d: %s\n", status, err_text);
+        fits_close_file(p, &status);
+        set_astro_errno(ASTRO_ERR_GET_SIZE);
+        return(NULL);
+        }
+
+    *xnum=(int)naxes[0];
+    *ynum=(int)naxes[1];
+
+    if (DEBUG) printf("DEBUG: astro::fits_open:dims xnum=%d, ynum=%d\n",*xnum,*ynum);
+
+    return(p);
+    }
+
+
+//
+// FITS_READ_TILES() - Reads a whole 2D image like fits_read(), but if the
+//                     image is tile compressed (fpack .fz) the tiles are
+//                     decompressed in parallel.  Each thread opens its own
+//                     handle on the file and reads a band of rows with
+//                     fits_read_subset().  The bands are aligned on tile
+//                     boundaries (ZTILE2) so no tile is decompressed twice.
+//                     Uncompressed and gzipped files are read serially
+//                     since CFITSIO has to inflate a gzipped file as a
+//                     single stream.
+//
+//                     The data is read into a caller buffer, which is grown
+//                     with realloc() if it is too small, so the same buffer
+//                     can be reused for many images.
+//
+//                     CFITSIO must be built re-entrant for the parallel
+//                     read.  If it is not, the image is read serially.
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be read
+//      nthreads- Number of threads to use for decompression
+//      buf     - Pointer to the data buffer (may point to NULL)
+//      cap     - Pointer to the size of the buffer in values (updated if
+//                the buffer is grown)
+//      xnum    - Set to number of rows (X dimension, fastest changing index)
+//      ynum    - Set to number of columns (Y dimension, slowest changing)
+//      size    - Set to the number of data entries in the buffer
+//
+// Return Value:
+//      ASTRO_SUCCESS   - Success
+//      ASTRO_FAILURE   - Failure (astro_errno will be set with detailed code)
+//
+// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//
+
+int     astro::fits_read_tiles(char *fname, int nthreads, float **buf, long *cap, int *xnum, int *ynum, int *size)
+    {
+    int         bad=0;
+    int         ztile=1;
+    int         status=0;
+    long        fpixel[2];
+    char        err_text[81];
+    float       *data;
+    fitsfile    *p;
+
+    if (!(p=fits_open(fname, xnum, ynum))) return(ASTRO_FAILURE);
+
+    if ((long)(*xnum)*(*ynum) > *cap)
+        {
+        if ((data=(float *)realloc(*buf, (size_t)(*xnum)*(*ynum)*sizeof(float)))==NULL)
+            {
+            if (astro_warn) printf("WARNING: astro::fits_read_tiles:realloc() Error\n");
+            fits_close_file(p, &status);
+            set_astro_errno(ASTRO_ERR_MALLOC);
+            return(ASTRO_FAILURE);
+            }
+        *buf=data;
+        *cap=(long)(*xnum)*(*ynum);
+        }
+    data=*buf;
+
+    if ((nthreads < 2) || !fits_is_compressed_image(p, &status) || !fits_is_reentrant())
+        {
+        fpixel[0]=fpixel[1]=1;
+        if (fits_read_pix(p, TFLOAT, fpixel, (long)(*xnum)*(*ynum), NULL, data, NULL, &status))
+            {
+            fits_get_errstatus(status,err_text);
+            if (astro_warn) printf("WARNING: astro::fits_read_tiles:fits_read_pix() Error %d: %s\n",status,err_text);
+            fits_close_file(p, &status);
+            set_astro_errno(ASTRO_ERR_READPIX);
+            return(ASTRO_FAILURE);
+            }
+        fits_close_file(p, &status);
+        *size=(*xnum)*(*ynum);
+        return(ASTRO_SUCCESS);
+        }
+
+    if (fits_read_key(p, TINT, "ZTILE2", &ztile, NULL, &status) || (ztile < 1))
+        {
+        status=0;
+        ztile=1;
+        }
+    fits_close_file(p, &status);
+
+    if (DEBUG) printf("DEBUG: astro::fits_read_tiles:%s %d threads, tile rows %d\n",fname,nthreads,ztile);
+
+#pragma omp parallel num_threads(nthreads) reduction(+:bad)
+        {
+        int         n=1, t=0;
+        int         tiles, lo, hi;
+        int         st=0;
+        long        blc[2], trc[2], inc[2];
+        fitsfile    *q=NULL;
+
+#ifdef _OPENMP
+        n=omp_get_num_threads();
+        t=omp_get_thread_num();
+#endif
+        tiles=((*ynum)+ztile-1)/ztile;
+        lo=(int)(((long)tiles*t)/n)*ztile+1;
+        hi=(int)(((long)tiles*(t+1))/n)*ztile;
+        if (hi > *ynum) hi=*ynum;
+
+        if ((hi >= lo) && !fits_open_any(&q, fname, 1, &st))
+            {
+            blc[0]=1;
+            blc[1]=lo;
+            trc[0]=*xnum;
+            trc[1]=hi;
+            inc[0]=inc[1]=1;
+            fits_read_subset(q, TFLOAT, blc, trc, inc, NULL, data+(long)(lo-1)*(*xnum), NULL, &st);
+            if (st) bad++;
+            st=0;
+            fits_close_file(q, &st);
+            }
+        else if (hi >= lo)
+            {
+            bad++;
+            }
+        }
+
+    if (bad)
+        {
+        if (astro_warn) printf("WARNING: astro::fits_read_tiles:fits_read_subset() Error in %d bands\n",bad);
+        set_astro_errno(ASTRO_ERR_READPIX);
+        return(ASTRO_FAILURE);
+        }
+
+    *size=(*xnum)*(*ynum);
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_READ_TILES() - Same as above, but a new buffer is allocated for the
+//                     image (release it with free()).
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be read
+//      nthreads- Number of threads to use for decompression
+//      xnum    - Set to number of rows (X dimension, fastest changing index)
+//      ynum    - Set to number of columns (Y dimension, slowest changing)
+//      size    - Set to the number of data entries in the return array
+//
+// Return Value:
+//      float * - pointer to base of one dimensional array with image data
+//
+// Errors:  Function will return NULL and set astro_errno with return code
+//          (see astro_class.h)
+//
+
+float   *astro::fits_read_tiles(char *fname, int nthreads, int *xnum, int *ynum, int *size)
+    {
+    long        cap=0;
+    float       *data=NULL;
+
+    if (fits_read_tiles(fname, nthreads, &data, &cap, xnum, ynum, size))
+        {
+        free(data);
+        return(NULL);
+        }
+    return(data);
+    }
+
+
+//
+// FITS_READ_STRIP() - Reads a strip of complete rows (FITS sense, so a range
+//                     of the slowest varying index) from a file opened with
+//                     fits_open().  The data is read with fits_read_subset()
+//                     and converted to floating point.
+//
+// Arguments:
+//      fptr    - CFITSIO file handle from fits_open()
+//      xnum    - Number of rows (X dimension, fastest changing index)
+//      row_lo  - First row of the strip (FITS index starting at 1)
+//      row_hi  - Last row of the strip (inclusive)
+//      buf     - Buffer for at least xnum*(row_hi-row_lo+1) values
+//
+// Return Value:
+//      ASTRO_SUCCESS  - Strip read
+//      ASTRO_FAILURE  - Read failed
+//
+// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//
+
+int     astro::fits_read_strip(fitsfile *fptr, int xnum, int row_lo, int row_hi, float *buf)
+    {
+    int         status=0;
+    long        blc[2], trc[2], inc[2];
+    char        err_text[81];
+
+    blc[0]=1;
+    blc[1]=(long) row_lo;
+    trc[0]=(long) xnum;
+    trc[1]=(long) row_hi;
+    inc[0]=inc[1]=1;
+
+    if (DEBUG) printf("DEBUG: astro::fits_read_strip:rows %d to %d\n",row_lo,row_hi);
+
+    if (fits_read_subset(fptr, TFLOAT, blc, trc, inc, NULL, buf, NULL, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_read_strip:fits_read_subset() Error %d: %s\n",status,err_text);
+        set_astro_errno(ASTRO_ERR_READPIX);
+        return(ASTRO_FAILURE);
+        }
+
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_READ_PLANE() - Reads one image plane from a file opened with
+//                     fits_open().  The file stays open so several planes
+//                     and HDUs can be read through one file handle.  The
+//                     data is returned the same way as fits_read().
+//
+// Arguments:
+//      fptr    - CFITSIO file handle from fits_open()
+//      hdu     - HDU number (1 is the primary HDU)
+//      plane   - Plane number in the HDU (1 for a 2D image)
+//      xnum    - Set to number of rows (X dimension, fastest changing index)
+//      ynum    - Set to number of columns (Y dimension, slowest changing)
+//      size    - Set to the number of data entries in the return array
+//
+// Return Value:
+//      float * - pointer to base of one dimensional array with image data
+//
+// Errors:  Function will return NULL and set astro_errno with return code
+//          (see astro_class.h)
+//
+
+float   *astro::fits_read_plane(fitsfile *fptr, int hdu, int plane, int *xnum, int *ynum, int *size)
+    {
+    return(fits_read_plane(fptr, hdu, plane, NULL, xnum, ynum, size));
+    }
+
+
+//
+// FITS_READ_PLANE() - Same as above, but the buffer is taken from an arena
+//                     (see ARENA below) and is released by the next reset()
+//                     of the arena.  If mem is NULL the buffer is allocated
+//                     with malloc() and must be released with free().
+//
+// Arguments:
+//      fptr    - CFITSIO file handle from fits_open()
+//      hdu     - HDU number (1 is the primary HDU)
+//      plane   - Plane number in the HDU (1 for a 2D image)
+//      mem     - Arena for the data buffer (or NULL)
+//      xnum    - Set to number of rows (X dimension, fastest changing index)
+//      ynum    - Set to number of columns (Y dimension, slowest changing)
+//      size    - Set to the number of data entries in the return array
+//
+// Return Value:
+//      float * - pointer to base of one dimensional array with image data
+//
+// Errors:  Function will return NULL and set astro_errno with return code
+//          (see astro_class.h)
+//
+
+float   *astro::fits_read_plane(fitsfile *fptr, int hdu, int plane, arena *mem, int *xnum, int *ynum, int *size)
+    {
+    int         i;
+    int         status=0;
+    int         hdutype;
+    long        naxes[3];
+    long        fpixel[3];
+    char        err_text[81];
+    float       *data;
+
+    if (fits_movabs_hdu(fptr, hdu, &hdutype, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_read_plane:fits_movabs_hdu() Error %d: %s\n",status,err_text);
+        set_astro_errno(ASTRO_ERR_HDU);
+        return(NULL);
+        }
+
+    naxes[0]=naxes[1]=naxes[2]=1;
+    if (fits_get_img_size(fptr, 3, naxes, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_read_plane:fits_get_img_size() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_GET_SIZE);
+        return(NULL);
+        }
+
+    if ((plane < 1) || (plane > naxes[2]))
+        {
+        if (astro_warn) printf("WARNING: astro::fits_read_plane: Plane %d Invalid\n",plane);
+        set_astro_errno(ASTRO_ERR_HDU);
+        return(NULL);
+        }
+
+    *xnum=(int)naxes[0];
+    *ynum=(int)naxes[1];
+
+    if (mem)
+        {
+        data=mem->floats((long)(*xnum)*(*ynum));
+        }
+    else
+        {
+        data=(float *)malloc((size_t)(*xnum)*(*ynum)*sizeof(float));
+        }
+
+    if (data==NULL)
+        {
+        if (astro_warn) printf("WARNING: astro::fits_read_plane:malloc() Error\n");
+        set_astro_errno(ASTRO_ERR_MALLOC);
+        return(NULL);
+        }
+
+    for (i=0; i < (*xnum)*(*ynum); i++) data[i]=0.0;
+
+    fpixel[0]=fpixel[1]=1;
+    fpixel[2]=(long) plane;
+
+    if (fits_read_pix(fptr, TFLOAT, fpixel, (long)(*xnum)*(*ynum), NULL, data, NULL, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_read_plane:fits_read_pix() Error %d: %s\n",status,err_text);
+        if (!mem) free(data);
+        set_astro_errno(ASTRO_ERR_READPIX);
+        return(NULL);
+        }
+
+    *size=(*xnum)*(*ynum);
+    return(data);
+    }
+
+
+//
+// FITS_CLOSE() - Closes a file opened with fits_open()
+//
+// Arguments:
+//      fptr    - CFITSIO file handle from fits_open()
+//
+// Return Value:
+//      ASTRO_SUCCESS  - File closed
+//      ASTRO_FAILURE  - Close failed
+//
+// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//
+
+int     astro::fits_close(fitsfile *fptr)
+    {
+    int         status=0;
+    char        err_text[81];
+
+    if (fits_close_file(fptr, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_close:fits_close_file() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_CLOSE);
+        return(ASTRO_FAILURE);
+        }
+
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_WRITE() - Write an image to a FITS file.  The image can be written to
+//                an existing file or will create a new file.
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be written
+//      data    - Image data to be written to the file
+//      x_size  - Number of rows in the image
+//      y_size  - Number of cloumns in the image
+//      newfile - Flag to create a file.  If 1, create a new file (overwrite
+//                any existing one.  If 0, will write to an existing file.
+//      pname   - Text string for program name in PROGRAM key value
+//      version - Test string with version information for PROGRAM key value
+//
+// Return Value:
+//      ASTRO_SUCCESS - Write was successful
+//      ASTRO_FAILURE - Write failed
+//
+// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//
+
+int    astro::fits_write(char *fname, float *data, int x_size, int y_size, 
+                         int newfile, const char *pname, const char *version)
+    {
+    int         status=0;
+    int         checkx;
+    int         checky;
+    long        naxes[2];
+    char        key[81];
+    char        err_text[81];
+    fitsfile    *fptr=NULL;
+    long        fpixel[2]= { 1, 1};
+
+    naxes[0]=(long) x_size;
+    naxes[1]=(long) y_size;
+
+    if (x_size < MIN_FITS || y_size < MIN_FITS || x_size > MAX_FITS || y_size > MAX_FITS)
+        {
+        if (astro_warn) printf("WARNING: astro::fits_write: Image Size Invalid\n");
+        set_astro_errno(ASTRO_ERR_WRITE);
+        return(ASTRO_FAILURE);
+        }
+
+    if (newfile)
+        {
+//
+// Create a new FITS file
+//
+
+        if (fits_create_file(&fptr,fname, &status))
+            {
+            fits_get_errstatus(status,err_text);
+            if (astro_warn) printf("WARNING: astro::fits_write:fits_create_file() Error %d: %s\n",status,err_text);
+            set_astro_errno(ASTRO_ERR_CREATE);
+            return(ASTRO_FAILURE);
+            }
+
+//
+// Create a new FITS image unit in the file
+//
+ 
+       if (fits_create_img(fptr, FLOAT_IMG, 2, naxes, &status))
+            {
+            fits_get_errstatus(status,err_text);
+            if (astro_warn) printf("WARNING: astro::fits_write:fits_create_img() Error %d: %s\n",status,err_text);
+            set_astro_errno(ASTRO_ERR_IMAGE);
+            return(ASTRO_FAILURE);
+            }
+        }
+    else
+        {
+//
+// Check the size of the primary image unit
+//
+
+        if (fits_dims(fname, &checkx, &checky)) return(ASTRO_FAILURE);
+
+        if ((checkx != x_size) || (checky != y_size))
+            {
+            if (astro_warn) printf("WARNING: astro::fits_write: Exist File Size Error %d:%d-%d:%d\n",x_size,checkx,y_size,checky);
+            set_astro_errno(ASTRO_ERR_SIZE);
+            return(ASTRO_FAILURE);
+            }
+
+//
+// Open the file for read/write
+//
+
+        if (DEBUG) printf("DEBUG: astro::fits_read:fits_file_open\n");
+
+        if (fits_open_file(&fptr, fname, READWRITE, &status))
+            {
+            fits_get_errstatus(status,err_text);
+            if (astro_warn) printf("WARNING: astro::fits_write:fits_open_file() Error %d: %s\n",status,err_text);
+            set_astro_errno(ASTRO_ERR_OPEN);
+            return(ASTRO_FAILURE);
+            }
+        }
+
+//
+// Write the image to the FITS files
+//
+
+    if (fits_write_pix(fptr, TFLOAT, fpixel, long(x_size*y_size), data, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_write:fits_write_pix() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_WRITE);
+        return(ASTRO_FAILURE);
+        }
+
+    sprintf(key,"HDU Created by %s/%s - %s", MAJOR_VERSION, pname, version);
+    if (fits_write_key(fptr, TSTRING, "PROGRAM", key, NULL, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_write:fits_write_key() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_KEY);
+        return(ASTRO_FAILURE);
+        }
+
+    if (fits_close_file(fptr, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_write:fits_close_file() Error %d: %s\n", status, err_text);
+        set_astro_errno(ASTRO_ERR_CLOSE);
+        return(ASTRO_FAILURE);
+        }
+
+    return(ASTRO_SUCCESS);
+    }
+
+
+//
+// FITS_WRITE() - Same as above, but the image is taken from an ImageView.
+//                The rows of the view are written as the FITS rows, and a
+//                view whose rows are padded is packed first.
+//
+// Arguments:
+//      fname   - Text filename for FITS file to be written
+//      img     - Image (x_size is img.cols, y_size is img.rows)
+//      newfile - See above
+//      pname   - See above
+//      version - See above
+//
+// Return Value:
+//      ASTRO_SUCCESS   - Success
+//      ASTRO_FAILURE   - Failure (astro_errno will be set with detailed code)
+//
+
+int    astro::fits_write(char *fname, ImageView<float> img, int newfile, const char *pname, const char *version)
+    {
+    long        r;
+    std::vector<float>  packed;
+
+    if (img.empty()) 
+        {
+        set_astro_errno(ASTRO_ERR_WRITE);
+        return(ASTRO_FAILURE);
+        }
+
+    if (img.stride == img.cols) return(fits_write(fname, img.base, (int)img.cols, (int)img.rows, newfile, pname, version));
+
+    packed.resize((size_t)img.rows*img.cols);
+    for (r=0; r < img.rows; r++) memcpy(&packed[(size_t)r*img.cols], img[r], (size_t)img.cols*sizeof(float));
+
+    return(fits_write(fname, &packed[0], (int)img.cols, (int)img.rows, newfile, pname, version));
+    }
+
+
+//
+// Tile compressed images.  The image is cut into tiles of whole rows which
+//   are quantized and compressed by worker threads, and the finished tiles
+//   are written by CFITSIO as the rows of a compressed image table (the FITS
+//   tiled image convention, the same layout fpack writes).  The quantization,
+//   dithering and Rice coding follow CFITSIO so that any FITS reader gives
+//   back the same values.
+//
+
+#define PACK_RANDOMS    10000          /* Size of the dither random table    */
+#define PACK_BLANK      -2147483647    /* Quantized value of NaN (ZBLANK)    */
+#define PACK_BLOCK      32             /* Rice block size (pixels)           */
+
+struct  pack_tile
+    {
+    std::vector<unsigned char> bytes;  /* Compressed tile                    */
+    double  scale;                     /* ZSCALE (quantization step)         */
+    double  zero;                      /* ZZERO (value of quantized 0)       */
+    int     nulls;                     /* Tile has NaN pixels                */
+    int     err;                       /* Compression failed                 */
+    };
+
+struct  pack_bits
+    {
+    std::vector<unsigned char> *out;   /* Output bytes                       */
+    unsigned long long  acc;           /* Bits not yet written (low n bits)  */
+    int     n;                         /* Number of bits in acc              */
+    };
+
+static  float           pack_rand[PACK_RANDOMS]; /* Dither random table      */
+static  pthread_once_t  pack_once=PTHREAD_ONCE_INIT;
+
+
+//
+// PACK_INIT() - Fills the dither random table.  This is the Park-Miller
+//               generator CFITSIO uses, which readers need to undo the
+//               dithering.
+//
+
+static  void    pack_init()
+    {
+    int     k;
+    double  a=16807.0;
+    double  m=2147483647.0;
+    double  seed=1.0;
+    double  temp;
+
+    for (k=0; k < PACK_RANDOMS; k++)
+        {
+        temp=a*seed;
+        seed=temp-m*((int) (temp/m));
+        pack_rand[k]=(float) (seed/m);
+        }
+    }
+
+
+//
+// PACK_PUT() - Appends the low nbits (up to 32) of v to a bit stream, most
+//              significant bit first
+//
+
+static  inline void pack_put(pack_bits *b, unsigned int v, int nbits)
+    {
+    b->acc=(b->acc << nbits) | ((unsigned long long) v & ((1ULL << nbits)-1));
+    b->n+=nbits;
+    while (b->n >= 8)
+        {
+        b->n-=8;
+        b->out->push_back((unsigned char) (b->acc >> b->n));
+        }
+    }
+
+
+//
+// PACK_RICE() - Rice codes 32 bit integers (RICE_1 with a block size of 32)
+//
+// Arguments:
+//      a       - Values
+//      n       - Number of values
+//      out     - Receives the coded bytes
+//
+
+static  void    pack_rice(const int *a, long n, std::vector<unsigned char> *out)
+    {
+    long            i, j;
+    long            len;
+    int             fs;
+    unsigned int    diff[PACK_BLOCK];
+    unsigned int    u, psum, top;
+    unsigned int    last;
+    double          sum, dpsum;
+    pack_bits       b;
+
+    b.out=out;
+    b.acc=0;
+    b.n=0;
+
+    out->clear();
+    out->reserve(n*2);
+
+    last=(unsigned int) a[0];
+    pack_put(&b, last, 32);
+
+    for (i=0; i < n; i+=PACK_BLOCK)
+        {
+        len=std::min((long) PACK_BLOCK, n-i);
+
+//
+// Differences of neighbouring values, folded so that small negative and
+//   positive differences are both small
+//
+
+        sum=0.0;
+        for (j=0; j < len; j++)
+            {
+            u=(unsigned int) a[i+j]-last;
+            diff[j]=((int) u < 0) ? ~(u << 1) : (u << 1);
+            sum+=diff[j];
+            last=(unsigned int) a[i+j];
+            }
+
+        dpsum=(sum-(len/2)-1)/len;
+        if (dpsum < 0) dpsum=0.0;
+        psum=((unsigned int) dpsum) >> 1;
+        for (fs=0; psum > 0; fs++) psum>>=1;
+
+        if (fs >= 25)
+            {
+            pack_put(&b, 26, 5);
+            for (j=0; j < len; j++) pack_put(&b, diff[j], 32);
+            }
+        else if ((fs == 0) && (sum == 0.0))
+            {
+            pack_put(&b, 0, 5);
+            }
+        else
+            {
+            pack_put(&b, fs+1, 5);
+            for (j=0; j < len; j++)
+                {
+                for (top=diff[j] >> fs; top >= 32; top-=32) pack_put(&b, 0, 32);
+                pack_put(&b, 1, top+1);
+                if (fs) pack_put(&b, diff[j], fs);
+                }
+            }
+        }
+
+    if (b.n) out->push_back((unsigned char) (b.acc << (8-b.n)));
+    }
+
+
+//
+// PACK_GZIP() - Compresses bytes into a gzip stream (GZIP_1)
+//
+// Arguments:
+//      in      - Bytes to compress
+//      n       - Number of bytes
+//      out     - Receives the compressed bytes
+//
+// Return Value:
+//      ASTRO_SUCCESS   - Compressed
+//      ASTRO_FAILURE   - zlib error
+//
+
+static  int     pack_gzip(const unsigned char *in, size_t n, std::vector<unsigned char> *out)
+    {
+    int         ret;
+    z_stream    z;
+
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, 1, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return(ASTRO_FAILURE);
+
+    out->resize(deflateBound(&z, n)+32);
+    z.next_in=(Bytef *) in;
+    z.avail_in=n;
+    z.next_out=&(*out)[0];
+    z.avail_out=out->size();
+
+    ret=deflate(&z, Z_FINISH);
+    out->resize(z.total_out);
+    deflateEnd(&z);
+
+    return((ret == Z_STREAM_END) ? ASTRO_SUCCESS : ASTRO_FAILURE);
+    }
+
+
+//
+// PACK_NOISE() - Estimates the background noise of a tile from the median
+//                of |2*x[i]-x[i-2]-x[i+2]| along the rows (the MAD estimate
+//                CFITSIO uses to pick the quantization step)
+//
+// Arguments:
+//      f       - Tile pixels (rows*cols, NaN pixels are skipped)
+//      rows    - Rows in the tile
+//      cols    - Columns in the tile
+//
+// Return Value:
+//      Sigma of the noise (0 if it cannot be measured)
+//
+
+static  double  pack_noise(const float *f, long rows, long cols)
+    {
+    long    r, c;
+    const float *p;
+    std::vector<float>  d;
+
+    if (cols < 5) return(0.0);
+
+    d.reserve(rows*(cols-4));
+    for (r=0; r < rows; r++)
+        {
+        p=f+r*cols;
+        for (c=2; c < cols-2; c++)
+            {
+            if ((p[c] == p[c]) && (p[c-2] == p[c-2]) && (p[c+2] == p[c+2])) d.push_back(fabsf(2.0f*p[c]-p[c-2]-p[c+2]));
+            }
+        }
+
+    if (d.empty()) return(0.0);
+
+    std::nth_element(d.begin(), d.begin()+d.size()/2, d.end());
+    return(0.6052697*d[d.size()/2]);
+    }
+
+
+//
+// PACK_ONE() - Quantizes and compresses one tile
+//
+// Arguments:
+//      v       - Tile (whole rows of the image)
+//      pk      - Compression options
+//      tile    - Tile number (0 based, selects the dither random values)
+//      seed    - ZDITHER0 of the image
+//      t       - Receives the compressed tile
+//
+
+static  void    pack_one(ImageView<float> v, const fits_pack *pk, long tile, int seed, pack_tile *t)
+    {
+    long    r, c, k;
+    long    n=v.rows*v.cols;
+    int     iseed, next;
+    unsigned int bits;
+    double  vmin=0.0, vmax=0.0;
+    double  delta, zero, x;
+    int     good=0;
+    std::vector<float>          f(n);
+    std::vector<int>            q;
+    std::vector<unsigned char>  raw;
+
+    t->nulls=0;
+    t->err=0;
+    t->scale=1.0;
+    t->zero=0.0;
+
+    for (r=0, k=0; r < v.rows; r++)
+        {
+        for (c=0; c < v.cols; c++, k++)
+            {
+            f[k]=v[r][c];
+            if (f[k] != f[k])
+                {
+                t->nulls=1;
+                }
+            else if (!good++)
+                {
+                vmin=vmax=f[k];
+                }
+            else
+                {
+                vmin=std::min(vmin, (double) f[k]);
+                vmax=std::max(vmax, (double) f[k]);
+                }
+            }
+        }
+
+//
+// Lossless tiles are the big endian floats, gzipped
+//
+
+    if (pk->q == 0.0)
+        {
+        raw.resize(n*4);
+        for (k=0; k < n; k++)
+            {
+            memcpy(&bits, &f[k], 4);
+            raw[4*k]=(unsigned char) (bits >> 24);
+            raw[4*k+1]=(unsigned char) (bits >> 16);
+            raw[4*k+2]=(unsigned char) (bits >> 8);
+            raw[4*k+3]=(unsigned char) bits;
+            }
+        if (pack_gzip(&raw[0], raw.size(), &t->bytes)) t->err=1;
+        return;
+        }
+
+//
+// Quantization step from the noise (or the fixed step), falling back to
+//   the range for tiles without measurable noise
+//
+
+    delta=(pk->q > 0.0) ? pack_noise(&f[0], v.rows, v.cols)/pk->q : -pk->q;
+    if (delta <= 0.0) delta=(vmax-vmin)/65536.0;
+    if (delta <= 0.0) delta=1.0;
+    if ((vmax-vmin)/delta > 2.0e9) delta=(vmax-vmin)/2.0e9;
+
+    zero=(double) ((long long) (vmin/delta+0.5))*delta;
+
+    q.resize(n);
+    iseed=(int) ((tile+seed-1) % PACK_RANDOMS);
+    next=(int) (pack_rand[iseed]*500.0);
+
+    for (k=0; k < n; k++)
+        {
+        if (f[k] != f[k])
+            {
+            q[k]=PACK_BLANK;
+            }
+        else
+            {
+            x=(f[k]-zero)/delta;
+            if (pk->dither) x+=pack_rand[next]-0.5;
+            q[k]=(x >= 0.0) ? (int) (x+0.5) : (int) (x-0.5);
+            }
+
+        if ((pk->dither) && (++next == PACK_RANDOMS))
+            {
+            if (++iseed == PACK_RANDOMS) iseed=0;
+            next=(int) (pack_rand[iseed]*500.0);
+            }
+        }
+
+    t->scale=delta;
+    t->zero=zero;
+
+    if (pk->type == FITS_PACK_RICE)
         {
-        if (astro_warn) printf("WARNING: astro::fits_read:malloc() Error\n");
-        fits_close_file(p, &status);
-        set_astro_errno(ASTRO_ERR_MALLOC);
-        return(NULL);
+        pack_rice(&q[0], n, &t->bytes);
+        return;
         }
 
-    for (i=0; i< (xnum*ynum) ; i++) data[i]=0.0;
+    raw.resize(n*4);
+    for (k=0; k < n; k++)
+        {
+        raw[4*k]=(unsigned char) (q[k] >> 24);
+        raw[4*k+1]=(unsigned char) (q[k] >> 16);
+        raw[4*k+2]=(unsigned char) (q[k] >> 8);
+        raw[4*k+3]=(unsigned char) q[k];
+        }
+    if (pack_gzip(&raw[0], raw.size(), &t->bytes)) t->err=1;
+    }
 
-    if (DEBUG) printf("DEBUG: astro::fits_read:malloc %zu (%d x %d x float size) bytes\n",xnum*ynum*sizeof(float),xnum,ynum);
 
-    fpixel[0]=fpixel[1]=(long) 1;
-    nelements=(long)(xnum*ynum);
+//
+// PACK_OPTION() - Parses a comma separated list of compression options:
+//
+//                      rice        - Rice compression (default)
+//                      gzip        - GZIP compression
+//                      none        - No compression (crop can still be used)
+//                      q=<val>     - Quantization step is noise/<val> (> 0),
+//                                    -<val> (< 0) or lossless (0, gzip)
+//                      tile=<rows> - Image rows per tile
+//                      nodither    - Do not dither the quantization
+//                      crop        - Write only the populated sub-image
+//
+// Arguments:
+//      opt     - Option text
+//      pk      - Options to update (type is set to Rice if not given)
+//
+// Return Value:
+//      ASTRO_SUCCESS   - Options parsed
+//      ASTRO_FAILURE   - Invalid option (astro_errno is ASTRO_ERR_OPTION)
+//
 
-    if (fits_read_pix(p, TFLOAT, fpixel, nelements, NULL, data, NULL, &status))
+int     astro::pack_option(const char *opt, fits_pack *pk)
+    {
+    int         type=FITS_PACK_RICE;
+    double      q;
+    char        *end;
+    size_t      a;
+    std::string key;
+    std::string val;
+    std::istringstream  in(opt);
+
+    while (std::getline(in, key, ','))
         {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_read:fits_read_pix() Error %d: %s\n",status,err_text);
-        free(data);
-        fits_close_file(p, &status);
-        set_astro_errno(ASTRO_ERR_READPIX);
-        return(NULL);
-        }
+        val="";
+        if ((a=key.find('=')) != std::string::npos)
+            {
+            val=key.substr(a+1);
+            key=key.substr(0, a);
+            }
 
-    if (fits_close_file(p, &status))
-        {
-        fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_read:fits_close_file() Error %d: %s\n", status, err_text);
-        free(data);
-        set_astro_errno(ASTRO_ERR_CLOSE);
-        return(NULL);
+        if (key == "rice" || key == "gzip" || key == "none")
+            {
+            type=(key == "rice") ? FITS_PACK_RICE : ((key == "gzip") ? FITS_PACK_GZIP : FITS_PACK_NONE);
+            }
+        else if ((key == "q") && !val.empty() && ((q=strtod(val.c_str(), &end)), !*end))
+            {
+            pk->q=(float) q;
+            }
+        else if ((key == "tile") && (atoi(val.c_str()) > 0))
+            {
+            pk->rows=atoi(val.c_str());
+            }
+        else if (key == "nodither")
+            {
+            pk->dither=0;
+            }
+        else if (key == "crop")
+            {
+            pk->crop=1;
+            }
+        else
+            {
+            if (astro_warn) printf("WARNING: astro::pack_option: Invalid Option %s\n",key.c_str());
+            set_astro_errno(ASTRO_ERR_OPTION);
+            return(ASTRO_FAILURE);
+            }
         }
-    *size=xnum*ynum;
-    return(data);
+
+    pk->type=type;
+    if ((pk->q == 0.0) && (type == FITS_PACK_RICE)) pk->type=FITS_PACK_GZIP;
+
+    return(ASTRO_SUCCESS);
     }
 
 
 //
-// FITS_WRITE() - Write an image to a FITS file.  The image can be written to
-//                an existing file or will create a new file.
+// FITS_WRITE() - Same as above, but the image can be tile compressed and/or
+//                cropped to its populated part.  Tiles of pk->rows rows are
+//                compressed on pk->nthreads threads and then written in
+//                order as a compressed image extension after an empty
+//                primary HDU.  A cropped image keeps its place in the full
+//                image in the LTV1/LTV2 keys.
 //
 // Arguments:
-//      fname   - Text filename for FITS file to be written
-//      data    - Image data to be written to the file
-//      x_size  - Number of rows in the image
-//      y_size  - Number of cloumns in the image
-//      newfile - Flag to create a file.  If 1, create a new file (overwrite
-//                any existing one.  If 0, will write to an existing file.
-//      pname   - Text string for program name in PROGRAM key value
-//      version - Test string with version information for PROGRAM key value
+//      fname   - Text filename for FITS file to be created
+//      img     - Image (x_size is img.cols, y_size is img.rows)
+//      pk      - Compression options (see pack_option())
+//      pname   - See above
+//      version - See above
 //
 // Return Value:
-//      ASTRO_SUCCESS - Write was successful
-//      ASTRO_FAILURE - Write failed
-//
-// Errors:  Function will set astro_errno with return code (see astro_class.h)
+//      ASTRO_SUCCESS   - Success
+//      ASTRO_FAILURE   - Failure (astro_errno will be set with detailed code)
 //
 
-int    astro::fits_write(char *fname, float *data, int x_size, int y_size, 
-                         int newfile, const char *pname, const char *version)
+int    astro::fits_write(char *fname, ImageView<float> img, const fits_pack *pk, const char *pname, const char *version)
     {
-    int         status=0;
-    int         checkx;
-    int         checky;
+    long        r, c;
+    long        t, trows, ntiles;
+    long        r0=0, r1=-1;
+    long        c0=0, c1=-1;
     long        naxes[2];
+    long        fpixel[2]={ 1, 1};
+    int         status=0;
+    int         seed=1;
+    int         nulls=0;
+    int         ncols;
+    int         yes=1;
+    unsigned int bits;
+    unsigned int sum=0;
     char        key[81];
     char        err_text[81];
+    char        *ttype[]={ (char *) "COMPRESSED_DATA", (char *) "ZSCALE", (char *) "ZZERO"};
+    char        *tform[]={ (char *) "1PB", (char *) "1D", (char *) "1D"};
     fitsfile    *fptr=NULL;
-    long        fpixel[2]= { 1, 1};
+    std::vector<pack_tile>  tiles;
 
-    naxes[0]=(long) x_size;
-    naxes[1]=(long) y_size;
+    if ((pk->type == FITS_PACK_NONE) && !pk->crop) return(fits_write(fname, img, 1, pname, version));
 
-    if (x_size < MIN_FITS || y_size < MIN_FITS || x_size > MAX_FITS || y_size > MAX_FITS)
+    if (img.empty() || img.cols > MAX_FITS || img.rows > MAX_FITS)
         {
         if (astro_warn) printf("WARNING: astro::fits_write: Image Size Invalid\n");
         set_astro_errno(ASTRO_ERR_WRITE);
         return(ASTRO_FAILURE);
         }
 
-    if (newfile)
+//
+// Find the populated part of the image (pixels that are not 0 or NaN).  An
+//   empty image is written whole.
+//
+
+    if (pk->crop)
         {
+        for (r=0; r < img.rows; r++)
+            {
+            for (c=0; c < img.cols; c++)
+                {
+                if ((img[r][c] == 0.0f) || (img[r][c] != img[r][c])) continue;
+                if (r1 < 0)
+                    {
+                    r0=r;
+                    c0=c1=c;
+                    }
+                r1=r;
+                c0=std::min(c0, c);
+                c1=std::max(c1, c);
+                }
+            }
+
+        if (r1 < 0)
+            {
+            r0=c0=0;
+            }
+        else
+            {
+            img=img.sub(r0, c0, r1-r0+1, c1-c0+1);
+            }
+        }
+
+    naxes[0]=img.cols;
+    naxes[1]=img.rows;
+
 //
-// Create a new FITS file
+// Compress the tiles.  The dither seed (ZDITHER0, 1 to 10000) comes from
+//   the first row so the same image always gives the same file.
 //
 
-        if (fits_create_file(&fptr,fname, &status))
+    if (pk->type != FITS_PACK_NONE)
+        {
+        trows=std::min((long) pk->rows, img.rows);
+        ntiles=(img.rows+trows-1)/trows;
+        tiles.resize(ntiles);
+
+        for (c=0; c < img.cols; c++)
             {
-            fits_get_errstatus(status,err_text);
-            if (astro_warn) printf("WARNING: astro::fits_write:fits_create_file() Error %d: %s\n",status,err_text);
-            set_astro_errno(ASTRO_ERR_CREATE);
-            return(ASTRO_FAILURE);
+            memcpy(&bits, &img[0][c], 4);
+            sum+=bits;
+            }
+        seed=1+(int) (sum % PACK_RANDOMS);
+
+        pthread_once(&pack_once, pack_init);
+
+#pragma omp parallel for schedule(dynamic) num_threads(std::max(1, pk->nthreads))
+        for (t=0; t < ntiles; t++)
+            {
+            pack_one(img.sub(t*trows, 0, std::min(trows, img.rows-t*trows), img.cols), pk, t, seed, &tiles[t]);
+            }
+
+        for (t=0; t < ntiles; t++)
+            {
+            if (tiles[t].err)
+                {
+                if (astro_warn) printf("WARNING: astro::fits_write: Tile %ld Compression Failed\n",t+1);
+                set_astro_errno(ASTRO_ERR_WRITE);
+                return(ASTRO_FAILURE);
+                }
+            nulls|=tiles[t].nulls;
             }
+        }
+
+    if (fits_create_file(&fptr, fname, &status))
+        {
+        fits_get_errstatus(status,err_text);
+        if (astro_warn) printf("WARNING: astro::fits_write:fits_create_file() Error %d: %s\n",status,err_text);
+        set_astro_errno(ASTRO_ERR_CREATE);
+        return(ASTRO_FAILURE);
+        }
 
+    if (pk->type == FITS_PACK_NONE)
+        {
 //
-// Create a new FITS image unit in the file
+// Cropped only, the rows of the view are written one at a time
 //
- 
-       if (fits_create_img(fptr, FLOAT_IMG, 2, naxes, &status))
+
+        if (fits_create_img(fptr, FLOAT_IMG, 2, naxes, &status))
             {
             fits_get_errstatus(status,err_text);
             if (astro_warn) printf("WARNING: astro::fits_write:fits_create_img() Error %d: %s\n",status,err_text);
+            fits_close_file(fptr, &status);
             set_astro_errno(ASTRO_ERR_IMAGE);
             return(ASTRO_FAILURE);
             }
+
+        for (r=0; r < img.rows && !status; r++)
+            {
+            fpixel[1]=r+1;
+            fits_write_pix(fptr, TFLOAT, fpixel, img.cols, img[r], &status);
+            }
         }
     else
         {
 //
-// Check the size of the primary image unit
+// Compressed image table, one row per tile (CFITSIO writes the empty
+//   primary HDU first).  Lossless tiles have no ZSCALE/ZZERO columns.
 //
 
-        if (fits_dims(fname, &checkx, &checky)) return(ASTRO_FAILURE);
-
-        if ((checkx != x_size) || (checky != y_size))
+        ncols=(pk->q == 0.0) ? 1 : 3;
+        if (fits_create_tbl(fptr, BINARY_TBL, ntiles, ncols, ttype, tform, NULL, "COMPRESSED_IMAGE", &status))
             {
-            if (astro_warn) printf("WARNING: astro::fits_write: Exist File Size Error %d:%d-%d:%d\n",x_size,checkx,y_size,checky);
-            set_astro_errno(ASTRO_ERR_SIZE);
+            fits_get_errstatus(status,err_text);
+            if (astro_warn) printf("WARNING: astro::fits_write:fits_create_tbl() Error %d: %s\n",status,err_text);
+            fits_close_file(fptr, &status);
+            set_astro_errno(ASTRO_ERR_IMAGE);
             return(ASTRO_FAILURE);
             }
 
-//
-// Open the file for read/write
-//
+        r=-32;
+        fits_write_key(fptr, TLOGICAL, "ZIMAGE", &yes, "extension contains compressed image", &status);
+        fits_write_key(fptr, TLONG, "ZBITPIX", &r, "data type of original image", &status);
+        r=2;
+        fits_write_key(fptr, TLONG, "ZNAXIS", &r, "dimension of original image", &status);
+        fits_write_key(fptr, TLONG, "ZNAXIS1", &naxes[0], "length of original image axis", &status);
+        fits_write_key(fptr, TLONG, "ZNAXIS2", &naxes[1], "length of original image axis", &status);
+        fits_write_key(fptr, TLONG, "ZTILE1", &naxes[0], "size of tiles to be compressed", &status);
+        fits_write_key(fptr, TLONG, "ZTILE2", &trows, "size of tiles to be compressed", &status);
+
+        if (pk->type == FITS_PACK_RICE)
+            {
+            fits_write_key(fptr, TSTRING, "ZCMPTYPE", (void *) "RICE_1", "compression algorithm", &status);
+            r=PACK_BLOCK;
+            fits_write_key(fptr, TSTRING, "ZNAME1", (void *) "BLOCKSIZE", "compression block size", &status);
+            fits_write_key(fptr, TLONG, "ZVAL1", &r, "pixels per block", &status);
+            r=4;
+            fits_write_key(fptr, TSTRING, "ZNAME2", (void *) "BYTEPIX", "bytes per pixel (1, 2, 4, or 8)", &status);
+            fits_write_key(fptr, TLONG, "ZVAL2", &r, "bytes per pixel (1, 2, 4, or 8)", &status);
+            }
+        else
+            {
+            fits_write_key(fptr, TSTRING, "ZCMPTYPE", (void *) "GZIP_1", "compression algorithm", &status);
+            }
 
-        if (DEBUG) printf("DEBUG: astro::fits_read:fits_file_open\n");
+        if (pk->q != 0.0)
+            {
+            fits_write_key(fptr, TSTRING, "ZQUANTIZ", (void *) (pk->dither ? "SUBTRACTIVE_DITHER_1" : "NO_DITHER"), "quantization method", &status);
+            if (pk->dither) fits_write_key(fptr, TINT, "ZDITHER0", &seed, "dithering offset when quantizing floats", &status);
+            if (nulls)
+                {
+                r=PACK_BLANK;
+                fits_write_key(fptr, TLONG, "ZBLANK", &r, "null value in the compressed integer array", &status);
+                }
+            }
 
-        if (fits_open_file(&fptr, fname, READWRITE, &status))
+        for (t=0; t < ntiles && !status; t++)
             {
-            fits_get_errstatus(status,err_text);
-            if (astro_warn) printf("WARNING: astro::fits_write:fits_open_file() Error %d: %s\n",status,err_text);
-            set_astro_errno(ASTRO_ERR_OPEN);
-            return(ASTRO_FAILURE);
+            fits_write_col(fptr, TBYTE, 1, t+1, 1, tiles[t].bytes.size(), &tiles[t].bytes[0], &status);
+            if (ncols == 1) continue;
+            fits_write_col(fptr, TDOUBLE, 2, t+1, 1, 1, &tiles[t].scale, &status);
+            fits_write_col(fptr, TDOUBLE, 3, t+1, 1, 1, &tiles[t].zero, &status);
             }
         }
 
-//
-// Write the image to the FITS files
-//
-
-    if (fits_write_pix(fptr, TFLOAT, fpixel, long(x_size*y_size), data, &status))
+    if (status)
         {
         fits_get_errstatus(status,err_text);
-        if (astro_warn) printf("WARNING: astro::fits_write:fits_write_pix() Error %d: %s\n", status, err_text);
+        if (astro_warn) printf("WARNING: astro::fits_write: Write Error %d: %s\n", status, err_text);
+        status=0;
+        fits_close_file(fptr, &status);
         set_astro_errno(ASTRO_ERR_WRITE);
         return(ASTRO_FAILURE);
         }
 
+//
+// Keys for the image (CFITSIO copies them to the uncompressed header)
+//
+
     sprintf(key,"HDU Created by %s/%s - %s", MAJOR_VERSION, pname, version);
-    if (fits_write_key(fptr, TSTRING, "PROGRAM", key, NULL, &status))
+    fits_write_key(fptr, TSTRING, "PROGRAM", key, NULL, &status);
+
+    if (pk->crop)
+        {
+        r=-c0;
+        c=-r0;
+        fits_write_key(fptr, TLONG, "LTV1", &r, "column offset of the cropped image", &status);
+        fits_write_key(fptr, TLONG, "LTV2", &c, "row offset of the cropped image", &status);
+        r=1;
+        fits_write_key(fptr, TLONG, "LTM1_1", &r, NULL, &status);
+        fits_write_key(fptr, TLONG, "LTM2_2", &r, NULL, &status);
+        }
+
+    if (status)
         {
         fits_get_errstatus(status,err_text);
         if (astro_warn) printf("WARNING: astro::fits_write:fits_write_key() Error %d: %s\n", status, err_text);
+        status=0;
+        fits_close_file(fptr, &status);
         set_astro_errno(ASTRO_ERR_KEY);
         return(ASTRO_FAILURE);
         }
@@ -902,15 +3399,17 @@ char     **astro::CArrayAlloc(int crows, int ccolumns)
 // Double index arrays have a header containing pointer to each row
 //
 
-    int header = crows * sizeof(char*);
-    int body = 0;
+    size_t header = (size_t)crows * sizeof(char*);
+    size_t body = (size_t)crows * ccolumns * sizeof(char);
 
-    if (DEBUG) printf("DEBUG: astro::ArrayAlloc (C): crows=%x, ccolumns=%x, header=%x\n",crows,ccolumns,header);
+    if (DEBUG) printf("DEBUG: astro::ArrayAlloc (C): crows=%x, ccolumns=%x, header=%lx\n",crows,ccolumns,(unsigned long)header);
+    if (DEBUG) printf("DEBUG: astro::ArrayAlloc (C): body=%lx\n",(unsigned long)body);
 
-    for(a=0; a<crows; a++) body+=ccolumns;
-    body*=sizeof(char);
-
-    if (DEBUG) printf("DEBUG: astro::ArrayAlloc (C): body=%x\n",body);
+    if ((crows < 1) || (ccolumns < 1))
+        {
+        set_astro_errno(ASTRO_ERR_MALLOC);
+        return(NULL);
+        }
 
 //
 // Allocate the total space needed
@@ -975,11 +3474,14 @@ float   **astro::ArrayAlloc(int frows, int fcolumns)
 // Double index arrays have a header containing pointer to each row
 //
 
-    int header = frows * sizeof(float*);
-    int body = 0;
+    size_t header = (size_t)frows * sizeof(float*);
+    size_t body = (size_t)frows * fcolumns * sizeof(float);
 
-    for(a=0; a<frows; a++) body+=fcolumns;
-    body*=sizeof(float);
+    if ((frows < 1) || (fcolumns < 1))
+        {
+        set_astro_errno(ASTRO_ERR_MALLOC);
+        return(NULL);
+        }
 
 //
 // Allocate the total space needed
@@ -1005,3 +3507,139 @@ float   **astro::ArrayAlloc(int frows, int fcolumns)
         }
     return(fptr);
     }
+
+
+//
+// ARENA - Memory arena for buffers that are only needed while one item is
+//         processed.  Buffers are handed out from one block and are all
+//         released together by reset(), which is called at the start of
+//         every item.  If an item needs more than the block holds, the extra
+//         buffers are allocated separately and the block is grown to the
+//         high water mark at the next reset(), so after the largest item
+//         has been seen no more memory is allocated and the memory used by
+//         a long batch stays flat.
+//
+//         All buffers are aligned on 64 byte (cache line) boundaries.
+//
+
+//
+// ARENA() - Constructor.  No memory is allocated until it is needed.
+//
+
+arena::arena()
+    {
+    base=NULL;
+    cap=0;
+    used=0;
+    high=0;
+    }
+
+
+//
+// ~ARENA() - Destructor.  Releases all memory.
+//
+
+arena::~arena()
+    {
+    reset();
+    free(base);
+    }
+
+
+//
+// ALLOC() - Returns a buffer of the given size from the arena.  The buffer
+//           is valid until the next reset().
+//
+// Arguments:
+//      bytes   - Size of the buffer in bytes
+//
+// Return Value:
+//      void *  - Pointer to the buffer (NULL if out of memory)
+//
+
+void    *arena::alloc(size_t bytes)
+    {
+    void    *p;
+
+    bytes=(bytes+63) & ~((size_t)63);
+
+    high+=bytes;
+
+    if (used+bytes <= cap)
+        {
+        p=base+used;
+        used+=bytes;
+        return(p);
+        }
+
+    if (posix_memalign(&p, 64, bytes)) return(NULL);
+    extra.push_back(p);
+    return(p);
+    }
+
+
+//
+// FLOATS() - Returns a buffer for n float values from the arena.
+//
+// Arguments:
+//      n       - Number of float values
+//
+// Return Value:
+//      float * - Pointer to the buffer (NULL if out of memory)
+//
+
+float   *arena::floats(long n)
+    {
+    return((float *) alloc((size_t)n*sizeof(float)));
+    }
+
+
+//
+// RESET() - Releases all buffers handed out since the last reset().  If the
+//           block was too small, it is replaced with one that holds
+//           everything that was needed.
+//
+// Arguments: NONE
+//
+// Return Value: NONE
+//
+
+void    arena::reset()
+    {
+    void        *p;
+    unsigned    int     i;
+
+    for (i=0; i < extra.size(); i++) free(extra[i]);
+    extra.clear();
+
+    if (high > cap)
+        {
+        free(base);
+        base=NULL;
+        cap=0;
+        if (!posix_memalign(&p, 64, high))
+            {
+            base=(char *) p;
+            cap=high;
+            }
+        if (DEBUG) printf("DEBUG: arena::reset() block grown to %zu bytes\n",cap);
+        }
+
+    used=0;
+    high=0;
+    }
+
+
+//
+// SIZE() - Returns the number of bytes held by the arena block.
+//
+// Arguments: NONE
+//
+// Return Value:
+//      Size of the block in bytes
+//
+
+size_t  arena::size()
+    {
+    return(cap);
+    }
@@ -45,6 +45,33 @@
 //
 //
 // Revision History:
+//      3.0  17-Oct-2026: - Add region center fields to file_rec and a
+//                          constructor so all fields have defaults
+//                        - Add fits_open(), fits_read_strip(), fits_close()
+//                          and read_catalog() for mosaic/catalog processing
+//                        - Add ASTRO_ERR_CATALOG error code
+//                        - Add hdu and plane fields to file_rec
+//                        - Add fits_expand() and fits_read_plane() for
+//                          cubes and multi-extension files
+//                        - Add ASTRO_ERR_HDU error code
+//                        - Add fits_read_tiles() and file_compressed()
+//                        - Add fits_read_tiles() for caller buffers
+//                        - Add arena class and fits_read()/fits_read_plane()
+//                          versions that use it
+//                        - Add header information fields to file_rec
+//                        - Add fits_meta() and prescan()
+//                        - Add per item option fields to file_rec and
+//                          read_option()
+//                        - Add ASTRO_ERR_OPTION error code
+//                        - Add cpu_name(), cpu_path() and cpu_report()
+//                        - Include image_class.h and add fits_read() and
+//                          fits_write() versions for Image2D/ImageView
+//                        - Add badpix field to file_rec, badpix_read() and
+//                          ASTRO_ERR_REGION error code
+//                        - Add mem_name(), mem_load(), mem_free() and
+//                          fits_open_any() for in memory images
+//                        - Add fits_pack options, pack_option() and a
+//                          tile compressed fits_write() version
 //      2.0  26-May-2018: - Add fits_write() function
 //                        - Add new error codes
 //                        - Add return constants
@@ -61,7 +88,7 @@
 //      1.0  17-Feb-2017: - Initial version
 //
 
-#define     ASTRO_H_VER     "2.0/20180526"
+#define     ASTRO_H_VER     "3.0/20261017"
 
 #include    <cstddef>
 #include    <iostream>
@@ -70,6 +97,8 @@
 
 #include    <fitsio.h>
 
+#include    "image_class.h"
+
 //
 // Data structure used for the file parameters
 //
@@ -82,8 +111,79 @@ struct  file_rec
     std::string     result;     /* Prefix for overall output files           */
     int             radius;     /* Outer radius value                        */
     int             binary;     /* Is binary (1) FITS or ASCII text FITS (0) */
+    int             region;     /* Item is a region of a mosaic (catalog)    */
+    int             x_ctr;      /* Region/image center column (0 = default)  */
+    int             y_ctr;      /* Region/image center row (0 = default)     */
+    int             hdu;        /* HDU number of the image (0 = default)     */
+    int             plane;      /* Plane number in a cube (1 based)          */
+    int             xnum;       /* X dimension from the header (0=unknown)   */
+    int             ynum;       /* Y dimension from the header (0=unknown)   */
+    int             bitpix;     /* BITPIX from the header                    */
+    int             compressed; /* Image is tile compressed                  */
+    int             nimg;       /* Image planes in the file (0=unknown)      */
+    long            mtime;      /* File modification time when scanned       */
+    long            bytes;      /* File size when scanned                    */
+
+//
+// Per item options.  -1 means the command line value is used.
+//
+
+    int             mask;       /* 0 none, 1 bright values, 2 line (bar)     */
+    int             fixed;      /* Fixed annuli size (0 = off)               */
+    int             reverse;    /* Decreasing outer radius                   */
+    int             highpass;   /* High pass filter                          */
+    int             zero;       /* Zero padding of the polar projection      */
+    int             rmin;       /* First radius to calculate (0 = 1)         */
+    int             rmax;       /* Last radius to calculate (0 = radius)     */
+    std::string     badpix;     /* Bad pixel/star mask file ("" = none)      */
+
+    file_rec() : valid(0), radius(-1), binary(0), region(0), x_ctr(0), y_ctr(0), hdu(0), plane(0),
+                 xnum(0), ynum(0), bitpix(0), compressed(0), nimg(0), mtime(0), bytes(0),
+                 mask(-1), fixed(-1), reverse(-1), highpass(-1), zero(-1), rmin(0), rmax(0) {}
     };        
 
+//
+// Memory arena for buffers that live while one item is processed.  All
+//   buffers are released together by reset() (see astro_class.cpp).
+//
+
+class   arena   {
+                public:
+                    arena();
+                    ~arena();
+                    void   *alloc(size_t bytes);
+                    float  *floats(long n);
+                    void   reset();
+                    size_t size();
+                private:
+                    char   *base;       /* Block buffers are handed out from */
+                    size_t cap;         /* Size of the block                 */
+                    size_t used;        /* Bytes of the block handed out     */
+                    size_t high;        /* Bytes needed since last reset()   */
+                    std::vector<void *> extra; /* Buffers outside the block  */
+                };
+
+//
+// Options for writing a tile compressed (or cropped) image.  See
+//   pack_option() and fits_write() in astro_class.cpp.
+//
+
+#define     FITS_PACK_NONE      0
+#define     FITS_PACK_RICE      1
+#define     FITS_PACK_GZIP      2
+
+struct  fits_pack
+    {
+    int             type;       /* FITS_PACK_NONE, _RICE or _GZIP            */
+    float           q;          /* >0 noise/q step, <0 -step, 0 lossless     */
+    int             dither;     /* Subtractive dithering of quantized tiles  */
+    int             rows;       /* Image rows per tile                       */
+    int             crop;       /* Write only the populated sub-image        */
+    int             nthreads;   /* Threads compressing the tiles             */
+
+    fits_pack() : type(FITS_PACK_NONE), q(4.0), dither(1), rows(16), crop(0), nthreads(1) {}
+    };
+
 //
 // Class definition values
 //
@@ -99,10 +199,36 @@ class   astro   {
                     char    **fits_header_read(char *fname, int *keys);
                     int     fits_header_write(char *fname, char keys[][32], char items[][80], int num);
                     float  *fits_read(char *fname, int *size);
+                    float  *fits_read(char *fname, arena *mem, int *size);
+                    int    fits_read(char *fname, Image2D<float> *img);
                     int    fits_write(char *fname, float *data, int x_size, int y_size, int newfile, const char *pname, const char *version);
+                    int    fits_write(char *fname, ImageView<float> img, int newfile, const char *pname, const char *version);
+                    int    fits_write(char *fname, ImageView<float> img, const fits_pack *pk, const char *pname, const char *version);
+                    int    pack_option(const char *opt, fits_pack *pk);
                     char   **CArrayAlloc(int crows, int ccols);
                     float  **ArrayAlloc(int frows, int fcols);
                     int    read_lines(std::string fname, std::vector<file_rec> *rec);
+                    int    read_catalog(std::string fname, std::vector<file_rec> *rec);
+                    fitsfile *fits_open(char *fname, int *xnum, int *ynum);
+                    int    fits_read_strip(fitsfile *fptr, int xnum, int row_lo, int row_hi, float *buf);
+                    int    fits_close(fitsfile *fptr);
+                    int    fits_expand(std::vector<file_rec> *rec);
+                    int    fits_meta(file_rec *f);
+                    int    prescan(std::vector<file_rec> *rec, std::string meta);
+                    int    read_option(std::string opt, file_rec *f);
+                    int    badpix_read(char *fname, int xnum, int ynum, BitMask *bm);
+                    float  *fits_read_plane(fitsfile *fptr, int hdu, int plane, int *xnum, int *ynum, int *size);
+                    float  *fits_read_plane(fitsfile *fptr, int hdu, int plane, arena *mem, int *xnum, int *ynum, int *size);
+                    float  *fits_read_tiles(char *fname, int nthreads, int *xnum, int *ynum, int *size);
+                    int    fits_read_tiles(char *fname, int nthreads, float **buf, long *cap, int *xnum, int *ynum, int *size);
+                    bool   file_compressed(std::string fname);
+                    bool   mem_name(const char *fname);
+                    int    mem_load(const char *fname);
+                    void   mem_free(const char *fname);
+                    int    fits_open_any(fitsfile **fptr, const char *fname, int image, int *status);
+                    std::string cpu_name();
+                    const char *cpu_path();
+                    void   cpu_report(const char *pname, const char **kernels);
                 };
 
 //
@@ -131,6 +257,10 @@ class   astro   {
 #define     ASTRO_ERR_READPIX   1036
 #define     ASTRO_ERR_HOMEDIR   1037
 #define     ASTRO_ERR_GET_SIZE  1038
+#define     ASTRO_ERR_CATALOG   1039
+#define     ASTRO_ERR_HDU       1040
+#define     ASTRO_ERR_OPTION    1041
+#define     ASTRO_ERR_REGION    1042
 
 //
 // astro_class return codes
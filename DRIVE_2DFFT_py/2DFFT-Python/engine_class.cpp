@@ -0,0 +1,444 @@
+//
+// ENGINE_CLASS.CPP - This class provides the transform engines used by P2DFFT
+//                    (see engine_class.h for the spectrum they produce).
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
+//           NC Museum of Natural Sciences,
+//           Astronomy & Astrophysics Lab,
+//           Raleigh, NC USA.
+//           http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//      North Carolina Museum of Natural Sciences
+//      Astronomy & Astrophysics Laboratory
+//      11 West Jones Street
+//      Raleigh, NC, 27601  USA
+//      +1.919.707.9800
+//
+//      -- or --
+//
+//      patrick.treuthardt@naturalsciences.org
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//                        - Add gather() and scale() (moved from p2dfft.cpp)
+//
+
+#define     ENGINE_VER   "1.0/20261017"
+
+#include    <math.h>
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+
+#include    "engine_class.h"
+#include    "polar_class.h"
+#include    "globals.h"
+
+//
+// Number of modes in the spectrum
+//
+
+#define     N_MODE      (M_FIN+1)
+
+//
+// FUNCTION BLOCK
+//
+
+
+//
+// ENGINE() - Constructor.  Plans and tables are made by build().
+//
+
+engine::engine()
+    {
+    tw_re=NULL;
+    tw_im=NULL;
+    r2c=NULL;
+    rows=NULL;
+    }
+
+
+//
+// ~ENGINE() - Destructor.  Releases the plans and tables.
+//
+
+engine::~engine()
+    {
+    if (r2c != NULL) fftw_destroy_plan(r2c);
+    if (rows != NULL) fftw_destroy_plan(rows);
+    free(tw_re);
+    free(tw_im);
+    }
+
+
+//
+// VERSION() - This function will print the current version.
+//
+// Arguments: NONE
+//
+// Return Value: NONE
+//
+
+void    engine::version()
+    {
+    printf("  -- Engine Class Include Version:  %s\n",ENGINE_H_VER);
+    printf("  -- Engine Class Function Version:  %s\n",ENGINE_VER);
+    }
+
+
+//
+// BUILD() - Makes the FFTW plans (and for ENGINE_PRUNED the theta twiddle
+//           table) for an engine.  Nothing is done if they were already
+//           made.  The FULL plan belongs to the caller.  The arrays are
+//           overwritten while planning, and every array later given to
+//           transform() must be allocated with fftw_malloc() like these.
+//
+// Arguments:
+//      kind    - ENGINE_FULL, ENGINE_R2C or ENGINE_PRUNED
+//      in      - Input array (DIM_THT*DIM_RAD complex values)
+//      out     - Output array (DIM_THT*DIM_RAD complex values)
+//
+// Return Value:
+//      ENGINE_SUCCESS  - Engine ready
+//      ENGINE_FAILURE  - Plan or table could not be made
+//
+
+int     engine::build(int kind, fftw_complex *in, fftw_complex *out)
+    {
+    int     m, t;          /* Mode and theta step                            */
+    int     n=DIM_RAD;     /* Length of the ln r transforms                  */
+
+    if (kind == ENGINE_R2C)
+        {
+        if (r2c == NULL) r2c=fftw_plan_dft_r2c_2d( (int) DIM_THT, (int) DIM_RAD, (double *) in, out, FFTW_MEASURE);
+        return((r2c == NULL) ? ENGINE_FAILURE : ENGINE_SUCCESS);
+        }
+
+    if (kind == ENGINE_PRUNED)
+        {
+        if (tw_re == NULL)
+            {
+            tw_re=(double *) malloc((size_t)N_MODE*DIM_THT*sizeof(double));
+            tw_im=(double *) malloc((size_t)N_MODE*DIM_THT*sizeof(double));
+            if ((tw_re == NULL) || (tw_im == NULL)) return(ENGINE_FAILURE);
+
+            for (m=0; m < N_MODE; m++)
+                {
+                for (t=0; t < DIM_THT; t++)
+                    {
+                    tw_re[m*DIM_THT+t]=cos(2.0*M_PI*(double)((m*t)%DIM_THT)/DIM_THT);
+                    tw_im[m*DIM_THT+t]=-sin(2.0*M_PI*(double)((m*t)%DIM_THT)/DIM_THT);
+                    }
+                }
+            }
+
+        if (rows == NULL) rows=fftw_plan_many_dft(1, &n, N_MODE, in, NULL, 1, DIM_RAD, out, NULL, 1, DIM_RAD, FFTW_FORWARD, FFTW_MEASURE);
+        return((rows == NULL) ? ENGINE_FAILURE : ENGINE_SUCCESS);
+        }
+
+    return(ENGINE_SUCCESS);
+    }
+
+
+//
+// CLEAR() - Zeroes the part of the input array an engine uses before the
+//           samples of an annulus are gathered into it.
+//
+//             ENGINE_FULL   - DIM_THT*DIM_RAD+1 complex values
+//             ENGINE_R2C    - DIM_THT*DIM_RAD real values
+//             ENGINE_PRUNED - N_MODE*DIM_RAD complex mode sums
+//
+// Arguments:
+//      kind    - Engine
+//      in      - Input array
+//
+// Return Value: NONE
+//
+
+void    engine::clear(int kind, fftw_complex *in)
+    {
+    if (kind == ENGINE_R2C)
+        memset(in, 0, (size_t)DIM_THT*DIM_RAD*sizeof(double));
+    else if (kind == ENGINE_PRUNED)
+        memset(in, 0, (size_t)N_MODE*DIM_RAD*sizeof(fftw_complex));
+    else
+        memset(in, 0, ((size_t)DIM_THT*DIM_RAD+1)*sizeof(fftw_complex));
+    }
+
+
+//
+// TRANSFORM() - Runs an engine on a gathered input array and returns the
+//               mode spectrum (see engine_class.h).  The spectrum is in
+//               out for FULL and PRUNED and in in (which is no longer
+//               needed) for R2C.
+//
+//               The R2C transform only has ln r frequencies 0 to DIM_RAD/2.
+//               Since the input is real, X[m][p] = conj(X[-m][-p]), so the
+//               others are taken from row DIM_THT-m.
+//
+// Arguments:
+//      kind    - Engine
+//      full    - Plan to use for ENGINE_FULL
+//      in      - Gathered input array
+//      out     - Output array
+//
+// Return Value:
+//      Pointer to the spectrum
+//
+
+fftw_complex    *engine::transform(int kind, fftw_plan full, fftw_complex *in, fftw_complex *out)
+    {
+    int     m, p;          /* Mode and ln r frequency                        */
+    int     h=DIM_RAD/2+1; /* Row length of the R2C output                   */
+    fftw_complex    *src;  /* R2C output value                               */
+
+    if (kind == ENGINE_R2C)
+        {
+        fftw_execute_dft_r2c(r2c, (double *) in, out);
+
+        for (m=0; m < N_MODE; m++)
+            {
+            for (p=0; p < h; p++)
+                {
+                in[m*DIM_RAD+p][0]=out[m*h+p][0];
+                in[m*DIM_RAD+p][1]=out[m*h+p][1];
+                }
+            for (p=h; p < DIM_RAD; p++)
+                {
+                src=&out[((DIM_THT-m)%DIM_THT)*h+(DIM_RAD-p)];
+                in[m*DIM_RAD+p][0]=(*src)[0];
+                in[m*DIM_RAD+p][1]=-(*src)[1];
+                }
+            }
+        return(in);
+        }
+
+    if (kind == ENGINE_PRUNED)
+        {
+        fftw_execute_dft(rows, in, out);
+        return(out);
+        }
+
+    fftw_execute_dft(full, in, out);
+    return(out);
+    }
+
+
+//
+// GATHER() - Samples an annulus of the image into the input array of an
+//            engine.  FULL and R2C get the projection itself, PRUNED gets
+//            the theta DFT of the used modes, summed as the samples are
+//            read.  With opt->zero the first two and last four theta rows
+//            are left at zero.  Samples of pixels in the bad pixel mask are
+//            read as 0 (a select, not a branch).
+//
+// Arguments:
+//      kind    - Engine
+//      in      - Input array of the engine (cleared)
+//      pol     - Polar sampling table
+//      m       - Image to read (see gather_opt for the layout)
+//      cx, cy  - Center pixel (x, y) of the annulus
+//      r_first - First ln r step kept
+//      r_last  - One past the last ln r step kept
+//      opt     - Options (engine_class.h)
+//
+// Return Value:
+//      Sum of the samples (normalization value)
+//
+
+CPU_CLONES
+float   engine::gather(int kind, fftw_complex *in, const logpolar &pol, ImageView<float> m,
+                       int cx, int cy, int r_first, int r_last, const gather_opt *opt)
+    {
+    int     t, rr;         /* Theta and ln r steps in the polar table        */
+    int     md;            /* Mode                                           */
+    int     ri, ci;        /* Row and column of the pixel sampled            */
+    int     masked=!opt->bad.empty(); /* Flag that there is a bad pixel mask */
+    int     r0=opt->xy ? cx : cy;  /* Row of the center                      */
+    int     c0=opt->xy ? cy : cx;  /* Column of the center                   */
+    float   v;             /* Sample value                                   */
+    float   norma=0.0;     /* Normalization value (sum of number of values)  */
+    float   *pj=opt->pj;   /* Polar projection                               */
+    double  *g=(double *) in; /* Real input array (R2C)                      */
+    const int   *dr=opt->xy ? pol.dx : pol.dy; /* Row offsets                */
+    const int   *dc=opt->xy ? pol.dy : pol.dx; /* Column offsets             */
+    ImageView<uint64_t> bv=opt->bad; /* Bad pixel mask                      */
+
+    for (t=0; t < DIM_THT; t++)
+        {
+        if ((opt->zero) && (t < 2 || t > DIM_THT-5)) continue;
+
+        for (rr=r_first; rr < r_last; rr++)
+            {
+            ri=dr[t*pol.n_rad+rr]+r0;
+            ci=dc[t*pol.n_rad+rr]+c0;
+            v=m[ri][ci];
+
+            if (masked) v=(bit_test(bv, ri, ci)) ? 0.0f : v;
+
+            if ((opt->mask) && (v >= opt->ctr_val)) continue;
+
+            norma+=(double) v;
+
+            if (kind == ENGINE_PRUNED)
+                {
+                for (md=0; md <= M_FIN; md++)
+                    {
+                    in[md*DIM_RAD+rr][0]+=(double) v*tw_re[md*DIM_THT+t];
+                    in[md*DIM_RAD+rr][1]+=(double) v*tw_im[md*DIM_THT+t];
+                    }
+                }
+            else if (kind == ENGINE_R2C)
+                {
+                g[t*DIM_RAD+rr]=(double) v;
+                }
+            else
+                {
+                in[t*DIM_RAD+rr][0]=(double) v;
+                }
+
+//
+// The projection is written ln r major, one ln r step behind the
+//   projection array (as it always has been)
+//
+
+            if (pj != NULL)
+                {
+                if (rr > 0) pj[(rr-1)*DIM_THT+t]=v;
+                else if (t > 0) pj[(DIM_RAD-1)*DIM_THT+t-1]=v;
+                }
+            }
+        }
+
+    return(norma);
+    }
+
+
+//
+// SCALE() - Normalizes the mode rows of a spectrum
+//
+// Arguments:
+//      spec    - Spectrum from transform()
+//      norma   - Normalization value from gather()
+//
+// Return Value: NONE
+//
+
+CPU_CLONES
+void    engine::scale(fftw_complex *spec, float norma)
+    {
+    int     im;            /* Index into the spectrum                        */
+
+    for(im=0;im<N_MODE*DIM_RAD;im++) 
+        {
+#ifdef DEBUG_DAT
+        printf("DEBUG: Out Data[%d][0]=%f\n",im,spec[im][0]);
+        printf("DEBUG: Out Data[%d][1]=%f\n",im,spec[im][1]);
+#endif
+        spec[im][0]=spec[im][0]/(double)norma;
+        spec[im][1]=spec[im][1]/(double)norma;
+        }
+    }
+
+
+//
+// COMPARE() - Returns the largest difference between two mode spectra,
+//             relative to the largest magnitude in b.
+//
+// Arguments:
+//      a       - Spectrum to check
+//      b       - Reference spectrum
+//
+// Return Value:
+//      max|a-b| / max|b| (0 if b is all zero)
+//
+
+double  engine::compare(fftw_complex *a, fftw_complex *b)
+    {
+    int     i;
+    double  d;             /* Difference of one value                        */
+    double  v;             /* Magnitude of one reference value               */
+    double  dmax=0.0;      /* Largest difference                             */
+    double  vmax=0.0;      /* Largest reference magnitude                    */
+
+    for (i=0; i < N_MODE*DIM_RAD; i++)
+        {
+        d=hypot(a[i][0]-b[i][0], a[i][1]-b[i][1]);
+        v=hypot(b[i][0], b[i][1]);
+        if (d != d) return(HUGE_VAL);
+        if (d > dmax) dmax=d;
+        if (v > vmax) vmax=v;
+        }
+
+    return((vmax > 0.0) ? dmax/vmax : dmax);
+    }
+
+
+//
+// NAME() - Returns the name of an engine
+//
+// Arguments:
+//      kind    - Engine
+//
+// Return Value:
+//      "full", "r2c", "pruned" or "auto"
+//
+
+const char  *engine::name(int kind)
+    {
+    switch (kind)
+        {
+        case ENGINE_FULL:   return("full");
+        case ENGINE_R2C:    return("r2c");
+        case ENGINE_PRUNED: return("pruned");
+        }
+    return("auto");
+    }
+
+
+//
+// FIND() - Returns the engine with a name
+//
+// Arguments:
+//      kind    - Name of the engine ("full", "r2c", "pruned" or "auto")
+//
+// Return Value:
+//      Engine number, ENGINE_AUTO, or -2 if the name is not known
+//
+
+int     engine::find(const char *kind)
+    {
+    int     k;
+
+    for (k=0; k < ENGINE_COUNT; k++)
+        {
+        if (!strcmp(kind, name(k))) return(k);
+        }
+    if (!strcmp(kind, "auto")) return(ENGINE_AUTO);
+    return(-2);
+    }
@@ -0,0 +1,130 @@
+//
+// ENGINE_CLASS.H - This class provides the transform engines used by P2DFFT
+//                  to get the mode spectra of a log-polar projection.
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
+//           NC Museum of Natural Sciences,
+//           Astronomy & Astrophysics Lab,
+//           Raleigh, NC USA.
+//           http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//      North Carolina Museum of Natural Sciences
+//      Astronomy & Astrophysics Laboratory
+//      11 West Jones Street
+//      Raleigh, NC, 27601  USA
+//      +1.919.707.9800
+//
+//      -- or --
+//
+//      patrick.treuthardt@naturalsciences.org
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//                        - Add gather() and scale() (moved from p2dfft.cpp)
+//                          so every program samples and normalizes the
+//                          projection the way p2dfft does
+//
+
+#define     ENGINE_H_VER   "1.0/20261017"
+
+#include    <fftw3.h>
+
+#include    "image_class.h"
+
+class   logpolar;
+
+//
+// Class definition values
+//
+//   Every engine produces the same spectrum: rows 0 to M_FIN (the modes) of
+//   the 2D forward FFT of the DIM_THT x DIM_RAD projection, stored as
+//   spec[mode*DIM_RAD+p] in FFTW order along ln r.  They differ in how the
+//   projection is given to them (see gather()) and how much of
+//   the 2D transform they calculate:
+//
+//     ENGINE_FULL   - Complex 2D FFT of the whole projection (reference)
+//     ENGINE_R2C    - Real to complex 2D FFT, about half the work of FULL.
+//                     The negative ln r frequencies come from symmetry.
+//     ENGINE_PRUNED - The theta DFT is only calculated for the modes that
+//                     are used, while the samples are gathered, followed by
+//                     one 1D FFT along ln r per mode.
+//
+
+#define     ENGINE_AUTO    -1
+#define     ENGINE_FULL     0
+#define     ENGINE_R2C      1
+#define     ENGINE_PRUNED   2
+#define     ENGINE_COUNT    3
+
+//
+// Options of gather().  The image is read as m[y][x], or m[x][y] with xy set
+//   (the layout of the p2dfft mat[] array).  The bad pixel mask has the same
+//   layout as the image.
+//
+
+struct  gather_opt
+    {
+    int     xy;            /* Image and mask are [x][y] instead of [y][x]    */
+    int     zero;          /* Leave first two and last four theta rows at 0  */
+    int     mask;          /* Leave out samples >= ctr_val (bright center)   */
+    float   ctr_val;       /* Value of the center pixel                      */
+    float   *pj;           /* Polar projection to fill (NULL for none)       */
+    ImageView<uint64_t> bad; /* Bad pixel mask (empty for none)              */
+
+    gather_opt() : xy(0), zero(0), mask(0), ctr_val(0.0f), pj(NULL) {}
+    };
+
+class   engine {
+              public:
+                 engine();
+                 ~engine();
+                 void         version();
+                 int          build(int kind, fftw_complex *in, fftw_complex *out);
+                 void         clear(int kind, fftw_complex *in);
+                 fftw_complex *transform(int kind, fftw_plan full, fftw_complex *in, fftw_complex *out);
+                 float        gather(int kind, fftw_complex *in, const logpolar &pol, ImageView<float> m,
+                                     int cx, int cy, int r_first, int r_last, const gather_opt *opt);
+                 void         scale(fftw_complex *spec, float norma);
+                 double       compare(fftw_complex *a, fftw_complex *b);
+                 const char   *name(int kind);
+                 int          find(const char *kind);
+
+                 double  *tw_re;     /* cos(2 pi m t/DIM_THT) [M_FIN+1][DIM_THT]  */
+                 double  *tw_im;     /* -sin(2 pi m t/DIM_THT) [M_FIN+1][DIM_THT] */
+
+              private:
+                 fftw_plan   r2c;    /* 2D real to complex plan              */
+                 fftw_plan   rows;   /* 1D plans along ln r, one per mode    */
+              };
+
+//
+// Return codes
+//
+
+#define     ENGINE_SUCCESS      0
+#define     ENGINE_FAILURE      1
@@ -2,7 +2,7 @@
 // GLOBALS.H - This file provides the global constants for the P2DFFT package.
 //
 //
-// Version 1.1: 01-Jun-2018
+// Version 1.2: 17-Oct-2026
 //
 //
 // Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
@@ -43,6 +43,14 @@
 //
 //
 // Revision History:
+//      1.2  17-Oct-2026: - Add DECODE_THREADS
+//                        - Add PREFETCH_DEPTH
+//                        - Add cost model defaults for p2dfft -E
+//                        - Add QUEUE_STALE and QUEUE_BEAT
+//                        - Add WATCH_POLL
+//                        - Add MAX_NODES
+//                        - Add engine cost model defaults and autotuner values
+//                        - Add CPU_CLONES and CPU_PATHS
 //      1.1  01-Jun-2018: - Add window limits
 //                        - Add maximum and minimum FITS image sizes
 //                        - Add overall version string
@@ -114,6 +122,91 @@
 #define MIN_FITS    1 
 #define MAX_FITS    MAX_DIM
 
+//
+//  Number of threads used to decompress a tile compressed image that is read
+//    in the background while the previous image is processed
+//
+
+#define DECODE_THREADS  2
+
+//
+//  Number of images that are read ahead of the one being processed (2 for
+//    double buffering, 3 for triple buffering)
+//
+
+#define PREFETCH_DEPTH  2
+
+//
+//  Maximum number of NUMA nodes used for thread placement (p2dfft -b)
+//
+
+#define MAX_NODES   8
+
+//
+//  Work queue (p2dfft -q) timing in seconds.  A claim that has not been
+//    touched for QUEUE_STALE seconds is taken over by another worker, and
+//    workers touch their claims every QUEUE_BEAT seconds.
+//
+
+#define QUEUE_STALE 600
+#define QUEUE_BEAT  30
+
+//
+//  Hot folder (p2dfft -W) wait in ms between checks for a signal while no
+//    image is waiting
+//
+
+#define WATCH_POLL  1000
+
+//
+//  Cost model used by p2dfft -E|--plan-only when the calibration file (written
+//    by p2bench) does not have a value.  Times are in seconds.
+//
+
+#define CAL_FILE    "p2dfft.cal"
+#define CAL_FFT     0.12        // One radius: zero, FFT, normalize, analyze
+#define CAL_SAMPLE  4.0e-9      // One polar sample
+#define CAL_PIXEL   3.0e-9      // Read one uncompressed pixel
+#define CAL_ZPIXEL  2.5e-8      // Decompress one tile compressed pixel
+#define CAL_BYTE    1.5e-8      // Format and write one byte of text output
+#define CAL_R2C_FFT         0.06    // One radius with -e r2c
+#define CAL_PRUNED_FFT      0.002   // One radius with -e pruned
+#define CAL_PRUNED_SAMPLE   2.5e-8  // One polar sample with -e pruned (twiddles)
+
+//
+//  Engine autotuner (p2dfft -e auto).  TUNE_RADII radii are timed for each
+//    engine, and an engine whose spectrum differs from the full transform by
+//    more than ENGINE_TOL (relative) is never used.
+//
+
+#define TUNE_FILE   "p2dfft.tune"
+#define TUNE_RADII  3
+#define ENGINE_TOL  1.0e-6
+
+//
+//  Average line sizes (bytes) of the p2dfft output files for the estimate
+//
+
+#define PLAN_RIP_HDR    20      // .rip header (size and normalization)
+#define PLAN_RIP_LINE   14      // .rip "%e" line
+#define PLAN_DAT_LINE   24      // .dat "%f %e" line
+#define PLAN_M_LINE     80      // _m<mode> line
+#define PLAN_SUM_LINE   21      // _sum_m<mode> line
+
+//
+//  The hot loops (marked CPU_CLONES) are built for each instruction set in
+//    CPU_PATHS and the loader picks the widest one the CPU supports, so one
+//    binary runs well on every node.  This needs GCC on x86-64 Linux (ifunc);
+//    other compilers and systems build the loops once.
+//
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define CPU_CLONES  __attribute__((target_clones("avx512f","avx2","default")))
+#define CPU_PATHS   "avx512f avx2 sse2"
+#else
+#define CPU_CLONES
+#endif
+
 //
 //  Math constants
 //
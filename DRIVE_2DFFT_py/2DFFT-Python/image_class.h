@@ -0,0 +1,393 @@
+//
+// IMAGE_CLASS.H - This file provides the 2D image and spectrum containers
+//                 used by the P2DFFT programs.  They are templates, so the
+//                 whole class is in this file (it is included by
+//                 astro_class.h).
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
+//           NC Museum of Natural Sciences,
+//           Astronomy & Astrophysics Lab,
+//           Raleigh, NC USA.
+//           http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//      North Carolina Museum of Natural Sciences
+//      Astronomy & Astrophysics Laboratory
+//      11 West Jones Street
+//      Raleigh, NC, 27601  USA
+//      +1.919.707.9800
+//
+//      -- or --
+//
+//      patrick.treuthardt@naturalsciences.org
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//                        - Add BitMask (packed pixel mask)
+//
+
+//
+// The containers are used by more than one class header, so this file may be
+//   included more than once
+//
+
+#ifndef     IMAGE_H_VER
+
+#define     IMAGE_H_VER   "1.0/20261017"
+
+#include    <stdint.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <sys/mman.h>
+
+//
+// Class definition values
+//
+//   Every buffer starts on a cache line, and the rows of an Image2D are
+//   padded to a whole number of cache lines so each row starts on one too.
+//   Buffers of IMAGE_HUGE bytes or more are aligned on a huge page and the
+//   kernel is asked to back them with huge pages (Linux).  All sizes are
+//   computed in size_t, so images of any size that fits in memory work.
+//
+//   img[r][c] addresses row r, column c.  A row is found by multiplying by
+//   the stride, not through a table of row pointers.  The C rows of an image
+//   written with astro::fits_write() are the FITS rows (NAXIS2), so the
+//   [x][y] arrays of p2dfft and p2map are written transposed, as they
+//   always have been.
+//
+
+#define     IMAGE_ALIGN         64
+#define     IMAGE_HUGE          (2*1024*1024)
+
+#define     IMAGE_SUCCESS       0
+#define     IMAGE_FAILURE       1
+
+//
+// IMAGE_BLOCK() - Allocates an aligned block of bytes (NULL on failure)
+//
+
+inline void *image_block(size_t bytes)
+    {
+    void    *p=NULL;
+    size_t  align=(bytes >= IMAGE_HUGE) ? IMAGE_HUGE : IMAGE_ALIGN;
+
+    if (bytes == 0) return(NULL);
+    if (posix_memalign(&p, align, bytes)) return(NULL);
+#ifdef MADV_HUGEPAGE
+    if (bytes >= IMAGE_HUGE) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    return(p);
+    }
+
+//
+// Non owning view of rows x cols values stride values apart.  Views are
+//   cheap to copy and are passed by value to the hot loops.
+//
+
+template <class T> class ImageView {
+              public:
+                 ImageView() : base(NULL), rows(0), cols(0), stride(0) {}
+                 ImageView(T *b, long r, long c, long s) : base(b), rows(r), cols(c), stride(s) {}
+
+                 T       *operator[](long r) const { return(base+(size_t)r*stride); }
+                 bool    empty() const { return(base == NULL); }
+
+                 ImageView<T> sub(long r0, long c0, long nr, long nc) const
+                     { return(ImageView<T>(base+(size_t)r0*stride+c0, nr, nc, stride)); }
+
+                 T       *base;      /* First value of row 0                 */
+                 long    rows;       /* Number of rows                       */
+                 long    cols;       /* Number of values used per row        */
+                 long    stride;     /* Values from one row to the next      */
+              };
+
+//
+// Image owning its buffer.  It can't be copied; ownership moves from one
+//   Image2D to another with swap().
+//
+
+template <class T> class Image2D {
+              public:
+                 Image2D() : buf(NULL), n_rows(0), n_cols(0), n_stride(0), n_cap(0) {}
+                 ~Image2D() { release(); }
+
+                 int     alloc(long rows, long cols);
+                 int     fit(long rows, long cols);
+                 void    release() { free(buf); buf=NULL; n_rows=n_cols=n_stride=0; n_cap=0; }
+                 void    zero() { if (buf) memset(buf, 0, bytes()); }
+                 void    swap(Image2D<T> &o);
+
+                 T       *operator[](long r) const { return(buf+(size_t)r*n_stride); }
+                 T       *data() const { return(buf); }
+                 long    rows() const { return(n_rows); }
+                 long    cols() const { return(n_cols); }
+                 long    stride() const { return(n_stride); }
+                 size_t  bytes() const { return((size_t)n_rows*n_stride*sizeof(T)); }
+                 ImageView<T> view() const { return(ImageView<T>(buf, n_rows, n_cols, n_stride)); }
+
+              private:
+                 Image2D(const Image2D<T> &);
+                 Image2D<T> &operator=(const Image2D<T> &);
+
+                 T       *buf;       /* Rows, each padded to a cache line    */
+                 long    n_rows;     /* Number of rows                       */
+                 long    n_cols;     /* Number of values used per row        */
+                 long    n_stride;   /* Values from one row to the next      */
+                 size_t  n_cap;      /* Size of the buffer in bytes          */
+              };
+
+//
+// ALLOC() - Allocates (or reallocates) the image.  The contents are not
+//           initialized.
+//
+// Arguments:
+//      rows    - Number of rows (slowest changing index)
+//      cols    - Number of columns (fastest changing index)
+//
+// Return Value:
+//      IMAGE_SUCCESS or IMAGE_FAILURE (bad size or no memory)
+//
+
+template <class T> int Image2D<T>::alloc(long rows, long cols)
+    {
+    long    per=IMAGE_ALIGN/sizeof(T); /* Values per cache line              */
+    long    stride;
+
+    release();
+
+    if ((rows < 1) || (cols < 1)) return(IMAGE_FAILURE);
+
+    stride=((cols+per-1)/per)*per;
+
+    if ((size_t)rows > ((size_t)-1)/sizeof(T)/(size_t)stride) return(IMAGE_FAILURE);
+
+    if ((buf=(T *) image_block((size_t)rows*stride*sizeof(T))) == NULL) return(IMAGE_FAILURE);
+
+    n_rows=rows;
+    n_cols=cols;
+    n_stride=stride;
+    n_cap=bytes();
+    return(IMAGE_SUCCESS);
+    }
+
+//
+// FIT() - Sets the size of the image, reusing the buffer if it is large
+//         enough (a loop over images of different sizes then stops
+//         allocating once it has seen the largest).  The contents are not
+//         initialized.
+//
+// Arguments:
+//      rows    - Number of rows (slowest changing index)
+//      cols    - Number of columns (fastest changing index)
+//
+// Return Value:
+//      IMAGE_SUCCESS or IMAGE_FAILURE (bad size or no memory)
+//
+
+template <class T> int Image2D<T>::fit(long rows, long cols)
+    {
+    long    per=IMAGE_ALIGN/sizeof(T); /* Values per cache line              */
+    long    stride;
+
+    if ((rows < 1) || (cols < 1)) return(IMAGE_FAILURE);
+
+    stride=((cols+per-1)/per)*per;
+
+    if ((buf == NULL) || ((size_t)rows > n_cap/sizeof(T)/(size_t)stride)) return(alloc(rows, cols));
+
+    n_rows=rows;
+    n_cols=cols;
+    n_stride=stride;
+    return(IMAGE_SUCCESS);
+    }
+
+//
+// SWAP() - Exchanges the buffers of two images
+//
+
+template <class T> void Image2D<T>::swap(Image2D<T> &o)
+    {
+    T       *b=buf;
+    long    r=n_rows, c=n_cols, s=n_stride;
+    size_t  k=n_cap;
+
+    buf=o.buf; n_rows=o.n_rows; n_cols=o.n_cols; n_stride=o.n_stride; n_cap=o.n_cap;
+    o.buf=b; o.n_rows=r; o.n_cols=c; o.n_stride=s; o.n_cap=k;
+    }
+
+//
+// Complex spectrum of rows x cols values, stored as (real, imaginary) pairs
+//   with no padding so a whole spectrum can be handed to FFTW.  For T=double
+//   row() returns the same type as fftw_complex *.  It can't be copied;
+//   ownership moves with swap().
+//
+
+template <class T> class Spectrum {
+              public:
+                 Spectrum() : buf(NULL), n_rows(0), n_cols(0) {}
+                 ~Spectrum() { release(); }
+
+                 int     alloc(long rows, long cols);
+                 void    release() { free(buf); buf=NULL; n_rows=n_cols=0; }
+                 void    zero() { if (buf) memset(buf, 0, bytes()); }
+                 void    swap(Spectrum<T> &o);
+
+                 T       (*row(long r) const)[2] { return(buf+(size_t)r*n_cols); }
+                 T       &re(long r, long c) const { return(buf[(size_t)r*n_cols+c][0]); }
+                 T       &im(long r, long c) const { return(buf[(size_t)r*n_cols+c][1]); }
+                 long    rows() const { return(n_rows); }
+                 long    cols() const { return(n_cols); }
+                 size_t  bytes() const { return((size_t)n_rows*n_cols*sizeof(T[2])); }
+
+              private:
+                 Spectrum(const Spectrum<T> &);
+                 Spectrum<T> &operator=(const Spectrum<T> &);
+
+                 T       (*buf)[2];  /* (real, imaginary) pairs, row major   */
+                 long    n_rows;     /* Number of rows                       */
+                 long    n_cols;     /* Number of values per row             */
+              };
+
+//
+// ALLOC() - Allocates (or reallocates) the spectrum.  The contents are not
+//           initialized.
+//
+// Arguments:
+//      rows    - Number of rows (slowest changing index)
+//      cols    - Number of columns (fastest changing index)
+//
+// Return Value:
+//      IMAGE_SUCCESS or IMAGE_FAILURE (bad size or no memory)
+//
+
+template <class T> int Spectrum<T>::alloc(long rows, long cols)
+    {
+    release();
+
+    if ((rows < 1) || (cols < 1)) return(IMAGE_FAILURE);
+
+    if ((size_t)rows > ((size_t)-1)/sizeof(T[2])/(size_t)cols) return(IMAGE_FAILURE);
+
+    if ((buf=(T (*)[2]) image_block((size_t)rows*cols*sizeof(T[2]))) == NULL) return(IMAGE_FAILURE);
+
+    n_rows=rows;
+    n_cols=cols;
+    return(IMAGE_SUCCESS);
+    }
+
+//
+// SWAP() - Exchanges the buffers of two spectra
+//
+
+template <class T> void Spectrum<T>::swap(Spectrum<T> &o)
+    {
+    T       (*b)[2]=buf;
+    long    r=n_rows, c=n_cols;
+
+    buf=o.buf; n_rows=o.n_rows; n_cols=o.n_cols;
+    o.buf=b; o.n_rows=r; o.n_cols=c;
+    }
+
+//
+// Packed mask of rows x cols pixels, one bit per pixel (1 = masked).  The
+//   bits of a row are 64 bit words in an Image2D, so every row starts on a
+//   cache line and bit c of row r is bit c%64 of word c/64.  A whole mask
+//   of the largest image is 1/32 the size of the float image.  The hot
+//   loops take view() and read a bit with bit_test(), which has no branch.
+//   It can't be copied.
+//
+
+class BitMask {
+              public:
+                 BitMask() : n_cols(0) {}
+
+                 int     alloc(long rows, long cols);
+                 void    release() { bits.release(); n_cols=0; }
+                 void    set(long r, long c) { bits[r][c>>6]|=(uint64_t)1 << (c&63); }
+                 void    clear(long r, long c) { bits[r][c>>6]&=~((uint64_t)1 << (c&63)); }
+                 int     test(long r, long c) const { return((int)((bits[r][c>>6] >> (c&63)) & 1)); }
+                 long    count() const;
+                 long    rows() const { return(bits.rows()); }
+                 long    cols() const { return(n_cols); }
+                 ImageView<uint64_t> view() const { return(bits.view()); }
+
+              private:
+                 BitMask(const BitMask &);
+                 BitMask &operator=(const BitMask &);
+
+                 Image2D<uint64_t> bits; /* Words of each row                */
+                 long    n_cols;     /* Number of pixels per row             */
+              };
+
+//
+// BIT_TEST() - Returns bit c of row r of a BitMask view (0 or 1)
+//
+
+inline int bit_test(ImageView<uint64_t> b, long r, long c)
+    {
+    return((int)((b[r][c>>6] >> (c&63)) & 1));
+    }
+
+//
+// ALLOC() - Allocates (or reallocates) the mask with no pixel masked
+//
+// Arguments:
+//      rows    - Number of rows (slowest changing index)
+//      cols    - Number of pixels per row (fastest changing index)
+//
+// Return Value:
+//      IMAGE_SUCCESS or IMAGE_FAILURE (bad size or no memory)
+//
+
+inline int BitMask::alloc(long rows, long cols)
+    {
+    n_cols=0;
+    if ((cols < 1) || bits.alloc(rows, (cols+63)/64)) return(IMAGE_FAILURE);
+
+    bits.zero();
+    n_cols=cols;
+    return(IMAGE_SUCCESS);
+    }
+
+//
+// COUNT() - Returns the number of masked pixels
+//
+
+inline long BitMask::count() const
+    {
+    long    r, w;
+    long    n=0;
+
+    for (r=0; r < bits.rows(); r++)
+        {
+        for (w=0; w < bits.cols(); w++) n+=__builtin_popcountll(bits[r][w]);
+        }
+
+    return(n);
+    }
+
+#endif
@@ -0,0 +1,1321 @@
+//
+// P2BENCH.CPP - This program measures how the P2DFFT radius loop scales on a
+//               machine, to choose the number of threads per p2dfft job and
+//               the number of jobs per node for each hardware generation.
+//               The radius loop (polar gather and FFT engine, as p2dfft runs
+//               it) is timed for 1 to N threads with and without SMT
+//               siblings and with the threads packed on one NUMA node or
+//               spread over the nodes, on the images given and on synthetic
+//               images.  A CSV table of the runs and a recommended
+//               configuration are written, along with the cost model
+//               (p2dfft.cal) used by p2dfft -E|--plan-only.
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// 2DFFT (original) Author: Dr. Ivanio Puerari
+//                          Instituto Nacional de Astrofisica,
+//                          Optica y Electronica,
+//                          Santa Maria Tonantzintla,
+//                          Puebla, Mexico
+//
+// 2DFFT (revised) Lead Author: Dr. Marc Seigar
+//                              University of Minnesota Duluth,
+//                              Duluth, MN USA
+//
+// 2DFFT (progenitor of P2DFFT) Lead Author: Dr. Benjamin Davis
+//                                           Swinburne University of Technology.
+//                                           Centre for Astrophysics and
+//                                           Supercomputing
+//                                           Melbourne, Victoria, Australia
+//                                       http://d.umn.edu/~msseigar/2DFFT.html
+//
+// P2DFFT By: Ian Hewitt & Dr. Patrick Treuthardt,
+//            NC Museum of Natural Sciences,
+//            Astronomy & Astrophysics Lab,
+//            Raleigh, NC USA.
+//            http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//     North Carolina Museum of Natural Sciences
+//     Astronomy & Astrophysics Laboratory
+//     11 West Jones Street
+//     Raleigh, NC, 27601  USA
+//     +1.919.707.9800
+//
+//     -- or --
+//
+//     patrick.treuthardt@naturalsciences.org
+//
+//
+// Usage: p2bench [-o|--output <file>] [-c|--cal <file>] [-N|--no-cal]
+//                [-v|--verbose] [-e|--engine full|r2c|pruned]
+//                [-t|--threads <n>[,<n>...]] [-n|--radii <n>]
+//                [-r|--repeat <n>] [-s|--synthetic <size>[,<size>...]]
+//                [-C|--cpu-report] [<file> ...]
+//
+//        The FITS files on the command line (e.g. the shipped ngc1566.fits
+//        and ngc5033.fits) and the synthetic images are each benchmarked.
+//        The options are:
+//
+//              -o|--output: Result table (default Bench.csv)
+//              -c|--cal   : Cost model file written for p2dfft -E (default
+//                           p2dfft.cal)
+//              -N|--no-cal: Do not measure or write the cost model
+//              -v|--verbose: Print each run as it is done
+//              -e|--engine: Transform timed in the radius loop (see p2dfft
+//                           -e, default full)
+//              -t|--threads: Thread counts to time (default 1, 2, 4, ... up
+//                           to all the CPUs of the placement)
+//              -n|--radii : Radii timed per run, spread evenly over the
+//                           radii of the image (default 64, 0 for all).  The
+//                           item times are scaled to all the radii.
+//              -r|--repeat: Runs of each configuration; the fastest is kept
+//                           (default 2)
+//              -s|--synthetic: Sizes of the square synthetic images (default
+//                           512,1024, 0 for none).  They are two armed
+//                           spirals with an exponential disk and noise.
+//              -C|--cpu-report: Show the CPU and the code path (sse2, avx2
+//                           or avx512f) the polar gather runs, then exit
+//
+//
+// Placements:
+//
+//      The CPUs this process may run on are put in order for each placement
+//      and thread t of a run is pinned to the t-th CPU of the order.
+//
+//      close        - Node 0 first, then node 1, ...  Both SMT siblings of
+//                     a core are used before the next core.
+//      close-nosmt  - As close, with one thread per core
+//      spread       - Round robin over the NUMA nodes (with SMT siblings)
+//      spread-nosmt - As spread, with one thread per core
+//
+//      The nosmt placements are only run when the cores have siblings and
+//      the spread placements only on machines with more than one node.  As
+//      in p2dfft -b, each node reads its own copy of the image.
+//
+//      Every thread count is run as one job (the scaling of one image) and,
+//      when more than one fits, as N/threads jobs at once on the same
+//      placement, each with its own radius list, which is the throughput
+//      of a node running that many p2dfft jobs.
+//
+//
+// Output Table (CSV, one line per run):
+//
+//      image       - File name or synth<size>
+//      rows, cols  - Size of the image
+//      engine      - Transform (see -e)
+//      placement   - See above
+//      threads     - Threads per job
+//      jobs        - Jobs run at once
+//      nodes       - NUMA nodes the threads ran on
+//      radii       - Radii timed per job (of all_radii)
+//      all_radii   - Radii p2dfft calculates for the image
+//      wall_s      - Wall time of the run
+//      item_s      - Wall time of one job scaled to all the radii
+//      items_hr    - Images per hour of all the jobs (node throughput)
+//      speedup     - Throughput over one job on one thread (same placement)
+//      efficiency  - speedup / (threads * jobs)
+//      gather_ms   - Mean time per radius to clear the engine input and
+//                    gather the polar samples
+//      fft_ms      - Mean time per radius of the FFT engine
+//      gather_GBs  - Bytes the gather must move (image, polar table and
+//                    engine input, each once) over its time, all threads
+//      fft_GBs     - Same for the FFT (input read and output written once;
+//                    the FFT passes move more, so this is a lower bound)
+//      thread_MB   - Engine arrays of each thread (the per thread workspace)
+//      shared_MB   - Image copies, polar table and engine tables shared by
+//                    the threads
+//
+//      The recommended configuration is the placement and threads per job
+//      with the highest node throughput (items_hr with as many jobs as
+//      fit) summed over the images, relative to the best of each image.
+//      It is printed and added to the cost model file as comments.
+//
+//
+// Cost Model:
+//
+//      Unless -N is given, each engine is timed on one thread for
+//      BENCH_CAL_RADII radii of the first image and the reading of the
+//      first FITS file is timed.  The values are written as "key value"
+//      lines that p2dfft -E reads (see read_calibration() in p2dfft.cpp):
+//
+//          <engine>.fft     - Seconds per radius (clear and transform)
+//          <engine>.sample  - Seconds per polar sample (gather)
+//          read.pixel       - Seconds per pixel to read an image
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//
+
+#define     VERSION "1.0/20261017"
+
+//
+// HEADER FILES
+//
+
+#include    <math.h>
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <unistd.h>
+#include    <getopt.h>
+#include    <omp.h>
+#ifdef __linux__
+#include    <sched.h>
+#endif
+#include    <vector>
+#include    <string>
+#include    <map>
+#include    <algorithm>
+
+#include    "globals.h"
+#include    "astro_class.h"
+#include    "polar_class.h"
+#include    "engine_class.h"
+
+//
+// CONSTANTS
+//
+
+#define     BENCH_RADII     64   /* Radii timed per run (-n)                 */
+#define     BENCH_REPEAT    2    /* Runs of each configuration (-r)          */
+#define     BENCH_CAL_RADII 8    /* Radii timed per engine for the cost model*/
+#define     DEF_OUT     "Bench.csv"  /* Default result table                 */
+#define     DEF_SYNTH   "512,1024"   /* Default synthetic image sizes        */
+#define     STR_SIZE    256  /* Maximum characters in an option value        */
+
+//
+// Order of the CPUs for one placement
+//
+
+struct  bench_place
+    {
+    std::string         name;   /* Placement name                            */
+    std::vector<int>    cpus;   /* CPU of each thread                        */
+    };
+
+//
+// Result of one run
+//
+
+struct  bench_row
+    {
+    std::string image;         /* Image name                                 */
+    long    rows, cols;        /* Image size                                 */
+    int     radii;             /* Radii timed                                */
+    int     all_rad;           /* Radii of the full analysis                 */
+    int     place;             /* Placement index                            */
+    int     threads;           /* Threads per job                            */
+    int     jobs;              /* Jobs run at once                           */
+    int     packed;            /* As many jobs as fit on the placement       */
+    int     nodes;             /* NUMA nodes used                            */
+    double  wall;              /* Wall seconds                               */
+    double  item;              /* Seconds per image (all radii)              */
+    double  items_hr;          /* Images per hour of all the jobs            */
+    double  speedup;           /* Throughput over one thread                 */
+    double  eff;               /* Parallel efficiency                        */
+    double  g_ms, f_ms;        /* Mean gather and FFT time per radius        */
+    double  g_gbs, f_gbs;      /* Gather and FFT bytes per second            */
+    double  ws_mb, sh_mb;      /* Per thread and shared memory               */
+    };
+
+//
+// VARIABLES
+//
+
+int     c;                 /* Getopt_long return value                       */
+int     verbose=0;         /* Flag for verbose mode                          */
+int     cpu_rep=0;         /* Flag for -C|--cpu-report                       */
+int     no_cal=0;          /* Flag for -N|--no-cal                           */
+int     eng_kind=ENGINE_FULL; /* Transform timed (-e)                        */
+int     n_radii=BENCH_RADII;  /* Radii timed per run (-n)                    */
+int     repeat=BENCH_REPEAT;  /* Runs of each configuration (-r)             */
+int     n_nodes=0;         /* Number of NUMA nodes                           */
+int     max_cpus=0;        /* CPUs this process may run on                   */
+int     all_rad;           /* Radii of the current image                     */
+int     cx, cy;            /* Center of the current image                    */
+int     node_of[CPU_SETSIZE]; /* NUMA node of each CPU                       */
+int     core_of[CPU_SETSIZE]; /* First SMT sibling (core) of each CPU        */
+
+double  log_rad;           /* ln of the largest radius of the current image  */
+double  cal_fft[ENGINE_COUNT];    /* Seconds per radius for the cost model   */
+double  cal_smp[ENGINE_COUNT];    /* Seconds per sample for the cost model   */
+double  cal_pix=0.0;       /* Seconds per pixel read (0 = not measured)      */
+
+char    oname[STR_SIZE]=DEF_OUT;  /* Result table name (-o)                  */
+char    calname[STR_SIZE]=CAL_FILE; /* Cost model file name (-c)             */
+char    synth[STR_SIZE]=DEF_SYNTH;  /* Synthetic image sizes (-s)            */
+char    tlist[STR_SIZE]="";  /* Thread counts (-t)                           */
+
+#ifdef __linux__
+cpu_set_t   all_cpus;      /* CPUs this process may run on                   */
+#endif
+
+astro       ast;           /* Instantiation of astro_class                   */
+logpolar    pol;           /* Polar sampling table shared by all threads     */
+engine      eng;           /* Transform engine (plans shared by all threads) */
+gather_opt  g_opt;         /* Gather options (none, as p2dfft by default)    */
+fftw_plan   plan=NULL;     /* Complex 2D plan for -e full                    */
+
+Image2D<float>  img;                /* Current image ([y][x])                */
+Image2D<float>  reps[MAX_NODES];    /* Copy of the image on each node        */
+
+fftw_complex    **in_data; /* Engine input array per thread                  */
+fftw_complex    **out_data;/* Engine output array per thread                 */
+
+std::vector<int>            node_cpus[MAX_NODES]; /* Allowed CPUs per node   */
+std::vector<bench_place>    places;  /* Placements run                       */
+std::vector<int>            rads;    /* Radii timed for the current image    */
+std::vector<bench_row>      rows;    /* Result of every run                  */
+
+//
+// SUBROUTINES
+//
+
+
+//
+// READ_TOPOLOGY() - Finds the CPUs this process may run on, their NUMA node
+//                   (/sys/devices/system/node) and their core (first CPU of
+//                   the thread_siblings_list).  Without the information all
+//                   CPUs are one node with one CPU per core.
+//
+// Global Variables:
+//      all_cpus, node_cpus, n_nodes, node_of, core_of, max_cpus
+//
+// Return Value: NONE
+//
+
+void    read_topology()
+    {
+    int     n;             /* Node number                                    */
+    int     lo, hi;        /* CPU range from a cpulist                       */
+    int     cpu;           /* CPU number                                     */
+    char    path[128];     /* sysfs file name                                */
+    char    line[1024];    /* cpulist contents (e.g. "0-15,32-47")           */
+    char    *tok;          /* Range in the cpulist                           */
+    char    *save;         /* strtok_r() state                               */
+    FILE    *fp;           /* sysfs file pointer                             */
+
+    for (cpu=0; cpu < CPU_SETSIZE; cpu++)
+        {
+        node_of[cpu]=0;
+        core_of[cpu]=cpu;
+        }
+
+#ifdef __linux__
+    CPU_ZERO(&all_cpus);
+    sched_getaffinity(0, sizeof(all_cpus), &all_cpus);
+
+    for (n=0; n < MAX_NODES; n++)
+        {
+        sprintf(path, "/sys/devices/system/node/node%d/cpulist", n);
+        if ((fp=fopen(path, "r")) == NULL) continue;
+
+        if (fgets(line, sizeof(line), fp) != NULL)
+            {
+            for (tok=strtok_r(line, ",\n", &save); tok != NULL; tok=strtok_r(NULL, ",\n", &save))
+                {
+                if (sscanf(tok, "%d-%d", &lo, &hi) != 2) hi=lo=atoi(tok);
+                for (cpu=lo; cpu <= hi; cpu++)
+                    {
+                    if ((cpu < CPU_SETSIZE) && CPU_ISSET(cpu, &all_cpus))
+                        {
+                        node_cpus[n_nodes].push_back(cpu);
+                        node_of[cpu]=n_nodes;
+                        }
+                    }
+                }
+            }
+        fclose(fp);
+
+        if (node_cpus[n_nodes].size()) n_nodes++;
+        }
+
+    if (n_nodes == 0)
+        {
+        for (cpu=0; cpu < CPU_SETSIZE; cpu++)
+            {
+            if (CPU_ISSET(cpu, &all_cpus)) node_cpus[0].push_back(cpu);
+            }
+        n_nodes=1;
+        }
+
+    for (cpu=0; cpu < CPU_SETSIZE; cpu++)
+        {
+        if (!CPU_ISSET(cpu, &all_cpus)) continue;
+        sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+        if ((fp=fopen(path, "r")) == NULL) continue;
+        if (fgets(line, sizeof(line), fp) != NULL) core_of[cpu]=atoi(line);
+        fclose(fp);
+        }
+#else
+    for (cpu=0; cpu < omp_get_num_procs(); cpu++) node_cpus[0].push_back(cpu);
+    n_nodes=1;
+#endif
+
+    for (n=0; n < n_nodes; n++) max_cpus+=node_cpus[n].size();
+    }
+
+
+//
+// MAKE_PLACES() - Builds the CPU order of every placement (see Placements
+//                 above)
+//
+// Global Variables:
+//      node_cpus, n_nodes, core_of, places
+//
+// Return Value: NONE
+//
+
+void    make_places()
+    {
+    int     n, k, i;       /* Node, CPU and sibling indices                  */
+    int     smt=0;         /* Flag that some core has more than one CPU      */
+    int     cpu;           /* CPU number                                     */
+    bench_place         p; /* Placement being built                          */
+    std::vector<int>    order[2][MAX_NODES]; /* CPUs per node (all, nosmt)   */
+
+    for (n=0; n < n_nodes; n++)
+        {
+        for (k=0; k < (int)node_cpus[n].size(); k++)
+            {
+            cpu=node_cpus[n][k];
+            if (core_of[cpu] != cpu)
+                {
+                smt=1;
+                continue;
+                }
+
+//
+// A core: the CPU itself, then its siblings
+//
+
+            order[1][n].push_back(cpu);
+            for (i=0; i < (int)node_cpus[n].size(); i++)
+                {
+                if (core_of[node_cpus[n][i]] == cpu) order[0][n].push_back(node_cpus[n][i]);
+                }
+            }
+
+//
+// CPUs whose first sibling may not be used are cores of their own
+//
+
+        for (k=0; k < (int)node_cpus[n].size(); k++)
+            {
+            cpu=node_cpus[n][k];
+            if ((core_of[cpu] != cpu) && (std::find(node_cpus[n].begin(), node_cpus[n].end(), core_of[cpu]) == node_cpus[n].end()))
+                {
+                core_of[cpu]=cpu;
+                order[0][n].push_back(cpu);
+                order[1][n].push_back(cpu);
+                }
+            }
+        }
+
+    for (i=0; i < 4; i++)
+        {
+        if ((i & 1) && !smt) continue;
+        if ((i & 2) && (n_nodes < 2)) continue;
+
+        p.name=std::string((i & 2) ? "spread" : "close")+((i & 1) ? "-nosmt" : "");
+        p.cpus.clear();
+
+        if (i & 2)
+            {
+            for (k=0; k < max_cpus; k++)
+                {
+                for (n=0; n < n_nodes; n++)
+                    {
+                    if (k < (int)order[i & 1][n].size()) p.cpus.push_back(order[i & 1][n][k]);
+                    }
+                }
+            }
+        else
+            {
+            for (n=0; n < n_nodes; n++) p.cpus.insert(p.cpus.end(), order[i & 1][n].begin(), order[i & 1][n].end());
+            }
+
+        places.push_back(p);
+        }
+    }
+
+
+//
+// PIN_CPU() - Pins the calling thread to one CPU
+//
+// Arguments:
+//      cpu     - CPU number
+//
+// Return Value:
+//      0 on success, -1 if the affinity could not be set
+//
+
+int     pin_cpu(int cpu)
+    {
+#ifdef __linux__
+    cpu_set_t   set;       /* CPU of the thread                              */
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return(sched_setaffinity(0, sizeof(set), &set));
+#else
+    return(-1);
+#endif
+    }
+
+
+//
+// SYNTH_IMAGE() - Draws a synthetic galaxy: an exponential disk with two
+//                 logarithmic arms of 20 degrees pitch and uniform noise.
+//                 The noise is seeded by the size, so the image is the same
+//                 on every run.
+//
+// Arguments:
+//      size    - Rows and columns of the image
+//      m       - Receives the image
+//
+// Return Value:
+//      0 if the image was made, 1 if it could not be allocated
+//
+
+int     synth_image(int size, Image2D<float> *m)
+    {
+    int     x, y;          /* Pixel                                          */
+    double  r, th;         /* Polar position of the pixel                    */
+    double  h=size/8.0;    /* Disk scale length                              */
+    double  k=1.0/tan(20.0*GR_RAD); /* Arm winding (1/tan(pitch))            */
+    unsigned long long  s=size; /* Noise generator state                     */
+
+    if (m->alloc(size, size)) return(1);
+
+    for (y=0; y < size; y++)
+        {
+        for (x=0; x < size; x++)
+            {
+            r=sqrt((double)(x-size/2)*(x-size/2)+(double)(y-size/2)*(y-size/2));
+            th=atan2((double)(y-size/2), (double)(x-size/2));
+            s=s*6364136223846793005ULL+1442695040888963407ULL;
+            (*m)[y][x]=(float)(1000.0*exp(-r/h)*(1.0+0.5*cos(2.0*(th-k*log(r+1.0))))+5.0*((s >> 11)*(1.0/9007199254740992.0)));
+            }
+        }
+
+    return(0);
+    }
+
+
+//
+// ARRAY_SIZE() - Returns the size of the engine arrays (complex values)
+//
+// Arguments:
+//      kind    - Engine
+//      n_in    - Receives the size of the input array
+//      n_out   - Receives the size of the output array
+//
+// Return Value: NONE
+//
+
+void    array_size(int kind, size_t *n_in, size_t *n_out)
+    {
+    if (kind == ENGINE_FULL)
+        {
+        *n_in=(size_t)DIM_THT*DIM_RAD+1;
+        *n_out=*n_in;
+        }
+    else if (kind == ENGINE_R2C)
+        {
+        *n_in=(size_t)DIM_THT*DIM_RAD/2+1;
+        *n_out=(size_t)DIM_THT*(DIM_RAD/2+1);
+        }
+    else
+        {
+        *n_in=(size_t)(M_FIN+1)*DIM_RAD;
+        *n_out=*n_in;
+        }
+    }
+
+
+//
+// STAGE_BYTES() - Bytes the gather and FFT stages have to move at least:
+//                 every value they read or write, once.  The gather clears
+//                 the engine input, reads the polar table and the image
+//                 and writes the input (PRUNED reads and writes its mode
+//                 sums).  The FFT reads its input and writes its output.
+//
+// Arguments:
+//      kind    - Engine
+//      radii   - Number of radii
+//      samples - Polar samples of all the radii
+//      g       - Receives the gather bytes
+//      f       - Receives the FFT bytes
+//
+// Return Value: NONE
+//
+
+void    stage_bytes(int kind, double radii, double samples, double *g, double *f)
+    {
+    size_t  n_in, n_out;   /* Engine array sizes                             */
+    double  mode=(double)(M_FIN+1)*DIM_RAD*sizeof(fftw_complex); /* Mode rows */
+    double  smp=2*sizeof(int)+sizeof(float); /* Table and image per sample   */
+
+    array_size(kind, &n_in, &n_out);
+
+    if (kind == ENGINE_PRUNED)
+        {
+        *g=radii*3.0*mode+samples*smp;
+        *f=radii*2.0*mode;
+        }
+    else if (kind == ENGINE_R2C)
+        {
+        *g=radii*(double)DIM_THT*DIM_RAD*sizeof(double)+samples*(smp+sizeof(double));
+        *f=radii*((double)DIM_THT*DIM_RAD*sizeof(double)+(double)n_out*sizeof(fftw_complex)+mode);
+        }
+    else
+        {
+        *g=radii*(double)n_in*sizeof(fftw_complex)+samples*(smp+sizeof(fftw_complex));
+        *f=radii*(double)(n_in+n_out)*sizeof(fftw_complex);
+        }
+    }
+
+
+//
+// SET_IMAGE() - Makes an image current: its center, largest radius and the
+//               radii timed (n_radii spread evenly from 1 to the largest)
+//
+// Global Variables:
+//      img, cx, cy, all_rad, log_rad, rads, n_radii
+//
+// Return Value:
+//      0 if the image can be analysed, 1 if it is too small
+//
+
+int     set_image()
+    {
+    int     k;             /* Radius index                                   */
+    int     n;             /* Radii timed                                    */
+
+    cx=(img.cols()-1)/2;
+    cy=(img.rows()-1)/2;
+    all_rad=(((img.cols() < img.rows()) ? img.cols() : img.rows())-1)/2;
+    if (all_rad < 2) return(1);
+
+    log_rad=log((double)all_rad);
+    n=((n_radii > 0) && (n_radii < all_rad)) ? n_radii : all_rad;
+
+    rads.clear();
+    for (k=0; k < n; k++) rads.push_back(1+(int)((double)k*(all_rad-1)/((n > 1) ? n-1 : 1)));
+
+    return(0);
+    }
+
+
+//
+// RUN_BENCH() - Times the radius loop of the current image for one
+//               configuration.  Each thread pins itself and first touches
+//               its own engine arrays (and the first thread of a node the
+//               node's copy of the image) before the timed runs.  The jobs
+//               each take their radii in turn from their own counter.
+//
+// Arguments:
+//      kind    - Engine
+//      pl      - Placement
+//      threads - Threads per job
+//      jobs    - Jobs at once
+//      r       - Receives the result (wall time and stage times/bytes)
+//
+// Global Variables:
+//      img, reps, in_data, out_data, rads, repeat, places, node_of
+//
+// Return Value:
+//      0 if the run was made, 1 if memory could not be allocated
+//
+
+int     run_bench(int kind, int pl, int threads, int jobs, bench_row *r)
+    {
+    int     n=threads*jobs;    /* Threads of the run                         */
+    int     t, k;              /* Thread and radius indices                  */
+    int     fail=0;            /* Threads that could not allocate            */
+    int     lead[MAX_NODES];   /* First thread of each node (-1 if none)     */
+    size_t  n_in, n_out;       /* Engine array sizes                         */
+    double  t0, wall;          /* Start and wall time of a run               */
+    double  samples;           /* Polar samples of the fastest run           */
+    double  g_byte=0.0, f_byte=0.0; /* Stage bytes of the fastest run        */
+    double  g_sum=0.0, f_sum=0.0;   /* Stage thread seconds of the run       */
+    std::vector<int>    next(jobs);  /* Next radius of each job              */
+    std::vector<double> g_sec(n), f_sec(n), smp(n); /* Per thread sums       */
+    const bench_place   &p=places[pl];
+
+    array_size(kind, &n_in, &n_out);
+
+    for (k=0; k < MAX_NODES; k++) lead[k]=-1;
+    for (t=n-1; t >= 0; t--) lead[node_of[p.cpus[t]]]=t;
+
+#pragma omp parallel num_threads(n) reduction(+:fail)
+    {
+    int     th=omp_get_thread_num();     /* Thread number                    */
+    int     nd=node_of[p.cpus[th]];      /* Node of the thread               */
+
+    pin_cpu(p.cpus[th]);
+
+    in_data[th]=(fftw_complex *) fftw_malloc(n_in*sizeof(fftw_complex));
+    out_data[th]=(fftw_complex *) fftw_malloc(n_out*sizeof(fftw_complex));
+    if ((in_data[th] == NULL) || (out_data[th] == NULL))
+        {
+        fail++;
+        }
+    else
+        {
+        memset(in_data[th], 0, n_in*sizeof(fftw_complex));
+        memset(out_data[th], 0, n_out*sizeof(fftw_complex));
+        }
+
+    if ((n_nodes > 1) && (lead[nd] == th))
+        {
+        if (reps[nd].alloc(img.rows(), img.cols()))
+            {
+            fail++;
+            }
+        else
+            {
+            for (long y=0; y < img.rows(); y++) memcpy(reps[nd][y], img[y], img.cols()*sizeof(float));
+            }
+        }
+    }
+
+    r->wall=0.0;
+
+    for (k=0; (k < repeat) && !fail; k++)
+        {
+        int     *nx=&next[0];              /* Radius counters                */
+        double  *gs=&g_sec[0], *fs=&f_sec[0], *ss=&smp[0]; /* Thread sums    */
+
+        next.assign(jobs, 0);
+        t0=omp_get_wtime();
+
+#pragma omp parallel num_threads(n)
+        {
+        int     th=omp_get_thread_num();   /* Thread number                  */
+        int     j=th/threads;              /* Job of the thread              */
+        int     i;                         /* Radius index                   */
+        int     r_first, r_last;           /* ln r steps of the annulus      */
+        double  s;                         /* Stage start time               */
+        double  g=0.0, f=0.0, sm=0.0;      /* Stage seconds and samples      */
+        ImageView<float> m=(n_nodes > 1) ? reps[node_of[p.cpus[th]]].view() : img.view();
+
+        for (;;)
+            {
+#pragma omp atomic capture
+            i=nx[j]++;
+
+            if (i >= (int)rads.size()) break;
+
+            pol.rad_range(log((double)rads[i]), log_rad, &r_first, &r_last);
+
+            s=omp_get_wtime();
+            eng.clear(kind, in_data[th]);
+            eng.gather(kind, in_data[th], pol, m, cx, cy, r_first, r_last, &g_opt);
+            g+=omp_get_wtime()-s;
+
+            s=omp_get_wtime();
+            eng.transform(kind, plan, in_data[th], out_data[th]);
+            f+=omp_get_wtime()-s;
+
+            sm+=(double)DIM_THT*(r_last-r_first);
+            }
+
+        gs[th]=g;
+        fs[th]=f;
+        ss[th]=sm;
+        }
+
+        wall=omp_get_wtime()-t0;
+        if ((r->wall > 0.0) && (wall >= r->wall)) continue;
+
+//
+// Fastest run so far
+//
+
+        r->wall=wall;
+        g_sum=f_sum=samples=0.0;
+        for (t=0; t < n; t++)
+            {
+            g_sum+=g_sec[t];
+            f_sum+=f_sec[t];
+            samples+=smp[t];
+            }
+        stage_bytes(kind, (double)rads.size()*jobs, samples, &g_byte, &f_byte);
+        }
+
+    for (t=0; t < n; t++)
+        {
+        fftw_free(in_data[t]);
+        fftw_free(out_data[t]);
+        }
+
+    if (fail) return(1);
+
+    r->threads=threads;
+    r->jobs=jobs;
+    r->place=pl;
+    r->g_ms=1000.0*g_sum/((double)rads.size()*jobs);
+    r->f_ms=1000.0*f_sum/((double)rads.size()*jobs);
+    r->g_gbs=(g_sum > 0.0) ? g_byte/(g_sum/n)/1.0e9 : 0.0;
+    r->f_gbs=(f_sum > 0.0) ? f_byte/(f_sum/n)/1.0e9 : 0.0;
+    r->ws_mb=(double)(n_in+n_out)*sizeof(fftw_complex)/1.0e6;
+
+    for (k=0, r->nodes=0; k < MAX_NODES; k++) r->nodes+=(lead[k] >= 0);
+
+    r->sh_mb=((double)img.bytes()*((n_nodes > 1) ? r->nodes : 1)+(double)DIM_THT*pol.n_rad*2*sizeof(int)+DIM_RAD*sizeof(float))/1.0e6;
+    if (kind == ENGINE_PRUNED) r->sh_mb+=2.0*(M_FIN+1)*DIM_THT*sizeof(double)/1.0e6;
+
+    return(0);
+    }
+
+
+//
+// CALIBRATE() - Times each engine on one thread for BENCH_CAL_RADII radii of
+//               the current image (the cost model for p2dfft -E)
+//
+// Global Variables:
+//      rads, pol, eng, plan, in_data, out_data, cal_fft, cal_smp
+//
+// Return Value: NONE
+//
+
+void    calibrate()
+    {
+    int     k, i;          /* Engine and radius indices                      */
+    int     n;             /* Radii timed                                    */
+    int     r_first, r_last; /* ln r steps of the annulus                    */
+    size_t  n_in, n_out;   /* Engine array sizes                             */
+    double  s;             /* Start time                                     */
+    double  g, f, smp;     /* Gather and FFT seconds, samples                */
+
+    n=std::min((int)BENCH_CAL_RADII, (int)rads.size());
+
+    for (k=0; k < ENGINE_COUNT; k++)
+        {
+        array_size(k, &n_in, &n_out);
+        in_data[0]=(fftw_complex *) fftw_malloc(n_in*sizeof(fftw_complex));
+        out_data[0]=(fftw_complex *) fftw_malloc(n_out*sizeof(fftw_complex));
+
+        if ((in_data[0] != NULL) && (out_data[0] != NULL))
+            {
+            memset(out_data[0], 0, n_out*sizeof(fftw_complex));
+            g=f=smp=0.0;
+
+            for (i=0; i < n; i++)
+                {
+                pol.rad_range(log((double)rads[(size_t)i*(rads.size()-1)/((n > 1) ? n-1 : 1)]), log_rad, &r_first, &r_last);
+
+                s=omp_get_wtime();
+                eng.clear(k, in_data[0]);
+                f+=omp_get_wtime()-s;
+
+                s=omp_get_wtime();
+                eng.gather(k, in_data[0], pol, img.view(), cx, cy, r_first, r_last, &g_opt);
+                g+=omp_get_wtime()-s;
+
+                s=omp_get_wtime();
+                eng.transform(k, plan, in_data[0], out_data[0]);
+                f+=omp_get_wtime()-s;
+
+                smp+=(double)DIM_THT*(r_last-r_first);
+                }
+
+            cal_fft[k]=f/n;
+            cal_smp[k]=(smp > 0.0) ? g/smp : 0.0;
+            if (verbose) printf("  %-8s %.6f s per radius, %.3e s per sample\n",eng.name(k),cal_fft[k],cal_smp[k]);
+            }
+
+        fftw_free(in_data[0]);
+        fftw_free(out_data[0]);
+        }
+    }
+
+
+//
+// BENCH_IMAGE() - Runs every placement and thread count on the current
+//                 image, as one job and as many jobs as fit
+//
+// Arguments:
+//      name    - Image name for the table
+//      tsel    - Thread counts from -t (empty for powers of two)
+//
+// Global Variables:
+//      places, rows, rads, all_rad, eng_kind, verbose
+//
+// Return Value:
+//      Number of runs that failed
+//
+
+int     bench_image(const std::string &name, const std::vector<int> &tsel)
+    {
+    int     pl;            /* Placement index                                */
+    int     nc;            /* CPUs of the placement                          */
+    int     k, pass;       /* Thread count index and pass (one/many jobs)    */
+    int     t, j;          /* Threads per job and jobs                       */
+    int     errs=0;        /* Runs that failed                               */
+    double  base;          /* Wall time of one job on one thread             */
+    bench_row           r; /* Result of a run                                */
+    std::vector<int>    tl;/* Thread counts of the placement                 */
+
+    for (pl=0; pl < (int)places.size(); pl++)
+        {
+        nc=places[pl].cpus.size();
+
+        tl.assign(1, 1);
+        if (tsel.empty())
+            {
+            for (t=2; t < nc; t*=2) tl.push_back(t);
+            if (nc > 1) tl.push_back(nc);
+            }
+        else
+            {
+            for (k=0; k < (int)tsel.size(); k++)
+                {
+                if ((tsel[k] > 1) && (tsel[k] <= nc)) tl.push_back(tsel[k]);
+                }
+            }
+
+        if (!verbose) printf("  %s: %d CPUs\n",places[pl].name.c_str(),nc);
+
+        base=0.0;
+        for (k=0; k < (int)tl.size(); k++)
+            {
+            for (pass=0; pass < 2; pass++)
+                {
+                t=tl[k];
+                j=pass ? nc/t : 1;
+                if (pass && (j < 2)) continue;
+
+                r.image=name;
+                r.rows=img.rows();
+                r.cols=img.cols();
+                r.radii=rads.size();
+                r.all_rad=all_rad;
+                if (run_bench(eng_kind, pl, t, j, &r))
+                    {
+                    printf("ERROR: Memory allocation failed for %d x %d threads (%s)\n",j,t,places[pl].name.c_str());
+                    errs++;
+                    continue;
+                    }
+
+                r.packed=(j == nc/t);
+                r.item=r.wall*(double)all_rad/rads.size();
+                r.items_hr=3600.0*j/r.item;
+                if ((t == 1) && (j == 1)) base=r.wall;
+                r.speedup=(base > 0.0) ? j*base/r.wall : 0.0;
+                r.eff=r.speedup/(t*j);
+                rows.push_back(r);
+
+                if (verbose) printf("  %-13s %3d threads x %3d jobs: %8.3f s  speedup %6.2f  eff %5.2f  gather %6.2f GB/s  fft %6.2f GB/s\n",
+                                    places[pl].name.c_str(),t,j,r.wall,r.speedup,r.eff,r.g_gbs,r.f_gbs);
+                }
+            }
+        }
+
+    return(errs);
+    }
+
+
+//
+// RECOMMEND() - Chooses the configuration with the highest node throughput
+//               (as many jobs as fit) and the one with the shortest time
+//               for one image, each scored over all the images relative to
+//               the best of the image (see Output Table above)
+//
+// Arguments:
+//      rec     - Receives the text of the recommendation (one per line)
+//
+// Global Variables:
+//      rows, places
+//
+// Return Value: NONE
+//
+
+void    recommend(std::vector<std::string> *rec)
+    {
+    int     k;             /* Row index                                      */
+    int     key;           /* Placement and threads of a row                 */
+    int     best_k[2]={ -1, -1 }; /* Best key (throughput, one image)        */
+    int     pl, t, j, nc;  /* Placement, threads, jobs and CPUs              */
+    double  v;             /* Score                                          */
+    double  best_v[2]={ 0.0, 0.0 };
+    char    line[256];     /* Text of a line                                 */
+    std::map<std::string,double>    top[2]; /* Best of each image            */
+    std::map<int,double>            score[2];
+    std::map<int,int>               seen[2];
+    std::map<int,double>::iterator  s;
+
+    for (k=0; k < (int)rows.size(); k++)
+        {
+        if (rows[k].packed) top[0][rows[k].image]=std::max(top[0][rows[k].image], rows[k].items_hr);
+        if (rows[k].jobs == 1) top[1][rows[k].image]=std::max(top[1][rows[k].image], 1.0/rows[k].item);
+        }
+
+    for (k=0; k < (int)rows.size(); k++)
+        {
+        key=rows[k].place*100000+rows[k].threads;
+        if (rows[k].packed)
+            {
+            score[0][key]+=rows[k].items_hr/top[0][rows[k].image];
+            seen[0][key]++;
+            }
+        if (rows[k].jobs == 1)
+            {
+            score[1][key]+=(1.0/rows[k].item)/top[1][rows[k].image];
+            seen[1][key]++;
+            }
+        }
+
+    for (j=0; j < 2; j++)
+        {
+        for (s=score[j].begin(); s != score[j].end(); s++)
+            {
+            if ((seen[j][s->first] == (int)top[j].size()) && (s->second > best_v[j]))
+                {
+                best_v[j]=s->second;
+                best_k[j]=s->first;
+                }
+            }
+        }
+
+    rec->clear();
+    if (best_k[0] < 0) return;
+
+    pl=best_k[0]/100000;
+    t=best_k[0]%100000;
+    nc=places[pl].cpus.size();
+    j=nc/t;
+    v=100.0*best_v[0]/top[0].size();
+
+    snprintf(line, sizeof(line), "Recommended (throughput): %d threads per job, %d jobs per node, %s (%.0f%% of the best per image)",t,j,places[pl].name.c_str(),v);
+    rec->push_back(line);
+    if (j > 1)
+        snprintf(line, sizeof(line), "  Run %d p2dfft jobs with OMP_NUM_THREADS=%d, each on its own %d CPUs in %s order%s",j,t,t,places[pl].name.c_str(),
+                 (places[pl].name.find("nosmt") != std::string::npos) ? " (one thread per core)" : "");
+    else
+        snprintf(line, sizeof(line), "  Run one p2dfft job with OMP_NUM_THREADS=%d -b %s%s",t,(places[pl].name.find("spread") == 0) ? "spread" : "close",
+                 (places[pl].name.find("nosmt") != std::string::npos) ? " (one thread per core)" : "");
+    rec->push_back(line);
+
+    if (best_k[1] < 0) return;
+
+    pl=best_k[1]/100000;
+    t=best_k[1]%100000;
+    snprintf(line, sizeof(line), "Recommended (one image):  %d threads, %s (p2dfft -b %s)",t,places[pl].name.c_str(),(places[pl].name.find("spread") == 0) ? "spread" : "close");
+    rec->push_back(line);
+    }
+
+
+//
+// MAIN ROUTINE
+//
+
+int main(int argc, char **argv)
+    {
+    int     k;                 /* Index                                      */
+    int     errcnt=0;          /* Images or runs that failed                 */
+    int     cal_done=0;        /* Flag that the engines were timed           */
+    double  s;                 /* Start time of a read                       */
+    char    *tok;              /* Value in a comma separated list            */
+    char    *save;             /* strtok_r() state                           */
+    char    name[STR_SIZE];    /* Image name                                 */
+    FILE    *fp;               /* Result table and cost model stream         */
+    fftw_complex    *tmp_in, *tmp_out; /* Arrays the plans are made on      */
+
+    std::vector<int>            tsel;   /* Thread counts (-t)                */
+    std::vector<int>            sizes;  /* Synthetic image sizes (-s)        */
+    std::vector<std::string>    rec;    /* Recommended configuration         */
+
+//
+// Define the command line options, see getopt_long(3) for details
+//
+
+    static struct option long_options[] =
+        {
+        {"verbose", no_argument,         0, 'v'},
+        {"no-cal", no_argument,          0, 'N'},
+        {"cpu-report", no_argument,      0, 'C'},
+        /* These options require an argument. */
+        {"output", required_argument,    0, 'o'},
+        {"cal", required_argument,       0, 'c'},
+        {"engine", required_argument,    0, 'e'},
+        {"threads", required_argument,   0, 't'},
+        {"radii", required_argument,     0, 'n'},
+        {"repeat", required_argument,    0, 'r'},
+        {"synthetic", required_argument, 0, 's'},
+        {0, 0, 0, 0}
+        };
+
+    int option_index = 0;
+
+    while ((c = getopt_long (argc, argv, "vNCo:c:e:t:n:r:s:", long_options, &option_index))
+!= -1)
+        {
+        switch (c)
+            {
+            case 'v':
+                {
+                verbose = 1;
+                break;
+                }
+            case 'N':
+                {
+                no_cal = 1;
+                break;
+                }
+            case 'C':
+                {
+                cpu_rep = 1;
+                break;
+                }
+            case 'o':
+                {
+                snprintf(oname,sizeof(oname),"%s",optarg);
+                break;
+                }
+            case 'c':
+                {
+                snprintf(calname,sizeof(calname),"%s",optarg);
+                break;
+                }
+            case 'e':
+                {
+                eng_kind=eng.find(optarg);
+                if (eng_kind < ENGINE_FULL)
+                    {
+                    printf("ERROR: Unknown engine %s (full, r2c or pruned)\n",optarg);
+                    exit(1);
+                    }
+                break;
+                }
+            case 't':
+                {
+                snprintf(tlist,sizeof(tlist),"%s",optarg);
+                break;
+                }
+            case 'n':
+                {
+                n_radii=atoi(optarg);
+                break;
+                }
+            case 'r':
+                {
+                repeat=std::max(1, atoi(optarg));
+                break;
+                }
+            case 's':
+                {
+                snprintf(synth,sizeof(synth),"%s",optarg);
+                break;
+                }
+            default:
+                {
+                fprintf(stderr, "Usage: p2bench [-o|--output <file>] [-c|--cal <file>] [-N|--no-cal] [-v|--verbose] [-e|--engine full|r2c|pruned] [-t|--threads <n>[,<n>...]] [-n|--radii <n>] [-r|--repeat <n>] [-s|--synthetic <size>[,<size>...]] [-C|--cpu-report] [<file> ...]\n");
+                exit(1);
+                break;
+                }
+            }
+        }
+
+    if (verbose) printf("p2bench - Version: %s\n",VERSION);
+
+    if (cpu_rep)
+        {
+        const char *kernels[]={"polar gather", NULL};
+
+        ast.cpu_report("p2bench", kernels);
+        exit(0);
+        }
+
+    for (tok=strtok_r(tlist, ",", &save); tok != NULL; tok=strtok_r(NULL, ",", &save)) tsel.push_back(atoi(tok));
+    for (tok=strtok_r(synth, ",", &save); tok != NULL; tok=strtok_r(NULL, ",", &save))
+        {
+        if (atoi(tok) > 0) sizes.push_back(atoi(tok));
+        }
+
+    if ((optind >= argc) && sizes.empty())
+        {
+        printf("No images to benchmark\n");
+        exit(1);
+        }
+
+//
+// CPUs, nodes and placements
+//
+
+    read_topology();
+    make_places();
+    omp_set_dynamic(0);
+
+    printf("CPU: %s, %d CPUs, %d NUMA node(s), engine %s\n",ast.cpu_name().c_str(),max_cpus,n_nodes,eng.name(eng_kind));
+    if (verbose)
+        {
+        for (k=0; k < (int)places.size(); k++) printf("  %-13s %d CPUs\n",places[k].name.c_str(),(int)places[k].cpus.size());
+        }
+
+//
+// Polar table, per thread array pointers and the plans (made on arrays of
+//   the largest size; FFTW runs them on the arrays of every thread)
+//
+
+    if (pol.build())
+        {
+        printf("ERROR: Can't Build Polar Table\n");
+        exit(1);
+        }
+
+    in_data=new fftw_complex *[max_cpus];
+    out_data=new fftw_complex *[max_cpus];
+
+    tmp_in=(fftw_complex *) fftw_malloc(((size_t)DIM_THT*DIM_RAD+1)*sizeof(fftw_complex));
+    tmp_out=(fftw_complex *) fftw_malloc(((size_t)DIM_THT*DIM_RAD+1)*sizeof(fftw_complex));
+    if ((tmp_in == NULL) || (tmp_out == NULL))
+        {
+        printf("ERROR: Memory allocation failed for the FFT arrays\n");
+        exit(1);
+        }
+
+    for (k=0; k < ENGINE_COUNT; k++)
+        {
+        if ((k != eng_kind) && no_cal) continue;
+        if (k == ENGINE_FULL) c=((plan=fftw_plan_dft_2d( (int) DIM_THT, (int) DIM_RAD, tmp_in, tmp_out, FFTW_FORWARD, FFTW_MEASURE)) == NULL);
+        else c=eng.build(k, tmp_in, tmp_out);
+
+        if (c)
+            {
+            printf("ERROR: Can't Make FFTW Plan (%s)\n",eng.name(k));
+            exit(1);
+            }
+        }
+
+    fftw_free(tmp_in);
+    fftw_free(tmp_out);
+
+//
+// Benchmark the files, then the synthetic images
+//
+
+    for (k=optind; k < argc+(int)sizes.size(); k++)
+        {
+        if (k < argc)
+            {
+            snprintf(name,sizeof(name),"%s",argv[k]);
+            s=omp_get_wtime();
+            if (ast.fits_read(name, &img))
+                {
+                printf("ERROR: Cannot read image - %s\n",name);
+                errcnt++;
+                continue;
+                }
+            if (cal_pix == 0.0) cal_pix=(omp_get_wtime()-s)/((double)img.rows()*img.cols());
+            }
+        else
+            {
+            snprintf(name,sizeof(name),"synth%d",sizes[k-argc]);
+            if (synth_image(sizes[k-argc], &img))
+                {
+                printf("ERROR: Memory allocation failed for %s\n",name);
+                errcnt++;
+                continue;
+                }
+            }
+
+        if (set_image())
+            {
+            printf("ERROR: Image %s is too small to analyse\n",name);
+            errcnt++;
+            continue;
+            }
+
+        if (!no_cal && !cal_done)
+            {
+            if (verbose) printf("Timing the engines on %s...\n",name);
+            calibrate();
+            cal_done=1;
+            }
+
+        printf("Benchmarking %s (%ld x %ld, %d of %d radii)...\n",name,img.cols(),img.rows(),(int)rads.size(),all_rad);
+        errcnt+=bench_image(name, tsel);
+        }
+
+//
+// Write the result table and the cost model
+//
+
+    if ((fp=fopen(oname,"w")) == NULL)
+        {
+        printf("ERROR: Could Not Write %s\n",oname);
+        exit(1);
+        }
+
+    fprintf(fp,"image,rows,cols,engine,placement,threads,jobs,nodes,radii,all_radii,wall_s,item_s,items_hr,speedup,efficiency,gather_ms,fft_ms,gather_GBs,fft_GBs,thread_MB,shared_MB\n");
+    for (k=0; k < (int)rows.size(); k++)
+        {
+        bench_row   &r=rows[k];
+
+        fprintf(fp,"%s,%ld,%ld,%s,%s,%d,%d,%d,%d,%d,%.4f,%.4f,%.2f,%.3f,%.3f,%.4f,%.4f,%.3f,%.3f,%.2f,%.2f\n",r.image.c_str(),r.rows,r.cols,eng.name(eng_kind),
+                places[r.place].name.c_str(),r.threads,r.jobs,r.nodes,r.radii,r.all_rad,r.wall,r.item,r.items_hr,r.speedup,r.eff,r.g_ms,r.f_ms,r.g_gbs,r.f_gbs,r.ws_mb,r.sh_mb);
+        }
+    fclose(fp);
+
+    recommend(&rec);
+    printf("-------------------------------\n");
+    for (k=0; k < (int)rec.size(); k++) printf("%s\n",rec[k].c_str());
+
+    if (!no_cal && cal_done)
+        {
+        if ((fp=fopen(calname,"w")) == NULL)
+            {
+            printf("ERROR: Could Not Write %s\n",calname);
+            exit(1);
+            }
+
+        fprintf(fp,"# P2DFFT cost model written by p2bench %s\n",VERSION);
+        fprintf(fp,"# CPU: %s, %d CPUs, %d NUMA node(s)\n",ast.cpu_name().c_str(),max_cpus,n_nodes);
+        for (k=0; k < ENGINE_COUNT; k++)
+            {
+            if (cal_fft[k] <= 0.0) continue;
+            fprintf(fp,"%s.fft %.6e\n",eng.name(k),cal_fft[k]);
+            fprintf(fp,"%s.sample %.6e\n",eng.name(k),cal_smp[k]);
+            }
+        if (cal_pix > 0.0) fprintf(fp,"read.pixel %.6e\n",cal_pix);
+        for (k=0; k < (int)rec.size(); k++) fprintf(fp,"# %s\n",rec[k].c_str());
+        fclose(fp);
+        }
+
+    delete [] in_data;
+    delete [] out_data;
+    if (plan) fftw_destroy_plan(plan);
+
+    printf("-------------------------------\n");
+    printf("Runs                         %d\n",(int)rows.size());
+    printf("Errors                       %d\n",errcnt);
+    printf("Result Table                 %s\n",oname);
+    if (!no_cal && cal_done) printf("Cost Model                   %s\n",calname);
+    return(0);
+    }
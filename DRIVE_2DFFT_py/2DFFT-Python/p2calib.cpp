@@ -0,0 +1,793 @@
+//
+// P2CALIB.CPP - This program measures how well P2DFFT recovers the pitch
+//               angle of synthetic galaxies.  Each model of a p2spiral input
+//               file is drawn in memory with the p2spiral drawing code
+//               (spiral_class), analysed with the p2dfft polar sampling and
+//               transforms (polar_class, engine_class), and its pitch angle
+//               found the way p2pa does.  The recovered pitch is compared to
+//               the pitch the model was drawn with.  No files are written
+//               for the models; one result table is written at the end.
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// 2DFFT (original) Author: Dr. Ivanio Puerari
+//                          Instituto Nacional de Astrofisica,
+//                          Optica y Electronica,
+//                          Santa Maria Tonantzintla,
+//                          Puebla, Mexico
+//
+// 2DFFT (revised) Lead Author: Dr. Marc Seigar
+//                              University of Minnesota Duluth,
+//                              Duluth, MN USA
+//
+// 2DFFT (progenitor of P2DFFT) Lead Author: Dr. Benjamin Davis
+//                                           Swinburne University of Technology.
+//                                           Centre for Astrophysics and
+//                                           Supercomputing
+//                                           Melbourne, Victoria, Australia
+//                                       http://d.umn.edu/~msseigar/2DFFT.html
+//
+// P2DFFT By: Ian Hewitt & Dr. Patrick Treuthardt,
+//            NC Museum of Natural Sciences,
+//            Astronomy & Astrophysics Lab,
+//            Raleigh, NC USA.
+//            http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//     North Carolina Museum of Natural Sciences
+//     Astronomy & Astrophysics Laboratory
+//     11 West Jones Street
+//     Raleigh, NC, 27601  USA
+//     +1.919.707.9800
+//
+//     -- or --
+//
+//     patrick.treuthardt@naturalsciences.org
+//
+//
+// Usage: p2calib [-i|--input <file>] [-o|--output <file>] [-v|--verbose]
+//                [-m|--magnitude] [-e|--engine full|r2c|pruned]
+//                [-s|--seed <n>] [-a|--analytic] [-P|--psf <psf>]
+//                [-g|--gain <e/count>] [-r|--read-noise <e>]
+//                [-C|--cpu-report]
+//
+//        The models are read from the input file (or standard input), one
+//        per line in the p2spiral INPUT FILE FORMAT.  The options are:
+//
+//              -i|--input : p2spiral input file with the models
+//              -o|--output: Result table (default Calib.csv)
+//              -v|--verbose : Print the result of each model as it is done
+//              -m|--magnitude: Use the mode with the highest amplitude
+//                           instead of the number of arms of the model (same
+//                           as p2pa -m)
+//              -e|--engine: Transform used for each annulus (see p2dfft -e).
+//                           The default is pruned, which is the fastest for
+//                           one annulus at a time.
+//              -s, -a, -P, -g, -r: Same as p2spiral (noise seed, analytic
+//                           arms, PSF, gain and read noise)
+//              -C|--cpu-report: Show the CPU and the code path (sse2, avx2
+//                           or avx512f) the polar gather runs, then exit
+//
+//        The models are shared out to the threads; each thread draws and
+//        analyses one model at a time with its own image and FFT arrays.
+//
+//
+// Analysis:
+//
+//      Every annulus with an inner radius from 1 to 90% of the largest
+//      radius (per Davis et. al. 2012) is transformed as p2dfft does with
+//      no options.  For each mode the normalized spectra of -50 to +50
+//      (steps of 0.25) are summed over the annuli.  The pitch angle (P) is
+//      taken at the frequency of the highest summed amplitude of the mode,
+//      which is the number of arms of the model (or with -m, the mode with
+//      the highest amplitude).  The error is that of p2pa: the spread of
+//      the pitch at the peak of each annulus combined with the FFT error
+//      polynomial of the mode.  The pitch of each annulus uses the same sign
+//      convention as P.
+//
+//
+// Output Table (tab separated, one line per model in input order):
+//
+//      File        - Model name
+//      Arms        - Number of arms of the model
+//      Mode        - Mode used for the pitch angle
+//      Start, End  - Range of annuli (inner radius)
+//      P           - Recovered pitch angle
+//      Error       - Error of P (see above)
+//      AVGPITCH, MINPITCH, MAX_PITCH - Pitch values of the model (the
+//                    p2spiral FITS keywords)
+//      Delta       - |P| - |AVGPITCH|
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//                        - Use the p2dfft gather and scaling (engine_class)
+//                          instead of a copy
+//
+
+#define     VERSION "1.0/20261017"
+
+//
+// HEADER FILES
+//
+
+#include    <math.h>
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <getopt.h>
+#include    <omp.h>
+#include    <vector>
+#include    <string>
+
+#include    "globals.h"
+#include    "astro_class.h"
+#include    "polar_class.h"
+#include    "engine_class.h"
+#include    "spiral_class.h"
+
+//
+// CONSTANTS
+//
+
+#define     CAL_BINS    401  /* Frequencies -50 to +50 in steps of STEP_P    */
+#define     CAL_USE     0.90 /* Part of the annuli used (Davis et. al. 2012) */
+#define     DEF_OUT     "Calib.csv" /* Default result table                  */
+#define     STR_SIZE    256  /* Maximum characters in input line             */
+
+//
+// Result of one model
+//
+
+struct  cal_rec
+    {
+    int     ok;            /* Model analysed                                 */
+    int     mode;          /* Mode used for the pitch angle                  */
+    int     start, end;    /* Range of annuli                                */
+    double  pa;            /* Recovered pitch angle                          */
+    double  err;           /* Error of pa                                    */
+    float   avg, min, max; /* Pitch values of the model                      */
+    };
+
+//
+// VARIABLES
+//
+
+int     c;                 /* Getopt_long return value                       */
+int     num;               /* Number of threads used                         */
+int     verbose=0;         /* Flag for verbose mode                          */
+int     magnitude=0;       /* Flag for -m|--magnitude                        */
+int     analytic=0;        /* Flag for the analytic arm renderer (-a)        */
+int     psf=PSF_NONE;      /* PSF type (-P)                                  */
+int     eng_kind=ENGINE_PRUNED; /* Transform used for each annulus (-e)      */
+int     cpu_rep=0;         /* Flag for -C|--cpu-report                       */
+int     errcnt=0;          /* Models that could not be read or analysed      */
+
+float   fwhm=0.0;          /* FWHM of the PSF in pixels (-P)                 */
+float   beta=PSF_BETA;     /* Moffat beta (-P)                               */
+float   gain=0.0;          /* Electrons per count for shot noise (-g)        */
+float   read_noise=0.0;    /* Read noise in electrons (-r)                   */
+
+unsigned long long seed=0; /* Seed for the model noise (-s)                  */
+
+char    line[STR_SIZE];    /* Input line                                     */
+char    fname[STR_SIZE];   /* Input file name (-i)                           */
+char    oname[STR_SIZE]=DEF_OUT; /* Result table name (-o)                   */
+
+FILE    *file_list;        /* Input file stream                              */
+FILE    *fp;               /* Result table stream                            */
+
+astro       ast;           /* Instantiation of astro_class                   */
+logpolar    pol;           /* Polar sampling table shared by all threads     */
+engine      eng;           /* Transform engine (plans shared by all threads) */
+fftw_plan   plan=NULL;     /* Complex 2D plan for -e full                    */
+spiral      reader;        /* Parses the input file lines                    */
+
+Image2D<float>  psf_img;   /* PSF image for -P <file>                        */
+
+std::vector<sp_rec>     models;  /* Models to analyse                        */
+std::vector<cal_rec>    results; /* Result of each model                     */
+
+//
+// Per thread state
+//
+
+spiral          *sps;      /* Model drawing per thread                       */
+Image2D<float>  *mats;     /* Model image per thread ([y][x])                */
+fftw_complex    **in_data; /* Engine input array per thread                  */
+fftw_complex    **out_data;/* Engine output array per thread                 */
+
+//
+// FUNCTION PROTOTYPES
+//
+
+int     calib_item(int n, int th);
+int     read_psf(char *spec);
+
+//
+// SUBROUTINES
+//
+
+
+//
+// READ_PSF() - Sets the PSF from the -P|--psf option value (see p2spiral)
+//
+// Globals:
+//      psf, fwhm, beta, psf_img - Set from the option
+//
+// Arguments:
+//      spec    - Option value
+//
+// Return Value:
+//      0 if the PSF was set, 1 if not
+//
+
+int     read_psf(char *spec)
+    {
+    char    *p;
+
+    if (strncmp(spec, "gauss:", 6) == 0)
+        {
+        psf=PSF_GAUSS;
+        fwhm=atof(spec+6);
+        }
+    else if (strncmp(spec, "moffat:", 7) == 0)
+        {
+        psf=PSF_MOFFAT;
+        fwhm=atof(spec+7);
+        if ((p=strchr(spec+7, ':')) != NULL) beta=atof(p+1);
+        if (beta <= 0.0)
+            {
+            printf("ERROR: Moffat beta must be > 0 (%s)\n",spec);
+            return(1);
+            }
+        }
+    else
+        {
+        psf=PSF_IMAGE;
+        if (ast.fits_read(spec, &psf_img))
+            {
+            printf("ERROR: Cannot read PSF file - %s\n",spec);
+            return(1);
+            }
+        return(0);
+        }
+
+    if (fwhm <= 0.0)
+        {
+        printf("ERROR: PSF FWHM must be > 0 (%s)\n",spec);
+        return(1);
+        }
+
+    return(0);
+    }
+
+
+//
+// FFT_ERROR() - Inherent error of the FFT pitch angle for a mode (Davis et.
+//               al. 2012, the polynomials used by p2pa)
+//
+// Arguments:
+//      mode    - Mode (1 to 6)
+//      apa     - Absolute pitch angle
+//
+// Return Value:
+//      Error in degrees
+//
+
+double  fft_error(int mode, double apa)
+    {
+    static const double k[6][4]=
+        {
+        { -4.0e-5, 0.0058, 0.0137, 0.0234 },
+        { -2.0e-5, 0.0029, 0.0084, 0.0222 },
+        { -1.4e-5, 0.0020, 0.0064, 0.0214 },
+        { -1.0e-5, 0.0015, 0.0054, 0.0207 },
+        { -9.0e-6, 0.0012, 0.0046, 0.0200 },
+        { -7.0e-6, 0.0010, 0.0041, 0.0191 }
+        };
+
+    if ((mode < 1) || (mode > 6)) return(0.0);
+
+    return(((k[mode-1][0]*apa+k[mode-1][1])*apa+k[mode-1][2])*apa+k[mode-1][3]);
+    }
+
+
+//
+// CALIB_ITEM() - Draws one model, analyses it and stores the result
+//
+// Arguments:
+//      n       - Model index
+//      th      - Thread number (selects the drawing, image and FFT arrays)
+//
+// Global Variables:
+//      models, results, pol, eng, plan, sps, mats, in_data, out_data
+//
+// Return Value:
+//      0 if the model was analysed, 1 if not
+//
+
+int     calib_item(int n, int th)
+    {
+    int     i, md;             /* Bin and mode indices                       */
+    int     p;                 /* Spectrum index of a bin                    */
+    int     rad;               /* Largest radius of the model                */
+    int     end;               /* Last annulus used                          */
+    int     radius;            /* Inner radius of the annulus                */
+    int     r_first, r_last;   /* ln r steps kept for the annulus            */
+    int     hmode;             /* Mode used for the pitch angle              */
+    int     best;              /* Bin of the highest amplitude               */
+    float   norma;             /* Normalization value (sum of the samples)   */
+    double  re, im;            /* Normalized spectrum value                  */
+    double  a, top;            /* Amplitudes                                 */
+    double  pa, val, var;      /* Pitch angles and variance                  */
+    double  vm, fft_err;       /* Error terms (see p2pa)                     */
+    double  log_rad;           /* ln of the largest radius                   */
+    double  sum_re[M_FIN+1][CAL_BINS];  /* Spectra summed over the annuli    */
+    double  sum_im[M_FIN+1][CAL_BINS];
+    std::vector<int> peak;     /* Bin of the highest amplitude per annulus   */
+                               /*   and mode ([radius-1][mode])              */
+    fftw_complex    *spec;     /* Mode spectrum from the engine              */
+    gather_opt      opt;       /* Gather options (none, [y][x] image)        */
+
+    sp_rec          *e=&models[n];
+    cal_rec         *r=&results[n];
+    spiral          &sp=sps[th];
+    Image2D<float>  &mat=mats[th];
+
+    r->ok=0;
+
+//
+// Draw the model (one thread; the models are shared out to the threads)
+//
+
+    if (sp.render(e, &mat, 1))
+        {
+#pragma omp critical (p2calib_out)
+        fputs(sp.text.c_str(), stdout);
+        return(1);
+        }
+
+//
+// Largest radius and annuli used, as p2dfft and p2pa do with no options
+//
+
+    rad=(((e->hsize < e->vsize) ? e->hsize : e->vsize)-1)/2;
+    end=(int)((double)rad*CAL_USE);
+    if (end < 1)
+        {
+#pragma omp critical (p2calib_out)
+        printf("ERROR: Model %s is too small to analyse\n",e->name);
+        return(1);
+        }
+
+    log_rad=log((double)rad);
+    memset(sum_re, 0, sizeof(sum_re));
+    memset(sum_im, 0, sizeof(sum_im));
+    peak.assign((size_t)end*(M_FIN+1), 0);
+
+    for (radius=1; radius <= end; radius++)
+        {
+        pol.rad_range(log((double)radius), log_rad, &r_first, &r_last);
+
+        eng.clear(eng_kind, in_data[th]);
+        norma=eng.gather(eng_kind, in_data[th], pol, mat.view(), (e->hsize-1)/2, (e->vsize-1)/2, r_first, r_last, &opt);
+        spec=eng.transform(eng_kind, plan, in_data[th], out_data[th]);
+        eng.scale(spec, norma);
+
+//
+// Sum the bins of -50 to +50 (normalized, conjugated as p2dfft writes them
+//   and with non finite values taken as 0 as p2pa reads them)
+//
+
+        for (md=1; md <= M_FIN; md++)
+            {
+            top=-1.0;
+            best=0;
+            for (i=0; i < CAL_BINS; i++)
+                {
+                p=(i < CAL_BINS/2) ? DIM_RAD-CAL_BINS/2+i : i-CAL_BINS/2;
+                re=spec[md*DIM_RAD+p][0];
+                im=-1.0*spec[md*DIM_RAD+p][1];
+                if (!isfinite(re)) re=0.0;
+                if (!isfinite(im)) im=0.0;
+
+                sum_re[md][i]+=re;
+                sum_im[md][i]+=im;
+
+                a=sqrt(re*re+im*im);
+                if (a > top)
+                    {
+                    top=a;
+                    best=i;
+                    }
+                }
+            peak[(size_t)(radius-1)*(M_FIN+1)+md]=best;
+            }
+        }
+
+//
+// Mode: the number of arms of the model or (-m) the highest amplitude
+//
+
+    hmode=e->arm;
+    top=-1.0;
+    for (md=1; md <= M_FIN; md++)
+        {
+        for (i=0; i < CAL_BINS; i++)
+            {
+            a=sqrt(sum_re[md][i]*sum_re[md][i]+sum_im[md][i]*sum_im[md][i]);
+            if ((magnitude || (e->arm < 1) || (e->arm > M_FIN)) && (a > top))
+                {
+                top=a;
+                hmode=md;
+                }
+            }
+        }
+
+//
+// Pitch angle at the frequency of the highest summed amplitude of the mode
+//
+
+    top=-1.0;
+    best=0;
+    for (i=0; i < CAL_BINS; i++)
+        {
+        a=sqrt(sum_re[hmode][i]*sum_re[hmode][i]+sum_im[hmode][i]*sum_im[hmode][i]);
+        if (a > top)
+            {
+            top=a;
+            best=i;
+            }
+        }
+
+    pa=atan2((double)hmode, -50.0+STEP_P*best)*(180.0/PI);
+    if (fabs(pa) > 90.0) pa=pa-180.0;
+
+//
+// Error (see p2pa): spread of the pitch at the peak of each annulus and the
+//   FFT error of the mode
+//
+
+    var=0.0;
+    for (radius=0; radius < end; radius++)
+        {
+        val=atan2((double)hmode, -50.0+STEP_P*peak[(size_t)radius*(M_FIN+1)+hmode])*(180.0/PI);
+        if (fabs(val) > 90.0) val=val-180.0;
+        var+=(val-pa)*(val-pa);
+        }
+
+    vm=sqrt(var/end)/sqrt((double)end);
+    fft_err=fft_error(hmode, fabs(pa));
+
+    r->mode=hmode;
+    r->start=1;
+    r->end=end;
+    r->pa=pa;
+    r->err=sqrt(vm*vm+fft_err*fft_err);
+    r->avg=sp.avg_pitch;
+    r->min=sp.min_pitch;
+    r->max=sp.max_pitch;
+    r->ok=1;
+
+    if ((verbose) || (!sp.text.empty()))
+        {
+#pragma omp critical (p2calib_out)
+        {
+        fputs(sp.text.c_str(), stdout);
+        if (verbose) printf("%s: Mode=%d, P=%.4f +/- %.4f, AVGPITCH=%.4f\n",e->name,hmode,pa,r->err,r->avg);
+        }
+        }
+
+    return(0);
+    }
+
+
+//
+// MAIN ROUTINE
+//
+
+int main(int argc, char **argv)
+    {
+    int     n;                 /* Model index                                */
+    size_t  n_in, n_out;       /* Size of the engine arrays (complex values) */
+
+//
+// Define the command line options, see getopt_long(3) for details
+//
+
+    static struct option long_options[] =
+        {
+        {"verbose", no_argument,         0, 'v'},
+        {"magnitude", no_argument,       0, 'm'},
+        {"analytic", no_argument,        0, 'a'},
+        {"cpu-report", no_argument,      0, 'C'},
+        /* These options require an argument. */
+        {"input", required_argument,     0, 'i'},
+        {"output", required_argument,    0, 'o'},
+        {"engine", required_argument,    0, 'e'},
+        {"seed", required_argument,      0, 's'},
+        {"psf", required_argument,       0, 'P'},
+        {"gain", required_argument,      0, 'g'},
+        {"read-noise", required_argument, 0, 'r'},
+        {0, 0, 0, 0}
+        };
+
+    int option_index = 0;
+
+    while ((c = getopt_long (argc, argv, "vmaCi:o:e:s:P:g:r:", long_options, &option_index))
+!= -1)
+        {
+        switch (c)
+            {
+            case 'v':
+                {
+                verbose = 1;
+                break;
+                }
+            case 'm':
+                {
+                magnitude = 1;
+                break;
+                }
+            case 'a':
+                {
+                analytic = 1;
+                break;
+                }
+            case 'C':
+                {
+                cpu_rep = 1;
+                break;
+                }
+            case 'i':
+                {
+                snprintf(fname,sizeof(fname),"%s",optarg);
+                break;
+                }
+            case 'o':
+                {
+                snprintf(oname,sizeof(oname),"%s",optarg);
+                break;
+                }
+            case 'e':
+                {
+                eng_kind=eng.find(optarg);
+                if (eng_kind < ENGINE_FULL)
+                    {
+                    printf("ERROR: Unknown engine %s (full, r2c or pruned)\n",optarg);
+                    exit(1);
+                    }
+                break;
+                }
+            case 's':
+                {
+                seed=strtoull(optarg, NULL, 0);
+                break;
+                }
+            case 'P':
+                {
+                if (read_psf(optarg)) exit(1);
+                break;
+                }
+            case 'g':
+                {
+                gain=atof(optarg);
+                break;
+                }
+            case 'r':
+                {
+                read_noise=atof(optarg);
+                break;
+                }
+            default:
+                {
+                fprintf(stderr, "Usage: p2calib [-i|--input <file>] [-o|--output <file>] [-v|--verbose] [-m|--magnitude] [-e|--engine full|r2c|pruned] [-s|--seed <n>] [-a|--analytic] [-P|--psf <psf>] [-g|--gain <e/count>] [-r|--read-noise <e>] [-C|--cpu-report]\n");
+                exit(1);
+                break;
+                }
+            }
+        }
+
+    if (verbose) printf("p2calib - Version: %s\n",VERSION);
+
+    if (cpu_rep)
+        {
+        const char *kernels[]={"polar gather", NULL};
+
+        ast.cpu_report("p2calib", kernels);
+        exit(0);
+        }
+
+    if ((gain < 0.0) || (read_noise < 0.0) || ((read_noise > 0.0) && (gain == 0.0)))
+        {
+        printf("ERROR: -g|--gain must be > 0 for shot/read noise (-g %f -r %f)\n",gain,read_noise);
+        exit(1);
+        }
+
+//
+// Read the models
+//
+
+    if (fname[0] != '\0')
+        {
+        if ((file_list=fopen(fname,"r")) == NULL)
+            {
+            printf("ERROR: Cannot open input file - %s\n",fname);
+            exit(1);
+            }
+        }
+    else
+        {
+        file_list=stdin;
+        }
+
+    while (fgets(line,STR_SIZE,file_list) != NULL)
+        {
+        if ((line[0] == '#') || (strlen(line) < 2)) continue;
+
+        sp_rec  e;
+
+        n=reader.parse(line, &e);
+        printf("%s",reader.text.c_str());
+        if (n)
+            {
+            errcnt++;
+            continue;
+            }
+        models.push_back(e);
+        }
+
+    if (file_list != stdin) fclose(file_list);
+
+    if (models.empty())
+        {
+        printf("No models to analyse\n");
+        exit(1);
+        }
+
+    results.resize(models.size());
+
+//
+// Build the polar table, the FFT arrays of every thread and the plans (made
+//   on the arrays of thread 0; FFTW runs them on the others)
+//
+
+    num=omp_get_max_threads();
+    if (num > (int) models.size()) num=(int) models.size();
+
+    if (verbose) printf("Analysing %d Models With %d Threads (%s)...\n",(int) models.size(),num,eng.name(eng_kind));
+
+    if (pol.build())
+        {
+        printf("ERROR: Can't Build Polar Table\n");
+        exit(1);
+        }
+
+    if (eng_kind == ENGINE_FULL)
+        {
+        n_in=(size_t)DIM_THT*DIM_RAD+1;
+        n_out=n_in;
+        }
+    else if (eng_kind == ENGINE_R2C)
+        {
+        n_in=(size_t)DIM_THT*DIM_RAD/2+1;
+        n_out=(size_t)DIM_THT*(DIM_RAD/2+1);
+        }
+    else
+        {
+        n_in=(size_t)(M_FIN+1)*DIM_RAD;
+        n_out=n_in;
+        }
+
+    sps=new spiral[num];
+    mats=new Image2D<float>[num];
+    in_data=new fftw_complex *[num];
+    out_data=new fftw_complex *[num];
+
+    for (c=0; c < num; c++)
+        {
+        in_data[c]=(fftw_complex *) fftw_malloc(n_in*sizeof(fftw_complex));
+        out_data[c]=(fftw_complex *) fftw_malloc(n_out*sizeof(fftw_complex));
+        if ((in_data[c] == NULL) || (out_data[c] == NULL))
+            {
+            printf("ERROR: Memory allocation failed for the FFT arrays\n");
+            exit(1);
+            }
+
+        sps[c].seed=seed;
+        sps[c].analytic=analytic;
+        sps[c].psf=psf;
+        sps[c].fwhm=fwhm;
+        sps[c].beta=beta;
+        sps[c].psf_img=&psf_img;
+        sps[c].gain=gain;
+        sps[c].read_noise=read_noise;
+        }
+
+    if (eng_kind == ENGINE_FULL)
+        {
+        plan=fftw_plan_dft_2d( (int) DIM_THT, (int) DIM_RAD, in_data[0], out_data[0], FFTW_FORWARD, FFTW_MEASURE);
+        c=(plan == NULL);
+        }
+    else
+        {
+        c=eng.build(eng_kind, in_data[0], out_data[0]);
+        }
+
+    if (c)
+        {
+        printf("ERROR: Can't Make FFTW Plan (%s)\n",eng.name(eng_kind));
+        exit(1);
+        }
+
+//
+// Analyse the models
+//
+
+#pragma omp parallel for num_threads(num) schedule(dynamic,1) reduction(+:errcnt)
+    for (int it=0; it < (int) models.size(); it++)
+        {
+        errcnt+=calib_item(it, omp_get_thread_num());
+        }
+
+//
+// Write the result table
+//
+
+    if ((fp=fopen(oname,"w")) == NULL)
+        {
+        printf("ERROR: Could Not Write %s\n",oname);
+        exit(1);
+        }
+
+    fprintf(fp,"File\tArms\tMode\tStart\tEnd\tPitch Angle (P)\tError\tAVGPITCH\tMINPITCH\tMAX_PITCH\tDelta\n");
+    for (n=0; n < (int) models.size(); n++)
+        {
+        if (!results[n].ok) continue;
+        fprintf(fp,"%s\t%d\t%d\t%d\t%d\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\n",models[n].name,models[n].arm,results[n].mode,
+                results[n].start,results[n].end,results[n].pa,results[n].err,results[n].avg,results[n].min,results[n].max,
+                fabs(results[n].pa)-fabs(results[n].avg));
+        }
+    fclose(fp);
+
+    for (c=0; c < num; c++)
+        {
+        fftw_free(in_data[c]);
+        fftw_free(out_data[c]);
+        }
+    delete [] in_data;
+    delete [] out_data;
+    delete [] mats;
+    delete [] sps;
+    if (plan) fftw_destroy_plan(plan);
+
+    for (n=0, c=0; n < (int) models.size(); n++) c+=results[n].ok;
+
+    printf("-------------------------------\n");
+    printf("Models Analysed              %d\n",c);
+    printf("Errors                       %d\n",errcnt);
+    printf("Result Table                 %s\n",oname);
+    return(0);
+    }
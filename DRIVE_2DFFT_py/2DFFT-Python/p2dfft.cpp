@@ -67,7 +67,12 @@
 //
 //  Usage: p2dfft [-i|--input <file>] [-v|--verbose] [-w|--warn]  [-r|--reverse]
 //                [-f|--fixed <size>] [-p|--polar] [-z|--zero] [-m|--mask 0,1]
-//                [-h|--highpass] [<args>]
+//                [-h|--highpass] [-c|--catalog <file> <mosaic>] [-o|--order]
+//                [-E|--plan-only[=<cal>]] [-s|--shard i/N] [-q|--queue <dir>]
+//                [-u|--summary <file>] [-b|--bind close|spread] [-l|--latency]
+//                [-e|--engine full|r2c|pruned|auto] [-C|--cpu-report]
+//                [-B|--badpix <file>] [-W|--watch <dir>]
+//                [-Z|--compress <opts>] [<args>]
 // 
 //         p2dfft will process a list of files.  These files can come from 
 //         standard input, the command line, or an input file.  The files can
@@ -111,6 +116,64 @@
 //                            data when a mask value of 0 is used.
 //              -h|--highpass: Apply a high pass filter to the results after
 //                             the low pass filter is applied (experimental)
+//              -c|--catalog: Process regions of a single large mosaic image.
+//                            The catalog file lists the region centers and
+//                            radii and the mosaic FITS file is given as the
+//                            only command line argument.  No cutout files
+//                            are written (see Catalog File below).
+//              -o|--order  : Process the items in order of decreasing cost
+//                            (radius, then image size) instead of the order
+//                            they were given in.  With -i the sizes come
+//                            from the header prescan.
+//              -E|--plan-only: Only read the image headers and print an
+//                            estimate of the CPU time, wall time for 1 to
+//                            all threads, peak memory and the number and
+//                            size of the output files, then exit.  The
+//                            cost model is read from the file given with
+//                            the option, or p2dfft.cal in the current
+//                            directory or BIN_DIR (written by p2bench).
+//              -s|--shard  : Only process shard i of N (0 <= i < N), which
+//                            is every N-th item of the work list starting
+//                            at item i.  Run N copies with the same input
+//                            to split a batch without editing it.
+//              -q|--queue  : Share the work list with other p2dfft
+//                            processes through a directory on a shared
+//                            filesystem (see Work Queue below).
+//              -u|--summary: Append one line per item to this file (see
+//                            Work Queue below).  The default with -q is
+//                            <dir>/summary.
+//              -b|--bind   : Pin each thread to one CPU.  close fills the
+//                            CPUs of the first NUMA node first, spread puts
+//                            the threads round robin on the nodes.  The FFT
+//                            arrays of each thread are then allocated on its
+//                            own node and every node that has threads gets
+//                            its own copy of the image (Linux only).
+//              -l|--latency: Give the radii to the threads one at a time
+//                            and, when the last round of radii would leave
+//                            threads idle, split each of its FFTs over the
+//                            idle threads (FFTW threads) once the other
+//                            radii are finished.  This shortens the time
+//                            for one large image; batches run faster
+//                            without it.
+//              -e|--engine : Transform used for each radius.  full is the
+//                            complex 2D FFT (default), r2c a real to complex
+//                            2D FFT, pruned computes only the mode rows from
+//                            a twiddle table.  auto times the engines on a
+//                            few radii of each item, keeps only the ones
+//                            that agree with full, and records the fastest
+//                            per CPU, size and options in p2dfft.tune so
+//                            later runs only verify it.  The engine used is
+//                            shown with -v and written to the -u summary.
+//              -C|--cpu-report: Show the CPU and the code path (sse2, avx2
+//                            or avx512f) each hot loop runs, then exit.
+//              -B|--badpix : Bad pixel/star mask for the items that don't
+//                            have a badpix option (see Bad Pixel Masks
+//                            below).
+//              -W|--watch  : Keep running and process the FITS images that
+//                            are written or moved into a directory as they
+//                            arrive (see Hot Folder below, Linux only).
+//              -Z|--compress: Write the -p P_ images tile compressed and/or
+//                            cropped (see Compressed Images below).
 //
 //
 //  Input formats:
@@ -135,6 +198,23 @@
 //        used as inputs to this version of p2dfft.  Blank lines are allowed
 //        in the file, but are no longer needed and will be ignored.
 //
+//        Any columns after the radius are per item options that override
+//        the command line for that item only, e.g.
+//
+//           barred.fits,barred,120,mask=1,zero
+//           ngc1234.fits,,,fixed=50,center=101:98,rmin=5,rmax=90
+//
+//        The options are mask=0|1|none, fixed=<size>, reverse, highpass,
+//        zero, center=<x>:<y> (FITS pixels), rmin=<r>/rmax=<r> (range
+//        of radii to calculate) and badpix=<file>|none.  A mixed input
+//        file is processed in one run sharing the same FFTW plan and
+//        buffers.
+//
+//        The headers of all files in the input file are read in parallel
+//        before processing starts and are saved in <file>.meta.  Later runs
+//        with the same input file only read the headers of files that have
+//        changed since then.
+//
 //        Standard Input - The standard input format is for compatibility
 //        with older scripts generated by scripter.  The expected format is
 //        (one per line):
@@ -147,8 +227,157 @@
 //        Only one file can be read from standard input.  The keyword is kept
 //        for compatiability reasons, but not used in P2DFFT v5.0+
 //
+//        Catalog File - Used with -c, the format of the catalog file is:
+//
+//           x_center_1,y_center_1,radius_1,result_file_1
+//           x_center_2,y_center_2,radius_2,result_file_2
+//
+//        The center is in FITS pixel coordinates of the mosaic (starting at
+//        1).  Lines starting with # and a header line are ignored.  The
+//        mosaic is read once, top to bottom, in strips of complete rows and
+//        each region is analyzed from memory.  Entries are processed in order
+//        of their lowest row so neighboring regions share the rows already
+//        read.
+//
+//        FITS Cubes and Multi-Extension Files - A binary FITS file with
+//        NAXIS=3 is analyzed one plane at a time and a file with several
+//        image extensions one HDU at a time.  The result file for each plane
+//        has _h<hdu> and/or _p<plane> added to it.  The file is opened once
+//        and all planes are read through the same handle.
+//
+//        In Memory Images - A file name of - reads a FITS file from standard
+//        input, shm:<name> maps the POSIX shared memory segment <name> and
+//        the name of a named pipe (FIFO) reads the pipe to its end.  The
+//        image is read (or mapped) into memory once, opened through the
+//        CFITSIO memory driver and released after its last item, so no
+//        temporary file is written.  The result name is stdin for - and
+//        <name> without its extension for shm:.  These names can also be
+//        used in -i input files and on standard input.  The stream must be
+//        an uncompressed or tile compressed FITS file (not gzipped).
+//
+//           producer | p2dfft -
+//           p2dfft shm:/ngc1566.fits
+//
+//        Compressed Images - With -Z|--compress <opts> the -p P_ images are
+//        written as tile compressed images (the fpack format, read by ds9,
+//        astropy and funpack).  The tiles are compressed on all threads
+//        before they are handed to CFITSIO.  <opts> is a comma separated
+//        list of:
+//
+//           rice        Rice compression (default)
+//           gzip        GZIP compression
+//           none        No compression (use with crop)
+//           q=<val>     Quantize to noise/<val> (default 4), to a step of
+//                       -<val> if negative, or lossless GZIP for 0
+//           tile=<rows> Image rows per tile (default 16)
+//           nodither    Do not dither the quantization
+//           crop        Write only the part of the image that is not 0 or
+//                       NaN (LTV1/LTV2 give its offset in the full image)
+//
+//           p2dfft -p -Z rice,q=8,crop ngc1566.fits
+//
+//        Work Queue - With -q|--queue <dir> any number of p2dfft processes
+//        (on one or many hosts) started with the same input take the items
+//        in turn.  An item is claimed by creating <dir>/<result>.claim with
+//        O_EXCL, which only one process can do, and the claim is renamed to
+//        <result>.done when the item is finished.  Running processes touch
+//        their claims every QUEUE_BEAT seconds.  A claim that has not been
+//        touched for QUEUE_STALE seconds (the process died) is taken over by
+//        the next process that reaches it.  Every process appends a line
+//
+//           result  name  radius  ok|error  seconds  host  pid  engine
+//
+//        to the summary file, so it lists every item of the batch once.
+//        Removing the directory resets the queue.
+//
+//        Bad Pixel Masks - Foreground stars and artifacts can be left out of
+//        the analysis without editing the image.  The mask is a FITS image
+//        of the same size (pixels that are not 0 are masked) or a DS9
+//        region file (<file>.reg, image coordinates, circle, ellipse, box
+//        and polygon; a -shape unmasks).  It is read once into a packed
+//        bitset with the layout of mat (kept while the next items use the
+//        same file and size), and masked samples are read as 0 by the
+//        polar gather, so they add nothing to the data or the
+//        normalization.  Masks are not used for catalog regions.
+//
+//        Hot Folder - With -W|--watch <dir> p2dfft processes the FITS images
+//        in the directory that have no completion marker, then keeps
+//        running and takes every image (.fits, .fit, .fts, .fz and .gz of
+//        them) that is closed after writing or renamed into the directory
+//        (inotify).  The FFTW plans, the polar table, the engine table and
+//        the thread buffers stay set up, so a new image is started within
+//        WATCH_POLL ms of its arrival.  The outputs are written next to the
+//        image as for a command line file, followed by the marker
+//        <image>.done with the line
+//
+//           ok|error  host  pid  time
+//
+//        An image that is written again after its marker is processed
+//        again.  Copy images in under a hidden or other name and rename them
+//        so they are only taken when complete.  SIGINT or SIGTERM finish
+//        the current item and end the run.  -q|--queue and -u|--summary can
+//        be used with -W to share one folder between several processes.
+//
 //  Version History:
 //
+//      6.0  17-Oct-2026 - Add -c|--catalog option to analyze many regions of
+//                         one mosaic image without writing cutout files
+//                       - Add support for FITS cubes and multi-extension
+//                         files (one analysis per image plane)
+//                       - Replace the per sample expf()/cosf()/sinf() polar
+//                         mapping with a sampling table (polar_class) that
+//                         is built once per run and shared by all images
+//                       - Decompress tile compressed (.fz) images in
+//                         parallel and read the next compressed image in the
+//                         background while the current one is processed
+//                       - Read and decode all upcoming images on a read
+//                         ahead thread into a ring of PREFETCH_DEPTH reused
+//                         buffers while the current image is processed
+//                       - Add a per run arena for per item buffers that is
+//                         reset at the start of every item so memory use
+//                         stays flat for long batches
+//                       - Read the headers of -i files in parallel with a
+//                         cached <file>.meta sidecar (astro::prescan())
+//                       - Add -o|--order option for cost ordered processing
+//                       - Add per item options in -i input files (mask,
+//                         fixed, reverse, highpass, zero, center, rmin and
+//                         rmax)
+//                       - Add -E|--plan-only cost and memory estimate
+//                       - Add -s|--shard, -q|--queue and -u|--summary options
+//                         for running one batch in several processes
+//                       - Add -b|--bind option for NUMA thread placement, with
+//                         per thread FFT arrays first touched by their thread
+//                         and one copy of mat per NUMA node
+//                       - Add -l|--latency option for single image runs that
+//                         splits the FFTs of the last round of radii over
+//                         the idle threads
+//                       - Add -e|--engine option with r2c and pruned
+//                         transforms and a per item autotuner (engine_class)
+//                       - Build the gather, scaling and mode extraction
+//                         loops for each instruction set in CPU_PATHS and
+//                         add -C|--cpu-report option
+//                       - Fix pitch analysis warnings printing the wrong mode
+//                       - mat and its NUMA replicas are Image2D (aligned,
+//                         rows found by stride instead of row pointers)
+//                       - Fix -f|--fixed using uninitialized annulus limits
+//                       - Fix per radius results of a previous item being
+//                         written for radii skipped with -f|--fixed
+//                       - Add -B|--badpix option and badpix per item option
+//                         for bad pixel/star masks applied in the gather
+//                       - Add -W|--watch hot folder mode (inotify)
+//                       - Read images from standard input (-), named pipes
+//                         and shared memory (shm:<name>) without a file
+//                       - Add -Z|--compress option to write the P_ images
+//                         tile compressed (tiles compressed in parallel)
+//                         and/or cropped, and write P_ after the radii
+//                       - Fix HDUs of a multi-extension file using the
+//                         radius of the first HDU when they differ in size
+//                       - Move the polar gather and spectrum scaling to
+//                         engine_class (shared with p2calib)
+//                       - -E reads the item headers with an astro instance
+//                         per thread and loads in memory images first
+//                       - -l split FFTs wait for the other radii so the FFTW
+//                         threads do not share CPUs with busy radii
 //      5.9  20-Jun-2019 - Remove incorrect FFT row sense fix
 //      5.8  02-Jun-2019 - Change 2D FFT row sense to correct bug left over
 //                         from FFTW migrations and to improve accuracy
@@ -317,7 +546,23 @@
 #include    <getopt.h>
 #include    <omp.h>
 #include    <fftw3.h>
-#include <libgen.h>
+#include    <pthread.h>
+#include    <fcntl.h>
+#include    <limits.h>
+#include    <utime.h>
+#include    <time.h>
+#include    <sys/file.h>
+#include    <signal.h>
+#include    <poll.h>
+#include    <dirent.h>
+#include    <strings.h>
+#ifdef __linux__
+#include    <sched.h>
+#include    <sys/inotify.h>
+#endif
+#include    <libgen.h>
+#include    <algorithm>
+#include    <map>
 //
 // GLOBAL CONSTANTS
 //
@@ -330,12 +575,14 @@
 
 #include    "astro_class.h"
 #include    "pitch_class.h"
+#include    "polar_class.h"
+#include    "engine_class.h"
 
 //
 // Version number definition
 //
 
-#define     VERSION     "5.9/20190620"
+#define     VERSION     "6.0/20261017"
 
 //
 // Set this flag to #define to get a data matrix debugging information.  This
@@ -380,7 +627,42 @@ int     proc_error;        /* Input file error count                         */
 int     high_pass=0;       /* Flag for applying high pass filter             */
 int     mask_line=0;       /* Flag for masking on an even line               */
 int     input_file=0;      /* Flag to indicate if input file is used         */
+int     catalog=0;         /* Flag to indicate if a mosaic catalog is used   */
+int     order=0;           /* Flag to process items by decreasing cost       */
+int     r_lo, r_hi;        /* Range of radii calculated for the item         */
+int     hits;              /* Number of items found in the prescan sidecar   */
+int     plan_only=0;       /* Flag to only print the cost estimate           */
+int     queue=0;           /* Flag for the shared work queue (-q)            */
+int     shard_i=0;         /* Shard of the items processed (-s i/N)          */
+int     shard_n=0;         /* Number of shards (0 = no sharding)             */
+int     taken=0;           /* Items processed by other queue workers         */
+int     beat_on=0;         /* Flag that the heartbeat thread is running      */
+int     bind=0;            /* Thread placement (0 none, 1 close, 2 spread)   */
+int     latency=0;         /* Flag for the low latency (one image) mode      */
+int     cpu_rep=0;         /* Flag for -C|--cpu-report                       */
+fits_pack pack;            /* P_ image compression/crop options (-Z)         */
+int     n_split;           /* Radii run with one thread per FFT (-l)         */
+int     tail_k=1;          /* FFTW threads per radius after n_split (-l)     */
+int     split_done;        /* Radii before n_split finished (-l)             */
+int     fft_threads=0;     /* Flag that FFTW threads are initialized         */
+int     eng_opt=ENGINE_FULL; /* Engine from -e (ENGINE_AUTO to choose)      */
+int     eng_kind;          /* Engine used for the current item               */
+int     n_nodes=1;         /* NUMA nodes with CPUs this process can use      */
+int     replicas=0;        /* Flag that mat is replicated per NUMA node      */
+int     node_lead[MAX_NODES]; /* First thread of each NUMA node           */
+volatile int beat_stop=0;  /* Flag to stop the heartbeat thread              */
+int     mos_x, mos_y;      /* The cartesian dimensions of the mosaic         */
+int     strip_lo=1;        /* First mosaic row held in strip[]               */
+int     strip_hi=0;        /* Last mosaic row held in strip[]                */
+long    strip_rows=0;      /* Total mosaic rows read from the file           */
 int     x_dim, y_dim;      /* The cartesian dimensions of the input file     */
+int     pre_on=0;          /* Flag that the read ahead thread is running     */
+int     ring_next=0;       /* Next ring slot to be taken by the main loop    */
+int     watch=0;           /* Flag for the hot folder mode (-W)              */
+int     watch_fd=-1;       /* inotify descriptor of the hot folder           */
+int     watch_done=0;      /* Flag that no more items will be added (-W)     */
+int     watch_err=0;       /* Flag that an item of the current image failed  */
+volatile sig_atomic_t watch_stop=0; /* Set by SIGINT/SIGTERM to end -W      */
 
 unsigned    int     it;    /* Files vector index variable                    */
 
@@ -390,33 +672,130 @@ char    *fname;            /* FITS filename                                  */
 char    cmd[128];          /* Buffer for system(2) commands                  */
 char    pfile[80];         /* Input filename for -i                          */
 char    infile[80];        /* Input filename for -i                          */
+char    catfile[256];      /* Catalog filename for -c                        */
+char    calfile[256];      /* Calibration filename for -E                    */
+char    qdir[256];         /* Work queue directory for -q                    */
+char    sumfile[PATH_MAX]; /* Shared summary file (-u or <qdir>/summary)     */
+char    host[64];          /* Host name written in claims and summary        */
+char    tunefile[PATH_MAX]=TUNE_FILE; /* Engine table for -e auto           */
+char    badfile[PATH_MAX];  /* Bad pixel mask for all items (-B)             */
+char    wdir[PATH_MAX];    /* Hot folder for -W                              */
+
+const   char    *eng_how="fixed"; /* How the engine was chosen              */
 char    keyword[80];       /* String for intermediate data file prefix       */
 char    outfile[80];       /* String for intermediate file name              */
 char    tmpofile[80];      /* Intermediate data file file name               */
 char    resultfile[80];    /* Summary file (*_m[0-6]) file name              */
 
-FILE    *fp_inp;           /* Input file pointer                             */
 FILE    *sum_out;          /* Output file pointer for per mode summed data   */
 FILE    *mode_out;         /* Output file pointer for per mode peak data     */
     
-float   **mat;             /* 2D cartesian image data                        */
 float   *data;             /* Polar mapped image data matrix                 */
 float   *proj;             /* Polar mapped image data matrix                 */
+float   *strip;            /* Rows of the mosaic currently in memory         */
 float   ctr_val;           /* Core brightness for masking                    */
 float   log_rad;           /* The natural log of the current radius value    */
 float   log_bar;           /* The natural log of the bar radius value        */
 float   log_itrad;         /* The natural log of the maximum radius value    */
 float   freq_counter;      /* Frequency counter value                        */
 
+double  t_item;            /* Start time of the current item                 */
+double  eng_err;           /* Difference of the engine from ENGINE_FULL      */
+
 const   float   radstep=2.0*PI/STEP_P/DIM_RAD;    /*                         */
 const   float   theta_step=2.0*PI/GR_RAD/DIM_THT; /*                         */
 
 astro   ast;               /* Instantiation of astro_class functions         */
 pitch   pit;               /* Instantiation of pitch_class functions         */
+logpolar    pol;           /* Polar sampling table shared by all images      */
+engine      eng;           /* Transform engines                              */
+
+Image2D<float>  mat;       /* 2D cartesian image data                        */
+Image2D<float>  mat_copy[MAX_NODES]; /* Replicas of mat on other NUMA nodes  */
+ImageView<float> mat_node[MAX_NODES]; /* Copy of mat used by each NUMA node  */
+
+BitMask     bad;           /* Bad pixel mask of the current item ([x][y])    */
+ImageView<uint64_t> bad_v; /* View of bad for the gather (empty = no mask)   */
+std::string bad_name;      /* Mask file bad was read from                    */
+std::string bad_item;      /* Mask file of the current item                  */
+int     bad_x, bad_y;      /* Image size bad was read for                    */
+astro   pre_ast;           /* astro_class instance for the read ahead thread */
+arena   mem;               /* Per item buffers (reset for every item)        */
         
 fftw_plan   plan;          /* FFTW execution plan variable                   */
+fftw_plan   tail_plans[32];/* Multi threaded plans for -l (by log2 threads)  */
+fftw_plan   tail;          /* Plan used for the radii after n_split          */
+
+fitsfile    *mos_p=NULL;   /* CFITSIO handle for the open mosaic (-c)        */
+fitsfile    *cube_p=NULL;  /* CFITSIO handle for the open cube/MEF file      */
+
+#ifdef __linux__
+cpu_set_t   all_cpus;      /* CPUs this process is allowed to run on         */
+#endif
+
+pthread_t   pre_thread;    /* Thread reading images ahead of the main loop   */
+pthread_t   beat_thread;   /* Thread keeping the queue claims fresh          */
+
+pthread_mutex_t ring_lock=PTHREAD_MUTEX_INITIALIZER; /* Ring slot lock       */
+pthread_cond_t  ring_cond=PTHREAD_COND_INITIALIZER;  /* Ring slot changes   */
+pthread_mutex_t claim_lock=PTHREAD_MUTEX_INITIALIZER; /* Queue claim state  */
+pthread_mutex_t items_lock=PTHREAD_MUTEX_INITIALIZER; /* Growth of items (-W) */
+pthread_cond_t  items_cond=PTHREAD_COND_INITIALIZER;  /* Items added (-W)    */
+
+std::string cube_name;     /* File name of the open cube/MEF file            */
+std::string cpu_model;     /* CPU model name for the engine table            */
 
 std::vector  <file_rec>    items; /* Vector of input files                   */
+std::vector  <int>         node_of;   /* NUMA node of each thread            */
+std::vector  <int>         cpu_of;    /* CPU of each thread (-b)             */
+std::vector  <int>         node_cpus[MAX_NODES]; /* CPUs of each NUMA node */
+std::vector  <int>         rad_list;  /* Radii calculated for the item       */
+std::vector  <int>         claim; /* Queue state per item (0 unknown, 1 this
+                                     worker, 2 other worker, 3 finished)     */
+
+std::map <std::string,double>  calib; /* Cost model values for -E          */
+std::map <std::string,int>     tune_table; /* Engine per table key (-e auto) */
+
+//
+// Ring slot for the images read ahead of the main loop.  The data buffer of
+//   each slot is kept and reused for the following images.
+//
+
+struct  pre_slot
+    {
+    int     item;          /* Index of the item in the slot                  */
+    int     ready;         /* Slot holds an image not yet taken              */
+    int     ok;            /* Image was read successfully                    */
+    int     x, y;          /* The cartesian dimensions of the image          */
+    int     size;          /* Number of values read                          */
+    long    cap;           /* Allocated size of data in values               */
+    float   *data;         /* Image data                                     */
+
+    pre_slot() : item(-1), ready(0), ok(0), x(0), y(0), size(0), cap(0), data(NULL) {}
+    };
+
+pre_slot    ring[PREFETCH_DEPTH];   /* Ring of read ahead slots              */
+pre_slot    own;           /* Slot used when there is no read ahead thread   */
+pre_slot    *slot;         /* Slot of the current item                       */
+
+//
+// Work and output of one item for -E|--plan-only
+//
+
+struct  plan_cost
+    {
+    int     nrad;          /* Radii calculated                               */
+    int     pfile;         /* Item writes a P_ polar projection file         */
+    int     ring;          /* Item is read through the read ahead ring       */
+    int     compressed;    /* Image is tile compressed                       */
+    long    files;         /* Output files                                   */
+    double  samples;       /* Polar samples gathered (all radii)             */
+    double  pixels;        /* Pixels read                                    */
+    double  bytes;         /* Output bytes                                   */
+    double  t_read;        /* CPU seconds to read the image                  */
+    double  t_comp;        /* CPU seconds for the radii                      */
+    double  t_write;       /* CPU seconds to write the output                */
+    };
 
 struct  result_pa   mode_data[M_FIN+1][(MAX_DIM/2)+1];   /* FFT analysis data*/
 
@@ -472,6 +851,43 @@ std::string remove_extension(std::string& filename)
     }
 
 
+//
+// STREAM_RESULT() - Sets the result name of an in memory image (standard
+//                   input, named pipe or shared memory, see
+//                   astro::mem_name()).  "-" becomes stdin and shm:<name>
+//                   becomes <name> without the leading / (any other / is
+//                   changed to _), so the outputs are written in the current
+//                   directory.  Named pipes keep their path like files.
+//
+// Arguments:
+//      f       - Pointer to the file_rec to fix
+//
+// Return Value: NONE
+//
+
+void    stream_result(file_rec *f)
+    {
+    std::string r=f->result;
+
+    if (f->region || !ast.mem_name(f->name.c_str())) return;
+
+    if (r == "-")
+        {
+        r="stdin";
+        }
+    else if (!r.compare(0, 4, "shm:"))
+        {
+        r=r.substr(4);
+        r.erase(0, r.find_first_not_of('/'));
+        std::replace(r.begin(), r.end(), '/', '_');
+        if (r.empty()) r="shm";
+        }
+
+    f->result=r;
+    f->binary=ASTRO_BIN_FILE;
+    }
+
+
 //
 // READ_STD_INPUT() - Reads parameters for processing/analysis from std input.
 //                    NOTE: In this version, it is assumed that the format is
@@ -654,247 +1070,2444 @@ float   find_bar(int rad, int x_org, int y_org, float lim_val)
 
 
 //
-// MAIN() CODE BLOCK
+// READ_NODES() - Finds the NUMA nodes and the CPUs of each node that this
+//                process is allowed to run on (from the cpulist files in
+//                /sys/devices/system/node).  If there is no NUMA
+//                information all CPUs are put in one node.
 //
-
-int main(int argc, char **argv)
-    {
+// Global Variables:
+//      all_cpus, node_cpus, n_nodes
 //
-// Parse the command line options, if any, and set the flags associated
-//   with the options
+// Return Value: NONE
 //
 
-    static struct option long_options[] =
+void    read_nodes()
+    {
+#ifdef __linux__
+    int     n;             /* Node number                                    */
+    int     lo, hi;        /* CPU range from the cpulist                     */
+    int     cpu;           /* CPU number                                     */
+    char    path[80];      /* cpulist file name                              */
+    char    line[1024];    /* cpulist contents (e.g. "0-15,32-47")           */
+    char    *tok;          /* Range in the cpulist                           */
+    char    *save;         /* strtok_r() state                               */
+    FILE    *fp;           /* cpulist file pointer                           */
+
+    CPU_ZERO(&all_cpus);
+    sched_getaffinity(0, sizeof(all_cpus), &all_cpus);
+
+    n_nodes=0;
+    for (n=0; n < MAX_NODES; n++)
         {
-        {"data", no_argument,        0, 'd'},
-        {"polar", no_argument,       0, 'p'},
-        {"zero",  no_argument,       0, 'z'},
-        {"warning", no_argument,     0, 'w'},
-        {"verbose", no_argument,     0, 'v'},
-        {"reverse", no_argument,     0, 'r'},
-        {"highpass", no_argument,    0, 'h'},
-        /* These options require an argument. */
-        {"mask",  optional_argument, 0, 'm'},
-        {"fixed", optional_argument, 0, 'f'},
-        {"input", optional_argument, 0, 'i'},
-        {0, 0, 0, 0}
-        };
+        sprintf(path, "/sys/devices/system/node/node%d/cpulist", n);
+        if ((fp=fopen(path, "r")) == NULL) continue;
 
-    int option_index = 0;
-
-    while ((c = getopt_long (argc, argv, "pzwvrhm:f:i:", long_options, &option_index)
-) != -1)
-        {
-        switch (c)
+        if (fgets(line, sizeof(line), fp) != NULL)
             {
-            case 'p':
-                {
-                polar = 1;
-                break;
-                }
-            case 'z':
-                {
-                zero = 1;
-                break;
-                }
-            case 'v':
-                {
-                verbose = 1;
-                break;
-                }
-            case 'r':
-                {
-                reverse = 1;
-                break;
-                }
-            case 'h':
-                {
-                high_pass = 1;
-                break;
-                }
-            case 'w':
-                {
-                warn = 1;
-                pit.set_warn(1);
-                ast.set_warn(1);
-                break;
-                }
-            case 'm':
-                {
-                if (atoi(optarg) != 0)
-                    {
-                    mask_line=1;
-                    }
-                else
-                    {
-                    mask=1;
-                    }
-                break;
-                }
-            case 'f':
-                {
-                fixed=atoi(optarg);
-                if ((fixed > MAX_WINDOW) || (fixed < MIN_WINDOW))
-                    {
-                    printf("ERROR: Window Size Must Be Between %d and %d...Exiting\n",MIN_WINDOW,MAX_WINDOW);
-                    exit(-1);
-                    }
-                break;
-                }
-            case 'i':
+            for (tok=strtok_r(line, ",\n", &save); tok != NULL; tok=strtok_r(NULL, ",\n", &save))
                 {
-                input_file = 1;
-                if (!ast.file_exists(optarg))
+                if (sscanf(tok, "%d-%d", &lo, &hi) != 2) hi=lo=atoi(tok);
+                for (cpu=lo; cpu <= hi; cpu++)
                     {
-                    printf("ERROR: Input File %s Not Found...Exiting\n",optarg);
-                    exit(-1);
+                    if ((cpu < CPU_SETSIZE) && CPU_ISSET(cpu, &all_cpus)) node_cpus[n_nodes].push_back(cpu);
                     }
-                strcpy(infile, optarg);
-                break;
-                }
-            default:
-                {
-                fprintf(stderr, "Usage: p2dfft [-i|--input <file>] [-v|--verbose] [-w|--warn]  [-r|--reverse] [-f|--fixed <size>] [-p|--polar] [-z|--zero] [-m|--mask 0|1] [<args>]\n");
-                exit(-1);
-                break;
                 }
             }
-        }
+        fclose(fp);
 
-//
-// Output version numbers
-//
+        if (node_cpus[n_nodes].size()) n_nodes++;
+        }
 
-    if (verbose)
+    if (n_nodes == 0)
         {
-        printf("p2dfft version: %s\n", VERSION);
-        ast.version();
-        pit.version();
+        for (cpu=0; cpu < CPU_SETSIZE; cpu++)
+            {
+            if (CPU_ISSET(cpu, &all_cpus)) node_cpus[0].push_back(cpu);
+            }
+        n_nodes=1;
         }
+#else
+    printf("WARNING: Thread Binding Is Only Supported on Linux...Ignoring -b\n");
+    bind=0;
+#endif
+    }
+
 
 //
-// Check for conflicting arguments
+// PIN_THREAD() - Pins the calling thread to the CPU chosen for OpenMP thread
+//                t by bind_threads().
 //
-
-    if (fixed && reverse)
-        {
-        printf("ERROR: Cannot specify -r|-reverse and -f|--fixed...Exiting\n");
-        exit(-1);
-        }
-
+// Arguments:
+//      t       - OpenMP thread number
 //
-// Allocate the Cartesian data array.  Also, zero out the first cell of mat 
-//   because FITS image indices start at 1.  Please Note:  ArrayAlloc()
-//   allocates a C-style array, not a FFTW3 style array.
+// Return Value:
+//      0 on success, -1 if the affinity could not be set
 //
 
-    if (verbose) printf("Allocating Cartesian mat[] Array...\n");
-
-    if (!(mat=ast.ArrayAlloc(MAX_DIM, MAX_DIM)))
-        {
-        if (mat != NULL) free(mat);
-        printf("ERROR: Memory allocation failed while allocating for mat[]/n");
-        exit(-1);
-        }
+int     pin_thread(int t)
+    {
+#ifdef __linux__
+    cpu_set_t   set;       /* CPU of the thread                              */
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu_of[t], &set);
+    return(sched_setaffinity(0, sizeof(set), &set));
+#else
+    return(-1);
+#endif
+    }
 
-    mat[0][0]=0.0;
 
 //
-// Get number of threads for this machine.  By default this should return
-//   a value = #cores * threads per core.
+// UNPIN_THREAD() - Lets the calling thread run on all the CPUs this process
+//                  is allowed to use again.
 //
-
-    num=omp_get_max_threads();
-
+// Arguments: NONE
 //
-// Allocate structure array for sum of FFT outputs and initialize the
-//   frequencies
+// Return Value: NONE
 //
 
-    i=M_FIN-M_INI+1;
-    lim=(int)((fabs(FREQ_START)+fabs(FREQ_END))*4.0)+1.0;
-
-    struct  fft_out     fft_sum[i][lim];  /* Array for sum of FFT outputs */
-
-    freq_counter=FREQ_START;
+void    unpin_thread()
+    {
+#ifdef __linux__
+    sched_setaffinity(0, sizeof(all_cpus), &all_cpus);
+#endif
+    }
 
-    for (i=0; i<lim; i++)
-        {
-        for(j=M_INI; j<=M_FIN; j++)
-            {
-            fft_sum[j][i].freq=freq_counter;
-            }
-        freq_counter+=STEP_P;
-        }
 
 //
-// Allocate the FFT arrays.  These need to be allocated with fftw_ functions
-//   since they are not C-style 2D arrays and the fact they need to be aligned
-//   on 16 byte boundaries if the target machine has SIMD support.
+// BIND_THREADS() - Pins each OpenMP thread to one CPU.  With close the
+//                  threads fill the CPUs of node 0 first, then node 1 and
+//                  so on.  With spread the threads go round robin over the
+//                  nodes so every node gets the same number of threads.
+//                  Each thread pins itself, so this has to be done before
+//                  the threads first touch their buffers.
 //
-// Note we need to allocate one set per thread, since this program is managing
-//   the threads and not the FFTW library.
+// Global Variables:
+//      bind, node_cpus, n_nodes, node_of, node_lead, num
+//
+// Return Value: NONE
 //
 
-    if (polar) proj = (float *) malloc((DIM_RAD*DIM_THT+1) * sizeof(float));
-    struct  fft_out     fft_data[num][DIM_RAD+2];  /* FFT output data array */
+void    bind_threads()
+    {
+    int     t;             /* Thread number                                  */
+    int     n;             /* Node number                                    */
+    int     k;             /* CPU index within all the CPUs                  */
+    int     ncpu=0;        /* Total CPUs allowed                             */
 
-    fftw_complex    *in_data[num];
-    fftw_complex    *out_data[num];
+    cpu_of.assign(num, 0);
+    for (n=0; n < n_nodes; n++) ncpu+=node_cpus[n].size();
 
-    for ( i=0; i < num; i++ )
+    for (t=0; t < num; t++)
         {
-        in_data[i] = (fftw_complex *) fftw_malloc((DIM_RAD*DIM_THT+1) * sizeof(fftw_complex));
-    if(NULL == in_data[i])
+        if (bind == 2)
             {
-            printf("ERROR: FFTW Memory allocation failed for in_data[%d]/n",i);
-            exit(-1);
+            n=t%n_nodes;
+            cpu_of[t]=node_cpus[n][(t/n_nodes)%node_cpus[n].size()];
             }
-
-        out_data[i] = (fftw_complex *) fftw_malloc((DIM_RAD*DIM_THT+1) * sizeof(fftw_complex));
-        if(NULL == out_data[i])
+        else
             {
-            printf("ERROR: FFTW Memory allocation failed for out_data[%d]/n",i);
-            exit(-1);
+            k=t%ncpu;
+            for (n=0; k >= (int)node_cpus[n].size(); n++) k-=node_cpus[n].size();
+            cpu_of[t]=node_cpus[n][k];
             }
+        node_of[t]=n;
+        if (node_lead[n] < 0) node_lead[n]=t;
         }
-        
-//
-// Read the input parameters for the analysis.  The input parameters will 
-//   include:
+
+#pragma omp parallel
+    {
+    if (pin_thread(omp_get_thread_num()) && warn) printf("WARNING: Can't Bind Thread %d to CPU %d\n",omp_get_thread_num(),cpu_of[omp_get_thread_num()]);
+    }
+
+    if (verbose)
+        {
+        for (t=0; t < num; t++) printf("--- thread %d: cpu %d node %d\n",t,cpu_of[t],node_of[t]);
+        }
+    }
+
+
 //
-//     * All filenames to be processed
-//     * Any keywords associated with those files (optional)
-//     * Any radius values for the files (optional)
+// REPLICATE_MAT() - Copies the image in mat to the replica of every other
+//                   NUMA node, so the threads of a node read the image from
+//                   their own memory in the radius loop.  The copy for a
+//                   node is made by the first thread of that node.
 //
-// Input can come from one of the following sources (in 
-//  priority order):
+// Global Variables:
+//      mat, mat_node, node_of, node_lead, x_dim, y_dim
 //
-//     * Input file specified with -i
-//     * Command line arguments
-//     * Std input
+// Return Value: NONE
 //
 
-    if (input_file)
+void    replicate_mat()
+    {
+    int     rows=std::min(x_dim, MAX_DIM-1); /* Rows of mat in use           */
+
+#pragma omp parallel
+    {
+    int     t=omp_get_thread_num();   /* Thread number                       */
+    int     n=node_of[t];             /* Node of the thread                  */
+
+    if ((node_lead[n] == t) && (mat_node[n].base != mat.data()))
         {
-        if (ast.read_lines(std::string(infile), &items))
-            {
-            std::cout << "ERROR: Can't Read File Name: " << infile << std::endl;
-            exit(-1);
-            }
-        if ((items.size()==0))
-            {
-            std::cout << "ERROR: No Valid Items in Input File: " << infile << std::endl;
-            exit(-1);
-            }
+        for (int r=1; r <= rows; r++) memcpy(mat_node[n][r]+1, mat[r]+1, (size_t)y_dim*sizeof(float));
         }
-    else
-        {
-//
-// Check if there are command line arguments
-//
+    }
+    }
 
-        if (DEBUG) printf("optind=%d, argc=%d\n",optind,argc);
+
+//
+// SPLIT_THREADS() - Returns the number of FFTW threads given to each radius
+//                   of the last (partial) round of radii in -l|--latency
+//                   mode.  The threads left idle by the short round are
+//                   shared out, as a power of two to limit the number of
+//                   FFTW plans.
+//
+// Arguments:
+//      n       - Number of threads
+//      w       - Number of radii in the last round (0 < w < n)
+//
+// Return Value:
+//      Threads per FFT (1 if the round does not leave enough idle threads)
+//
+
+int     split_threads(int n, int w)
+    {
+    int     k;             /* Threads per FFT                                */
+
+    for (k=1; k*2 <= n/w; k*=2);
+    return(k);
+    }
+
+
+//
+// TAIL_PLAN() - Returns the FFTW plan that uses k threads per transform for
+//               the last round of radii.  The plans are built the first
+//               time they are needed (with the same flags as the main plan)
+//               and kept for the rest of the run.
+//
+// Arguments:
+//      k       - Threads per transform (a power of two)
+//      in, out - Arrays used to build the plan
+//
+// Return Value:
+//      The plan, or NULL if it could not be built
+//
+
+fftw_plan   tail_plan(int k, fftw_complex *in, fftw_complex *out)
+    {
+    int     lg;            /* log2(k), index into tail_plans                 */
+
+    for (lg=0; (1 << lg) < k; lg++);
+
+    if (tail_plans[lg] == NULL)
+        {
+        if (verbose) printf("Building %d thread plan for FFTW...",k);
+        fftw_plan_with_nthreads(k);
+        tail_plans[lg]=fftw_plan_dft_2d( (int) DIM_THT, (int) DIM_RAD, in, out, FFTW_FORWARD, FFTW_MEASURE);
+        fftw_plan_with_nthreads(1);
+        if (verbose) printf("Done\n");
+        }
+
+    return(tail_plans[lg]);
+    }
+
+
+//
+// ANNULUS() - Finds the range of ln r steps kept for one annulus.  Since ln r
+//             increases along each theta row, the samples kept are one
+//             contiguous range of ln r steps, which depends on the value of
+//             reverse and fixed.  Everything outside it stays zero.
+//
+// Arguments:
+//      rad     - Outer radius of the item
+//      radius  - Radius being calculated
+//      r_first - Set to the first ln r step kept
+//      r_last  - Set to one past the last ln r step kept
+//
+// Global Variables:
+//      reverse, fixed, mask_line, log_itrad, log_bar, pol
+//
+// Return Value: NONE
+//
+
+void    annulus(int rad, int radius, int *r_first, int *r_last)
+    {
+    float   lr;            /* Natural log of current value of radius         */
+
+    if (reverse)
+        {
+        lr=log((double)(rad-radius+1));
+        pol.rad_range(0.0, (lr < log_itrad) ? lr : log_itrad, r_first, r_last);
+        }
+    else if (fixed)
+        {
+        pol.rad_range(log((double)(radius-(fixed/2))), log((double)(radius+(fixed/2))), r_first, r_last);
+        }
+    else
+        {
+        pol.rad_range(log((double)radius), log_itrad, r_first, r_last);
+        }
+
+    if (mask_line)
+        {
+        while ((*r_first < *r_last) && (pol.lnr[*r_first] <= log_bar)) (*r_first)++;
+        }
+    }
+
+
+//
+// GATHER() - Samples an annulus of the current item into the input array of
+//            an engine with the item options (engine::gather(), shared
+//            with p2calib and p2bench)
+//
+// Arguments:
+//      kind    - Engine
+//      in      - Input array of the engine (cleared)
+//      m       - Copy of mat to read (view)
+//      r_first - First ln r step kept
+//      r_last  - One past the last ln r step kept
+//      pj      - Polar projection for -p|--polar (NULL for none)
+//
+// Global Variables:
+//      pol, eng, x_0, y_0, mask, ctr_val, zero, bad_v
+//
+// Return Value:
+//      Sum of the samples (normalization value)
+//
+
+float   gather(int kind, fftw_complex *in, ImageView<float> m, int r_first, int r_last, float *pj)
+    {
+    gather_opt  opt;       /* Options of the item                            */
+
+    opt.xy=1;
+    opt.zero=zero;
+    opt.mask=mask;
+    opt.ctr_val=ctr_val;
+    opt.pj=pj;
+    opt.bad=bad_v;
+
+    return(eng.gather(kind, in, pol, m, x_0, y_0, r_first, r_last, &opt));
+    }
+
+
+//
+// EXTRACT() - Copies one mode row of a spectrum into an fft_out array in
+//             frequency order and computes the amplitudes (see the mapping
+//             table in main())
+//
+// Arguments:
+//      spec    - Spectrum from the engine (normalized)
+//      mode    - Mode
+//      fd      - fft_out array (DIM_RAD+2 entries)
+//
+// Return Value: NONE
+//
+
+CPU_CLONES
+void    extract(fftw_complex *spec, int mode, fft_out *fd)
+    {
+    int     cont_p;        /* Index for remapping output data in fd          */
+    fftw_complex    *row=spec+mode*DIM_RAD; /* Mode row of the spectrum      */
+
+    for(cont_p=0;cont_p<DIM_RAD/2;cont_p++) 
+        {
+        fd[cont_p+(DIM_RAD/2)+1].real=row[cont_p][0];
+        fd[cont_p+(DIM_RAD/2)+1].imag=-1.0*row[cont_p][1];
+        fd[cont_p+(DIM_RAD/2)+1].abs=sqrt(row[cont_p][0]*row[cont_p][0]+row[cont_p][1]*row[cont_p][1]);
+        }
+
+    fd[DIM_RAD+1].real=row[DIM_RAD/2][0];
+    fd[DIM_RAD+1].imag=-1.0*row[DIM_RAD/2][1];
+    fd[DIM_RAD+1].abs=sqrt(row[DIM_RAD/2][0]*row[DIM_RAD/2][0]+row[DIM_RAD/2][1]*row[DIM_RAD/2][1]);
+
+//
+// This was in the original code.  Not sure if it is still needed.
+//
+
+    fd[1].abs=fd[DIM_RAD+1].abs;
+
+    for(cont_p=1;cont_p<DIM_RAD/2;cont_p++) 
+        {
+        fd[cont_p+1].real=row[cont_p+DIM_RAD/2][0];
+        fd[cont_p+1].imag=-1.0*row[cont_p+DIM_RAD/2][1];
+        fd[cont_p+1].abs=sqrt(row[cont_p+DIM_RAD/2][0]*row[cont_p+DIM_RAD/2][0]+row[cont_p+DIM_RAD/2][1]*row[cont_p+DIM_RAD/2][1]);
+        }
+    }
+
+
+//
+// TUNE_KEY() - Builds the engine table key of the current item: the CPU
+//              model, the radius rounded up to a power of two and the
+//              options that change the number of samples per radius.
+//
+// Arguments:
+//      rad     - Outer radius of the item
+//
+// Return Value:
+//      Key (tab separated)
+//
+
+std::string tune_key(int rad)
+    {
+    int     bucket;        /* Radius rounded up to a power of two            */
+    char    opts[64];      /* Options part of the key                        */
+
+    for (bucket=1; bucket < rad; bucket*=2);
+    snprintf(opts, sizeof(opts), "%d\tm%d%d f%d r%d z%d", bucket, mask, mask_line, fixed, reverse, zero);
+
+    return(cpu_model+"\t"+std::string(opts));
+    }
+
+
+//
+// READ_TUNE() - Reads the engine table.  Each line is
+//
+//                 cpu  bucket  options  engine  t_full  t_r2c  t_pruned
+//
+//               (tab separated, times in seconds per radius).  Later lines
+//               replace earlier ones with the same key.
+//
+// Arguments:
+//      file    - Name of the engine table
+//
+// Global Variables:
+//      tune_table
+//
+// Return Value: NONE
+//
+
+void    read_tune(const char *file)
+    {
+    char    line[512];     /* Line of the table                              */
+    char    *f[4];         /* Key fields and engine name                     */
+    char    *save;         /* strtok_r() state                               */
+    int     n;             /* Field counter                                  */
+    int     k;             /* Engine                                         */
+    FILE    *fp;           /* Table file pointer                             */
+
+    if ((fp=fopen(file,"r")) == NULL) return;
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+        {
+        if (line[0] == '#') continue;
+        for (n=0, f[0]=strtok_r(line, "\t\n", &save); (n < 3) && (f[n] != NULL); n++) f[n+1]=strtok_r(NULL, "\t\n", &save);
+        if ((n < 4) || (f[3] == NULL) || ((k=eng.find(f[3])) < 0)) continue;
+        tune_table[std::string(f[0])+"\t"+f[1]+"\t"+f[2]]=k;
+        }
+
+    fclose(fp);
+    }
+
+
+//
+// TUNE_RUN() - Runs one engine on one radius of the current item on the
+//              main thread (with the arrays of thread 0).
+//
+// Arguments:
+//      kind    - Engine
+//      rad     - Outer radius of the item
+//      radius  - Radius to calculate
+//      spec    - Receives a copy of the spectrum ((M_FIN+1)*DIM_RAD values)
+//      in, out - Arrays of thread 0
+//
+// Return Value:
+//      Time taken in seconds
+//
+
+double  tune_run(int kind, int rad, int radius, fftw_complex *spec, fftw_complex *in, fftw_complex *out)
+    {
+    int     r_first, r_last;   /* ln r steps kept for this annulus           */
+    double  t0=omp_get_wtime();    /* Start time                             */
+    fftw_complex    *s;    /* Spectrum from the engine                       */
+
+    annulus(rad, radius, &r_first, &r_last);
+    eng.clear(kind, in);
+    gather(kind, in, mat_node[node_of[0]], r_first, r_last, NULL);
+    s=eng.transform(kind, plan, in, out);
+    t0=omp_get_wtime()-t0;
+
+    memcpy(spec, s, (size_t)(M_FIN+1)*DIM_RAD*sizeof(fftw_complex));
+    return(t0);
+    }
+
+
+//
+// CHOOSE_ENGINE() - Picks the engine for the current item with -e auto.  The
+//                   engine table is used if it has the key of the item
+//                   (see tune_key()).  Otherwise every engine is timed on
+//                   TUNE_RADII radii spread over the item and the fastest
+//                   one that agrees with ENGINE_FULL within ENGINE_TOL is
+//                   used, and added to the table.  An engine from the table
+//                   is checked against ENGINE_FULL on one radius, and FULL
+//                   is used if it does not agree.
+//
+// Arguments:
+//      rad     - Outer radius of the item
+//      in, out - Arrays of thread 0
+//
+// Global Variables:
+//      rad_list, tune_table, tunefile, eng_how, eng_err
+//
+// Return Value:
+//      Engine for the item
+//
+
+int     choose_engine(int rad, fftw_complex *in, fftw_complex *out)
+    {
+    int         k;         /* Engine                                         */
+    int         n;         /* Radius sample counter                          */
+    int         best=ENGINE_FULL;  /* Fastest engine that agrees             */
+    int         ns;        /* Number of radii timed                          */
+    int         fd;        /* Table file descriptor                          */
+    double      t[ENGINE_COUNT];   /* Time per engine                        */
+    double      err;       /* Difference from ENGINE_FULL                    */
+    char        line[512]; /* Table line                                     */
+    fftw_complex    *ref;  /* Spectra of ENGINE_FULL                         */
+    fftw_complex    *spec; /* Spectrum of the engine checked                 */
+    std::string key=tune_key(rad);
+    std::map<std::string,int>::iterator  e=tune_table.find(key);
+
+    eng_err=0.0;
+    if (rad_list.size() == 0) return(ENGINE_FULL);
+
+    ns=(e != tune_table.end()) ? 1 : std::min((int)rad_list.size(), TUNE_RADII);
+
+    ref=(fftw_complex *) fftw_malloc((size_t)(ns+1)*(M_FIN+1)*DIM_RAD*sizeof(fftw_complex));
+    if (ref == NULL) return(ENGINE_FULL);
+    spec=ref+(size_t)ns*(M_FIN+1)*DIM_RAD;
+
+//
+// Reference spectra (radii spread evenly over the item)
+//
+
+    t[ENGINE_FULL]=0.0;
+    for (n=0; n < ns; n++) t[ENGINE_FULL]+=tune_run(ENGINE_FULL, rad, rad_list[(rad_list.size()-1)*(2*n+1)/(2*ns)], ref+(size_t)n*(M_FIN+1)*DIM_RAD, in, out);
+
+    if (e != tune_table.end())
+        {
+//
+// Engine from the table - check it on one radius
+//
+
+        best=e->second;
+        eng_how="table";
+        if (best != ENGINE_FULL)
+            {
+            if (eng.build(best, in, out))
+                {
+                best=ENGINE_FULL;
+                }
+            else
+                {
+                tune_run(best, rad, rad_list[(rad_list.size()-1)/2], spec, in, out);
+                if ((eng_err=eng.compare(spec, ref)) > ENGINE_TOL)
+                    {
+                    printf("WARNING: Engine %s Differs From full by %g...Using full\n",eng.name(best),eng_err);
+                    best=ENGINE_FULL;
+                    eng_how="verify";
+                    }
+                }
+            }
+        fftw_free(ref);
+        return(best);
+        }
+
+//
+// Time the other engines on the same radii
+//
+
+    for (k=ENGINE_FULL+1; k < ENGINE_COUNT; k++)
+        {
+        t[k]=HUGE_VAL;
+        if (eng.build(k, in, out)) continue;
+
+        t[k]=0.0;
+        err=0.0;
+        for (n=0; n < ns; n++)
+            {
+            t[k]+=tune_run(k, rad, rad_list[(rad_list.size()-1)*(2*n+1)/(2*ns)], spec, in, out);
+            err=std::max(err, eng.compare(spec, ref+(size_t)n*(M_FIN+1)*DIM_RAD));
+            }
+
+        if (verbose) printf("--- engine %-6s %9.4f s/radius  difference %g\n",eng.name(k),t[k]/ns,err);
+
+        if (err > ENGINE_TOL)
+            {
+            printf("WARNING: Engine %s Differs From full by %g...Not Used\n",eng.name(k),err);
+            t[k]=HUGE_VAL;
+            continue;
+            }
+        if (t[k] < t[best])
+            {
+            best=k;
+            eng_err=err;
+            }
+        }
+
+    fftw_free(ref);
+    eng_how="tuned";
+    tune_table[key]=best;
+
+//
+// Add the decision to the table (shared with other processes, so append it
+//   while holding a lock on the file)
+//
+
+    if (tunefile[0] && ((fd=open(tunefile, O_CREAT|O_WRONLY|O_APPEND, 0644)) >= 0))
+        {
+        snprintf(line, sizeof(line), "%s\t%s\t%.6f\t%.6f\t%.6f\n", key.c_str(), eng.name(best), t[ENGINE_FULL]/ns, t[ENGINE_R2C]/ns, t[ENGINE_PRUNED]/ns);
+        flock(fd, LOCK_EX);
+        if (write(fd, line, strlen(line)) < 0) printf("WARNING: Can't Write Engine Table %s\n",tunefile);
+        flock(fd, LOCK_UN);
+        close(fd);
+        }
+
+    return(best);
+    }
+
+
+//
+// CATALOG_ORDER() - Sort comparison for catalog entries.  Entries are ordered
+//                   by the lowest mosaic row they need so the strip of rows
+//                   in memory only has to move forward through the mosaic.
+//
+// Arguments:
+//      a, b    - file_rec entries to compare
+//
+// Return Value:
+//      true if a needs to be processed before b
+//
+
+bool    catalog_order(const file_rec &a, const file_rec &b)
+    {
+    if ((a.y_ctr-a.radius) != (b.y_ctr-b.radius)) return((a.y_ctr-a.radius) < (b.y_ctr-b.radius));
+    return(a.x_ctr < b.x_ctr);
+    }
+
+
+//
+// ITEM_OPTIONS() - Fills in the per item options that were not given in the
+//                  input file with the command line values and checks them.
+//
+// Arguments:
+//      f       - Pointer to the file_rec to fill in
+//
+// Global Variables:
+//      mask, mask_line, fixed, reverse, high_pass, zero (command line)
+//
+// Return Value: NONE
+//
+
+void    item_options(file_rec *f)
+    {
+    if (f->mask < 0) f->mask=mask_line ? 2 : (mask ? 1 : 0);
+    if (f->reverse < 0) f->reverse=reverse;
+    if (f->highpass < 0) f->highpass=high_pass;
+    if (f->zero < 0) f->zero=zero;
+
+    if ((f->fixed > 0) && ((f->fixed > MAX_WINDOW) || (f->fixed < MIN_WINDOW)))
+        {
+        printf("WARNING: %s Window Size Must Be Between %d and %d...Using %d\n",f->name.c_str(),MIN_WINDOW,MAX_WINDOW,fixed);
+        f->fixed=-1;
+        }
+    if (f->fixed < 0) f->fixed=fixed;
+
+    if (f->fixed && f->reverse)
+        {
+        printf("WARNING: %s Cannot Use reverse and fixed...Ignoring reverse\n",f->name.c_str());
+        f->reverse=0;
+        }
+    }
+
+
+//
+// COST_ORDER() - Sort comparison for -o|--order.  The cost of an item is
+//                mostly one FFT per radius, so items with a larger radius
+//                go first.  Items with the same radius are ordered by the
+//                number of pixels that have to be read.
+//
+// Arguments:
+//      a, b    - file_rec entries to compare
+//
+// Return Value:
+//      true if a needs to be processed before b
+//
+
+bool    cost_order(const file_rec &a, const file_rec &b)
+    {
+    if (a.radius != b.radius) return(a.radius > b.radius);
+    return((long)a.xnum*a.ynum > (long)b.xnum*b.ynum);
+    }
+
+
+//
+// LOAD_REGION() - Copies the region of the mosaic for a catalog entry into
+//                 the mat 2D Cartesian array.  Rows are read from the mosaic
+//                 with fits_read_strip() only if they are not already in
+//                 strip[].  Rows still needed are kept (moved to the start
+//                 of strip[]) so neighboring regions share them.  Pixels
+//                 outside the mosaic are set to zero.
+//
+// Globals:
+//      mat, strip, strip_lo, strip_hi, mos_p, mos_x, mos_y, x_dim, y_dim
+//
+// Arguments:
+//      f       - Catalog entry (file_rec) to be loaded
+//
+// Return Value:
+//      0 on success, -1 if the region could not be read
+//
+
+int     load_region(file_rec *f)
+    {
+    int     row, col;      /* Mosaic row and column (FITS, 1 based)          */
+    int     keep;          /* Number of rows reused from strip[]             */
+    int     need_lo;       /* First mosaic row needed for this region        */
+    int     need_hi;       /* Last mosaic row needed for this region         */
+
+    need_lo=std::max(f->y_ctr-f->radius, 1);
+    need_hi=std::min(f->y_ctr+f->radius, mos_y);
+
+    if ((need_lo > need_hi) || (f->x_ctr+f->radius < 1) || (f->x_ctr-f->radius > mos_x))
+        {
+        printf("WARNING: Region %d,%d is outside of the mosaic\n",f->x_ctr,f->y_ctr);
+        return(-1);
+        }
+
+    if ((need_lo < strip_lo) || (need_lo > strip_hi))
+        {
+//
+// Nothing in memory can be used, so read the whole strip
+//
+
+        if (ast.fits_read_strip(mos_p, mos_x, need_lo, need_hi, strip)) return(-1);
+        strip_rows+=need_hi-need_lo+1;
+        strip_lo=need_lo;
+        strip_hi=need_hi;
+        }
+    else
+        {
+//
+// Slide the strip forward and only read the rows that are missing
+//
+
+        keep=strip_hi-need_lo+1;
+        if (need_lo > strip_lo) memmove(strip, strip+(long)(need_lo-strip_lo)*mos_x, (size_t)keep*mos_x*sizeof(float));
+        strip_lo=need_lo;
+
+        if (need_hi > strip_hi)
+            {
+            if (ast.fits_read_strip(mos_p, mos_x, strip_hi+1, need_hi, strip+(long)keep*mos_x)) return(-1);
+            strip_rows+=need_hi-strip_hi;
+            strip_hi=need_hi;
+            }
+        }
+
+//
+// Copy the region into mat using the same [x][y] sense as the file readers
+//
+
+    x_dim=(f->radius*2)+1;
+    y_dim=(f->radius*2)+1;
+
+    for (j=1; j<=y_dim; j++)
+        {
+        row=f->y_ctr-f->radius+j-1;
+        for (i=1; i<=x_dim; i++)
+            {
+            col=f->x_ctr-f->radius+i-1;
+            if ((row < strip_lo) || (row > strip_hi) || (col < 1) || (col > mos_x))
+                {
+                mat[i][j]=0.0;
+                }
+            else
+                {
+                mat[i][j]=strip[(long)(row-strip_lo)*mos_x+(col-1)];
+                }
+            }
+        }
+
+    if (verbose) printf("--- region %d,%d radius %d (mosaic rows %d-%d in memory)\n",f->x_ctr,f->y_ctr,f->radius,strip_lo,strip_hi);
+
+    return(0);
+    }
+
+
+//
+// RING_ITEM() - Returns true if an item is read through the read ahead ring.
+//               Mosaic regions and planes of cubes/MEF files are read in
+//               the main loop through their own open file handles.
+//
+// Arguments:
+//      n       - Index of the item in items
+//
+// Return Value:
+//      true if the item goes through the ring
+//
+
+bool    ring_item(unsigned int n)
+    {
+    return(!items[n].region && !items[n].hdu);
+    }
+
+
+//
+// CLAIM_NAME() - Builds the name of the queue file of an item.  The file is
+//                named from the result name (with / changed to _) so every
+//                worker using the same manifest uses the same name.
+//
+// Arguments:
+//      n       - Index of the item in items
+//      ext     - File extension ("claim" or "done")
+//      buf     - Receives the name (PATH_MAX bytes)
+//
+// Return Value:
+//      buf
+//
+
+char    *claim_name(unsigned int n, const char *ext, char *buf)
+    {
+    std::string key=items[n].result;
+
+    std::replace(key.begin(), key.end(), '/', '_');
+    snprintf(buf, PATH_MAX, "%s/%s.%s", qdir, key.c_str(), ext);
+    return(buf);
+    }
+
+
+//
+// TRY_CLAIM() - Tries to claim an item in the work queue directory.  A claim
+//               is a <result>.claim file created with O_EXCL, which only
+//               one worker can do, and it becomes <result>.done when the
+//               item is finished.  A claim that has not been touched for
+//               QUEUE_STALE seconds belongs to a worker that died and is
+//               taken over.  Taking over is done while holding a flock() on
+//               <dir>/lock so only one worker can remove a stale claim.
+//
+// Arguments:
+//      n       - Index of the item in items
+//
+// Return Value:
+//      1 - Item claimed by this worker
+//      0 - Item is claimed or done by another worker
+//
+
+int     try_claim(unsigned int n)
+    {
+    int         fd;        /* Claim file descriptor                          */
+    int         lf;        /* Queue lock file descriptor                     */
+    char        cname[PATH_MAX]; /* Claim file name                          */
+    char        dname[PATH_MAX]; /* Done file name                           */
+    char        lname[PATH_MAX]; /* Queue lock file name                     */
+    char        line[128]; /* Claim record                                   */
+    struct stat st;        /* Claim file status                              */
+
+    claim_name(n, "claim", cname);
+    claim_name(n, "done", dname);
+
+    if (ast.file_exists(dname)) return(0);
+
+    if ((fd=open(cname, O_CREAT|O_EXCL|O_WRONLY, 0644)) < 0)
+        {
+        if (errno != EEXIST)
+            {
+            printf("WARNING: Can't Create Claim %s (%s)\n",cname,strerror(errno));
+            return(0);
+            }
+
+        if (stat(cname, &st) || (time(NULL)-st.st_mtime < QUEUE_STALE)) return(0);
+
+        snprintf(lname, sizeof(lname), "%s/lock", qdir);
+        if ((lf=open(lname, O_CREAT|O_RDWR, 0644)) < 0) return(0);
+        flock(lf, LOCK_EX);
+
+        if (!stat(cname, &st) && (time(NULL)-st.st_mtime >= QUEUE_STALE) && !ast.file_exists(dname))
+            {
+            printf("Taking over stale claim %s\n",cname);
+            unlink(cname);
+            fd=open(cname, O_CREAT|O_EXCL|O_WRONLY, 0644);
+            }
+
+        flock(lf, LOCK_UN);
+        close(lf);
+        if (fd < 0) return(0);
+        }
+
+    snprintf(line, sizeof(line), "%s %d %ld\n", host, (int)getpid(), (long)time(NULL));
+    if (write(fd, line, strlen(line)) < 0) printf("WARNING: Can't Write Claim %s\n",cname);
+    close(fd);
+
+//
+// The item may have been finished between the check above and the claim
+//
+
+    if (ast.file_exists(dname))
+        {
+        unlink(cname);
+        return(0);
+        }
+
+    return(1);
+    }
+
+
+//
+// WANT_ITEM() - Returns true if this worker processes an item.  Without
+//               -q|--queue every item is processed.  With a queue the item
+//               is claimed the first time it is asked for, by either the
+//               main loop or the read ahead thread, and the answer is kept
+//               so both skip the same items.
+//
+// Arguments:
+//      n       - Index of the item in items
+//
+// Global Variables:
+//      claim, claim_lock, queue
+//
+// Return Value:
+//      true if the item is processed by this worker
+//
+
+bool    want_item(unsigned int n)
+    {
+    bool    mine;          /* Item belongs to this worker                    */
+
+    if (!queue) return(true);
+
+    pthread_mutex_lock(&claim_lock);
+    if (claim[n] == 0) claim[n]=try_claim(n) ? 1 : 2;
+    mine=(claim[n] != 2);
+    pthread_mutex_unlock(&claim_lock);
+
+    return(mine);
+    }
+
+
+//
+// WATCH_NAME() - Returns true if a file in the hot folder looks like a FITS
+//                image by its name.  The outputs written next to the images
+//                (<result>_m<n>, the markers) and hidden or temporary files
+//                of the programs copying images in are not taken.
+//
+// Arguments:
+//      name    - File name (without the directory)
+//
+// Return Value:
+//      true if the file is a candidate image
+//
+
+bool    watch_name(const char *name)
+    {
+    int         k;         /* Index of the extension                         */
+    size_t      n=strlen(name);  /* Length of the name                       */
+    const char  *ext[]={".fits", ".fit", ".fts", ".fz", ".fits.gz", ".fit.gz", ".fts.gz", NULL};
+
+    if (name[0] == '.') return(false);
+
+    for (k=0; ext[k] != NULL; k++)
+        {
+        if ((n > strlen(ext[k])) && !strcasecmp(name+n-strlen(ext[k]), ext[k])) return(true);
+        }
+
+    return(false);
+    }
+
+
+//
+// WATCH_MARKED() - Returns true if an image in the hot folder already has a
+//                  completion marker (<file>.done) at least as new as the
+//                  image.  An image that is copied in again is processed
+//                  again.
+//
+// Arguments:
+//      name    - Path of the image
+//
+// Return Value:
+//      true if the image was processed since it was last written
+//
+
+bool    watch_marked(const std::string &name)
+    {
+    struct stat fs;        /* Image file status                              */
+    struct stat ms;        /* Marker file status                             */
+
+    if (stat(name.c_str(), &fs) || stat((name+".done").c_str(), &ms)) return(false);
+    return(ms.st_mtime >= fs.st_mtime);
+    }
+
+
+//
+// WATCH_REC() - Fills in the file_rec of an image in the hot folder the same
+//               way as for a command line argument
+//
+// Arguments:
+//      name    - Path of the image
+//      f       - Pointer to the file_rec to fill in
+//
+// Return Value:
+//      0 - Binary FITS image
+//     -1 - Not a FITS image (or not readable yet)
+//
+
+int     watch_rec(const std::string &name, file_rec *f)
+    {
+    f->name=name;
+    f->result=remove_extension(f->name);
+    f->keyword="outi";
+    f->radius=-1;
+    f->valid=0;
+
+    if ((f->binary=ast.file_type(f->name)) != ASTRO_BIN_FILE) return(-1);
+    return(0);
+    }
+
+
+//
+// WATCH_ADD() - Adds an image that arrived in the hot folder to the end of
+//               items while the run goes on.  Cubes and multi-extension
+//               files become one item per plane as usual.  The read ahead
+//               thread and the heartbeat thread look at items, so the list
+//               is only grown while holding items_lock and claim_lock, and
+//               the read ahead thread is woken up.  An image that is
+//               already waiting to be processed is not added twice.
+//
+// Arguments:
+//      name    - Path of the image
+//
+// Global Variables:
+//      items, claim, it (next item of the main loop)
+//
+// Return Value:
+//      Number of items added
+//
+
+int     watch_add(const std::string &name)
+    {
+    unsigned int            k;   /* Item index                               */
+    file_rec                f;   /* Entry for the image                      */
+    std::vector<file_rec>   add; /* Items of the image                       */
+
+    for (k=it; k < items.size(); k++)
+        {
+        if (items[k].name == name) return(0);
+        }
+
+    if (watch_rec(name, &f))
+        {
+        if (warn) printf("WARNING: %s Is Not a Binary FITS Image...Skipping\n",name.c_str());
+        return(0);
+        }
+
+    add.push_back(f);
+    ast.fits_expand(&add);
+    for (k=0; k < add.size(); k++) item_options(&add[k]);
+
+    pthread_mutex_lock(&items_lock);
+    pthread_mutex_lock(&claim_lock);
+    items.insert(items.end(), add.begin(), add.end());
+    if (queue) claim.resize(items.size(), 0);
+    pthread_mutex_unlock(&claim_lock);
+    pthread_cond_broadcast(&items_cond);
+    pthread_mutex_unlock(&items_lock);
+
+    if (verbose) printf("Queued %s (%u item(s), %u waiting)\n",name.c_str(),(unsigned int)add.size(),(unsigned int)(items.size()-it));
+    return((int)add.size());
+    }
+
+
+//
+// WATCH_SCAN() - Adds the images in the hot folder that have no completion
+//                marker.  This picks up what arrived while p2dfft was not
+//                running, and is done again if the kernel dropped events.
+//                The images are taken in name order.
+//
+// Arguments:
+//      start   - 1 for the scan before processing starts (the entries are
+//                only put in items, main() expands them), 0 while running
+//
+// Global Variables:
+//      wdir, items
+//
+// Return Value:
+//      Number of images found
+//
+
+int     watch_scan(int start)
+    {
+    unsigned int                k;      /* Name index                        */
+    DIR                         *dp;    /* Hot folder                        */
+    struct dirent               *de;    /* Directory entry                   */
+    struct stat                 st;     /* File status                       */
+    std::string                 path;   /* Path of the image                 */
+    std::vector<std::string>    names;  /* Images to add                     */
+
+    if ((dp=opendir(wdir)) == NULL)
+        {
+        printf("WARNING: Can't Read Hot Folder %s (%s)\n",wdir,strerror(errno));
+        return(0);
+        }
+
+    while ((de=readdir(dp)) != NULL)
+        {
+        if (!watch_name(de->d_name)) continue;
+        path=std::string(wdir)+"/"+de->d_name;
+        if (stat(path.c_str(), &st) || !S_ISREG(st.st_mode) || watch_marked(path)) continue;
+        names.push_back(path);
+        }
+
+    closedir(dp);
+    std::sort(names.begin(), names.end());
+
+    for (k=0; k < names.size(); k++)
+        {
+        if (start)
+            {
+            file_rec    f;
+
+            if (!watch_rec(names[k], &f)) items.push_back(f);
+            }
+        else
+            {
+            watch_add(names[k]);
+            }
+        }
+
+    return((int)names.size());
+    }
+
+
+//
+// WATCH_SIGNAL() - Signal handler for SIGINT and SIGTERM with -W|--watch.
+//                  The item being processed is finished and the run ends
+//                  normally.
+//
+// Arguments:
+//      sig     - Signal number (not used, both signals stop the watch)
+//
+// Return Value: NONE
+//
+
+void    watch_signal(int sig)
+    {
+    (void) sig;
+    watch_stop=1;
+    }
+
+
+//
+// WATCH_START() - Starts watching the hot folder for -W|--watch.  Images are
+//                 taken when they are closed after writing (IN_CLOSE_WRITE)
+//                 or renamed into the folder (IN_MOVED_TO), so an image is
+//                 never read while it is still being copied.  The watch is
+//                 set up before the folder is scanned, so nothing arriving
+//                 in between is missed.
+//
+// Arguments: NONE
+//
+// Global Variables:
+//      wdir, watch_fd
+//
+// Return Value:
+//      0 - Watching
+//     -1 - The folder can't be watched
+//
+
+int     watch_start()
+    {
+    struct sigaction    sa;    /* Signal action for SIGINT/SIGTERM          */
+
+#ifdef __linux__
+    if ((watch_fd=inotify_init1(IN_NONBLOCK|IN_CLOEXEC)) < 0) return(-1);
+    if (inotify_add_watch(watch_fd, wdir, IN_CLOSE_WRITE|IN_MOVED_TO|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR) < 0)
+        {
+        close(watch_fd);
+        watch_fd=-1;
+        return(-1);
+        }
+#else
+    errno=ENOSYS;
+    return(-1);
+#endif
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler=watch_signal;
+    sa.sa_flags=SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    watch_scan(1);
+    return(0);
+    }
+
+
+//
+// WATCH_EVENTS() - Reads the events of the hot folder and adds the images
+//                  that arrived.  When block is set it waits (checking for
+//                  a signal every WATCH_POLL ms) until at least one item is
+//                  added or the watch is stopped.
+//
+// Arguments:
+//      block   - 1 to wait for an image, 0 to only take what is there
+//
+// Global Variables:
+//      watch_fd, watch_stop, wdir
+//
+// Return Value: NONE
+//
+
+void    watch_events(int block)
+    {
+#ifdef __linux__
+    int             added=0;   /* Items added                                */
+    ssize_t         len;       /* Bytes of events read                       */
+    char            *p;        /* Event being looked at                      */
+    struct pollfd   pfd;       /* Poll descriptor for the inotify fd         */
+    struct inotify_event    *ev;   /* Event                                  */
+    char            buf[16384] __attribute__((aligned(__alignof__(struct inotify_event)))); /* Event buffer */
+
+    if (block)
+        {
+        printf("Waiting for images in %s\n",wdir);
+        fflush(stdout);
+        }
+
+    pfd.fd=watch_fd;
+    pfd.events=POLLIN;
+
+    while (!watch_stop)
+        {
+        pfd.revents=0;
+        if (poll(&pfd, 1, block ? WATCH_POLL : 0) <= 0)
+            {
+            if (!block) return;
+            continue;
+            }
+
+        while ((len=read(watch_fd, buf, sizeof(buf))) > 0)
+            {
+            for (p=buf; p < buf+len; p+=sizeof(struct inotify_event)+ev->len)
+                {
+                ev=(struct inotify_event *) p;
+
+                if (ev->mask & IN_Q_OVERFLOW)
+                    {
+                    printf("WARNING: Hot Folder Events Lost...Rescanning %s\n",wdir);
+                    added+=watch_scan(0);
+                    }
+                else if (ev->mask & (IN_DELETE_SELF|IN_MOVE_SELF|IN_IGNORED))
+                    {
+                    printf("WARNING: Hot Folder %s Was Removed...Stopping\n",wdir);
+                    watch_stop=1;
+                    }
+                else if (ev->len && !(ev->mask & IN_ISDIR) && watch_name(ev->name))
+                    {
+                    added+=watch_add(std::string(wdir)+"/"+ev->name);
+                    }
+                }
+            }
+
+        if (!block || added) return;
+        }
+#endif
+    }
+
+
+//
+// MORE_ITEMS() - Loop test of the main loop.  Without -W|--watch it is just
+//                n < items.size().  With -W the images that arrived are
+//                added first, and when all items are done it waits for the
+//                next image.  When the watch is stopped the read ahead
+//                thread is told there will be no more items.
+//
+// Arguments:
+//      n       - Index of the next item of the main loop
+//
+// Return Value:
+//      true if there is an item n to process
+//
+
+bool    more_items(unsigned int n)
+    {
+    if (!watch) return(n < items.size());
+
+    if (!watch_stop) watch_events(n >= items.size());
+    if (n < items.size()) return(true);
+
+    pthread_mutex_lock(&items_lock);
+    watch_done=1;
+    pthread_cond_broadcast(&items_cond);
+    pthread_mutex_unlock(&items_lock);
+
+    return(false);
+    }
+
+
+//
+// WAIT_ITEM() - Used by the read ahead thread to wait for item n.  Without
+//               -W|--watch there is no waiting.
+//
+// Arguments:
+//      n       - Index of the item
+//
+// Return Value:
+//      true if item n exists, false if there will be no more items
+//
+
+bool    wait_item(unsigned int n)
+    {
+    bool    more;          /* Item n exists                                  */
+
+    pthread_mutex_lock(&items_lock);
+    while (watch && !watch_done && (n >= items.size())) pthread_cond_wait(&items_cond, &items_lock);
+    more=(n < items.size());
+    pthread_mutex_unlock(&items_lock);
+
+    return(more);
+    }
+
+
+//
+// WATCH_MARK() - Writes the completion marker <file>.done of an image from
+//                the hot folder once its last item is finished.  The marker
+//                has one line
+//
+//                  ok|error host pid time
+//
+//                (error if any plane failed) and is written to a temporary
+//                name and renamed, so a pipeline waiting for it never sees
+//                it half written.
+//
+// Arguments:
+//      n       - Index of the item in items
+//      ok      - 1 if the item was processed, 0 if it failed
+//
+// Global Variables:
+//      watch_err
+//
+// Return Value: NONE
+//
+
+void    watch_mark(unsigned int n, int ok)
+    {
+    FILE        *fp;       /* Marker file pointer                            */
+    std::string mname;     /* Marker file name                               */
+
+    if (!ok) watch_err=1;
+    if ((n+1 < items.size()) && (items[n+1].name == items[n].name)) return;
+
+    mname=items[n].name+".done";
+    if ((fp=fopen((mname+".tmp").c_str(), "w")) == NULL)
+        {
+        printf("WARNING: Can't Write Marker %s\n",mname.c_str());
+        watch_err=0;
+        return;
+        }
+
+    fprintf(fp, "%s\t%s\t%d\t%ld\n", watch_err ? "error" : "ok", host, (int)getpid(), (long)time(NULL));
+    fclose(fp);
+
+    if (rename((mname+".tmp").c_str(), mname.c_str())) printf("WARNING: Can't Write Marker %s (%s)\n",mname.c_str(),strerror(errno));
+    watch_err=0;
+    }
+
+
+//
+// FINISH_ITEM() - Marks an item finished.  The claim becomes the done file
+//                 (rename() is atomic, so there is no time when neither
+//                 exists) and a line is appended to the summary file.  The
+//                 summary is shared by all workers, so the line is written
+//                 while holding a flock() on it.  The summary line is:
+//
+//                   result name radius status seconds host pid engine
+//
+//                 With -W|--watch the completion marker of the image is
+//                 written when its last item is finished, and an in memory
+//                 image is released then.
+//
+// Arguments:
+//      n       - Index of the item in items
+//      ok      - 1 if the item was processed, 0 if it failed
+//      secs    - Processing time in seconds
+//
+// Return Value: NONE
+//
+
+void    finish_item(unsigned int n, int ok, double secs)
+    {
+    int     fd;            /* Summary file descriptor                        */
+    char    cname[PATH_MAX]; /* Claim file name                              */
+    char    dname[PATH_MAX]; /* Done file name                               */
+    char    line[PATH_MAX+512]; /* Summary line                              */
+
+    if (queue)
+        {
+        pthread_mutex_lock(&claim_lock);
+        claim[n]=3;
+        pthread_mutex_unlock(&claim_lock);
+
+        if (rename(claim_name(n, "claim", cname), claim_name(n, "done", dname)))
+            printf("WARNING: Can't Mark %s Done (%s)\n",cname,strerror(errno));
+        }
+
+    if (watch) watch_mark(n, ok);
+
+//
+// An in memory image is released after its last item
+//
+
+    if (((n+1 >= items.size()) || (items[n+1].name != items[n].name)) && ast.mem_name(items[n].name.c_str()))
+        {
+        if (cube_p && (cube_name == items[n].name))
+            {
+            ast.fits_close(cube_p);
+            cube_p=NULL;
+            }
+        ast.mem_free(items[n].name.c_str());
+        }
+
+    if (!sumfile[0]) return;
+
+    if ((fd=open(sumfile, O_CREAT|O_WRONLY|O_APPEND, 0644)) < 0)
+        {
+        printf("WARNING: Can't Open Summary File %s\n",sumfile);
+        return;
+        }
+
+    snprintf(line, sizeof(line), "%s\t%s\t%d\t%s\t%.1f\t%s\t%d\t%s\n", items[n].result.c_str(), items[n].name.c_str(),
+             items[n].radius, ok ? "ok" : "error", secs, host, (int)getpid(), (eng_kind >= 0) ? eng.name(eng_kind) : "-");
+
+    flock(fd, LOCK_EX);
+    if (write(fd, line, strlen(line)) < 0) printf("WARNING: Can't Write Summary File %s\n",sumfile);
+    flock(fd, LOCK_UN);
+    close(fd);
+    }
+
+
+//
+// HEARTBEAT() - Thread that touches the claims of this worker every
+//               QUEUE_BEAT seconds so other workers do not take them over
+//               as stale while a long item is being processed.
+//
+// Arguments:
+//      arg     - Not used
+//
+// Return Value:
+//      NULL
+//
+
+void    *heartbeat(void *arg)
+    {
+    int             s;     /* Seconds since the last touch                   */
+    unsigned int    n;     /* Item index                                     */
+    char    cname[PATH_MAX]; /* Claim file name                              */
+
+    (void) arg;
+    while (!beat_stop)
+        {
+        for (s=0; (s < QUEUE_BEAT) && !beat_stop; s++) sleep(1);
+
+        pthread_mutex_lock(&claim_lock);
+        for (n=0; n < claim.size(); n++)
+            {
+            if (claim[n] == 1) utime(claim_name(n, "claim", cname), NULL);
+            }
+        pthread_mutex_unlock(&claim_lock);
+        }
+
+    return(NULL);
+    }
+
+
+//
+// READ_IMAGE() - Reads the image of one item (binary FITS or ASCII text
+//                FITS) into the buffer of a ring slot.  The buffer is only
+//                grown when an image does not fit, otherwise it is reused.
+//                This runs on the read ahead thread, so it does not change
+//                items and uses its own astro_class instance.
+//
+// Arguments:
+//      f        - Item to read
+//      a        - astro_class instance to use
+//      nthreads - Number of threads for tile decompression
+//      s        - Slot to receive the data and dimensions
+//
+// Return Value:
+//      0 - Image read
+//     -1 - Image could not be read
+//
+
+int     read_image(file_rec *f, astro *a, int nthreads, pre_slot *s)
+    {
+    int     i;             /* Number of values read                          */
+    int     st;            /* Return value for fscanf()                      */
+    float   *grow;         /* Resized buffer                                 */
+    FILE    *fp;           /* ASCII file pointer                             */
+
+    s->x=0;
+    s->y=0;
+
+    if (f->binary)
+        {
+//
+// It's a binary FITS file - Data will start at location 0
+//
+
+        if (a->fits_read_tiles((char *) f->name.c_str(), nthreads, &s->data, &s->cap, &s->x, &s->y, &s->size)) return(-1);
+        return(0);
+        }
+
+//
+// It's a ASCII FITS file -- IMPORTANT NOTE: These type of files must have
+//   two bytes for size information.  The bytes can be zero, but must be
+//   be there or the first two bytes of the data will be ignored and the
+//   alignment of the other data incorrect, which will lead to changes
+//   in the output values.
+//
+
+    if (verbose) puts("--- reading image");
+
+    if ((fp=fopen(f->name.c_str(),"r"))==NULL) return(-1);
+
+    if (s->cap < (long)MAX_DIM*MAX_DIM+1)
+        {
+        if ((grow=(float *) realloc(s->data, ((size_t)MAX_DIM*MAX_DIM+1)*sizeof(float))) == NULL)
+            {
+            printf("ERROR: malloc() failed for data array, Skipping...\n");
+            exit(1);
+            }
+        s->data=grow;
+        s->cap=(long)MAX_DIM*MAX_DIM+1;
+        }
+
+//
+// The values end at the end of the file or at the first text that is not a
+//   number (a short read of the image)
+//
+
+    i=0;
+    st=fscanf(fp,"%f",&s->data[i]);
+    if (st != 1)
+        {
+        fclose(fp);
+        return(-1);
+        }
+
+    do
+        {
+        i++;
+        if (i >= (MAX_DIM * MAX_DIM))
+            {
+            std::cout << "ERROR: File Exceeded Maximum Size " << f->name << std::endl;
+            exit(1);
+            }
+        } while((fscanf(fp,"%f",&s->data[i])) == 1);
+
+    fclose(fp);
+    i--;
+
+//
+// Try to read the size from the first two bytes
+//
+
+    if(s->data[0]==s->data[1] && s->data[0]>0.0 && s->data[1]>0.0)
+        {
+        s->x=s->data[0];
+        s->y=s->data[1];
+        if (verbose) printf("--- dimensions (read) : xdim=%d : ydim=%d\n",s->x,s->y);
+        }
+
+//
+//  If there were problems reading the size from the file, or the force read, 
+//    calculate the size
+//
+
+    if ((s->x == 0) || (s->y == 0))
+        {
+        s->x=sqrt(i-1);
+        s->y=sqrt(i-1);
+        if (verbose) printf("--- dimensions (not read) : xdim=%d : ydim=%d\n",s->x,s->y);
+        }
+
+    s->size=i;
+    return(0);
+    }
+
+
+//
+// READ_AHEAD() - Thread that reads the items into the ring of slots ahead of
+//                the main loop.  It waits when all PREFETCH_DEPTH slots are
+//                full.  The first image is decompressed with all threads
+//                since nothing else is running yet, the others with
+//                DECODE_THREADS so they do not take over the FFT threads.
+//                With -W|--watch items may be added while it runs, so it
+//                works on a copy of each entry and waits for new ones.
+//
+// Arguments:
+//      arg     - Not used
+//
+// Global Variables:
+//      ring, ring_lock, ring_cond, pre_ast, items, num
+//
+// Return Value:
+//      NULL
+//
+
+void    *read_ahead(void *arg)
+    {
+    int             s=0;   /* Slot being filled                              */
+    int             first=1; /* Flag for first image read                    */
+    bool            use;   /* Item goes through the ring                     */
+    unsigned int    n;     /* Item index                                     */
+    file_rec        f;     /* Copy of the item                               */
+
+    (void) arg;
+
+//
+// The main thread may be bound to one CPU, so let this thread (and the
+//   threads it starts to decompress images) use all of them
+//
+
+    if (bind) unpin_thread();
+
+    for (n=0; wait_item(n); n++)
+        {
+        pthread_mutex_lock(&items_lock);
+        use=ring_item(n);
+        f=items[n];
+        pthread_mutex_unlock(&items_lock);
+
+        if (!use || !want_item(n)) continue;
+
+        pthread_mutex_lock(&ring_lock);
+        while (ring[s].ready) pthread_cond_wait(&ring_cond, &ring_lock);
+        pthread_mutex_unlock(&ring_lock);
+
+        ring[s].item=(int) n;
+        ring[s].ok=!read_image(&f, &pre_ast, first ? num : DECODE_THREADS, &ring[s]);
+        first=0;
+
+        pthread_mutex_lock(&ring_lock);
+        ring[s].ready=1;
+        pthread_cond_broadcast(&ring_cond);
+        pthread_mutex_unlock(&ring_lock);
+
+        s=(s+1)%PREFETCH_DEPTH;
+        }
+
+    return(NULL);
+    }
+
+
+//
+// TAKE_SLOT() - Waits for the next slot of the ring to be filled and returns
+//               it.  The main loop takes the items in the same order the
+//               read ahead thread reads them.
+//
+// Arguments: NONE
+//
+// Return Value:
+//      Pointer to the filled slot
+//
+
+pre_slot    *take_slot()
+    {
+    pthread_mutex_lock(&ring_lock);
+    while (!ring[ring_next].ready) pthread_cond_wait(&ring_cond, &ring_lock);
+    pthread_mutex_unlock(&ring_lock);
+
+    return(&ring[ring_next]);
+    }
+
+
+//
+// RELEASE_SLOT() - Hands the slot taken with take_slot() back to the read
+//                  ahead thread once its image has been copied into mat.
+//
+// Arguments: NONE
+//
+// Return Value: NONE
+//
+
+void    release_slot()
+    {
+    pthread_mutex_lock(&ring_lock);
+    ring[ring_next].ready=0;
+    pthread_cond_broadcast(&ring_cond);
+    pthread_mutex_unlock(&ring_lock);
+
+    ring_next=(ring_next+1)%PREFETCH_DEPTH;
+    }
+
+
+//
+// READ_CALIBRATION() - Reads the cost model used by -E|--plan-only.  The file
+//                      is written by p2bench and has one "key value" pair
+//                      per line (# starts a comment).  Values not in the
+//                      file keep their built in defaults (see globals.h).
+//
+// Arguments:
+//      file    - Name of the calibration file
+//
+// Global Variables:
+//      calib
+//
+// Return Value:
+//      0 - File read
+//     -1 - File could not be opened
+//
+
+int     read_calibration(const char *file)
+    {
+    char    line[256];     /* Line from the calibration file                 */
+    char    key[128];      /* Key of the line                                */
+    double  val;           /* Value of the line                              */
+    FILE    *fp;           /* Calibration file pointer                       */
+
+    if ((fp=fopen(file,"r"))==NULL) return(-1);
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+        {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%127s %lf", key, &val) == 2) calib[std::string(key)]=val;
+        }
+
+    fclose(fp);
+    return(0);
+    }
+
+
+//
+// CAL() - Returns a value of the cost model
+//
+// Arguments:
+//      key     - Name of the value (e.g. "full.fft")
+//      def     - Value used when the calibration file does not have it
+//
+// Return Value:
+//      Calibrated value, or def
+//
+
+double  cal(const char *key, double def)
+    {
+    std::map<std::string,double>::iterator  m=calib.find(std::string(key));
+
+    return((m == calib.end()) ? def : m->second);
+    }
+
+
+//
+// PLAN_ITEM() - Works out the amount of work and output of one item from its
+//               header information, the same way the main loop chooses the
+//               radii and the polar samples of every annulus.  The polar
+//               table gives the exact number of samples, only the rows
+//               removed by a line mask (which needs the image) are counted.
+//
+// Arguments:
+//      f       - Item to estimate
+//      p       - Receives the counts for the item
+//
+// Return Value:
+//      0 - Estimate made
+//     -1 - Image size is not known without reading it (ASCII text files)
+//
+
+int     plan_item(file_rec *f, plan_cost *p)
+    {
+    int     rr;            /* Radius calculated by the main loop             */
+    int     xn, yn;        /* Image dimensions                               */
+    int     rad;           /* Outer radius of the item                       */
+    int     lo, hi;        /* Range of radii calculated                      */
+    int     rows;          /* Theta rows sampled for each radius             */
+    int     r_first;       /* First ln r step kept                           */
+    int     r_last;        /* Last ln r step kept                            */
+    int     modes=M_FIN-M_INI+1; /* Number of modes written                  */
+    float   lr, lit;       /* ln of the current and outer radius             */
+
+    memset(p, 0, sizeof(plan_cost));
+
+    if (f->region)
+        {
+        xn=(f->radius*2)+1;
+        yn=xn;
+        }
+    else if (f->binary && f->xnum && f->ynum)
+        {
+        xn=f->xnum;
+        yn=f->ynum;
+        }
+    else
+        {
+        return(-1);
+        }
+
+    rad=f->valid ? f->radius : (std::min(xn, yn)-1)/2;
+    if (f->x_ctr && !f->region) rad=std::min(rad, std::min(std::min(f->x_ctr-1, f->y_ctr-1), std::min(xn-f->x_ctr, yn-f->y_ctr)));
+
+    lo=(f->rmin > 0) ? f->rmin : 1;
+    hi=((f->rmax > 0) && (f->rmax < rad)) ? f->rmax+1 : rad;
+
+    rows=f->zero ? DIM_THT-6 : DIM_THT;
+    lit=log((double)rad);
+
+    for (rr=lo; rr < hi; rr++)
+        {
+        if (f->fixed && ((rr <= (f->fixed/2)) || (rr >= rad-(f->fixed/2)))) continue;
+
+        lr=f->reverse ? log((double)(rad-rr+1)) : log((double)rr);
+
+        if (f->reverse)
+            pol.rad_range(0.0, (lr < lit) ? lr : lit, &r_first, &r_last);
+        else if (f->fixed)
+            pol.rad_range(log((double)(rr-(f->fixed/2))), log((double)(rr+(f->fixed/2))), &r_first, &r_last);
+        else
+            pol.rad_range(lr, lit, &r_first, &r_last);
+
+        p->nrad++;
+        p->samples+=(double)rows*(r_last-r_first);
+        if (polar && (rr == 1)) p->pfile=1;
+        }
+
+//
+// Output: a .rip and a .dat file per radius and mode (lim frequencies, see
+//   the main loop for the formats), then the _m and _sum files per mode
+//
+
+    p->files=(long)p->nrad*modes*2+modes*2+p->pfile;
+    p->bytes=(double)p->nrad*modes*(PLAN_RIP_HDR+lim*(PLAN_RIP_LINE*2+PLAN_DAT_LINE));
+    p->bytes+=(double)modes*(rad*PLAN_M_LINE+lim*PLAN_SUM_LINE);
+    if (p->pfile) p->bytes+=(double)(((long)DIM_THT*DIM_RAD*sizeof(float)+2879)/2880+1)*2880;
+
+    p->pixels=(double)xn*yn;
+    p->compressed=f->compressed && !f->region;
+    return(0);
+    }
+
+
+//
+// ESTIMATE() - Prints the pre-flight estimate for -E|--plan-only.  Only the
+//              headers of the items are read.  The cost model (seconds per
+//              radius for the FFT engine, per polar sample, per pixel read
+//              and per output byte) comes from the calibration file written
+//              by p2bench, or the defaults in globals.h.  Wall times assume
+//              that the radii of an item are spread over the threads, the
+//              .rip/.dat writes are serialized (they are in a critical
+//              section) and reads are hidden behind the previous item when
+//              the read ahead thread can run.
+//
+// Global Variables:
+//      items, calfile, num, pol, polar, catalog, mos_x
+//
+// Return Value: NONE
+//
+
+void    estimate()
+    {
+    int         n;         /* Thread count for the wall time table           */
+    int         zt;        /* Threads decompressing an image                 */
+    int         ahead;     /* Flag that images are read ahead                */
+    int         skipped=0; /* Items that could not be sized                  */
+    long        files=0;   /* Output files                                   */
+    double      cpu=0.0;   /* Total CPU seconds                              */
+    double      bytes=0.0; /* Output bytes                                   */
+    double      wall;      /* Wall seconds at n threads                      */
+    double      comp;      /* Compute wall seconds of an item                */
+    double      rd;        /* Read wall seconds of an item                   */
+    double      prev;      /* Compute wall seconds of the previous item      */
+    double      max_pix=0; /* Largest image read through the ring            */
+    double      max_pln=0; /* Largest cube plane (arena)                     */
+    double      rss;       /* Peak resident memory                           */
+    double      t_fft, t_smp, t_pix, t_zpix, t_byte;
+    int         k;         /* Engine estimated                               */
+    char        key[64];   /* Cost model key                                 */
+    const char  *src;      /* Where the cost model came from                 */
+    plan_cost   pc;        /* Counts for one item                            */
+
+    std::vector <plan_cost> cost;
+
+//
+// Cost model
+//
+
+    if (calfile[0])
+        {
+        if (read_calibration(calfile))
+            {
+            printf("ERROR: Can't Read Calibration File %s...Exiting\n",calfile);
+            exit(-1);
+            }
+        src=calfile;
+        }
+    else if (!read_calibration(CAL_FILE))
+        {
+        src=CAL_FILE;
+        }
+#ifdef BIN_DIR
+    else if (!read_calibration(BIN_DIR "/" CAL_FILE))
+        {
+        src=BIN_DIR "/" CAL_FILE;
+        }
+#endif
+    else
+        {
+        src="built in defaults";
+        }
+
+//
+// The engine given with -e (-e auto is estimated as full)
+//
+
+    k=(eng_opt > ENGINE_FULL) ? eng_opt : ENGINE_FULL;
+    snprintf(key, sizeof(key), "%s.fft", eng.name(k));
+    t_fft=cal(key, (k == ENGINE_PRUNED) ? CAL_PRUNED_FFT : ((k == ENGINE_R2C) ? CAL_R2C_FFT : CAL_FFT));
+    snprintf(key, sizeof(key), "%s.sample", eng.name(k));
+    t_smp=cal(key, (k == ENGINE_PRUNED) ? CAL_PRUNED_SAMPLE : CAL_SAMPLE);
+    t_pix=cal("read.pixel", CAL_PIXEL);
+    t_zpix=cal("read.compressed", CAL_ZPIXEL);
+    t_byte=cal("write.byte", CAL_BYTE);
+
+    if (pol.build())
+        {
+        printf("ERROR: Memory allocation failed while building polar table\n");
+        exit(-1);
+        }
+
+//
+// Read the headers of the items that were not prescanned (command line and
+//   standard input).  In memory images are loaded one at a time first (see
+//   astro::prescan()), then each thread reads file headers with its own
+//   astro instance.
+//
+
+    for (it=0; it < items.size(); it++)
+        {
+        if (items[it].binary && !items[it].region && !items[it].xnum && ast.mem_name(items[it].name.c_str())) ast.fits_meta(&items[it]);
+        }
+
+#pragma omp parallel for schedule(dynamic) if (fits_is_reentrant())
+    for (int ix=0; ix < (int)items.size(); ix++)
+        {
+        astro   hdr;       /* astro_class instance of this thread            */
+
+        if (items[ix].binary && !items[ix].region && !items[ix].xnum && !hdr.mem_name(items[ix].name.c_str())) hdr.fits_meta(&items[ix]);
+        }
+
+//
+// Count the work and output of every item
+//
+
+    for (it=0; it < items.size(); it++)
+        {
+        if (plan_item(&items[it], &pc))
+            {
+            if (verbose) std::cout << "Not Estimated (size unknown until read): " << items[it].name << std::endl;
+            skipped++;
+            pc.pixels=(double)MAX_DIM*MAX_DIM;
+            }
+        else
+            {
+            pc.t_read=pc.pixels*(pc.compressed ? t_zpix : t_pix);
+            pc.t_comp=pc.nrad*t_fft+pc.samples*t_smp;
+            pc.t_write=pc.bytes*t_byte;
+            cpu+=pc.t_read+pc.t_comp+pc.t_write;
+            files+=pc.files;
+            bytes+=pc.bytes;
+            }
+
+        if (ring_item(it)) max_pix=std::max(max_pix, pc.pixels);
+        else if (items[it].hdu) max_pln=std::max(max_pln, pc.pixels);
+
+        pc.ring=ring_item(it);
+        cost.push_back(pc);
+
+        if (verbose) printf("  %-40s radii %5d  samples %12.0f  cpu %9.2f s  out %10.0f bytes\n",items[it].name.c_str(),pc.nrad,pc.samples,pc.t_read+pc.t_comp+pc.t_write,pc.bytes);
+        }
+
+    ahead=fits_is_reentrant();
+
+    printf("-------------------------------\n");
+    printf("Plan Only (cost model: %s)\n",src);
+    printf("Items                        %u\n",(unsigned int)items.size());
+    if (skipped) printf("Items not estimated          %d (ASCII text, size unknown)\n",skipped);
+    printf("Total CPU time               %.1f s\n",cpu);
+
+//
+// Wall time for 1, 2, 4, ... threads up to the threads of this machine
+//
+
+    for (n=1; ; n=(n*2 < num) ? n*2 : num)
+        {
+        wall=0.0;
+        prev=0.0;
+        for (it=0; it < cost.size(); it++)
+            {
+            if (cost[it].nrad == 0) continue;
+
+            comp=(cost[it].nrad/n)*t_fft+cost[it].samples*t_smp/std::min(n, cost[it].nrad);
+            if (cost[it].nrad%n) comp+=t_fft/(latency ? split_threads(n, cost[it].nrad%n) : 1);
+            comp=std::max(comp, cost[it].t_write);
+
+            zt=(ahead && (it > 0)) ? std::min(DECODE_THREADS, n) : n;
+            rd=cost[it].compressed ? cost[it].t_read/zt : cost[it].t_read;
+            if (ahead && cost[it].ring) rd-=std::min(rd, prev);
+
+            wall+=rd+comp;
+            prev=comp;
+            }
+        printf("Wall time at %3d threads     %.1f s\n",n,wall);
+        if (n >= num) break;
+        }
+
+//
+// Peak memory: mat, FFT buffers per thread, polar table, read ahead ring
+//   (or the single slot), arena, mosaic strip and the result arrays
+//
+
+    rss=(double)MAX_DIM*MAX_DIM*sizeof(float);
+    rss+=(double)num*(2.0*(DIM_RAD*DIM_THT+1)*sizeof(fftw_complex)+(DIM_RAD+2)*sizeof(struct fft_out));
+    rss+=(double)DIM_THT*pol.n_rad*2*sizeof(int)+DIM_RAD*sizeof(float);
+    rss+=(ahead ? PREFETCH_DEPTH : 1)*max_pix*sizeof(float);
+    rss+=max_pln*sizeof(float);
+    rss+=sizeof(mode_data);
+    if (polar) rss+=(double)(DIM_RAD*DIM_THT+1)*sizeof(float);
+    if (catalog) rss+=(double)mos_x*MAX_DIM*sizeof(float);
+    if (bind) rss+=(double)(std::min(n_nodes, num)-1)*MAX_DIM*MAX_DIM*sizeof(float);
+
+    printf("Peak memory                  %.0f MB (%d threads)\n",rss/1048576.0,num);
+    printf("Output files                 %ld\n",files);
+    printf("Output size                  %.1f MB\n",bytes/1048576.0);
+    }
+
+
+//
+// MAIN() CODE BLOCK
+//
+
+int main(int argc, char **argv)
+    {
+//
+// Parse the command line options, if any, and set the flags associated
+//   with the options
+//
+
+    static struct option long_options[] =
+        {
+        {"data", no_argument,        0, 'd'},
+        {"polar", no_argument,       0, 'p'},
+        {"zero",  no_argument,       0, 'z'},
+        {"warning", no_argument,     0, 'w'},
+        {"verbose", no_argument,     0, 'v'},
+        {"reverse", no_argument,     0, 'r'},
+        {"highpass", no_argument,    0, 'h'},
+        {"order", no_argument,       0, 'o'},
+        {"plan-only", optional_argument, 0, 'E'},
+        {"shard", required_argument, 0, 's'},
+        {"bind", required_argument, 0, 'b'},
+        {"latency", no_argument,     0, 'l'},
+        {"cpu-report", no_argument,  0, 'C'},
+        {"engine", required_argument, 0, 'e'},
+        {"badpix", required_argument, 0, 'B'},
+        {"watch", required_argument, 0, 'W'},
+        {"compress", required_argument, 0, 'Z'},
+        {"queue", required_argument, 0, 'q'},
+        {"summary", required_argument, 0, 'u'},
+        /* These options require an argument. */
+        {"mask",  optional_argument, 0, 'm'},
+        {"fixed", optional_argument, 0, 'f'},
+        {"input", optional_argument, 0, 'i'},
+        {"catalog", required_argument, 0, 'c'},
+        {0, 0, 0, 0}
+        };
+
+    int option_index = 0;
+
+    while ((c = getopt_long (argc, argv, "pzwvrhoCE::lm:f:i:c:s:q:u:b:e:B:W:Z:", long_options, &option_index)
+) != -1)
+        {
+        switch (c)
+            {
+            case 'p':
+                {
+                polar = 1;
+                break;
+                }
+            case 'z':
+                {
+                zero = 1;
+                break;
+                }
+            case 'v':
+                {
+                verbose = 1;
+                break;
+                }
+            case 'r':
+                {
+                reverse = 1;
+                break;
+                }
+            case 'h':
+                {
+                high_pass = 1;
+                break;
+                }
+            case 'o':
+                {
+                order = 1;
+                break;
+                }
+            case 'E':
+                {
+                plan_only = 1;
+                if (optarg) strncpy(calfile, optarg, sizeof(calfile)-1);
+                break;
+                }
+            case 's':
+                {
+                if ((sscanf(optarg, "%d/%d", &shard_i, &shard_n) != 2) || (shard_n < 1) || (shard_i < 0) || (shard_i >= shard_n))
+                    {
+                    printf("ERROR: Shard Must Be i/N With 0 <= i < N...Exiting\n");
+                    exit(-1);
+                    }
+                break;
+                }
+            case 'e':
+                {
+                if ((eng_opt=eng.find(optarg)) < ENGINE_AUTO)
+                    {
+                    printf("ERROR: Engine Must Be full, r2c, pruned or auto...Exiting\n");
+                    exit(-1);
+                    }
+                break;
+                }
+            case 'C':
+                {
+                cpu_rep=1;
+                break;
+                }
+            case 'B':
+                {
+                if (!ast.file_exists(optarg))
+                    {
+                    printf("ERROR: Bad Pixel Mask %s Not Found...Exiting\n",optarg);
+                    exit(-1);
+                    }
+                snprintf(badfile, sizeof(badfile), "%s", optarg);
+                break;
+                }
+            case 'W':
+                {
+                struct stat st;
+
+                if (stat(optarg, &st) || !S_ISDIR(st.st_mode))
+                    {
+                    printf("ERROR: Hot Folder %s Not Found...Exiting\n",optarg);
+                    exit(-1);
+                    }
+                watch = 1;
+                snprintf(wdir, sizeof(wdir), "%s", optarg);
+                break;
+                }
+            case 'Z':
+                {
+                if (ast.pack_option(optarg, &pack))
+                    {
+                    printf("ERROR: Invalid Compression Option %s...Exiting\n",optarg);
+                    exit(-1);
+                    }
+                break;
+                }
+            case 'l':
+                {
+                latency = 1;
+                break;
+                }
+            case 'b':
+                {
+                if (!strcmp(optarg, "close")) bind=1;
+                else if (!strcmp(optarg, "spread")) bind=2;
+                else if (!strcmp(optarg, "none")) bind=0;
+                else
+                    {
+                    printf("ERROR: Bind Must Be close, spread or none...Exiting\n");
+                    exit(-1);
+                    }
+                break;
+                }
+            case 'q':
+                {
+                queue = 1;
+                strncpy(qdir, optarg, sizeof(qdir)-1);
+                break;
+                }
+            case 'u':
+                {
+                strncpy(sumfile, optarg, sizeof(sumfile)-1);
+                break;
+                }
+            case 'w':
+                {
+                warn = 1;
+                pit.set_warn(1);
+                ast.set_warn(1);
+                break;
+                }
+            case 'm':
+                {
+                if (atoi(optarg) != 0)
+                    {
+                    mask_line=1;
+                    }
+                else
+                    {
+                    mask=1;
+                    }
+                break;
+                }
+            case 'f':
+                {
+                fixed=atoi(optarg);
+                if ((fixed > MAX_WINDOW) || (fixed < MIN_WINDOW))
+                    {
+                    printf("ERROR: Window Size Must Be Between %d and %d...Exiting\n",MIN_WINDOW,MAX_WINDOW);
+                    exit(-1);
+                    }
+                break;
+                }
+            case 'i':
+                {
+                input_file = 1;
+                if (!ast.file_exists(optarg))
+                    {
+                    printf("ERROR: Input File %s Not Found...Exiting\n",optarg);
+                    exit(-1);
+                    }
+                strcpy(infile, optarg);
+                break;
+                }
+            case 'c':
+                {
+                catalog = 1;
+                if (!ast.file_exists(optarg))
+                    {
+                    printf("ERROR: Catalog File %s Not Found...Exiting\n",optarg);
+                    exit(-1);
+                    }
+                strncpy(catfile, optarg, sizeof(catfile)-1);
+                break;
+                }
+            default:
+                {
+                fprintf(stderr, "Usage: p2dfft [-i|--input <file>] [-v|--verbose] [-w|--warn]  [-r|--reverse] [-f|--fixed <size>] [-p|--polar] [-z|--zero] [-m|--mask 0|1] [-c|--catalog <file> <mosaic>] [-o|--order] [-E|--plan-only[=<cal>]] [-s|--shard i/N] [-q|--queue <dir>] [-u|--summary <file>] [-b|--bind close|spread] [-l|--latency] [-e|--engine full|r2c|pruned|auto] [-C|--cpu-report] [-B|--badpix <file>] [-W|--watch <dir>] [-Z|--compress <opts>] [<args>]\n");
+                exit(-1);
+                break;
+                }
+            }
+        }
+
+//
+// Output version numbers
+//
+
+    if (verbose)
+        {
+        printf("p2dfft version: %s\n", VERSION);
+        ast.version();
+        pit.version();
+        pol.version();
+        eng.version();
+        }
+
+    if (cpu_rep)
+        {
+        const char *kernels[]={"polar gather", "spectrum scaling", "mode extraction", "pitch analysis", NULL};
+
+        ast.cpu_report("p2dfft", kernels);
+        exit(0);
+        }
+
+//
+// Check for conflicting arguments
+//
+
+    if (fixed && reverse)
+        {
+        printf("ERROR: Cannot specify -r|-reverse and -f|--fixed...Exiting\n");
+        exit(-1);
+        }
+
+    if (catalog && input_file)
+        {
+        printf("ERROR: Cannot specify -i|--input and -c|--catalog...Exiting\n");
+        exit(-1);
+        }
+
+    if (watch && (catalog || input_file || plan_only || shard_n || (optind < argc)))
+        {
+        printf("ERROR: Cannot specify -W|--watch with -i, -c, -E, -s or file arguments...Exiting\n");
+        exit(-1);
+        }
+
+    if (bind) read_nodes();
+
+//
+// Allocate the Cartesian data array.  Also, zero out the first cell of mat 
+//   because FITS image indices start at 1.  mat is indexed [x][y] (see
+//   image_class.h), its rows are found by stride, not a row pointer table.
+//
+
+    if (verbose) printf("Allocating Cartesian mat[] Array...\n");
+
+    if (mat.alloc(MAX_DIM, MAX_DIM))
+        {
+        printf("ERROR: Memory allocation failed while allocating for mat[]/n");
+        exit(-1);
+        }
+
+    mat[0][0]=0.0;
+
+//
+// Get number of threads for this machine.  By default this should return
+//   a value = #cores * threads per core.  The per thread buffers, bindings
+//   and mat replicas are set up by thread number, so the teams must not
+//   shrink (OMP_DYNAMIC).
+//
+
+    num=omp_get_max_threads();
+    omp_set_dynamic(0);
+
+//
+// Allocate structure array for sum of FFT outputs and initialize the
+//   frequencies
+//
+
+    i=M_FIN-M_INI+1;
+    lim=(int)((fabs(FREQ_START)+fabs(FREQ_END))*4.0)+1.0;
+
+    struct  fft_out     fft_sum[i][lim];  /* Array for sum of FFT outputs */
+
+    freq_counter=FREQ_START;
+
+    for (i=0; i<lim; i++)
+        {
+        for(j=M_INI; j<=M_FIN; j++)
+            {
+            fft_sum[j][i].freq=freq_counter;
+            }
+        freq_counter+=STEP_P;
+        }
+
+//
+// Allocate the FFT arrays.  These need to be allocated with fftw_ functions
+//   since they are not C-style 2D arrays and the fact they need to be aligned
+//   on 16 byte boundaries if the target machine has SIMD support.
+//
+// Note we need to allocate one set per thread, since this program is managing
+//   the threads and not the FFTW library.
+//
+
+    if (polar) proj = (float *) malloc((DIM_RAD*DIM_THT+1) * sizeof(float));
+    struct  fft_out     fft_data[num][DIM_RAD+2];  /* FFT output data array */
+
+    fftw_complex    *in_data[num];
+    fftw_complex    *out_data[num];
+
+    for (i=0; i < num; i++) in_data[i]=out_data[i]=NULL;
+
+//
+// Read the input parameters for the analysis.  The input parameters will 
+//   include:
+//
+//     * All filenames to be processed
+//     * Any keywords associated with those files (optional)
+//     * Any radius values for the files (optional)
+//
+// Input can come from one of the following sources (in 
+//  priority order):
+//
+//     * Catalog file specified with -c (regions of one mosaic image)
+//     * Input file specified with -i
+//     * Hot folder specified with -W (the images already there, the rest
+//       are added as they arrive)
+//     * Command line arguments
+//     * Std input
+//
+
+    if (catalog)
+        {
+        if ((optind+1) != argc)
+            {
+            printf("ERROR: -c|--catalog Needs Exactly One Mosaic FITS File...Exiting\n");
+            exit(-1);
+            }
+
+        if (ast.read_catalog(std::string(catfile), &items))
+            {
+            std::cout << "ERROR: Can't Read Catalog File: " << catfile << std::endl;
+            exit(-1);
+            }
+
+        for (it = 0; it < items.size(); it++) items[it].name=std::string(argv[optind]);
+        std::stable_sort(items.begin(), items.end(), catalog_order);
+
+//
+// Open the mosaic once for all regions and allocate the row strip.  A region
+//   is never more than MAX_DIM rows high, so that is the most that is kept.
+//
+
+        if (!(mos_p=ast.fits_open(argv[optind], &mos_x, &mos_y)))
+            {
+            printf("ERROR: Can't Open Mosaic File %s...Exiting\n",argv[optind]);
+            exit(-1);
+            }
+
+        if ((strip=(float *) malloc((size_t)mos_x*MAX_DIM*sizeof(float))) == NULL)
+            {
+            printf("ERROR: Memory allocation failed while allocating for strip[]\n");
+            exit(-1);
+            }
+
+        if (verbose) printf("Mosaic %s: %d x %d, %u regions\n",argv[optind],mos_x,mos_y,(unsigned int)items.size());
+        }
+    else if (input_file)
+        {
+        if (ast.read_lines(std::string(infile), &items))
+            {
+            std::cout << "ERROR: Can't Read File Name: " << infile << std::endl;
+            exit(-1);
+            }
+        if ((items.size()==0))
+            {
+            std::cout << "ERROR: No Valid Items in Input File: " << infile << std::endl;
+            exit(-1);
+            }
+
+//
+// Read all the headers in parallel (reusing the sidecar for files that have
+//   not changed) before any processing starts
+//
+
+        hits=ast.prescan(&items, std::string(infile)+".meta");
+        if (verbose) printf("Header prescan: %u files, %d unchanged\n",(unsigned int)items.size(),hits);
+        }
+    else if (watch)
+        {
+        if (watch_start())
+            {
+            printf("ERROR: Can't Watch Hot Folder %s (%s)...Exiting\n",wdir,strerror(errno));
+            exit(-1);
+            }
+        printf("Watching %s: %u images waiting\n",wdir,(unsigned int)items.size());
+        }
+    else
+        {
+//
+// Check if there are command line arguments
+//
+
+        if (DEBUG) printf("optind=%d, argc=%d\n",optind,argc);
 
         if (optind >= argc)
             {
@@ -939,7 +3552,38 @@ int main(int argc, char **argv)
 // Final check to make sure we have items.   No Reason to Fail Here, but......
 //
 
-    if (items.size() == 0)
+    for (it = 0; it < items.size(); it++) stream_result(&items[it]);
+
+    if (!catalog) ast.fits_expand(&items);
+
+    if (order && !catalog) std::stable_sort(items.begin(), items.end(), cost_order);
+
+//
+// With -s|--shard i/N only every N-th item (starting at i) is kept.  All the
+//   workers build the same list from the same manifest, so the shards do
+//   not overlap.
+//
+
+    if (shard_n)
+        {
+        std::vector <file_rec>  mine;
+
+        for (it = 0; it < items.size(); it++)
+            {
+            if ((int)(it % shard_n) == shard_i) mine.push_back(items[it]);
+            }
+        if (verbose) printf("Shard %d/%d: %u of %u items\n",shard_i,shard_n,(unsigned int)mine.size(),(unsigned int)items.size());
+        if (mine.size() == 0)
+            {
+            printf("No items for shard %d/%d\n",shard_i,shard_n);
+            exit(0);
+            }
+        items.swap(mine);
+        }
+
+    for (it = 0; it < items.size(); it++) item_options(&items[it]);
+
+    if ((items.size() == 0) && !watch)
         {
         printf("ERROR: No Valid Files to Process (Empty work list)\n");
         exit(-1);
@@ -951,18 +3595,178 @@ int main(int argc, char **argv)
 
     proc_error=0;
 
+//
+// With -E|--plan-only, print the estimate and stop before the FFTW plan is
+//   built or any image is read
+//
+
+    if (plan_only)
+        {
+        estimate();
+        exit(0);
+        }
+
+//
+// Build the thread placement.  Without -b|--bind all threads use the one
+//   copy of mat.
+//
+
+    node_of.assign(num, 0);
+    for (i=0; i < MAX_NODES; i++) node_lead[i]=-1;
+    node_lead[0]=0;
+    mat_node[0]=mat.view();
+
+    if (bind)
+        {
+        bind_threads();
+        if (verbose) printf("Threads bound (%s) over %d NUMA node(s)\n",(bind == 2) ? "spread" : "close",n_nodes);
+        }
+
+//
+// Allocate the per thread FFT arrays (and the mat replicas of the other NUMA
+//   nodes) from the thread that uses them and touch them there, so their
+//   pages are placed on the node of that thread.  The team must have num
+//   threads or some buffers are never allocated (caught below).
+//
+
+#pragma omp parallel num_threads(num)
+    {
+    int     t=omp_get_thread_num();   /* Thread number                       */
+    int     n=node_of[t];             /* Node of the thread                  */
+
+    in_data[t] = (fftw_complex *) fftw_malloc((DIM_RAD*DIM_THT+1) * sizeof(fftw_complex));
+    out_data[t] = (fftw_complex *) fftw_malloc((DIM_RAD*DIM_THT+1) * sizeof(fftw_complex));
+    if (in_data[t]) memset(in_data[t], 0, (DIM_RAD*DIM_THT+1) * sizeof(fftw_complex));
+    if (out_data[t]) memset(out_data[t], 0, (DIM_RAD*DIM_THT+1) * sizeof(fftw_complex));
+
+    if ((n_nodes > 1) && (node_lead[n] == t) && (n != node_of[0]))
+        {
+        if (mat_copy[n].alloc(MAX_DIM, MAX_DIM) == IMAGE_SUCCESS) mat_copy[n].zero();
+        mat_node[n]=mat_copy[n].view();
+        }
+    }
+
+    for ( i=0; i < num; i++ )
+        {
+        if(NULL == in_data[i])
+            {
+            printf("ERROR: FFTW Memory allocation failed for in_data[%d]/n",i);
+            exit(-1);
+            }
+
+        if(NULL == out_data[i])
+            {
+            printf("ERROR: FFTW Memory allocation failed for out_data[%d]/n",i);
+            exit(-1);
+            }
+
+        if ((node_lead[node_of[i]] == i) && (mat_node[node_of[i]].empty()))
+            {
+            printf("ERROR: Memory allocation failed while allocating mat[] for node %d\n",node_of[i]);
+            exit(-1);
+            }
+
+        if (mat_node[node_of[i]].base != mat.data()) replicas=1;
+        }
+
 //
 // Build the plan for the FFT transform
 //
 
-    if (verbose) printf("Building plan for FFTW...");
-    plan=fftw_plan_dft_2d( (int) DIM_THT, (int) DIM_RAD, in_data[0], out_data[0], FFTW_FORWARD, FFTW_MEASURE);
-    if ( plan == NULL )
+    if (verbose) printf("Building plan for FFTW...");
+    plan=fftw_plan_dft_2d( (int) DIM_THT, (int) DIM_RAD, in_data[0], out_data[0], FFTW_FORWARD, FFTW_MEASURE);
+    if ( plan == NULL )
+        {
+        printf("ERROR: FFTW Plan (%d) Build Failed\n",i);
+        exit(1);
+        }
+    if (verbose) printf("Done\n");
+
+//
+// Make the plans of the engine given with -e, or read the engine table for
+//   -e auto (the other engines are then made when they are first tried)
+//
+
+    if ((eng_opt > ENGINE_FULL) && eng.build(eng_opt, in_data[0], out_data[0]))
+        {
+        printf("ERROR: FFTW Plan Build Failed for Engine %s\n",eng.name(eng_opt));
+        exit(1);
+        }
+
+    if (eng_opt == ENGINE_AUTO)
+        {
+        cpu_model=ast.cpu_name();
+        read_tune(tunefile);
+        if (verbose) printf("Engine table %s: %u entries for %s\n",tunefile,(unsigned int)tune_table.size(),cpu_model.c_str());
+        }
+
+//
+// In -l|--latency mode the radii are handed out one at a time, and the last
+//   round uses multi threaded FFTW plans (see tail_plan()).  Otherwise
+//   each thread gets an even block of radii as before.
+//
+
+    if (latency)
+        {
+        if (fftw_init_threads())
+            {
+            fft_threads=1;
+            }
+        else
+            {
+            printf("WARNING: FFTW Threads Not Available...Using One Thread Per FFT\n");
+            }
+        omp_set_schedule(omp_sched_dynamic, 1);
+        }
+    else
+        {
+        omp_set_schedule(omp_sched_static, 0);
+        }
+
+//
+// Build the polar sampling table.  It does not depend on the image, so it is
+//   built once and shared by every image, plane and radius.
+//
+
+    if (pol.build())
+        {
+        printf("ERROR: Memory allocation failed while building polar table\n");
+        exit(-1);
+        }
+
+//
+// Set up the shared work queue.  Items are claimed as they are reached, and
+//   the heartbeat thread keeps the claims of this worker from going stale.
+//
+
+    gethostname(host, sizeof(host)-1);
+
+    if (queue)
+        {
+        if (mkdir(qdir, 0755) && (errno != EEXIST))
+            {
+            printf("ERROR: Can't Create Queue Directory %s...Exiting\n",qdir);
+            exit(-1);
+            }
+        if (!sumfile[0]) snprintf(sumfile, sizeof(sumfile), "%s/summary", qdir);
+        claim.assign(items.size(), 0);
+
+        if (!pthread_create(&beat_thread, NULL, heartbeat, NULL)) beat_on=1;
+        }
+
+//
+// Start the read ahead thread.  CFITSIO is also used by the main loop, so
+//   this is only done if CFITSIO is re-entrant.
+//
+
+    if (fits_is_reentrant() && !pthread_create(&pre_thread, NULL, read_ahead, NULL))
         {
-        printf("ERROR: FFTW Plan (%d) Build Failed\n",i);
-        exit(1);
+        pre_on=1;
+        }
+    else
+        {
+        if (verbose) printf("CFITSIO is not re-entrant, images will not be read ahead\n");
         }
-    if (verbose) printf("Done\n");
 
 
 //
@@ -970,12 +3774,35 @@ int main(int argc, char **argv)
 //
 
 //
-// Now we have the list of files.  Loop through all fo them and process.
+// Now we have the list of files.  Loop through all fo them and process.  With
+//   -W|--watch the images arriving in the hot folder are added to the end of
+//   the list, and the loop waits for them when the list is done.
 //
 
-    for ( it = 0; it < items.size();  it++)
+    for ( it = 0; more_items(it);  it++)
         {
 //
+// Release the buffers of the previous item.  Anything taken from mem is only
+//   valid until the end of this item.
+//
+
+        mem.reset();
+
+//
+// Skip the items claimed by other workers of the queue
+//
+
+        if (!want_item(it))
+            {
+            if (verbose) std::cout << "Claimed By Another Worker: " << items[it].name << std::endl;
+            taken++;
+            continue;
+            }
+
+        t_item=omp_get_wtime();
+        eng_kind=-1;
+
+//
 // Zero out x_dim and y_dim.  This is important for the logic to 
 //   determine the radius
 //
@@ -1005,133 +3832,132 @@ int main(int argc, char **argv)
 //   file or binary FITS file.  Also determine the radius, if needed.
 //
 
-        if (items[it].binary)
+        if (items[it].region)
             {
 //
-// It's a binary FITS file - Data will start at location 0 from fits_read()
+// It's a region of the mosaic - mat is filled directly from the row strip
 //
-            
+
             offset=0;
-            fname=(char *) items[it].name.c_str();
-            if (!(data=ast.fits_read(fname, &msize)))
+            if (load_region(&items[it]))
                 {
-//
-// Read Failure
-//
-
-                std::cout << "WARNING: Can't Read Binary File: " << items[it].name << " Skipping..." << std::endl;
+                std::cout << "WARNING: Can't Read Region: " << items[it].result << " Skipping..." << std::endl;
                 proc_error++;
+                finish_item(it, 0, omp_get_wtime()-t_item);
                 continue;
                 }
+            }
+        else if (items[it].hdu)
+            {
 //
-// Get the radius
+// It's one plane of a cube or MEF file.  Keep the file open while the
+//   following entries are planes of the same file.
 //
 
-            if (ast.fits_dims(items[it].name.c_str(),&x_dim, &y_dim))
+            offset=0;
+            if (cube_p && (cube_name != items[it].name))
                 {
-//
-// Failure to get size from Header
-//
-
-                std::cout << "ERROR: Can't Read Binary File Size: " << items[it].name << " Skipping..." << std::endl;
+                ast.fits_close(cube_p);
+                cube_p=NULL;
+                }
+            if (!cube_p)
+                {
+                if (!(cube_p=ast.fits_open((char *) items[it].name.c_str(), &x_dim, &y_dim)))
+                    {
+                    std::cout << "WARNING: Can't Open Binary File: " << items[it].name << " Skipping..." << std::endl;
+                    proc_error++;
+                    finish_item(it, 0, omp_get_wtime()-t_item);
+                    continue;
+                    }
+                cube_name=items[it].name;
+                }
+            if (!(data=ast.fits_read_plane(cube_p, items[it].hdu, items[it].plane, &mem, &x_dim, &y_dim, &msize)))
+                {
+                std::cout << "WARNING: Can't Read HDU " << items[it].hdu << " Plane " << items[it].plane << " of " << items[it].name << " Skipping..." << std::endl;
                 proc_error++;
+                finish_item(it, 0, omp_get_wtime()-t_item);
                 continue;
                 }
 
-//
-// Find radius.  Images are no longer required to be square so find the 
-//   shortest dimension for the radius.
-//
-
-            if (!items[it].valid)
+            if (!items[it].valid || (items[it].radius > (((x_dim < y_dim) ? x_dim : y_dim)-1)/2))
                 {
-                if ( x_dim < y_dim )
-                    {
-                    items[it].radius=(x_dim-1)/2;
-                    items[it].valid=1;
-                    }
-                else
-                    {
-                    items[it].radius=(y_dim-1)/2;
-                    items[it].valid=1;
-                    }
+                items[it].radius=(((x_dim < y_dim) ? x_dim : y_dim)-1)/2;
+                items[it].valid=1;
                 }
             }
         else
             {
 //
-// It's a ASCII FITS file -- IMPORTANT NOTE: These type of files must have
-//   two bytes for size information.  The bytes can be zero, but must be
-//   be there or the first two bytes of the data will be ignored and the
-//   alignment of the other data incorrect, which will lead to changes
-//   in the output values.
-//
-
-//
-// Read ASCII File into data
+// It's a whole binary FITS file or an ASCII text FITS file.  Take it from
+//   the read ahead ring, or read it here if there is no read ahead thread.
 //
 
-            if (verbose) puts("--- reading image");
-
-            if((fp_inp=fopen(items[it].name.c_str(),"r"))==NULL)
+            if (pre_on)
                 {
-                std::cout << "WARNING: Problem Reading ASCII FITS File: " << items[it].name << std::endl;
-                proc_error++;
-                continue;
+                slot=take_slot();
                 }
-
-            data=(float *) malloc((DIM_RAD*DIM_THT*2+2) * sizeof(float *));
-
-            if ( data == NULL )
+            else
                 {
-                printf("ERROR: malloc() failed for data array, Skipping...\n");
-                exit(1);
+                slot=&own;
+                slot->ok=!read_image(&items[it], &ast, num, slot);
                 }
 
-            i=0;
-            status=fscanf(fp_inp,"%f",&data[i]);
-            do
+            if (!slot->ok)
                 {
-                i++;
-                if (i >= (MAX_DIM * MAX_DIM))
-                    {
-                    std::cout << "ERROR: File Exceeded Maximum Size " << items[it].name << std::endl;
-                    exit(1);
-                    }
-                } while((fscanf(fp_inp,"%f",&data[i])) != EOF);
-        
-            i--;
-
 //
-// Try to read the size from the first two bytes
+// Read Failure
 //
 
-            if(data[0]==data[1] && data[0]>0.0 && data[1]>0.0)
-                {
-                x_dim=data[0];
-                y_dim=data[1];
-                if (verbose) printf("--- dimensions (read) : xdim=%d : ydim=%d\n",x_dim,y_dim);
+                if (items[it].binary)
+                    std::cout << "WARNING: Can't Read Binary File: " << items[it].name << " Skipping..." << std::endl;
+                else
+                    std::cout << "WARNING: Problem Reading ASCII FITS File: " << items[it].name << std::endl;
+                if (pre_on) release_slot();
+                slot=NULL;
+                proc_error++;
+                finish_item(it, 0, omp_get_wtime()-t_item);
+                continue;
                 }
 
+            data=slot->data;
+            msize=slot->size;
+            x_dim=slot->x;
+            y_dim=slot->y;
+
+            if (items[it].binary)
+                {
+                offset=0;
+
 //
-//  If there were problems reading the size from the file, or the force read, 
-//    calculate the size
+// Find radius.  Images are no longer required to be square so find the 
+//   shortest dimension for the radius.
 //
 
-            if ((x_dim == 0) || (y_dim == 0))
+                if (!items[it].valid)
+                    {
+                    if ( x_dim < y_dim )
+                        {
+                        items[it].radius=(x_dim-1)/2;
+                        items[it].valid=1;
+                        }
+                    else
+                        {
+                        items[it].radius=(y_dim-1)/2;
+                        items[it].valid=1;
+                        }
+                    }
+                }
+            else
                 {
-                x_dim=sqrt(i-1);
-                y_dim=sqrt(i-1);
-                if (verbose) printf("--- dimensions (not read) : xdim=%d : ydim=%d\n",x_dim,y_dim);
+                items[it].radius=(x_dim-1)/2;
+                items[it].valid=1;
+                offset=2;
                 }
-
-            items[it].radius=(x_dim-1)/2;
-            items[it].valid=1;
-            offset=2;
             }
 
 //
-// Copy the FITS data into the mat 2D Cartesian array
+// Copy the FITS data into the mat 2D Cartesian array (mosaic regions are
+//   already there)
 //
 
 #ifdef DEBUG_DAT
@@ -1143,7 +3969,7 @@ int main(int argc, char **argv)
 #endif
 
         counter=0;
-        for(j=1;j<=y_dim;j++) 
+        for(j=1;(j<=y_dim) && !items[it].region;j++) 
             {
             for(i=1;i<=x_dim;i++)
                 {
@@ -1156,6 +3982,15 @@ int main(int argc, char **argv)
                 }
             }
 
+//
+// The image is in mat, so the slot can be filled with the next image
+//
+
+        if (slot && pre_on) release_slot();
+        slot=NULL;
+
+        if (replicas) replicate_mat();
+
         if (verbose) std::cout << "Processing Entry - Name: " << items[it].name << " Result: " << items[it].result << " Keyword: " << items[it].keyword << " Radius: " << items[it].radius << " Binary: " << items[it].binary << " Valid: " << items[it].valid << std::endl;
 
         if (verbose) puts("--- transforming X x Y -> Theta x ln r");
@@ -1168,6 +4003,73 @@ int main(int argc, char **argv)
         x_0=((x_dim-1)/2)+1;
         y_0=((y_dim-1)/2)+1;
 
+//
+// Set the options for this item (command line values, unless the input file
+//   had options for it) and clear the results of the previous item
+//
+
+        mask=(items[it].mask == 1);
+        mask_line=(items[it].mask == 2);
+        fixed=items[it].fixed;
+        reverse=items[it].reverse;
+        high_pass=items[it].highpass;
+        zero=items[it].zero;
+
+        memset(mode_data, 0, sizeof(mode_data));
+
+//
+// A center from the input file moves the center, and the radius is limited
+//   so the annuli stay inside the image
+//
+
+        if (items[it].x_ctr && !items[it].region)
+            {
+            x_0=items[it].x_ctr;
+            y_0=items[it].y_ctr;
+            i=std::min(std::min(x_0-1, y_0-1), std::min(x_dim-x_0, y_dim-y_0));
+            if (items[it].radius > i)
+                {
+                printf("WARNING: Radius %d Too Large for Center %d,%d...Using %d\n",items[it].radius,x_0,y_0,i);
+                items[it].radius=i;
+                }
+            }
+
+        r_lo=(items[it].rmin > 0) ? items[it].rmin : 1;
+        r_hi=((items[it].rmax > 0) && (items[it].rmax < items[it].radius)) ? items[it].rmax+1 : items[it].radius;
+
+//
+// Bad pixel mask of the item (its badpix option, else -B).  The mask is only
+//   read again when the file or the image size changes.
+//
+
+        bad_v=ImageView<uint64_t>();
+        bad_item=(!items[it].badpix.empty()) ? items[it].badpix : std::string(badfile);
+        if (bad_item == "none") bad_item.clear();
+
+        if (!bad_item.empty() && items[it].region)
+            {
+            if (warn) printf("WARNING: Bad Pixel Mask %s Not Used for Catalog Region %s\n",bad_item.c_str(),items[it].result.c_str());
+            }
+        else if (!bad_item.empty())
+            {
+            if ((bad_item != bad_name) || (bad_x != x_dim) || (bad_y != y_dim))
+                {
+                bad_name.clear();
+                if (ast.badpix_read((char *) bad_item.c_str(), x_dim, y_dim, &bad))
+                    {
+                    std::cout << "WARNING: Can't Read Bad Pixel Mask: " << bad_item << " Skipping " << items[it].name << "..." << std::endl;
+                    proc_error++;
+                    finish_item(it, 0, omp_get_wtime()-t_item);
+                    continue;
+                    }
+                bad_name=bad_item;
+                bad_x=x_dim;
+                bad_y=y_dim;
+                if (verbose) printf("Bad Pixel Mask %s: %ld Pixels\n",bad_item.c_str(),bad.count());
+                }
+            bad_v=bad.view();
+            }
+
 //
 // Determine the masking value by determining the core brightness
 //
@@ -1199,15 +4101,60 @@ int main(int argc, char **argv)
         sprintf(cmd,"mkdir -p %s\n",base);
         status=system(cmd);
 
+//
+// List the radii to calculate.  Radii that -f|--fixed skips are left out so
+//   every entry is real work.
+//
+
+        rad_list.clear();
+        for (i = r_lo; i < r_hi; i++)
+            {
+            if (fixed && ((i <= (fixed/2)) || (i >= items[it].radius-(fixed/2)))) continue;
+            rad_list.push_back(i);
+            }
+
+//
+// Pick the transform engine for the item
+//
+
+        eng_kind=eng_opt;
+        eng_how="fixed";
+        eng_err=0.0;
+        if (eng_opt == ENGINE_AUTO) eng_kind=choose_engine(items[it].radius, in_data[0], out_data[0]);
+        if (verbose) printf("--- engine %s (%s, difference %g)\n",eng.name(eng_kind),eng_how,eng_err);
+
+//
+// With -l|--latency, when the radii do not divide evenly over the threads,
+//   the last round would leave threads idle.  Those radii use a plan that
+//   splits each FFT over the idle threads instead.
+//
+
+        n_split=(int)rad_list.size();
+        split_done=0;
+        tail=plan;
+        if (fft_threads && (eng_kind == ENGINE_FULL) && (rad_list.size()%num) && (split_threads(num, rad_list.size()%num) > 1))
+            {
+            tail_k=split_threads(num, rad_list.size()%num);
+            if ((tail=tail_plan(tail_k, in_data[0], out_data[0])) != NULL)
+                {
+                n_split-=(int)(rad_list.size()%num);
+                if (verbose) printf("--- last %d radii use %d threads per FFT\n",(int)rad_list.size()-n_split,tail_k);
+                }
+            else
+                {
+                tail=plan;
+                }
+            }
+
 //
 //  This is the parallel version of the code.  All the inner radius values for
 //    each annuli will be caculated in groups of parallel threads starting here.
 //    Even if there is is only one thread, this code will still work.
 //
 
-#pragma omp parallel for
+#pragma omp parallel for schedule(runtime)
 
-        for (int radius = 1; radius < items[it].radius; radius++)
+        for (int k = 0; k < (int)rad_list.size(); k++)
             {
 //
 // VERY IMPORTANT - current is unique to each thread, so it must be defined 
@@ -1219,20 +4166,19 @@ int main(int argc, char **argv)
 //
 
 int     current=omp_get_thread_num(); /* Current index for arrays for thread */
+int     radius=rad_list[k];           /* Inner (or outer) radius of annulus  */
 
 //
 // Other definitions that are unique instances per thread.
 //
 
-int     a, b;              /* Cartesian coordinates of ln(r)/theta in image  */
 int    	mode;              /* Mode index value                               */
-int     jm, im;            /* Local index variables                          */
-int     cont_p;            /* Index for remapping output data in fft_data    */
+int     jm;                /* Local index variable                           */
 int     status;            /* Pitch_class return value                       */
 int     sum_ptr;           /* Index for FFT summed data strcuture            */
-int     counter=0;         /* FFT array index value                          */
-int     count_theta=1;     /* Counter for theta steps in degrees             */
-int     count_radians;     /* Counter for theta steos in radians             */
+int     r_first, r_last;   /* ln r steps kept for this annulus               */
+
+ImageView<float> m=mat_node[node_of[current]]; /* Copy of mat on this node */
 
 char    outfile1[80];      /* Intermediate .rip file name string             */
 char    outfile2[80];      /* Intermediate .dat file name string             */
@@ -1240,119 +4186,24 @@ char    outfile2[80];      /* Intermediate .dat file name string             */
 FILE    *fp_out1;          /* Intermediate .rip file pointer                 */
 FILE    *fp_out2;          /* Intermediate .dat file pointer                 */
 
-float   lnr;               /* Natural log of radius for a certain point      */
-float   x, y;              /* Relative cartesian coordinates of ln(r)/theta  */
-float   log_lo;            /* Natural log of inside of fixed annuli          */
-float   log_hi;            /* Natural log of outside of fixed annuli         */
-float   log_rad;           /* Natural log of current value of radius         */
-float   norma=0.0;         /* Normalization value (sum of number of values)  */
-float   freq_save;         /* Current frequency calculation value            */
-float   theta_degrees;     /* Current theta (polar angle) in degrees         */
-float   theta_radians;     /* Current theta (polar angle) in radians         */
-
-
-            if (reverse)
-                {
-                log_rad=log((double)(items[it].radius-radius+1));
-                }
-            else
-                {
-                log_rad=log((double)radius);
-                }
-
-            if (fixed && ((radius <= (fixed/2)) || (radius >= items[it].radius-(fixed/2)))) continue; 
-
-//
-// Zero out the arrays.  This is really important to getting the correct
-//   results.
-//
-
-            for (im=0; im < DIM_RAD*DIM_THT+1; im++)
-                {
-                in_data[current][im][0]=0.0;
-                in_data[current][im][1]=0.0;
-                out_data[current][im][0]=0.0;
-                out_data[current][im][1]=0.0;
-                }
-        
-//
-// Step around theta angles (360 degrees in 0.35 steps)
-//
-
-            for(theta_degrees=0.0;count_theta<=DIM_THT;theta_degrees+=theta_step) 
-                {
-                count_theta++;
-
-//
-// Convert the degrees to radians
-//
-
-                theta_radians=theta_degrees*GR_RAD;	
-                count_radians=1;
+fftw_complex    *spec;     /* Mode spectrum from the engine                  */
 
-                for(lnr=0.0;count_radians<=DIM_RAD;lnr+=radstep) 
-                    {
-                    count_radians++;
+float   norma;             /* Normalization value (sum of number of values)  */
+float   freq_save;         /* Current frequency calculation value            */
+int     done;              /* Radii before n_split finished so far           */
 
-                    if ((zero) && (count_theta < 4 || count_theta > 1021))
-                        {
-                        in_data[current][counter][0]=0.0;
-                        in_data[current][counter++][1]=0.0;
-                        continue;
-                        }
+            annulus(items[it].radius, radius, &r_first, &r_last);
 
-                    if ((mask_line) && (lnr <= log_bar))
-                        {
-                        in_data[current][counter][0]=0.0;
-                        in_data[current][counter++][1]=0.0;
-                        continue;
-                        }
-                       
 //
-// Here's the bit that controls what get mapped and what is set to zero.
-//   These tests depend on the value of reverse and fixed.
+// Zero out the input array.  This is really important to getting the correct
+//   results.  The -p projection is written from the samples of radius 1.
 //
-    
-                    if (reverse && (lnr>log_rad || lnr>log_itrad))
-                        {
-                        in_data[current][counter][0]=0.0;
-                        in_data[current][counter++][1]=0.0;
-                        continue;
-                        }
-                       
-                    if (fixed && (lnr>log_hi || lnr<log_lo)) 
-                        {
-                        in_data[current][counter][0]=0.0;
-                        in_data[current][counter++][1]=0.0;
-                        continue;
-                        }
-    
-                    if (!reverse && !fixed && (lnr>log_itrad || lnr<log_rad))
-                        {
-
-                        in_data[current][counter][0]=0.0;
-                        in_data[current][counter++][1]=0.0;
-                        continue;
-                        }
 
-                    x=expf(lnr)*cosf(theta_radians);
-                    y=expf(lnr)*sinf(theta_radians);
+            eng.clear(eng_kind, in_data[current]);
 
-                    a=(int)x+x_0;
-                    b=(int)y+y_0;
+            if ((polar) && (radius==1)) memset(proj, 0, (DIM_RAD*DIM_THT+1) * sizeof(float));
 
-                    if ((mask) && (mat[a][b] >= ctr_val))
-                        {
-                        in_data[current][counter][0]=0.0;
-                        }
-                    else
-                        {
-                        in_data[current][counter][0]=(double) mat[a][b];
-                        norma+=in_data[current][counter][0];
-                        }
-                    in_data[current][counter++][1]=0.0;
-                    }
-                }
+            norma=gather(eng_kind, in_data[current], m, r_first, r_last, ((polar) && (radius==1)) ? proj : NULL);
 
             if (verbose) printf("--- calculating 2DFFT: %d/%d\n",radius, items[it].radius);
 
@@ -1360,7 +4211,7 @@ float   theta_radians;     /* Current theta (polar angle) in radians         */
             if (radius<5)
                 {
                 printf("RADIUS: %d\n",radius);
-                for(im=0;im<=counter;im++) 
+                for(int im=0;im<DIM_THT*DIM_RAD;im++) 
                     {
                     printf("DEBUG: In Data[%d][0]=%f\n",im,in_data[current][im][0]);
                     printf("DEBUG: In Data[%d][1]=%f\n",im,in_data[current][im][1]);
@@ -1369,48 +4220,34 @@ float   theta_radians;     /* Current theta (polar angle) in radians         */
 #endif
 
 //
-// Save the polar mapped image if the -p option was specified
+// Perform the FFT with the engine.  A split FFT (-l) waits until the other
+//   radii are finished, so its FFTW threads only use threads that are idle.
+//   A thread bound to one CPU has to be let out of it while its FFT is
+//   split, or the FFTW threads would all share that CPU.
 //
 
-            if ((polar) && (radius==1))
+            if (k >= n_split)
                 {
-                counter=0;
-                for (jm=0; jm < DIM_RAD; jm++)
-                    {
-                    for (im=0; im < DIM_THT; im++)
-                        {
-                        proj[counter++]=(float) in_data[current][(im*2048)+jm+1][0];
-                        }
-                    }
-                fname=(char *) items[it].name.c_str();
-                if (verbose) printf("  --- Write P_%s File\n",fname);
-
-                sprintf(pfile,"!P_%s",fname);
-                if (ast.fits_write(pfile, proj, DIM_THT, DIM_RAD, 1, "p2dfft/",VERSION))
+                do
                     {
-                    printf("WARNING: fits_write(%s) Failed\n",pfile);
+#pragma omp atomic read
+                    done=split_done;
+                    if (done < n_split) sched_yield();
                     }
+                while (done < n_split);
                 }
 
-//
-// Perform the FFT using the plan
-//
+            if (bind && (k >= n_split)) unpin_thread();
+
+            spec=eng.transform(eng_kind, (k < n_split) ? plan : tail, in_data[current], out_data[current]);
 
-            fftw_execute_dft(plan,in_data[current],out_data[current]);
+            if (bind && (k >= n_split)) pin_thread(current);
 
 //
-// Normalize the output data
+// Normalize the output data (only the mode rows are used)
 //
 
-            for(im=0;im<=counter;im++) 
-                {
-#ifdef DEBUG_DAT
-                printf("DEBUG: Out Data[%d][0]=%f\n",im,out_data[current][im][0]);
-                printf("DEBUG: Out Data[%d][1]=%f\n",im,out_data[current][im][1]);
-#endif
-                out_data[current][im][0]=out_data[current][im][0]/(double)norma;
-                out_data[current][im][1]=out_data[current][im][1]/(double)norma;
-                }
+            eng.scale(spec, norma);
 
 //
 // Loop for each mode
@@ -1418,8 +4255,6 @@ float   theta_radians;     /* Current theta (polar angle) in radians         */
 
             for(mode=M_INI;mode<=M_FIN;mode++) 
                 {
-                counter=mode*DIM_RAD;
-
 //
 // If data files are being generated, open them and write the initial data
 //
@@ -1478,41 +4313,7 @@ float   theta_radians;     /* Current theta (polar angle) in radians         */
 //   returns a sign reversed value compared to the previous algorithm.
 //
 
-                for(cont_p=0;cont_p<DIM_RAD/2;cont_p++) 
-                    {
-                    fft_data[current][cont_p+(DIM_RAD/2)+1].real=out_data[current][counter][0];
-                    fft_data[current][cont_p+(DIM_RAD/2)+1].imag=-1.0*out_data[current][counter][1];
-                    fft_data[current][cont_p+DIM_RAD/2+1].abs=sqrt(pow(out_data[current][counter][0],2.0)+pow(out_data[current][counter][1],2.0));
-
-                    if (DEBUG && radius==1) printf("DEBUG: Map out_data[%d][1] to fft_data[current][%d].real/imag/abs\n",counter,cont_p+(DIM_RAD/2)+1);
-
-                    ++counter;
-                    }
-
-                fft_data[current][DIM_RAD+1].real=out_data[current][counter][0];
-                fft_data[current][DIM_RAD+1].imag=-1.0*out_data[current][counter][1];
-                fft_data[current][DIM_RAD+1].abs=sqrt(pow(out_data[current][counter][0],2.0)+pow(out_data[current][counter][1],2.0));
-
-//
-// This was in the original code.  Not sure if it is still needed.
-//
-
-                fft_data[current][1].abs=sqrt(pow(out_data[current][counter][0],2.0)+pow(out_data[current][counter][1],2.0));
-
-                if (DEBUG && radius==1) printf("DEBUG: Map out_data[%d][1] to fft_data[%d].real/imag/abs\n",counter,cont_p+(DIM_RAD/2)+1);
-
-                ++counter;
-
-                for(cont_p=(-1)*(DIM_RAD/2)+1;cont_p<=-1;cont_p++) 
-                    {
-                    fft_data[current][cont_p+(DIM_RAD/2)+1].real=out_data[current][counter][0];
-                    fft_data[current][cont_p+(DIM_RAD/2)+1].imag=-1.0*out_data[current][counter][1];
-                    fft_data[current][cont_p+(DIM_RAD/2)+1].abs=sqrt(pow(out_data[current][counter][0],2.0)+pow(out_data[current][counter][1],2.0));
-
-                    if (DEBUG && radius==1) printf("DEBUG: Map out_data[%d][1] to fft_data[%d].real/imag/abs\n",counter,cont_p+(DIM_RAD/2)+1);
-
-                    ++counter;
-                    }
+                extract(spec, mode, fft_data[current]);
 
 //
 // Add frequency values to the fft_data array, the summed data array, and
@@ -1582,7 +4383,7 @@ float   theta_radians;     /* Current theta (polar angle) in radians         */
 //    parameters.
 //
 
-                    if (warn) printf("WARNING: pitch_phase() failed (%d) for radius %d and mode %d\n",pit.get_err(),radius,cont_p);
+                    if (warn) printf("WARNING: pitch_phase() failed (%d) for radius %d and mode %d\n",pit.get_err(),radius,mode);
                     mode_data[mode][radius].index=0;
                     mode_data[mode][radius].freq=NAN;
                     mode_data[mode][radius].amp=NAN;
@@ -1597,7 +4398,7 @@ float   theta_radians;     /* Current theta (polar angle) in radians         */
                     status=pit.snr(fft_data[current],&mode_data[mode][radius]);
                     if (status==PITCH_RET_ERR)
                         {
-                        if (warn) printf("WARNING: snr() failed (%d) for radius %d and mode %d\n",pit.get_err(),radius,cont_p);
+                        if (warn) printf("WARNING: snr() failed (%d) for radius %d and mode %d\n",pit.get_err(),radius,mode);
                         mode_data[mode][radius].avg_amp=NAN;
                         mode_data[mode][radius].snr=NAN;
                         mode_data[mode][radius].fwhm=NAN;
@@ -1607,17 +4408,55 @@ float   theta_radians;     /* Current theta (polar angle) in radians         */
                         status=pit.fwhm(fft_data[current],&mode_data[mode][radius]);
                         if (status==PITCH_RET_ERR)
                             {
-                            if (warn) printf("WARNING: fwhm() failed (%d) for radius %d and mode %d\n",pit.get_err(),radius,cont_p);
+                            if (warn) printf("WARNING: fwhm() failed (%d) for radius %d and mode %d\n",pit.get_err(),radius,mode);
                             mode_data[mode][radius].fwhm=NAN;
                             }
                         }
                     }
                 if (DEBUG) printf("DEBUG: Pitch Phase Angle=%f, SNR=%f, FWHM=%f\n",mode_data[mode][radius].pa,mode_data[mode][radius].snr,mode_data[mode][radius].fwhm);
                 }
+
+//
+// Count the radii finished before n_split (the split FFTs wait for them).
+//   The radii are handed out in order, so every radius before n_split is
+//   already running when a thread reaches a split one.
+//
+
+            if (k < n_split)
+                {
+#pragma omp atomic
+                split_done++;
+                }
             }
 
 // **** END OF PARALLEL THREAD FOR LOOP
 
+//
+// Save the polar mapped image if the -p option was specified.  It is written
+//   after the radii so all the threads can compress its tiles (-Z).
+//
+
+        if ((polar) && (std::find(rad_list.begin(), rad_list.end(), 1) != rad_list.end()))
+            {
+            if (items[it].region || items[it].hdu)
+                {
+                sprintf(tmpofile,"%s.fits",base);
+                fname=tmpofile;
+                }
+            else
+                {
+                fname=(char *) items[it].name.c_str();
+                }
+            if (verbose) printf("  --- Write P_%s File\n",fname);
+
+            sprintf(pfile,"!P_%s",fname);
+            pack.nthreads=num;
+            if (ast.fits_write(pfile, ImageView<float>(proj, DIM_RAD, DIM_THT, DIM_THT), &pack, "p2dfft/",VERSION))
+                {
+                printf("WARNING: fits_write(%s) Failed\n",pfile);
+                }
+            }
+
 //
 // Now that all radii are complete, write the per mode and summed output files
 //
@@ -1651,9 +4490,36 @@ float   theta_radians;     /* Current theta (polar angle) in radians         */
                 }
             fclose(sum_out);
             }
+
+        finish_item(it, 1, omp_get_wtime()-t_item);
+        }
+//
+// Release the mosaic, if one was used
+//
+
+    if (catalog)
+        {
+        if (verbose) printf("Mosaic rows read: %ld of %d\n",strip_rows,mos_y);
+        ast.fits_close(mos_p);
+        free(strip);
+        }
+
+    if (cube_p) ast.fits_close(cube_p);
+
+    if (pre_on) pthread_join(pre_thread, NULL);
+
+    if (beat_on)
+        {
+        beat_stop=1;
+        pthread_join(beat_thread, NULL);
         }
+
+    for (i=0; i < PREFETCH_DEPTH; i++) free(ring[i].data);
+    free(own.data);
+
     printf("-------------------------------\n");
-    it=(unsigned int)items.size()-(unsigned int)proc_error;
+    it=(unsigned int)items.size()-(unsigned int)proc_error-(unsigned int)taken;
     printf("Successfuly Processed        %d\n",it);
     printf("Errors                       %u\n",proc_error);
+    if (queue) printf("Done By Other Workers        %d\n",taken);
     }
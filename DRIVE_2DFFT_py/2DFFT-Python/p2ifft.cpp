@@ -5,7 +5,7 @@
 //              some .rip files for a subset of the data.
 //
 //
-// Version 3.4: 20-Jun-2019
+// Version 3.5: 17-Oct-2026
 //
 //
 // 2DFFT (original) Author: Dr. Ivanio Puerari
@@ -63,7 +63,8 @@
 //
 //
 // Usage: p2ifft [-i|--input <file>] [-v|--verbose] [-m|--mode <n>[,<n>...]] 
-//               [-s|--start <arg>] [-e|--end <arg>] [<file>[,<file>...]]
+//               [-s|--start <arg>] [-e|--end <arg>] [-C|--cpu-report]
+//               [-Z|--compress <opts>] [<file>[,<file>...]]
 // 
 //        If there is an input file specified with -i, that will be used for
 //            the list of file names to be processed (one per line).  If no
@@ -87,6 +88,14 @@
 //              -s|--start : Specify a starting inner radius (default is 1)
 //              -e|--end   : Specify an ending inner radius (default is file
 //                           size - 10%)
+//              -C|--cpu-report: Show the CPU and the code path (sse2, avx2
+//                           or avx512f) the back projection runs, then exit
+//              -Z|--compress: Write the I_ images tile compressed and/or
+//                           cropped to the part that is not 0 or NaN.
+//                           <opts> is a comma separated list of rice, gzip,
+//                           none, q=<val>, tile=<rows>, nodither and crop
+//                           (same as p2dfft -Z).  The tiles are compressed
+//                           on all threads.
 //
 // Algorithm Notes:
 //
@@ -99,6 +108,14 @@
 //      created.
 //
 // Revision History:
+//      3.5  17-Oct-2026: - Move the polar to Cartesian mapping into
+//                          back_project(), built for each instruction set
+//                          in CPU_PATHS
+//                        - Add -C|--cpu-report option
+//                        - Use Image2D for mat, vals and result and
+//                          Spectrum for the FFT arrays (image_class.h)
+//                        - Add -Z|--compress option for tile compressed
+//                          and/or cropped I_ images (astro::fits_write())
 //      3.4  20-Jun-2019: - Fix small bug in ifft image generation
 //                        - Correct/rework some DEBUG information printing
 //                        - Fix bounds checking as isnan() did not detect -nan
@@ -206,7 +223,7 @@
 // CONSTANTS
 //
 
-#define VERSION "3.4/20190620"
+#define VERSION "3.5/20261017"
 
 //
 // Number of total frequency steps
@@ -247,9 +264,8 @@ int     cmd_line; /* Flag to indicate if command line arguments are used */
 int     maxrad90; /* Outer radius value - 10%                            */
 int     num_files; /* Number of file to eb processed                     */
 int     inp_mode=0; /* Glaf to indicate if an input file was used        */
-int     count_theta;   /* Step counter for radial degrees                */
-int     count_radians; /* Step counter for radial radians                */
 int     option_index=0; /* Used for argument processing                  */
+int     cpu_rep=0; /* Flag for -C|--cpu-report                           */
 
 int     end[MAX_FILES];   /* Array for user specified starting radii     */
 int     start[MAX_FILES]; /* Array for user specified ending radii       */
@@ -257,6 +273,7 @@ int     mode[MAX_FILES][M_FIN+2]; /* Flags for modes to use              */
         
 long    naxis=2;       /* CFITSIO number of axes                         */
 long    naxes[2];      /* CFITSIO axes size                              */
+long    fpixel[2]={1,1}; /* CFITSIO first pixel of a row                 */
 
 char    c;             /* Value from getopt_long(3)                      */
 char    cval;          /* Character holder for mode                      */
@@ -276,21 +293,13 @@ char    files[MAX_ARGS]; /* Input file name from command line            */
 char    base[MAX_FILES][128]; /* Input file name prefixes                */
 char    mode_str[MAX_FILES][32]; /* Input mode value strings             */
 
-float   lnr;           /* LN(R) value for polar-->Cartesian mapping      */
 float   norma;         /* Normalization value from FFT                   */
-float   fx, fy;        /* Floating point x,y Cartesian values            */
 float   radstep;       /* Radian step increment                          */
-float   **result;      /* Pointer for matrix which has final result      */
 float   rip[805];      /* Array holding rip file contents                */
 float   theta_step;    /* Theta angle increment                          */
-float   theta_degrees; /* Value of polar mapping theta angle in degrees  */
-float   theta_radians; /* Value of polar mapping theta angle in radians  */
-float   mat[MAX_DIM][MAX_DIM]; /* Individual radius loop result matrix   */
-float   vals[MAX_DIM][MAX_DIM]; /* Number of entries in a given x,y      */
 
 size_t	num_read;
 
-double  log_rad;       /* Log(2) of current radius                       */
 double  log_maxrad;    /* Log(2) of maximum radius                       */
 
 FILE    *tmp_file;    /* File input for first file to get sizes/norma    */
@@ -299,12 +308,100 @@ FILE    *file_list;   /* Directory listing from command line             */
 FILE    *rip_ptr;     /* Rip file pointer                                */
 
 astro   ast;          /* Class object for NCNMS astro_class library      */
+fits_pack pack;       /* I_ image compression/crop options (-Z)          */
+
+Image2D<float>  mat;    /* Individual radius loop result matrix [x][y]   */
+Image2D<float>  vals;   /* Number of entries in a given x,y              */
+Image2D<float>  result; /* Final result (FITS rows)                      */
 
 struct  stat    sb;   /* Structure for stat command to check files/dir   */
 
 fitsfile *fptr;       /* CFITSIO file pointer                            */
 
 
+//
+// BACK_PROJECT() - Maps the polar coordinates of the inverse transform back
+//                  to Cartesian.  The original mapping in P2DFFT makes radial
+//                  slices in small steps of theta, so this just reverses the
+//                  mapping.  Please note that some values are duplicated in
+//                  the polar version, so we need to account for this when
+//                  mapping back to cart.
+//
+// Arguments:
+//      out     - Inverse transform (normalized)
+//
+// Global Variables:
+//      finish, maxrad, radstep, theta_step, mat, vals
+//
+// Return Value: NONE
+//
+
+CPU_CLONES
+void    back_project(fftw_complex *out)
+    {
+    int     x, y;          /* Cartesian coordinates in mat                   */
+    int     counter=0;     /* Index value for mapping out[] to mat[][]       */
+    int     count_theta=1; /* Step counter for radial degrees                */
+    int     count_radians; /* Step counter for radial radians                */
+
+    float   lnr;           /* LN(R) value for polar-->Cartesian mapping      */
+    float   fx, fy;        /* Floating point x,y Cartesian values            */
+    float   theta_degrees; /* Value of polar mapping theta angle in degrees  */
+    float   theta_radians; /* Value of polar mapping theta angle in radians  */
+
+    double  log_rad=log((double)finish); /* Log of the ending radius        */
+
+//
+// Step around theta angles (360 degrees in 0.35 steps)
+//
+
+    for(theta_degrees=0.0;count_theta<=DIM_THT;theta_degrees+=theta_step) 
+        {
+        count_theta++;
+
+//
+// Convert the degrees to radians
+//
+
+        theta_radians=theta_degrees*GR_RAD;	
+        count_radians=1;
+
+        for(lnr=0.0;count_radians<=DIM_RAD;lnr+=radstep) 
+            {
+            count_radians++;
+            if(lnr>(double)log_rad) 
+                {
+                ++counter;
+                continue;
+                }
+
+            fx=exp(lnr)*cos(theta_radians);
+            fy=exp(lnr)*sin(theta_radians);
+
+            x=(int)fx+maxrad+1;
+            y=(int)fy+maxrad+1;
+
+//
+// If the data is valid, add the result to the master matrix and increment the
+//   number of values used.  This will be used to normalize the total value
+//   later.  Invalid values tend to occur at outer radii, but can happen in
+//   other places.  Having a NAN result in the image file is allowed, but
+//   causes programs to ds9 to display the data in a less useful way.
+//
+
+            if (!(out[counter][0]!=out[counter][0]))
+                {
+                mat[x][y]+=out[counter][0];
+                vals[x][y]+=1.0;
+
+                if (DEBUG) printf("Assign Mat[%d][%d]=%f,vals[%d][%d]=%f, Index=%d\n",x,y,out[counter][0],x,y,vals[x][y],counter);
+                }
+            ++counter;
+            }
+        }
+    }
+
+
 //
 // MAIN ROUTINE
 //
@@ -318,6 +415,8 @@ int main(int argc, char **argv)
     static struct option long_options[] =
         {
         {"verbose", no_argument,     0, 'v'},
+        {"cpu-report", no_argument,  0, 'C'},
+        {"compress", required_argument, 0, 'Z'},
         /* These options require an argument. */
         {"start",  optional_argument, 0, 's'},
         {"end",  optional_argument, 0, 'e'},
@@ -326,7 +425,7 @@ int main(int argc, char **argv)
         {0, 0, 0, 0}
         };
       
-    while ((c = getopt_long (argc, argv, "vfs:e:i:m:", long_options, &option_index)) != -1)
+    while ((c = getopt_long (argc, argv, "vfCs:e:i:m:Z:", long_options, &option_index)) != -1)
         {
         switch (c)
             {
@@ -335,6 +434,11 @@ int main(int argc, char **argv)
                 verbose = 1;
                 break;
                 }
+            case 'C':
+                {
+                cpu_rep=1;
+                break;
+                }
             case 's':
                 {
                 st=atoi(optarg);
@@ -356,9 +460,18 @@ int main(int argc, char **argv)
                 strcpy(fname,optarg);
                 break;
                 }
+            case 'Z':
+                {
+                if (ast.pack_option(optarg, &pack))
+                    {
+                    printf("ERROR: Invalid Compression Option %s...Exiting\n",optarg);
+                    exit(1);
+                    }
+                break;
+                }
             default:
                 {
-                fprintf(stderr, "Usage: p2ifft [-i|--input <file>] [-v|--verbose] [-s|--start <arg>] [-e|--end <arg>] [-m|--mode <n>[,<n>...]]\n");
+                fprintf(stderr, "Usage: p2ifft [-i|--input <file>] [-v|--verbose] [-s|--start <arg>] [-e|--end <arg>] [-m|--mode <n>[,<n>...]] [-C|--cpu-report] [-Z|--compress <opts>]\n");
                 exit(1);
                 break;
                 }
@@ -367,6 +480,14 @@ int main(int argc, char **argv)
 
     if (verbose) printf("p2ifft - Version: %s\n",VERSION);
 
+    if (cpu_rep)
+        {
+        const char *kernels[]={"back projection", NULL};
+
+        ast.cpu_report("p2ifft", kernels);
+        exit(0);
+        }
+
 //
 // Check the start and end values, if given.  Will adjust the default endpoint
 //   later, if it is too high.
@@ -566,29 +687,36 @@ int main(int argc, char **argv)
     fftw_plan   plan;
 
 //
-// Allocate the FFT arrays.  These need to be allocated with fftw_ functions
-//   since they are not C-style 2D arrays.
+// Allocate the FFT arrays (DIM_THT rows of DIM_RAD complex values, aligned
+//   for FFTW) and the Cartesian arrays.
 //
 
-    fftw_complex *in_data;
-    fftw_complex *out_data;
+    Spectrum<double>    in_spec;
+    Spectrum<double>    out_spec;
 
     if (verbose) printf("Allocating FFT Arrays...");
 
-    in_data = (fftw_complex *) fftw_malloc((DIM_RAD*DIM_THT+1) * sizeof(fftw_complex));
-    if(NULL == in_data)
+    if (in_spec.alloc(DIM_THT, DIM_RAD))
         {
         printf("ERROR: FFTW Memory allocation failed for in_data[]/n");
         exit(-1);
         }
 
-    out_data = (fftw_complex *) fftw_malloc((DIM_RAD*DIM_THT+1) * sizeof(fftw_complex));
-    if(NULL == out_data)
+    if (out_spec.alloc(DIM_THT, DIM_RAD))
         {
         printf("ERROR: FFTW Memory allocation failed for out_data[]/n");
         exit(-1);
         }
 
+    fftw_complex *in_data=in_spec.row(0);
+    fftw_complex *out_data=out_spec.row(0);
+
+    if (mat.alloc(MAX_DIM, MAX_DIM) || vals.alloc(MAX_DIM, MAX_DIM))
+        {
+        printf("ERROR: Memory allocation failed for mat[]/vals[]\n");
+        exit(-1);
+        }
+
 //
 // Build a plan for the FFT transform
 //
@@ -740,14 +868,9 @@ int main(int argc, char **argv)
 //   subset of them.  Needs to be done once for each new file/directory, not
 //   each radius.
 //
-        for (i=0; i < MAX_DIM; i++)
-            {
-            for (j=0; j < MAX_DIM; j++)
-                {
-                mat[i][j]=0.0;
-                vals[i][j]=0.0;
-                }
-            }
+
+        mat.zero();
+        vals.zero();
 
 //
 // Set up the dimension variables as these will be the same for each radius.
@@ -762,13 +885,8 @@ int main(int argc, char **argv)
 // Must completely zero the data arrays each time or you get incorrect results
 //
 
-        for(x=0;x<DIM_RAD*DIM_THT+1;x++)
-            {
-            in_data[x][0]=0.0;
-            in_data[x][1]=0.0;
-            out_data[x][0]=0.0;
-            out_data[x][1]=0.0;
-            }
+        in_spec.zero();
+        out_spec.zero();
 
 //
 // Loop for each radius.  Do the logarithm of the max radius outside the loop
@@ -950,86 +1068,31 @@ int main(int argc, char **argv)
             }
 
 //
-// Map the polar coordinates in out_data[][] to Cartesian. The original mapping 
-//   in P2DFFT makes radial slices in small steps of theta, so this just
-//   reverses the mapping.  Please note that some values are duplicated in the
-//   polar version, so we need to account for this when mapping back to cart.
+// Map the polar coordinates in out_data[][] to Cartesian (see back_project())
 //
 
         if (verbose) printf("Transform data lnr theta ---> X,Y\n");
-        counter=0;
-        count_theta=1;
-        log_rad=log((double)finish);
-
-//
-// Step around theta angles (360 degrees in 0.35 steps)
-//
-
-        for(theta_degrees=0.0;count_theta<=DIM_THT;theta_degrees+=theta_step) 
-            {
-            count_theta++;
-
-//
-// Convert the degrees to radians
-//
-
-            theta_radians=theta_degrees*GR_RAD;	
-            count_radians=1;
-
-            for(lnr=0.0;count_radians<=DIM_RAD;lnr+=radstep) 
-                {
-                count_radians++;
-                if(lnr>(double)log_rad) 
-                    {
-                    ++counter;
-                    continue;
-                    }
-
-                fx=exp(lnr)*cos(theta_radians);
-                fy=exp(lnr)*sin(theta_radians);
-
-                x=(int)fx+maxrad+1;
-                y=(int)fy+maxrad+1;
-
-//
-// If the data is valid, add the result to the master matrix and increment the
-//   number of values used.  This will be used to normalize the total value
-//   later.  Invalid values tend to occur at outer radii, but can happen in
-//   other places.  Having a NAN result in the image file is allowed, but
-//   causes programs to ds9 to display the data in a less useful way.
-//
 
-                if (!(out_data[counter][0]!=out_data[counter][0]))
-                    {
-                     mat[x][y]+=out_data[counter][0];
-    
-                     vals[x][y]+=1.0;
-
-                    if (DEBUG) printf("Radius: %d: Assign Mat[%d][%d]=%f,radius,vals[%d][%d]=%f, Index=%d\n",radius,x,y,out_data[counter][0],x,y,vals[x][y],counter);
-                    }
-                ++counter;
-                }
-            }
+        back_project(out_data);
 
 //
 // Need to create a matrix with the exact size and average data from all runs.
 //   This is needed because the CFITSIO libraries can return incorrect results
-//   if part of a larger array is used.  In addition, the matrix must have a
-//   contiguous memory space, so you the astro_class function to allocate.
+//   if part of a larger array is used.  The rows are written one at a time
+//   since they are padded (see image_class.h).
 //
 
         if (verbose) printf("Creating Output File...\n");
 
-        result = ast.ArrayAlloc(dim,dim);
-
-        for(i=0;i<dim;i++)
+        if (result.alloc(dim,dim))
             {
-            for(j=0;j<dim;j++)
-                {
-                result[i][j]=0.0;
-                }
+            printf("WARNING: Memory allocation failed for %s result...Skipping\n",base[looper]);
+            err_cnt++;
+            continue;
             }
 
+        result.zero();
+
 //
 // Normalize the values
 //
@@ -1080,17 +1143,32 @@ int main(int argc, char **argv)
         sprintf(cmd,"rm -f %s",outfile);
         status=system(cmd);
 
-        fits_create_file(&fptr,outfile, &status);
+        if ((pack.type != FITS_PACK_NONE) || (pack.crop))
+            {
+            pack.nthreads=omp_get_max_threads();
+            if (ast.fits_write(outfile, result.view(), &pack, "p2ifft/", VERSION))
+                {
+                printf("WARNING: fits_write(%s) Failed\n",outfile);
+                }
+            }
+        else
+            {
+            fits_create_file(&fptr,outfile, &status);
 
-        fits_create_img(fptr,FLOAT_IMG,naxis,naxes, &status);
+            fits_create_img(fptr,FLOAT_IMG,naxis,naxes, &status);
 
-        fits_write_img(fptr,TFLOAT,1,dim*dim,result[0],&status);
+            for (i=0; i < dim; i++)
+                {
+                fpixel[1]=i+1;
+                fits_write_pix(fptr,TFLOAT,fpixel,(long)dim,result[i],&status);
+                }
 
-        fits_close_file(fptr, &status);
+            fits_close_file(fptr, &status);
 
-        fits_report_error(stderr,status);
+            fits_report_error(stderr,status);
+            }
     
-        free(result);
+        result.release();
         }
 
 //
@@ -1098,8 +1176,6 @@ int main(int argc, char **argv)
 //
 
     fftw_destroy_plan(plan);
-    fftw_free(in_data);
-    fftw_free(out_data);
 
     if (file_list) fclose(file_list);
     if (verbose) printf("Closing....\n");
@@ -3,9 +3,10 @@
 //             galaxy images.  The output files will have the prefix M_ added
 //             to avoid collisions.  It will also produce a text table showing
 //             the mapping of the polar coordinates to cartesian X, Y values.
+//             The files are mapped in parallel, one file per thread.
 //
 //
-//  Version 1.2: 03-May-2019
+//  Version 2.0: 17-Oct-2026
 //
 //
 //  2DFFT (Original) Author: Dr. Ivanio Puerari
@@ -58,19 +59,44 @@
 //      patrick.treuthardt@naturalsciences.org
 //
 //
-//  Usage: p2map [-i|--input <file>] [-v|--verbose] [<args>]
+//  Usage: p2map [-i|--input <file>] [-v|--verbose] [-Z|--compress <opts>]
+//               [<args>]
 // 
 //         There are several non-mandatory options:
 //              -i|--input  : Will read file names, results file, and radius
 //                            from the file specified with this option instead
-//                            of standard input.
+//                            of the command line (same format as p2dfft -i).
+//                            A radius in the file is used if it fits in the
+//                            image.
 //              -v|--verbose: Prints status messages during the
 //                            processing (good for those who like to see
 //                            things during a run).
+//              -Z|--compress: Write the M_, P_ and R_ images tile
+//                            compressed and/or cropped to the part that is
+//                            not 0 or NaN.  <opts> is a comma separated list
+//                            of rice, gzip, none, q=<val>, tile=<rows>,
+//                            nodither and crop (same as p2dfft -Z).  The
+//                            tiles are compressed by the thread mapping the
+//                            file.
 //
 //
 //  Version History:
 //
+//      2.0  17-Oct-2026 - Read each image into a per run arena that is reset
+//                         for every file instead of a new buffer per file
+//                       - Use Image2D for mat and polar (image_class.h)
+//                       - Fix -i (the input file was never read)
+//                       - Map the files in parallel with per thread buffers
+//                       - Use the polar table shared with p2dfft
+//                         (polar_class)
+//                       - Write the M_ and R_ files at the image size
+//                         instead of MAX_DIM x MAX_DIM
+//                       - Build the T_ table in memory and write it at once
+//                       - Add -Z|--compress option for tile compressed
+//                         and/or cropped M_, P_ and R_ images
+//                       - Print the messages of the parallel files in one
+//                         piece (say())
+//                       - Map one file at a time if cfitsio is not reentrant
 //      1.2  03-May-2019 - Correct header comments
 //      1.1  13-Nov-2018 - Update error messages to be more consistent
 //                       - Correct error handling bug
@@ -96,11 +122,15 @@
 #include    <stdio.h>
 #include    <stdlib.h>
 #include    <string.h>
+#include    <stdarg.h>
 #include    <errno.h>
 #include    <sys/types.h>
 #include    <sys/stat.h>
 #include    <unistd.h>
 #include    <getopt.h>
+#include    <omp.h>
+#include    <vector>
+#include    <string>
 
 //
 // Include the Astro Functions Class
@@ -108,11 +138,17 @@
 
 #include    "astro_class.h"
 
+//
+// Include the Polar Sampling Table Class
+//
+
+#include    "polar_class.h"
+
 //
 // Version number
 //
 
-#define     VERSION     "1.2/20190503"
+#define     VERSION     "2.0/20261017"
 
 //
 // Set this flag to #define to get a data matrix debugging information.  This
@@ -138,50 +174,39 @@
 
 int     c;                 /* Return value for command line options parser   */
 int     fn;                /* Argument index                                 */
-int     lim;               /* Initialization size for fft_sum                */
 int     num;               /* Number of threads on the host machine          */
-int     a, b;              /* Cartesian coordinates of ln(r)/theta in image  */
-int     pflag;             /* Table printing flag                            */
-int     msize;             /* Binary FITS file data size                     */
-int     jm, im;            /* Local index variables                          */
-int     radius;            /* Radius for current file                        */
-int     status;            /* Return value for scanx() and system() calls    */
-int     items=0;           /* Number of files processed                      */
-int     i, j, k;           /* Index variables                                */
-int     counter;           /* Counter for output array                       */
-int     core_val;          /* Core brightness value                          */
-int     x_0, y_0;          /* Carteian coordinates for the image center      */
 int     verbose=0;         /* Flag for printing of status messages           */
-int     count_theta;       /* Counter for theta steps in degrees             */
 int     proc_error=0;      /* Input file error count                         */
 int     input_file=0;      /* Flag to indicate if input file is used         */
-int     x_dim, y_dim;      /* The cartesian dimensions of the input file     */
-int     count_radians;     /* Counter for theta steps in radians             */
 
-char    *tmp;              /* Pointer to string for integer conversion       */
-char    cmd[128];          /* Buffer for system(2) commands                  */
 char    infile[80];        /* Input filename for -i                          */
-char    fname[128];        /* FITS filename                                  */
-
-FILE    *table;            /* Output mapping table file pointer              */
-FILE    *fp_inp;           /* Input file pointer                             */
-    
-float   lnr;               /* Natural log of radius for a certain point      */
-float   x, y;              /* Relative cartesian coordinates of ln(r)/theta  */
-float   **mat;             /* 2D cartesian image data                        */
-float   *data;             /* Polar mapped image data matrix                 */
-float   **polar;           /* 2D cartesian output image data                 */
-float   log_tmp;           /* The natural log of the current radius value    */
-float   log_rad;           /* The natural log of the current radius value    */
-float   log_itrad;         /* The natural log of the maximum radius value    */
-float   freq_counter;      /* Frequency counter value                        */
-float   theta_degrees;     /* Current theta (polar angle) in degrees         */
-float   theta_radians;     /* Current theta (polar angle) in radians         */
+
+fits_pack pack;            /* Image compression/crop options (-Z)            */
 
 const   float   radstep=2.0*PI/STEP_P/DIM_RAD;    /*                         */
 const   float   theta_step=2.0*PI/GR_RAD/DIM_THT; /*                         */
 
 astro   ast;               /* Instantiation of astro_class functions         */
+logpolar    pol;           /* Polar sampling table shared by all images      */
+
+std::vector<file_rec>   items;  /* Files to process (-i file or arguments)   */
+
+//
+// Per thread state.  Each thread maps one image at a time into its own
+//   buffers, which keep the size of the largest image it has seen.
+//
+
+astro           *asts;     /* astro_class instance per thread                */
+arena           *mems;     /* Per file buffers (reset for every file)        */
+Image2D<float>  *mats;     /* 2D cartesian image data [x][y]                 */
+Image2D<float>  *polars;   /* 2D polar output image data [ln r][theta]       */
+
+//
+// FUNCTION PROTOTYPES
+//
+
+int     map_item(file_rec *f, int th);
+void    say(const char *fmt, ...);
         
 
 //
@@ -202,13 +227,14 @@ int main(int argc, char **argv)
         {
         {"verbose", no_argument,     0, 'v'},
         /* These options require an argument. */
-        {"input", optional_argument, 0, 'i'},
+        {"input", required_argument, 0, 'i'},
+        {"compress", required_argument, 0, 'Z'},
         {0, 0, 0, 0}
         };
 
     int option_index = 0;
 
-    while ((c = getopt_long (argc, argv, "vi:", long_options, &option_index)
+    while ((c = getopt_long (argc, argv, "vi:Z:", long_options, &option_index)
 ) != -1)
         {
         switch (c)
@@ -226,42 +252,27 @@ int main(int argc, char **argv)
                     printf("ERROR: Input File %s Not Found...Exiting\n",optarg);
                     exit(-1);
                     }
-                strcpy(infile, optarg);
+                strncpy(infile, optarg, sizeof(infile)-1);
+                break;
+                }
+            case 'Z':
+                {
+                if (ast.pack_option(optarg, &pack))
+                    {
+                    printf("ERROR: Invalid Compression Option %s...Exiting\n",optarg);
+                    exit(-1);
+                    }
                 break;
                 }
             default:
                 {
-                fprintf(stderr, "Usage: p2map [-v|--verbose] [-i <file>] [<n>[,<n>...]]\n");
+                fprintf(stderr, "Usage: p2map [-v|--verbose] [-i <file>] [-Z|--compress <opts>] [<file> ...]\n");
                 exit(-1);
                 break;
                 }
             }
         }
 
-//
-// Allocate the Cartesian data arrays.  Also, zero out the first cell of mat 
-//   because FITS image indices start at 1.  Please Note:  ArrayAlloc()
-//   allocates a contiguous C-style array.
-//
-
-    if (verbose) printf("Allocating Cartesian mat[] Array...\n");
-
-    if (!(mat=ast.ArrayAlloc(MAX_DIM, MAX_DIM)))
-        {
-        if (mat != NULL) free(mat);
-        printf("ERROR: Memory allocation failed while allocating for mat[]/n");
-        exit(-1);
-        }
-
-    if (verbose) printf("Allocating Cartesian polar[] Array...\n");
-
-    if (!(polar=ast.ArrayAlloc(DIM_RAD, DIM_THT)))
-        {
-        if (polar != NULL) free(polar);
-        printf("ERROR: Memory allocation failed while allocating for polar[]/n");
-        exit(-1);
-        }
-
 //
 // Read the input parameters for the analysis.  The input parameters will 
 //   include:
@@ -278,12 +289,12 @@ int main(int argc, char **argv)
 
     if (input_file)
         {
-        if (1)
+        if (ast.read_lines(std::string(infile), &items))
             {
             std::cout << "ERROR: Can't Read File Name: " << infile << std::endl;
             exit(-1);
             }
-        if ((items==0))
+        if ((items.size()==0))
             {
             std::cout << "ERROR: No Valid Items in Input File: " << infile << std::endl;
             exit(-1);
@@ -299,99 +310,200 @@ int main(int argc, char **argv)
 
         if (optind >= argc)
             {
-//
-// No command line arguments for files, so read from stdin.  Assume old
-//   style 2DFFT input format here.
-//
-
-            std::cout << "ERROR: No valud arguments...Exiting" << std::endl;
+            std::cout << "ERROR: No valid arguments...Exiting" << std::endl;
             exit(-1);
             }
+
 //
-// Get the command line arguments and put them in vector of items
+// Get the command line arguments and put them in vector of items.  The
+//   radius is found from the image size.
 //
 
         for (fn=optind; fn < argc; fn++)
             {
-            items++;
             if (DEBUG) printf("argv[%d]=%s\n",fn,argv[fn]);
 
-            if (!(ast.file_exists(argv[fn])))
-                {
-                std::cout << "WARNING: " << argv[fn] << " Does Not Exist...Skipping" << std::endl;
-                proc_error++;
-                continue;
-                }
+            file_rec    f;
+            f.name=argv[fn];
+            f.radius=-1;
+            items.push_back(f);
+            }
+        }
 
-            if (ast.file_type(argv[fn]) != ASTRO_BIN_FILE)
-                {
-                std::cout << "WARNING: Can't Get File Type: " << argv[fn] << " Skipping..." << std::endl;
-                proc_error++;
-                continue;
-                }
+//
+// Build the polar sampling table.  It does not depend on the image, so it is
+//   built once and shared by every image (the same table p2dfft uses).
+//
 
-            x_dim=0;
-            y_dim=0;
+    if (pol.build())
+        {
+        printf("ERROR: Memory allocation failed while building polar table\n");
+        exit(-1);
+        }
+
+//
+// Allocate the per thread buffers.  The polar arrays have a fixed size; the
+//   Cartesian arrays are sized for each image (see map_item()).
+//
+
+    num=omp_get_max_threads();
+    if (num > (int) items.size()) num=(int) items.size();
+    if (num < 1) num=1;
+
+    if (verbose) printf("Mapping %u Files With %d Threads...\n",(unsigned int)items.size(),num);
+
+    asts=new astro[num];
+    mems=new arena[num];
+    mats=new Image2D<float>[num];
+    polars=new Image2D<float>[num];
+
+    for (fn=0; fn < num; fn++)
+        {
+        asts[fn].set_warn(1);
+
+        if (polars[fn].alloc(DIM_RAD, DIM_THT))
+            {
+            printf("ERROR: Memory allocation failed while allocating for polar[]\n");
+            exit(-1);
+            }
+        }
+
+//
+// Map the files.  Each file is independent, so the threads take them one at
+//   a time (images may be of very different sizes).  A cfitsio library built
+//   without --enable-reentrant maps them one at a time.
+//
+
+#pragma omp parallel for num_threads(num) schedule(dynamic,1) reduction(+:proc_error) if (fits_is_reentrant())
+    for (int it=0; it < (int) items.size(); it++)
+        {
+        proc_error+=map_item(&items[it], omp_get_thread_num());
+        }
 
-            std::cout << "Processing Entry - Name: " << argv[fn] << std::endl;
+    delete [] polars;
+    delete [] mats;
+    delete [] mems;
+    delete [] asts;
+
+    printf("-------------------------------\n");
+    printf("Successfuly Processed        %d\n",(int)items.size()-proc_error);
+    printf("Errors                       %d\n",proc_error);
+    }
+
+//
+// MAP_ITEM() - Maps one image to polar coordinates and back, writing the
+//              M_, T_, P_ and R_ files for it.  Runs in parallel; everything
+//              it changes belongs to thread th.
+//
+// Arguments:
+//      f       - File to map.  A radius > 0 is used (up to the largest that
+//                fits in the image), otherwise it is found from the size.
+//      th      - Thread number (selects the per thread buffers)
+//
+// Global Variables:
+//      asts, mems, mats, polars - Per thread state
+//      pol                     - Polar sampling table
+//      verbose                 - Status message flag
+//
+// Return Value:
+//      0 on success, otherwise the number of errors (the file is counted
+//        once if it can't be read)
+//
+
+int     map_item(file_rec *f, int th)
+    {
+    int     i, j;              /* Index variables                                */
+    int     t, rr;             /* Theta and ln r steps in the polar table        */
+    int     a, b;              /* Cartesian coordinates of ln(r)/theta in image  */
+    int     msize;             /* Binary FITS file data size                     */
+    int     radius;            /* Radius for current file                        */
+    int     errs=0;            /* Errors writing the output files                */
+    int     counter;           /* Counter for input array                        */
+    int     core_val;          /* Core brightness value                          */
+    int     x_0, y_0;          /* Carteian coordinates for the image center      */
+    int     x_dim, y_dim;      /* The cartesian dimensions of the input file     */
+    int     r_first, r_last;   /* ln r steps inside the radius                   */
+    int     len;               /* Length of one table line                       */
+    char    fname[FILENAME_MAX+8]; /* Output FITS/table filename                 */
+    char    *name=(char *) f->name.c_str(); /* Input filename                    */
+    float   *data;             /* FITS image data                                */
+    float   log_rad;           /* The natural log of the current radius value    */
+    float   theta_degrees;     /* Current theta (polar angle) in degrees         */
+    float   theta_radians;     /* Current theta (polar angle) in radians         */
+    float   cs, sn;            /* Cosine and sine of theta                       */
+    FILE    *table;            /* Output mapping table file pointer              */
+    std::string     text;      /* Mapping table, written with one call           */
+    char    line[128];         /* One line of the mapping table                  */
+
+    astro           &ast=asts[th];
+    Image2D<float>  &mat=mats[th];
+    Image2D<float>  &polar=polars[th];
+
+    mems[th].reset();
+
+    if (!(ast.file_exists(name)))
+        {
+        say("WARNING: %s Does Not Exist...Skipping\n",name);
+        return(1);
+        }
+
+    if (ast.file_type(f->name) != ASTRO_BIN_FILE)
+        {
+        say("WARNING: Can't Get File Type: %s Skipping...\n",name);
+        return(1);
+        }
+
+    say("Processing Entry - Name: %s\n",name);
 
 // 
 // Read the data from the image and determine the radius
 //
 
-            
-            if (!(data=ast.fits_read(argv[fn], &msize)))
-                {
+    if (!(data=ast.fits_read(name, &mems[th], &msize)))
+        {
 //
 // Read Failure
 //
 
-                std::cout << "WARNING: Can't Read FITS Binary File: " << argv[fn] << " Skipping..." << std::endl;
-                proc_error++;
-                continue;
-                }
+        say("WARNING: Can't Read FITS Binary File: %s Skipping...\n",name);
+        return(1);
+        }
 
-//
-// Get the radius
-//
+    x_dim=0;
+    y_dim=0;
 
-            if (ast.fits_dims(argv[fn],&x_dim, &y_dim))
-                {
+    if (ast.fits_dims(f->name, &x_dim, &y_dim))
+        {
 //
 // Failure to get size from Header
 //
 
-                std::cout << "ERROR: Can't Read FITS Dimensions for " << argv[fn] << " Skipping..." << std::endl;
-                proc_error++;
-                continue;
-                }
+        say("ERROR: Can't Read FITS Dimensions for %s Skipping...\n",name);
+        return(1);
+        }
 
-            printf("FITS DIMS: X_DIM=%d, Y_DIM=%d\n",x_dim, y_dim);
+    if (verbose) say("FITS DIMS: %s X_DIM=%d, Y_DIM=%d\n",name, x_dim, y_dim);
 
 //
-// Find radius
+// Find radius.  A radius from the input file is kept inside the image.
 //
 
-            if ( x_dim < y_dim )
-                {
-                radius=(x_dim-1)/2;
-                }
-            else
-                {
-                radius=(y_dim-1)/2;
-                }
+    radius=((x_dim < y_dim) ? x_dim-1 : y_dim-1)/2;
+
+    if ((f->radius > 0) && (f->radius < radius)) radius=f->radius;
 
 //
-// Zero output array
+// Size the Cartesian array for this image (index 0 is not used because FITS
+//   image indices start at 1) and zero the polar array
 //
 
-            for (i=0; i < DIM_THT; i++)
-                {
-                for (j=0; j < DIM_RAD; j++)
-                    {
-                    polar[j][i]=0.0;
-                    }
-                }
+    if (mat.fit(x_dim+1, y_dim+1))
+        {
+        say("ERROR: Memory allocation failed while allocating for mat[] (%s)\n",name);
+        return(1);
+        }
+
+    polar.zero();
 
 //
 // Copy the FITS data into the mat 2D Cartesian array.  Need to take this from
@@ -400,173 +512,183 @@ int main(int argc, char **argv)
 //
 
 #ifdef DEBUG_DAT
-            for(i=0;i<(DIM_RAD*DIM_THT*2+2); i++)
-                {
-                printf("DEBUG: data[%d]=%f\n",i,data[i]);
-                }
+    for(i=0;i<msize; i++)
+        {
+        printf("DEBUG: data[%d]=%f\n",i,data[i]);
+        }
 #endif
 
-            counter=0;
-            for(j=1;j<=y_dim;j++) 
-                {
-                for(i=1;i<=x_dim;i++)
-                    {
-                    mat[i][j]=data[counter++];
+    counter=0;
+    for(j=1;j<=y_dim;j++) 
+        {
+        for(i=1;i<=x_dim;i++)
+            {
+            mat[i][j]=data[counter++];
 
 #ifdef DEBUG_MAT
-                    printf("DEBUG: mat[%d][%d]=%f\n",i,j,mat[i][j]);
+            printf("DEBUG: mat[%d][%d]=%f\n",i,j,mat[i][j]);
 #endif
 
-                    }
-                }
+            }
+        }
 
 //
 // Print out the intermediate matrix.  NOTE: since the row/column has been
-//   changed, it will have a rotation in the image.
+//   changed, it will have a rotation in the image.  Only the image itself
+//   (not row and column 0) is written.
 //
 
-            sprintf(fname,"!M_%s.fits",argv[fn]);
-
-            if (ast.fits_write(fname, mat[0], MAX_DIM, MAX_DIM, 1, "p2map/",VERSION))
-                {
-                printf("ERROR: fits_write(%s) Failed\n",fname);
-                proc_error++;
-                }
-
-            sprintf(fname,"T_%s.txt",argv[fn]);
-
-            if ((table=fopen(fname,"w"))==NULL)
-                {
-                printf("ERROR: Could Not Write T_%s.txt\n",fname);
-                exit(1);
-                }
+    snprintf(fname,sizeof(fname),"!M_%s.fits",name);
 
-            fprintf(table,"File Mapping: %s\n", fname);
+    if (ast.fits_write(fname, mat.view().sub(1, 1, x_dim, y_dim), &pack, "p2map/",VERSION))
+        {
+        say("ERROR: fits_write(%s) Failed\n",fname);
+        errs++;
+        }
 
-            if (verbose) std::cout << "Processing Entry - Name: " << argv[fn] << " Radius: " << radius << std::endl;
+    if (verbose) say("Processing Entry - Name: %s Radius: %d\n",name,radius);
 
 //
 // Use (dim-1)/2 for each dimension.  This makes it work for both odd and even
 //   sized images.  Need to calculate both because image may not be rectangular.
 //
 
-            x_0=((x_dim-1)/2)+1;
-            y_0=((y_dim-1)/2)+1;
-            fprintf(table,"X_0=%d, Y_0=%d\n",x_0,y_0);
-            fprintf(table,"Radius\tln(R)\tX\tY\tRel X\tRel Y\n");
-            fprintf(table,"------\t-----\t-\t-\t-----\t-----\n");
+    x_0=((x_dim-1)/2)+1;
+    y_0=((y_dim-1)/2)+1;
 
 //
-// log() functions are computationally expensive, so calculate the logs
-//   outside of the loop.
+// The ln r steps inside the radius come from the polar table (ln r values
+//   above ln(radius) are not sampled)
 //
 
-            log_rad=log((double)radius);
-            log_tmp=log((double)76);
+    log_rad=log((double)radius);
+    pol.rad_range(0.0, log_rad, &r_first, &r_last);
 
 //
-// Step around theta angles (360 degrees in 0.35 steps)
+// Build the mapping table (theta=0) in memory and write it with one call.
+//   At theta=0 the offsets are those of the first row of the polar table.
 //
 
-            core_val=mat[x_0][y_0];
-            pflag=1;
-            count_theta=0;
-            for(theta_degrees=0.0;count_theta<DIM_THT;theta_degrees+=theta_step) 
-                {
+    snprintf(fname,sizeof(fname),"T_%s.txt",name);
+
+    snprintf(line,sizeof(line),"File Mapping: %s\n",fname);
+    text=line;
+    snprintf(line,sizeof(line),"X_0=%d, Y_0=%d\n",x_0,y_0);
+    text+=line;
+    text+="Radius\tln(R)\tX\tY\tRel X\tRel Y\n";
+    text+="------\t-----\t-\t-\t-----\t-----\n";
+
+    text.reserve(text.size()+(size_t)(r_last-r_first)*64);
+
+    for (rr=r_first; rr < r_last; rr++)
+        {
+        a=pol.dx[rr]+x_0;
+        b=pol.dy[rr]+y_0;
+        len=snprintf(line,sizeof(line),"%f\t%f\t%d\t%d\t%d\t%d\n",expf((float)radius),pol.lnr[rr],a,b,a-x_0,b-y_0);
+        text.append(line, len);
+        }
+
+    if (((table=fopen(fname,"w"))==NULL) || (fwrite(text.data(), 1, text.size(), table) != text.size()))
+        {
+        say("ERROR: Could Not Write %s\n",fname);
+        errs++;
+        }
+
+    if (table) fclose(table);
 
 //
-// Convert the degrees to radians
+// Step around theta angles (360 degrees in 0.35 steps).  Only values below
+//   the core brightness are mapped.
 //
 
-                theta_radians=theta_degrees*GR_RAD;	
-                count_radians=0;
+    core_val=mat[x_0][y_0];
 
-                for(lnr=0.0;count_radians<DIM_RAD;lnr+=radstep) 
-                    {
-                    if (lnr>log_rad)
-                        {
-                        count_radians++;
-                        continue;
-                        }
-                    x=expf(lnr)*cosf(theta_radians);
-                    y=expf(lnr)*sinf(theta_radians);
-
-                    a=(int)x+x_0;
-                    b=(int)y+y_0;
-
-                    if (mat[a][b] < core_val - 3)
-                        polar[count_radians][count_theta]=(float) mat[a][b];
-                    
-                    if (pflag) fprintf(table,"%f\t%f\t%d\t%d\t%d\t%d\n",expf((float)radius),lnr,a,b,a-x_0,b-y_0);
-                    count_radians++;
-                    }
-                pflag=0;
-                count_theta++;
-                }
+    for (t=0; t < DIM_THT; t++)
+        {
+        for (rr=r_first; rr < r_last; rr++)
+            {
+            a=pol.dx[t*pol.n_rad+rr]+x_0;
+            b=pol.dy[t*pol.n_rad+rr]+y_0;
+
+            if (mat[a][b] < core_val - 3)
+                polar[rr][t]=(float) mat[a][b];
+            }
+        }
 
 //
-// Do a reverse mapping Step around theta angles (360 degrees in 0.35 steps)
+// Do a reverse mapping Step around theta angles (360 degrees in 0.35 steps).
+//   This one is linear in ln r, so it is not in the polar table.
 //
 
-            count_theta=0;
-            for(theta_degrees=0.0;count_theta<DIM_THT;theta_degrees+=theta_step) 
-                {
-
+    theta_degrees=0.0;
+    for (t=0; t < DIM_THT; t++)
+        {
 //
 // Convert the degrees to radians
 //
 
-                theta_radians=theta_degrees*GR_RAD;	
-                count_radians=0;
+        theta_radians=theta_degrees*GR_RAD;	
+        cs=cosf(theta_radians);
+        sn=sinf(theta_radians);
+
+        for (rr=r_first; rr < r_last; rr++)
+            {
+            a=(int)(pol.lnr[rr]*cs)+x_0;
+            b=(int)(pol.lnr[rr]*sn)+y_0;
+
+            mat[a][b]=polar[rr][t];
+            }
+        theta_degrees+=theta_step;
+        }
 
-                for(lnr=0.0;count_radians<DIM_RAD;lnr+=radstep) 
-                    {
-                    if (lnr>log_rad)
-                        {
-                        count_radians++;
-                        continue;
-                        }
-                    x=lnr*cosf(theta_radians);
-                    y=lnr*sinf(theta_radians);
-
-                    a=(int)x+x_0;
-                    b=(int)y+y_0;
-
-                    mat[a][b]=polar[count_radians][count_theta];
-                    
-                    count_radians++;
-                    }
-                count_theta++;
-                }
 //
 // Now create a FITS file using the astro_class libraries.  Please note that 
 //   when the new flag is set to 1 it will overwrite any existing file with
 //   with the same name.
 //
   
-            if (verbose) printf("  --- Write P_%s.fits File\n",argv[fn]);
+    if (verbose) say("  --- Write P_%s.fits File\n",name);
 
-            sprintf(fname,"!P_%s.fits",argv[fn]);
+    snprintf(fname,sizeof(fname),"!P_%s.fits",name);
 
-            ast.set_warn(1);
-            if (ast.fits_write(fname, polar[0], 1024, 2048, 1, "p2map/",VERSION))
-                {
-                printf("ERROR: fits_write(%s) Failed\n",fname);
-                proc_error++;
-                }
-            sprintf(fname,"!R_%s.fits",argv[fn]);
+    if (ast.fits_write(fname, polar.view(), &pack, "p2map/",VERSION))
+        {
+        say("ERROR: fits_write(%s) Failed\n",fname);
+        errs++;
+        }
 
-            ast.set_warn(1);
-            if (ast.fits_write(fname, mat[0], MAX_DIM, MAX_DIM, 1, "p2map/",VERSION))
-                {
-                printf("ERROR: fits_write(%s) Failed\n",fname);
-                proc_error++;
-                }
-            fclose(table);
-            }
+    snprintf(fname,sizeof(fname),"!R_%s.fits",name);
+
+    if (ast.fits_write(fname, mat.view().sub(1, 1, x_dim, y_dim), &pack, "p2map/",VERSION))
+        {
+        say("ERROR: fits_write(%s) Failed\n",fname);
+        errs++;
         }
 
-    printf("-------------------------------\n");
-    printf("Successfuly Processed        %d\n",items-proc_error);
-    printf("Errors                       %u\n",proc_error);
+    return(errs);
+    }
+
+
+//
+// SAY() - Prints a printf() formatted message in one piece.  The files are
+//         mapped in parallel, so the messages of the threads are printed one
+//         at a time.
+//
+// Arguments:
+//      fmt     - printf() format, followed by its values
+//
+// Return Value: NONE
+//
+
+void    say(const char *fmt, ...)
+    {
+    char    buf[FILENAME_MAX+128]; /* Formatted message                      */
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+#pragma omp critical (p2map_out)
+    fputs(buf, stdout);
     }
@@ -0,0 +1,683 @@
+//
+// P2OVERLAY.CPP - This program draws the spiral arms measured by P2DFFT onto
+//                 the galaxy images, for checking the results by eye.  The
+//                 pitch angle and mode of each galaxy are read from the p2pa
+//                 result table and the phase from the p2dfft per mode output
+//                 file.  The arms are drawn with the p2spiral arm equations
+//                 (spiral_class).  The galaxies are done in parallel, one
+//                 galaxy per thread, and written as FITS or PNG images.
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// 2DFFT (original) Author: Dr. Ivanio Puerari
+//                          Instituto Nacional de Astrofisica,
+//                          Optica y Electronica,
+//                          Santa Maria Tonantzintla,
+//                          Puebla, Mexico
+//
+// 2DFFT (revised) Lead Author: Dr. Marc Seigar
+//                              University of Minnesota Duluth,
+//                              Duluth, MN USA
+//
+// 2DFFT (progenitor of P2DFFT) Lead Author: Dr. Benjamin Davis
+//                                           Swinburne University of Technology.
+//                                           Centre for Astrophysics and
+//                                           Supercomputing
+//                                           Melbourne, Victoria, Australia
+//                                       http://d.umn.edu/~msseigar/2DFFT.html
+//
+// P2DFFT By: Ian Hewitt & Dr. Patrick Treuthardt,
+//            NC Museum of Natural Sciences,
+//            Astronomy & Astrophysics Lab,
+//            Raleigh, NC USA.
+//            http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//     North Carolina Museum of Natural Sciences
+//     Astronomy & Astrophysics Laboratory
+//     11 West Jones Street
+//     Raleigh, NC, 27601  USA
+//     +1.919.707.9800
+//
+//     -- or --
+//
+//     patrick.treuthardt@naturalsciences.org
+//
+//
+// Usage: p2overlay [-R|--results <file>] [-d|--dir <dir>] [-o|--outdir <dir>]
+//                  [-f|--format png|fits] [-w|--width <pixels>] [-l|--log]
+//                  [-v|--verbose] [-C|--cpu-report]
+//
+//              -R|--results: p2pa result table (default Results.csv)
+//              -d|--dir   : Directory with the galaxy images and the p2dfft
+//                           output files (default current directory)
+//              -o|--outdir: Directory for the overlay images (default the
+//                           -d directory)
+//              -f|--format: png (default) for an 8 bit image with the arms in
+//                           red, or fits for the galaxy image with the arm
+//                           pixels set to the image maximum
+//              -w|--width : Arm width added on each side in pixels (0 to 10,
+//                           default 1)
+//              -l|--log   : Log scale for the PNG gray levels (default
+//                           linear from the image minimum to maximum)
+//              -v|--verbose : Print the arms used for each galaxy
+//              -C|--cpu-report: Show the CPU and the code path (sse2, avx2
+//                           or avx512f) the arm renderer runs, then exit
+//
+//
+// Input Files:
+//
+//      For every line of the result table (File, Start, End, Mode, Pitch
+//      Angle) the program reads:
+//
+//          <dir>/<File>.fits    - Galaxy image
+//          <dir>/<File>_m<Mode> - p2dfft per radius results of the mode
+//
+//      and writes <outdir>/<File>_overlay.png (or .fits).
+//
+//
+// Arms:
+//
+//      The phase of each radius in the p2dfft output is the angle of the
+//      arm pattern at r=1 (ln r = 0) for the pitch at that radius.  The
+//      phases of the radii Start to End are averaged (weighted by their
+//      amplitude, modulo 360/Mode).  Mode arms of the result pitch angle
+//      then start at radius Start (the bar radius used by p2pa) at the
+//      angle that puts them through that phase, and are drawn out to the
+//      edge of the image about the image center.
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//
+
+#define     VERSION "1.0/20261017"
+
+//
+// HEADER FILES
+//
+
+#include    <math.h>
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <getopt.h>
+#include    <omp.h>
+#include    <png.h>
+#include    <vector>
+#include    <string>
+
+#include    "globals.h"
+#include    "astro_class.h"
+#include    "spiral_class.h"
+
+//
+// CONSTANTS
+//
+
+#define     DEF_RESULTS "Results.csv" /* Default p2pa result table           */
+#define     OV_SWEEP    36000.0  /* Longest arm (degrees) for small pitches  */
+#define     MAX_WIDTH   10       /* Largest -w|--width                       */
+#define     STR_SIZE    256      /* Maximum characters in input line/names   */
+
+//
+// One galaxy of the result table
+//
+
+struct  ov_rec
+    {
+    std::string name;      /* File column (galaxy image without .fits)      */
+    int     start, end;    /* Range of annuli used by p2pa                   */
+    int     mode;          /* Mode (number of arms)                          */
+    float   pa;            /* Pitch angle                                    */
+    };
+
+//
+// VARIABLES
+//
+
+int     c;                 /* Getopt_long return value                       */
+int     num;               /* Number of threads used                         */
+int     verbose=0;         /* Flag for verbose mode                          */
+int     cpu_rep=0;         /* Flag for -C|--cpu-report                       */
+int     fits=0;            /* Write FITS instead of PNG (-f fits)            */
+int     log_scale=0;       /* Log scale for the PNG gray levels (-l)         */
+int     width=1;           /* Arm width on each side in pixels (-w)          */
+int     errcnt=0;          /* Galaxies that could not be drawn               */
+
+char    line[STR_SIZE];    /* Input line                                     */
+char    rname[STR_SIZE]=DEF_RESULTS; /* Result table (-R)                    */
+char    dir[STR_SIZE]=".";  /* Input directory (-d)                          */
+char    odir[STR_SIZE];    /* Output directory (-o)                          */
+
+FILE    *fp;               /* Result table stream                            */
+
+astro   ast;               /* Instantiation of astro_class                   */
+
+std::vector<ov_rec> items; /* Galaxies to draw                               */
+
+//
+// Per thread state
+//
+
+astro           *asts;     /* astro_class instance per thread                */
+spiral          *sps;      /* Arm drawing per thread                         */
+Image2D<float>  *mats;     /* Galaxy image per thread ([y][x])               */
+Image2D<float>  *masks;    /* Arm pixels per thread ([y][x])                 */
+
+//
+// FUNCTION PROTOTYPES
+//
+
+int     overlay_item(int n, int th);
+int     read_results(char *fname);
+int     read_phase(const ov_rec *g, float *phase);
+int     png_write(const char *fname, ImageView<float> m, ImageView<float> arms);
+
+//
+// SUBROUTINES
+//
+
+
+//
+// READ_RESULTS() - Reads the p2pa result table into items
+//
+// Arguments:
+//      fname   - Result table
+//
+// Global Variables:
+//      items   - Galaxies read
+//
+// Return Value:
+//      0 if the table was read, 1 if not
+//
+
+int     read_results(char *fname)
+    {
+    char    *f[5];         /* File, Start, End, Mode and Pitch Angle columns */
+    int     i;
+    ov_rec  g;
+
+    if ((fp=fopen(fname,"r")) == NULL)
+        {
+        printf("ERROR: Cannot open result table - %s\n",fname);
+        return(1);
+        }
+
+    while (fgets(line,STR_SIZE,fp) != NULL)
+        {
+        for (i=0; i < 5; i++)
+            {
+            if ((f[i]=strtok((i == 0) ? line : NULL, "\t\r\n")) == NULL) break;
+            }
+        if ((i < 5) || (strcmp(f[0],"File") == 0)) continue;
+
+        g.name=f[0];
+        g.start=atoi(f[1]);
+        g.end=atoi(f[2]);
+        g.mode=atoi(f[3]);
+        g.pa=atof(f[4]);
+
+        if ((g.mode < 1) || (g.mode > M_FIN) || (g.pa == 0.0) || (fabs(g.pa) >= 90.0))
+            {
+            printf("WARNING: No arms to draw for %s (mode %d, pitch %f)...Skipping\n",f[0],g.mode,g.pa);
+            continue;
+            }
+        if (g.start < 1) g.start=1;
+        if (g.end < g.start) g.end=g.start;
+
+        items.push_back(g);
+        }
+
+    fclose(fp);
+    return(0);
+    }
+
+
+//
+// READ_PHASE() - Finds the phase of the arms from the p2dfft per mode output
+//                file (<dir>/<name>_m<mode>).  The phases of the radii
+//                start to end are averaged modulo 360/mode, weighted by
+//                their amplitude.
+//
+// Arguments:
+//      g       - Galaxy
+//      phase   - Phase (degrees) returned
+//
+// Return Value:
+//      0 if the phase was found, 1 if not
+//
+
+int     read_phase(const ov_rec *g, float *phase)
+    {
+    int     md, j;         /* Mode and radius of a line                      */
+    float   freq, amp, pa, ph; /* Columns of a line                          */
+    double  s=0.0, cs=0.0; /* Weighted sums of the phase vectors             */
+    char    name[STR_SIZE];    /* Radius file name column                    */
+    char    buf[STR_SIZE];     /* Input line                                 */
+    std::string fname=std::string(dir)+"/"+g->name+"_m"+(char)('0'+g->mode);
+    FILE    *in;
+
+    if ((in=fopen(fname.c_str(),"r")) == NULL)
+        {
+#pragma omp critical (p2overlay_out)
+        printf("ERROR: Cannot open p2dfft output - %s\n",fname.c_str());
+        return(1);
+        }
+
+    j=0;
+    while (fgets(buf,STR_SIZE,in) != NULL)
+        {
+        if (sscanf(buf,"%d %255s %f %f %f %f",&md,name,&freq,&amp,&pa,&ph) != 6) continue;
+        j++;
+        if ((j < g->start) || (j > g->end)) continue;
+        if (!isfinite(amp) || !isfinite(ph)) continue;
+
+        s+=amp*sin(g->mode*ph*(PI/180.0));
+        cs+=amp*cos(g->mode*ph*(PI/180.0));
+        }
+
+    fclose(in);
+
+    if ((s == 0.0) && (cs == 0.0))
+        {
+#pragma omp critical (p2overlay_out)
+        printf("ERROR: No phase for radii %d to %d in %s\n",g->start,g->end,fname.c_str());
+        return(1);
+        }
+
+    *phase=atan2(s, cs)*(180.0/PI)/g->mode;
+    return(0);
+    }
+
+
+//
+// PNG_WRITE() - Writes an 8 bit RGB PNG of an image (gray levels, linear or
+//               log from the minimum to the maximum) with the arm pixels in
+//               red.  The rows are written top down, so row 0 of the image
+//               (the first FITS row) is the last PNG row, as FITS viewers
+//               show it.
+//
+// Arguments:
+//      fname   - PNG file
+//      m       - Image ([y][x])
+//      arms    - Arm pixels (non zero) ([y][x])
+//
+// Global Variables:
+//      log_scale
+//
+// Return Value:
+//      0 if the file was written, 1 if not
+//
+
+int     png_write(const char *fname, ImageView<float> m, ImageView<float> arms)
+    {
+    long    x, y;
+    float   lo, hi, v;     /* Range and scaled value of the image            */
+    FILE    *out;
+    png_structp png;
+    png_infop   info;
+    std::vector<png_byte>   row((size_t)m.cols*3);
+
+    lo=hi=NAN;
+    for (y=0; y < m.rows; y++)
+        {
+        for (x=0; x < m.cols; x++)
+            {
+            if (!isfinite(m[y][x])) continue;
+            if (!(m[y][x] >= lo)) lo=m[y][x];
+            if (!(m[y][x] <= hi)) hi=m[y][x];
+            }
+        }
+    if (!(hi > lo))
+        {
+        lo=0.0;
+        hi=1.0;
+        }
+
+    if ((out=fopen(fname,"wb")) == NULL) return(1);
+
+    png=png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info=(png) ? png_create_info_struct(png) : NULL;
+    if ((info == NULL) || setjmp(png_jmpbuf(png)))
+        {
+        png_destroy_write_struct(&png, (info) ? &info : NULL);
+        fclose(out);
+        return(1);
+        }
+
+    png_init_io(png, out);
+    png_set_IHDR(png, info, (png_uint_32) m.cols, (png_uint_32) m.rows, 8, PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+
+    for (y=m.rows-1; y >= 0; y--)
+        {
+        for (x=0; x < m.cols; x++)
+            {
+            if (arms[y][x] != 0.0)
+                {
+                row[x*3]=255;
+                row[x*3+1]=0;
+                row[x*3+2]=0;
+                continue;
+                }
+
+            v=(isfinite(m[y][x])) ? (m[y][x]-lo)/(hi-lo) : 0.0;
+            if (log_scale) v=log10(1.0+999.0*v)/3.0;
+            row[x*3]=row[x*3+1]=row[x*3+2]=(png_byte) (255.0*v+0.5);
+            }
+        png_write_row(png, &row[0]);
+        }
+
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+
+    return((fclose(out) == 0) ? 0 : 1);
+    }
+
+
+//
+// OVERLAY_ITEM() - Draws the arms of one galaxy and writes the overlay image
+//
+// Arguments:
+//      n       - Galaxy index
+//      th      - Thread number (selects the per thread state)
+//
+// Global Variables:
+//      items, asts, sps, mats, masks
+//
+// Return Value:
+//      0 if the overlay was written, 1 if not
+//
+
+int     overlay_item(int n, int th)
+    {
+    long    x, y;
+    float   phase;         /* Phase of the arms at r=1 (degrees)             */
+    float   mod;           /* Chirality of the arms (see spiral::arms())     */
+    float   slope;         /* tan(pitch angle)                               */
+    float   hi;            /* Image maximum (arm value for FITS)             */
+    char    fname[2*STR_SIZE]; /* File names                                 */
+    sp_rec  e;             /* Arms to draw                                   */
+
+    ov_rec          *g=&items[n];
+    astro           &ast=asts[th];
+    spiral          &sp=sps[th];
+    Image2D<float>  &mat=mats[th];
+    Image2D<float>  &mask=masks[th];
+
+    if (read_phase(g, &phase)) return(1);
+
+    snprintf(fname,sizeof(fname),"%s/%s.fits",dir,g->name.c_str());
+    if (ast.fits_read(fname, &mat))
+        {
+#pragma omp critical (p2overlay_out)
+        printf("ERROR: Cannot read galaxy image - %s\n",fname);
+        return(1);
+        }
+
+//
+// Arms of the measured pitch and mode starting at radius Start.  An arm of
+//   spiral::arms() is at angle mod*(theta+rot) where ln(r/Start) is
+//   theta*tan(pitch), so rot puts it at the phase angle at r=1.  The sweep
+//   reaches the corners of the image.
+//
+
+    slope=tan(fabs(g->pa)*(PI/180.0));
+    mod=(g->pa > 0.0) ? -1.0 : 1.0;
+
+    snprintf(e.name,sizeof(e.name),"%s",g->name.c_str());
+    e.pa=g->pa;
+    e.arm=g->mode;
+    e.hsize=(int) mat.cols();
+    e.vsize=(int) mat.rows();
+    e.feath=width;
+    e.r0=(float) g->start;
+    e.rot=mod*phase+log(e.r0)/slope*(180.0/PI);
+    e.sweep=log(0.5*sqrt((double) e.hsize*e.hsize+(double) e.vsize*e.vsize)/e.r0)/slope*(180.0/PI);
+    if (e.sweep > OV_SWEEP) e.sweep=OV_SWEEP;
+    if (e.sweep < 0.0) e.sweep=0.0;
+    e.fg=1.0;
+
+    if (mask.fit(mat.rows(), mat.cols()))
+        {
+#pragma omp critical (p2overlay_out)
+        printf("ERROR: Memory allocation failed for %s...Skipping\n",g->name.c_str());
+        return(1);
+        }
+    mask.zero();
+
+    if (sp.overlay(&e, mask.view(), 1))
+        {
+#pragma omp critical (p2overlay_out)
+        printf("%s",sp.text.c_str());
+        return(1);
+        }
+
+    if (verbose)
+        {
+#pragma omp critical (p2overlay_out)
+        printf("%s: Mode=%d, P=%.4f, Phase=%.4f, Radius %d to edge\n",g->name.c_str(),g->mode,g->pa,phase,g->start);
+        }
+
+//
+// Write the overlay
+//
+
+    if (fits)
+        {
+        hi=NAN;
+        for (y=0; y < mat.rows(); y++)
+            {
+            for (x=0; x < mat.cols(); x++)
+                {
+                if (isfinite(mat[y][x]) && !(mat[y][x] <= hi)) hi=mat[y][x];
+                }
+            }
+
+        for (y=0; y < mat.rows(); y++)
+            {
+            for (x=0; x < mat.cols(); x++)
+                {
+                if (mask[y][x] != 0.0) mat[y][x]=hi;
+                }
+            }
+
+        snprintf(fname,sizeof(fname),"!%s/%s_overlay.fits",odir,g->name.c_str());
+        if (ast.fits_write(fname, mat.view(), 1, "p2overlay/", VERSION))
+            {
+#pragma omp critical (p2overlay_out)
+            printf("ERROR: fits_write() Failed for %s\n",fname+1);
+            return(1);
+            }
+        }
+    else
+        {
+        snprintf(fname,sizeof(fname),"%s/%s_overlay.png",odir,g->name.c_str());
+        if (png_write(fname, mat.view(), mask.view()))
+            {
+#pragma omp critical (p2overlay_out)
+            printf("ERROR: Could Not Write %s\n",fname);
+            return(1);
+            }
+        }
+
+    return(0);
+    }
+
+
+//
+// MAIN ROUTINE
+//
+
+int main(int argc, char **argv)
+    {
+
+//
+// Define the command line options, see getopt_long(3) for details
+//
+
+    static struct option long_options[] =
+        {
+        {"verbose", no_argument,         0, 'v'},
+        {"log", no_argument,             0, 'l'},
+        {"cpu-report", no_argument,      0, 'C'},
+        /* These options require an argument. */
+        {"results", required_argument,   0, 'R'},
+        {"dir", required_argument,       0, 'd'},
+        {"outdir", required_argument,    0, 'o'},
+        {"format", required_argument,    0, 'f'},
+        {"width", required_argument,     0, 'w'},
+        {0, 0, 0, 0}
+        };
+
+    int option_index = 0;
+
+    while ((c = getopt_long (argc, argv, "vlCR:d:o:f:w:", long_options, &option_index))
+!= -1)
+        {
+        switch (c)
+            {
+            case 'v':
+                {
+                verbose = 1;
+                break;
+                }
+            case 'l':
+                {
+                log_scale = 1;
+                break;
+                }
+            case 'C':
+                {
+                cpu_rep = 1;
+                break;
+                }
+            case 'R':
+                {
+                snprintf(rname,sizeof(rname),"%s",optarg);
+                break;
+                }
+            case 'd':
+                {
+                snprintf(dir,sizeof(dir),"%s",optarg);
+                break;
+                }
+            case 'o':
+                {
+                snprintf(odir,sizeof(odir),"%s",optarg);
+                break;
+                }
+            case 'f':
+                {
+                if (strcmp(optarg,"fits") == 0) fits=1;
+                else if (strcmp(optarg,"png") == 0) fits=0;
+                else
+                    {
+                    printf("ERROR: Unknown format %s (png or fits)\n",optarg);
+                    exit(1);
+                    }
+                break;
+                }
+            case 'w':
+                {
+                width=atoi(optarg);
+                if ((width < 0) || (width > MAX_WIDTH))
+                    {
+                    printf("ERROR: -w|--width must be 0 to %d (%s)\n",MAX_WIDTH,optarg);
+                    exit(1);
+                    }
+                break;
+                }
+            default:
+                {
+                fprintf(stderr, "Usage: p2overlay [-R|--results <file>] [-d|--dir <dir>] [-o|--outdir <dir>] [-f|--format png|fits] [-w|--width <pixels>] [-l|--log] [-v|--verbose] [-C|--cpu-report]\n");
+                exit(1);
+                break;
+                }
+            }
+        }
+
+    if (verbose) printf("p2overlay - Version: %s\n",VERSION);
+
+    if (cpu_rep)
+        {
+        const char *kernels[]={"analytic arm rendering", NULL};
+
+        ast.cpu_report("p2overlay", kernels);
+        exit(0);
+        }
+
+    if (odir[0] == '\0') snprintf(odir,sizeof(odir),"%s",dir);
+
+    if (read_results(rname)) exit(1);
+
+    if (items.empty())
+        {
+        printf("No galaxies to draw\n");
+        exit(1);
+        }
+
+//
+// Draw the galaxies, one per thread
+//
+
+    num=omp_get_max_threads();
+    if (num > (int) items.size()) num=(int) items.size();
+
+    if (verbose) printf("Drawing %d Overlays With %d Threads...\n",(int) items.size(),num);
+
+    asts=new astro[num];
+    sps=new spiral[num];
+    mats=new Image2D<float>[num];
+    masks=new Image2D<float>[num];
+
+    for (c=0; c < num; c++)
+        {
+        asts[c].set_warn(1);
+        sps[c].analytic=1;
+        }
+
+//
+// Draw the galaxies, one per thread at a time (one at a time in all if
+//   cfitsio was built without --enable-reentrant)
+//
+
+#pragma omp parallel for num_threads(num) schedule(dynamic,1) reduction(+:errcnt) if (fits_is_reentrant())
+    for (int it=0; it < (int) items.size(); it++)
+        {
+        errcnt+=overlay_item(it, omp_get_thread_num());
+        }
+
+    delete [] masks;
+    delete [] mats;
+    delete [] sps;
+    delete [] asts;
+
+    printf("-------------------------------\n");
+    printf("Overlays Written             %d\n",(int) items.size()-errcnt);
+    printf("Errors                       %d\n",errcnt);
+    return(0);
+    }
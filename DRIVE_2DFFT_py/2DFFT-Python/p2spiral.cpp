@@ -7,7 +7,7 @@
 //            the options (see below).
 //
 //
-// Version 4.1: 13-Dec-2018
+// Version 5.0: 17-Oct-2026
 //
 //
 // Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
@@ -106,12 +106,13 @@
 //
 //
 // Usage: p2spiral [-i|--input <file>] [-v|--verbose] [-t|--text] [-p|--print]
+//                 [-s|--seed <n>] [-a|--analytic] [-C|--cpu-report]
+//                 [-P|--psf <psf>] [-g|--gain <e/count>] [-r|--read-noise <e>]
 // 
 //        If p2spiral is called with no -i argument, the user will be
 //        prompted for all the parameters (see below) pitch angle,     
-//        number of arms, and total file size (which must be odd).  Up to 64 
-//        files can be specified (this can be changed by altering MAX_FILES).
-//        Entering <ctrl>-D will stop the input and start the generation of
+//        number of arms, and total file size (which must be odd).  Any
+//        number of files can be specified.  Entering <ctrl>-D will stop the input and start the generation of
 //        the files.  For each entry, up to two files will be generated: 
 //        <base name>.fits will be a 32-bit floating point FITS file and 
 //        (optionally) <base name>.txt will be an ASCII text FITS image file
@@ -127,6 +128,34 @@
 //              -v|--verbose : Causes status messages to be printed.
 //              -t|--text  : Generate ASCII FITS files as well as binary
 //              -p|--print : Print a listing of pitch angle by radius to stdout
+//              -s|--seed  : Seed for the noise (default 0).  The noise of a
+//                           model depends only on this seed and its name, so
+//                           the files are the same on every run, machine and
+//                           number of threads.
+//              -a|--analytic: Draw the arms with the analytic renderer.  Each
+//                           pixel is lit from its distance to the nearest
+//                           arm, which is computed in closed form, so the
+//                           rows are independent and are drawn with SIMD
+//                           instructions on all the threads.  The arms are
+//                           solid curves (the traced arms are one point per
+//                           degree, feathered).  With a pitch change (delta)
+//                           the two agree on the shape, not pixel for pixel.
+//              -C|--cpu-report: Show the CPU and the code path (sse2, avx2
+//                           or avx512f) the analytic renderer runs, then exit
+//              -P|--psf   : Convolve the models with a point spread function:
+//                             gauss:<fwhm>          - Gaussian
+//                             moffat:<fwhm>[:<beta>] - Moffat (beta 4.765)
+//                             <file>                - PSF FITS image, centered
+//                                                     on its center pixel
+//                           The FWHM is in pixels.
+//              -g|--gain  : Add shot noise, taking the model values as the
+//                           expected counts with <e/count> electrons per
+//                           count (after the PSF)
+//              -r|--read-noise: Read noise in electrons (RMS) added with the
+//                           shot noise (default 0, needs -g)
+//
+//        The models are generated in parallel (one model per thread, with
+//        any threads left over splitting the rows of each model).
 //
 //
 // INPUT FILE FORMAT:
@@ -192,6 +221,26 @@
 //
 //
 // Revision History:
+//      5.0  17-Oct-2026: - Use Image2D for the model image (image_class.h)
+//                          and check that its allocation succeeded
+//                        - Move the drawing code to spiral_class and
+//                          generate the models in parallel
+//                        - Replace rand() with a counter based generator
+//                          (Philox) keyed by the model name and -s seed so
+//                          the noise is reproducible at any thread count
+//                        - Remove the MAX_FILES limit on input lines
+//                        - Fix the bar check on input files testing the bar
+//                          of the first file instead of the current one
+//                        - Add -a|--analytic option (vectorized arm renderer)
+//                        - Add -C|--cpu-report option
+//                        - Add -P|--psf, -g|--gain and -r|--read-noise options
+//                          (PSF convolution and shot/read noise)
+//                        - Move the input line parsing and parameter limits
+//                          to spiral_class (shared with p2calib)
+//                        - Reject models with the same name (their files
+//                          would be written at the same time)
+//                        - Write one model at a time if cfitsio is not
+//                          reentrant
 //      4.1  13-Dec-2018: - Fix bug in feathering code to make more consistent
 //                          arm widths
 //      4.0  10-Jun-2018: - Add parameter to add/specify a bar
@@ -272,7 +321,7 @@
 //
 //
 
-#define     VERSION "4.1/20181213"
+#define     VERSION "5.0/20261017"
 
 //
 // HEADER FILES
@@ -285,9 +334,14 @@
 #include    <getopt.h>
 #include    <sys/stat.h>
 #include    <sys/types.h>
+#include    <omp.h>
+#include    <vector>
+#include    <map>
+#include    <string>
 
 #include    "globals.h"
 #include    "astro_class.h"
+#include    "spiral_class.h"
 
 //
 // CONSTANTS - These are the default values for the parameters
@@ -319,188 +373,67 @@
 #undef      DEBUG
 
 #define     STR_SIZE    64 /* Maximum characters in input line               */
-#define     MAX_FILES 1024 /* The limit on the number of files specified     */
-
-#define     MIN_PA   -75.0 /* Minimum pitch angle (floating point value)     */
-#define     MAX_PA    75.0 /* Maximum pitch angle (floating point value)     */
-#define     MIN_ARM      1 /* Minimum number of spiral arms                  */
-#define     MAX_ARM      6 /* Maximum number of spiral arms                  */
-#define     MIN_SIZE    50 /* Minimum file size (should be at least 50)      */
-#define     MAX_SIZE  2048 /* Maximum files size ( < 2049 for 2DFFT)         */
-#define     MIN_FTHR     0 /* Minimum feather setting (integer value)        */
-#define     MAX_FTHR    15 /* Maximum feather setting (integer value)        */
-#define     MIN_SWEEP 90.0 /* Minimum arm sweep (< 45 is not meaningful)     */
-#define     MAX_SWEEP 720.0 /* Maximum arm mapping angle                     */
-#define     MIN_ROT  -90.0 /* Minimum rotation angle (floating point value)  */
-#define     MAX_ROT   90.0 /* Maximum rotation angle (floating point value)  */
-#define     MIN_R0     1.0 /* Minimum initial radius (floating point value)  */
-#define     MAX_R0  1000.0 /* Maximum initial radius (floating point value)  */
-#define     MIN_CORE     0 /* Lowest core mapping value                      */
-#define     MAX_CORE     2 /* Highest core mapping value                     */
-#define     MIN_BARA     0 /* Minimum bar semi-major axis                    */
-#define     MAX_BARA 1024.0 /* Maximum bar semi-major axis                   */
-#define     MIN_BARB     0 /* Minimum bar semi-minor axis                    */
-#define     MAX_BARB 1024.0 /* Maximum bar semi-minor axis                   */
-#define     MIN_MAR      0 /* Minimum outer margin of blank space            */
-#define     MAX_MAR    200 /* Maximum outer margin of blank space            */
-#define     MIN_PIXEL -1024.0 /* The minimum value for fg and bg variables   */
-#define     MAX_PIXEL  1024.0 /* The maximum value for fg and bg variables   */
-#define     MIN_DELTA -60.0 /* Minimum pitch angle change (floating point)   */
-#define     MAX_DELTA  60.0 /* Maximum pitch angle change (floating point)   */
-#define     MIN_LUM   -0.99 /* Minimum brightness change (floating point)    */
-#define     MAX_LUM    0.99 /* Maximum brightness change (floating point)    */
-#define     MIN_LOG      0 /* Lowest brightness option                       */
-#define     MAX_LOG      1 /* Highest brightness option                      */
-#define     MIN_ARM_LUM  0 /* Lowest arm width luminosity change value       */
-#define     MAX_ARM_LUM  1 /* Highest arm width luminosity change value      */
-#define     MIN_NOISE -512.0 /* The minimum value for fg and bg variables    */
-#define     MAX_NOISE  512.0 /* The maximum value for fg and bg variables    */
 
 //
 // VARIABLES
 //
 
 int     c;                 /* Getopt_long return value                       */
-int     r2;                /* Initial core radius squared                    */
-int     i, j;              /* Index variables                                */
-int     s, t;              /* Index variables                                */
-int     x, y;              /* Array index variables                          */
-int     ctr;               /* Counter for number of entries/line in txt file */
-int     mode;              /* Index used in the formula to process each arm  */
+int     status;            /* Return value of spiral::parse()                */
+int     num;               /* Number of threads on the host machine          */
 int     txt=0;             /* Flag for creating ASCII FITS files             */
-int     outer;             /* Estimate of arm length                         */
-int     longr;             /* Estimate of longest radius                     */
 int     list=0;            /* Flag for listing the pitch angles by radius    */
-int     errcnt;            /* Total number of input errors encountered       */
-int     starti;            /* Starting radius for arms (integer)             */
-int     status;            /* Result from system() command                   */
-int     centerx;           /* Center coordinate for x (horizontal) axis      */
-int     centery;           /* Center coordinate for x (vertical) axis        */
-int     counter;           /* Main processing loop variable                  */
+int     analytic=0;        /* Flag for the analytic arm renderer (-a)        */
+int     cpu_rep=0;         /* Flag for -C|--cpu-report                       */
+int     psf=PSF_NONE;      /* PSF type (-P)                                  */
+int     outer;             /* Threads drawing models                         */
+int     inner;             /* Threads drawing the rows of each model         */
+int     errcnt=0;          /* Total number of input errors encountered       */
+int     dups=0;            /* Models named like an earlier model             */
 int     verbose;           /* Flag for verbose mode (1=true)                 */
-int     starti_s;          /* Starting radius for semi-minor axis            */
-int     num_files;         /* Total number of files to process - 1           */
-int     mar[MAX_FILES];    /* Outer margin value                             */
-int     arm[MAX_FILES];    /* Number of arms for each file                   */
-int     hsize[MAX_FILES];  /* Horizontal size in pixels for each file        */
-int     vsize[MAX_FILES];  /* Vertical size in pixels for each file          */
-int     core[MAX_FILES];   /* Flag for filling in the core area              */
-int     feath[MAX_FILES];  /* Feathering/fuzziness value for each file       */
-int     linear[MAX_FILES]; /* Brightness change algorithm flag               */
-int     arm_lum[MAX_FILES];  /* Flag for changing brightness over arm width  */
-
-char    *item;             /* Token parsed from input line                   */
-char    cmd[STR_SIZE];     /* String for command to remove old file versions */
-char    key[256];          /* String for FITS keywords                       */
+int     num_files;         /* Total number of files to process               */
+
 char    line[256];         /* String for reading input file lines            */
-char    keys[5][32];       /* FITS header key names                          */
-char    items[5][80];      /* FITS header key values                         */
 char    fname[STR_SIZE];   /* Input file name string                         */
-char    fname2[STR_SIZE];  /* Input file name string                         */
 char    entry[STR_SIZE];   /* Input file name string                         */
 
-char    base[MAX_FILES][64]; /* Base names for generated files               */
-
-float   r;                 /* R value for the polar coordinates              */
-float   rn;                /* calculated noise value                         */
-float   mod;               /* Modifier for the chirality (direction)         */
-float   brt;               /* Current pixel value for foreground             */
-float   dist;              /* Cartesian distance from center                 */
-float   mb,ma;             /* Bar (ellipse) mapping coordinates              */
-float   si,co;             /* Sine and cosine of ellipse mapping coordinates */
-float   theta;             /* Loop variable for theta angles                 */
-float   pitch;             /* Loop variable for changing pitch angle         */
-float   **mat;             /* Pointer for the Cartesion mapping of image     */
-float   change;            /* Rate of change for varying pitch angles        */
-float   startf;            /* Starting radius for arms (float)               */
-float   lum_rate;          /* Luminosity change per radius step              */
-float   newpitch;          /* Updated pitch value                            */
-float   avg_pitch;         /* Average pitch value                            */
-float   max_pitch;         /* Maximum pitch value                            */
-float   min_pitch;         /* Minimum pitch value                            */
-float   num_pitch;         /* Number of pitch values used                    */
-float   separation;        /* Angular separation arms (polar coordinates)    */
-        
-float   r0[MAX_FILES];     /* Initial radius at 0 degrees for each file      */
-float   fg[MAX_FILES];     /* Foreground FITS pixel value                    */
-float   bg[MAX_FILES];     /* Background FITS pixel value                    */
-float   pa[MAX_FILES];     /* Pitch angles of files                          */
-float   lum[MAX_FILES];    /* Brightness change over radius                  */
-float   rot[MAX_FILES];    /* Rotation (degrees) value for each file         */
-float   bara[MAX_FILES];   /* Pitch angle change value for each file         */
-float   barb[MAX_FILES];   /* Pitch angle change value for each file         */
-float   delta[MAX_FILES];  /* Pitch angle change value for each file         */
-float   sweep[MAX_FILES];  /* Pitch angle range for mapping                  */
-float   noise[MAX_FILES];  /* Maximum noise ceiling value                    */
-
-long    naxis=2;           /* CFITSIO number of axes - always 2              */
-long    naxes[2];          /* Size of array give to CFITSIO                  */
-
-FILE    *ofile;            /* File stream for output .txt file               */
+unsigned long long seed=0; /* Seed for the model noise (-s)                  */
+
+float   fwhm=0.0;          /* FWHM of the PSF in pixels (-P)                 */
+float   beta=PSF_BETA;     /* Moffat beta (-P)                               */
+float   gain=0.0;          /* Electrons per count for shot noise (-g)        */
+float   read_noise=0.0;    /* Read noise in electrons (-r)                   */
+
+Image2D<float>  psf_img;   /* PSF image for -P <file>                        */
+
 FILE    *file_list;        /* File stream for input file                     */
 
 astro   ast;               /* Instantiation of astro_class                   */
+spiral  reader;            /* Parses the input file lines                    */
 
-//
-// SUBROUTINES
-//
-
+std::vector<sp_rec> models;  /* Parameters of the models to generate         */
+std::map<std::string,int> names; /* Model number of each model name           */
 
-// 
-// READ_TOKEN() - Runs a loop to get the input value for a parameter from a
-//                file line.  Parses the next token in the line and compares
-//                it for validity.
-//
-// Prerequisites:  strtok() must have alread been run on the input line prior
-//                 to first execution of this routine.
-//
-// Globals:
-//      errcnt  - Count of lines with errors
-//
-// Arguments:
-//      fname   - Character string with base name of the file
-//      name    - Character string with name of the field
-//      min     - Minimum value for any valid input
-//      max     - Minimum value for any valid input
 //
-// Return Value:
-//      ret     - Floating point value or -2048.0 if error
+// Per thread state.  Each thread draws one model at a time into its own
+//   image, which keeps the size of the largest model it has drawn.
 //
-            
-float   read_token(char *fname, const char *name,float min,float max)
-
-    {
 
-    float   ret;
+astro           *asts;     /* astro_class instance per thread                */
+spiral          *sps;      /* Model drawing per thread                       */
+Image2D<float>  *mats;     /* Cartesian model image [y][x] per thread        */
 
 //
-// Get next token in string (line from file)
+// FUNCTION PROTOTYPES
 //
 
-    if ((item=strtok(NULL,",\t "))!=NULL)
-        {
-        ret=(float)atof(item);
+int     make_model(int n, int th);
+int     read_psf(char *spec);
 
 //
-// Check it
+// SUBROUTINES
 //
 
-        if ( (ret < min) || (ret > max) )
-            {
-            printf("WARNING: Invalid %s %f for File %s\n", name, ret, fname);
-            errcnt++;
-            ret= -2048.0;
-            }
-        }
-    else
-        {
-        printf("ERROR: No %s for File %s\n",name, fname);
-        errcnt++;
-        ret= -2048.0;
-        }
-
-    return(ret);
-    }
 
 // 
 // GET_INPUT() - Runs a loop to get the input value for a parameter from stdin.
@@ -575,6 +508,62 @@ float   get_input(const char *prompt, float min, float max, float def)
     }
 
 
+//
+// READ_PSF() - Sets the PSF from the -P|--psf option value (see the usage
+//              notes above).  A PSF image is read here, once, and shared by
+//              all the threads.
+//
+// Globals:
+//      psf, fwhm, beta, psf_img - Set from the option
+//
+// Arguments:
+//      spec    - Option value
+//
+// Return Value:
+//      0 if the PSF was set, 1 if not
+//
+
+int     read_psf(char *spec)
+    {
+    char    *p;
+
+    if (strncmp(spec, "gauss:", 6) == 0)
+        {
+        psf=PSF_GAUSS;
+        fwhm=atof(spec+6);
+        }
+    else if (strncmp(spec, "moffat:", 7) == 0)
+        {
+        psf=PSF_MOFFAT;
+        fwhm=atof(spec+7);
+        if ((p=strchr(spec+7, ':')) != NULL) beta=atof(p+1);
+        if (beta <= 0.0)
+            {
+            printf("ERROR: Moffat beta must be > 0 (%s)\n",spec);
+            return(1);
+            }
+        }
+    else
+        {
+        psf=PSF_IMAGE;
+        if (ast.fits_read(spec, &psf_img))
+            {
+            printf("ERROR: Cannot read PSF file - %s\n",spec);
+            return(1);
+            }
+        return(0);
+        }
+
+    if (fwhm <= 0.0)
+        {
+        printf("ERROR: PSF FWHM must be > 0 (%s)\n",spec);
+        return(1);
+        }
+
+    return(0);
+    }
+
+
 //
 // MAIN ROUTINE
 //
@@ -595,14 +584,20 @@ int main(int argc, char **argv)
         {"verbose", no_argument,         0, 'v'},
         {"text", no_argument,            0, 't'},
         {"print", no_argument,           0, 'p'},
+        {"analytic", no_argument,        0, 'a'},
+        {"cpu-report", no_argument,      0, 'C'},
+        {"psf", required_argument,       0, 'P'},
+        {"gain", required_argument,      0, 'g'},
+        {"read-noise", required_argument, 0, 'r'},
         /* These options require an argument. */
         {"input", optional_argument,     0, 'i'},
+        {"seed", required_argument,      0, 's'},
         {0, 0, 0, 0}
         };
       
     int option_index = 0;
 
-    while ((c = getopt_long (argc, argv, "vtpi:", long_options, &option_index)) 
+    while ((c = getopt_long (argc, argv, "vtpaCi:s:P:g:r:", long_options, &option_index)) 
 != -1)
         {
         switch (c)
@@ -622,20 +617,64 @@ int main(int argc, char **argv)
                 list = 1;
                 break;
                 }
+            case 'a':
+                {
+                analytic = 1;
+                break;
+                }
+            case 'C':
+                {
+                cpu_rep = 1;
+                break;
+                }
             case 'i':
                 {
                 strcpy(fname,optarg);
                 break;
                 }
+            case 's':
+                {
+                seed=strtoull(optarg, NULL, 0);
+                break;
+                }
+            case 'P':
+                {
+                if (read_psf(optarg)) exit(1);
+                break;
+                }
+            case 'g':
+                {
+                gain=atof(optarg);
+                break;
+                }
+            case 'r':
+                {
+                read_noise=atof(optarg);
+                break;
+                }
             default:
                 {
-                fprintf(stderr, "Usage: p2spiral [-i|--input <file>] [-v|--verbose] [-t|--text] [-p|--print]\n");
+                fprintf(stderr, "Usage: p2spiral [-i|--input <file>] [-v|--verbose] [-t|--text] [-p|--print] [-s|--seed <n>] [-a|--analytic] [-C|--cpu-report] [-P|--psf <psf>] [-g|--gain <e/count>] [-r|--read-noise <e>]\n");
                 exit(1);
                 break;
                 }
             }
         }
 
+    if (cpu_rep)
+        {
+        const char *kernels[]={"analytic arm rendering", NULL};
+
+        ast.cpu_report("p2spiral", kernels);
+        exit(0);
+        }
+
+    if ((gain < 0.0) || (read_noise < 0.0) || ((read_noise > 0.0) && (gain == 0.0)))
+        {
+        printf("ERROR: -g|--gain must be > 0 for shot/read noise (-g %f -r %f)\n",gain,read_noise);
+        exit(1);
+        }
+
 //
 // Open the input file name if given
 //
@@ -650,8 +689,7 @@ int main(int argc, char **argv)
             }
 
 //
-// Open the input file and read the values into the arrays.  This code seems a
-//   bit tedious because of all the error checking.
+// Open the input file and read the values into the arrays
 //
 
         errcnt=0;
@@ -664,94 +702,25 @@ int main(int argc, char **argv)
 
             if ((line[0]=='#') || (strlen(line) < 2)) continue;
 
-//
-// If we have reached the maximum file number, we need to flag an error.
-//
-
-            if (num_files == MAX_FILES)
-                {
-                printf("ERROR: Too many input lines!\n");
-                exit(1);
-                }
+            sp_rec  e;
 
 //
-// Start breaking the line into individual fields.  Need to run strtok() at
-//   least once before calling read_token().
+// Break the line into its fields (see spiral::parse())
 //
 
-            if ((item=strtok(line,", \t"))!=NULL)
-                {
-                strcpy(base[num_files],item);
-                }
-            else
+            status=reader.parse(line, &e);
+            printf("%s",reader.text.c_str());
+            if (status)
                 {
-                printf("WARNING: Invalid Keyword on Line %d\n",num_files);
                 errcnt++;
                 continue;
                 }
 
-            if ((pa[num_files]=read_token(base[num_files],"Pitch Angle",MIN_PA,MAX_PA)) < -2000.0) continue;
-            
-            if ((arm[num_files]=(int)read_token(base[num_files],"Arm Number",MIN_ARM,MAX_ARM)) < -2000.0) continue;
-            
-            if ((hsize[num_files]=(int)read_token(base[num_files],"Horizontal File Size",MIN_SIZE,MAX_SIZE)) < -2000.0) continue;
-            
-            if ((vsize[num_files]=(int)read_token(base[num_files],"Vertical File Size",MIN_SIZE,MAX_SIZE)) < -2000.0) continue;
-            
-            if ((feath[num_files]=(int)read_token(base[num_files],"Feather",MIN_FTHR,MAX_FTHR)) < -2000.0) continue;
-            
-            if ((sweep[num_files]=read_token(base[num_files],"Sweep Angle",MIN_SWEEP,MAX_SWEEP)) < -2000.0) continue;
-            
-            if ((rot[num_files]=read_token(base[num_files],"Rotation Angle",MIN_ROT,MAX_ROT)) < -2000.0) continue;
-            
-            if ((r0[num_files]=read_token(base[num_files],"Initial Radius",MIN_R0,MAX_R0)) < -2000.0) continue;
-           
-            if ((core[num_files]=(int)read_token(base[num_files],"Core Setting",MIN_CORE,MAX_CORE)) < -2000.0) continue;
-            
-            if ((bara[num_files]=read_token(base[num_files],"Bar Semi-Major Axis",MIN_BARA,MAX_BARA)) < -2000.0) continue;
-           
-            if ((barb[num_files]=read_token(base[num_files],"Bar Semi-Minor Axis",MIN_BARB,MAX_BARB)) < -2000.0) continue;
-
-            if (bara[counter] && (barb[num_files] < 1.0))
-                {
-                printf("WARNING: Semi-Minor Axis Must Be At Least 1.0...Ignoring\n");
-                bara[num_files]=0.0;
-                barb[num_files]=0.0;
-                }
- 
-            if (barb[num_files] > bara[num_files])
-                {
-                printf("WARNING: Semi-Major Axis Must Be >= Than Semi-Minor Axis...Skipping\n");
-                continue;
-                }
- 
-            if (bara[num_files] && (r0[num_files] >= bara[num_files]))
-                {
-                printf("WARNING: Semi-Major Axis Must Be > Than Initial Radius...Ingoring Bar Values\n");
-                bara[num_files]=0.0;
-                barb[num_files]=0.0;
-                }
- 
-            if ((mar[num_files]=(int)read_token(base[num_files],"Outer Margin",MIN_MAR,MAX_MAR)) < -2000.0) continue;
- 
-            if ((fg[num_files]=read_token(base[num_files],"Foreground",MIN_PIXEL,MAX_PIXEL)) < -2000.0) continue;
-           
-            if ((bg[num_files]=read_token(base[num_files],"Background (Bias)",MIN_PIXEL,MAX_PIXEL)) < -2000.0) continue;
-           
-            if ((delta[num_files]=read_token(base[num_files],"Pitch Angle Change",MIN_DELTA,MAX_DELTA)) < -2000.0) continue;
-           
-            if ((lum[num_files]=read_token(base[num_files],"Luminosity Change",MIN_LUM,MAX_LUM)) < -2000.0) continue;
-           
-            if ((linear[num_files]=(int)read_token(base[num_files],"Brightness Algorithm",MIN_LOG,MAX_LOG)) < -2000.0) continue;
-            
-            if ((arm_lum[num_files]=(int)read_token(base[num_files],"Arm Width Luminosity Change",MIN_ARM_LUM,MAX_ARM_LUM)) < -2000.0) continue;
-            
-            if ((noise[num_files]=read_token(base[num_files],"Noise (Shot)",MIN_NOISE,MAX_NOISE)) < -2000.0) continue;
-           
 //
 // Success!  Carry on with next item.
 //
 
+            models.push_back(e);
             num_files++;
             continue;
             }
@@ -771,6 +740,8 @@ int main(int argc, char **argv)
 
         while (1)
             {
+            sp_rec  e;
+
             printf("\nBase File Name: ");
 
 //
@@ -781,60 +752,61 @@ int main(int argc, char **argv)
             entry[strcspn(entry,"\n")]=0; 
             if (strlen(entry)==0)
                 {
-                printf("WARNING: Invalid Keyword %s\n",base[num_files]);
+                printf("WARNING: Invalid Keyword %s\n",e.name);
                 continue;
                 }
-            strcpy(base[num_files],entry);
+            snprintf(e.name,sizeof(e.name),"%s",entry);
 
 //
 // For the rest of the values, use the subroutine
 //
 
-            if ((pa[num_files]=get_input("Pitch Angle [%f]: ", MIN_PA, MAX_PA, DEF_PA)) < -2000.0) break;
+            if ((e.pa=get_input("Pitch Angle [%f]: ", MIN_PA, MAX_PA, DEF_PA)) < -2000.0) break;
 
-            if ((arm[num_files]=(int)get_input("Arms [%f]: ", MIN_ARM, MAX_ARM, DEF_ARMS)) < -2000.0) break;
+            if ((e.arm=(int)get_input("Arms [%f]: ", MIN_ARM, MAX_ARM, DEF_ARMS)) < -2000.0) break;
 
-            if ((hsize[num_files]=(int)get_input("Horizontal Size [%f]: ", MIN_SIZE, MAX_SIZE, DEF_SIZE)) < -2000.0) break;
+            if ((e.hsize=(int)get_input("Horizontal Size [%f]: ", MIN_SIZE, MAX_SIZE, DEF_SIZE)) < -2000.0) break;
 
-            if ((vsize[num_files]=(int)get_input("Vertical Size [%f]: ", MIN_SIZE, MAX_SIZE, DEF_SIZE)) < -2000.0) break;
+            if ((e.vsize=(int)get_input("Vertical Size [%f]: ", MIN_SIZE, MAX_SIZE, DEF_SIZE)) < -2000.0) break;
 
-            if ((feath[num_files]=(int)get_input("Feather [%f]: ", MIN_FTHR, MAX_FTHR, DEF_FTHR)) < -2000.0) break;
+            if ((e.feath=(int)get_input("Feather [%f]: ", MIN_FTHR, MAX_FTHR, DEF_FTHR)) < -2000.0) break;
 
-            if ((sweep[num_files]=get_input("Sweep Angle[%f]: ", MIN_SWEEP, MAX_SWEEP, DEF_SWEEP)) < -2000.0) break;
+            if ((e.sweep=get_input("Sweep Angle[%f]: ", MIN_SWEEP, MAX_SWEEP, DEF_SWEEP)) < -2000.0) break;
 
-            if ((rot[num_files]=get_input("Rotation Angle[%f]: ", MIN_ROT, MAX_ROT, DEF_ROT)) < -2000.0) break;
+            if ((e.rot=get_input("Rotation Angle[%f]: ", MIN_ROT, MAX_ROT, DEF_ROT)) < -2000.0) break;
 
-            if ((r0[num_files]=get_input("Initial Radius [%f]: ", MIN_R0, MAX_R0, DEF_R0)) < -2000.0) break;
+            if ((e.r0=get_input("Initial Radius [%f]: ", MIN_R0, MAX_R0, DEF_R0)) < -2000.0) break;
 
-            if ((core[num_files]=(int)get_input("Core Setting [%f]: ", MIN_CORE, MAX_CORE, DEF_CORE)) < -2000.0) break;
+            if ((e.core=(int)get_input("Core Setting [%f]: ", MIN_CORE, MAX_CORE, DEF_CORE)) < -2000.0) break;
 
-            if ((bara[num_files]=get_input("Initial Radius [%f]: ", MIN_BARA, MAX_BARA, DEF_BARA)) < -2000.0) break;
+            if ((e.bara=get_input("Initial Radius [%f]: ", MIN_BARA, MAX_BARA, DEF_BARA)) < -2000.0) break;
 
-            if (bara[num_files])
+            if (e.bara)
                 {
-                if ((barb[num_files]=get_input("Initial Radius [%f]: ", MIN_BARB, MAX_BARB, DEF_BARB)) < -2000.0) break;
+                if ((e.barb=get_input("Initial Radius [%f]: ", MIN_BARB, MAX_BARB, DEF_BARB)) < -2000.0) break;
                 }
             else
                 {
-                if ((barb[num_files]=get_input("Initial Radius [%f]: ", MIN_BARB, MAX_BARB, DEF_BARB+1.0)) < -2000.0) break;
+                if ((e.barb=get_input("Initial Radius [%f]: ", MIN_BARB, MAX_BARB, DEF_BARB+1.0)) < -2000.0) break;
                 }
 
-            if ((mar[num_files]=(int)get_input("Outer Margin [%f]: ", MIN_MAR, MAX_MAR, DEF_MAR)) < -2000.0) break;
+            if ((e.mar=(int)get_input("Outer Margin [%f]: ", MIN_MAR, MAX_MAR, DEF_MAR)) < -2000.0) break;
 
-            if ((fg[num_files]=get_input("Foreground [%f]: ", MIN_PIXEL, MAX_PIXEL, DEF_FG)) < -2000.0) break;
+            if ((e.fg=get_input("Foreground [%f]: ", MIN_PIXEL, MAX_PIXEL, DEF_FG)) < -2000.0) break;
 
-            if ((bg[num_files]=get_input("Background (Bias) [%f]: ", MIN_PIXEL, MAX_PIXEL, DEF_BG)) < -2000.0) break;
+            if ((e.bg=get_input("Background (Bias) [%f]: ", MIN_PIXEL, MAX_PIXEL, DEF_BG)) < -2000.0) break;
 
-            if ((delta[num_files]=get_input("Pitch Angle Change[%f]: ", MIN_DELTA, MAX_DELTA, DEF_DELTA)) < -2000.0) break;
+            if ((e.delta=get_input("Pitch Angle Change[%f]: ", MIN_DELTA, MAX_DELTA, DEF_DELTA)) < -2000.0) break;
 
-            if ((lum[num_files]=get_input("Luminosity Change [%f]: ", MIN_LUM, MAX_LUM, DEF_LUM)) < -2000.0) break;
+            if ((e.lum=get_input("Luminosity Change [%f]: ", MIN_LUM, MAX_LUM, DEF_LUM)) < -2000.0) break;
 
-            if ((linear[num_files]=(int)get_input("Brightness Change Algorithm [%f]: ", MIN_LOG, MAX_LOG, DEF_LOG)) < -2000.0) break;
+            if ((e.linear=(int)get_input("Brightness Change Algorithm [%f]: ", MIN_LOG, MAX_LOG, DEF_LOG)) < -2000.0) break;
 
-            if ((arm_lum[num_files]=(int)get_input("Arm Width Luminosity Change Setting [%f]: ", MIN_ARM_LUM, MAX_ARM_LUM, DEF_ARM_LUM)) < -2000.0) break;
+            if ((e.arm_lum=(int)get_input("Arm Width Luminosity Change Setting [%f]: ", MIN_ARM_LUM, MAX_ARM_LUM, DEF_ARM_LUM)) < -2000.0) break;
 
-            if ((noise[num_files]=get_input("Noise (Shot) [%f]: ", MIN_NOISE, MAX_NOISE, DEF_NOISE)) < -2000.0) break;
+            if ((e.noise=get_input("Noise (Shot) [%f]: ", MIN_NOISE, MAX_NOISE, DEF_NOISE)) < -2000.0) break;
 
+            models.push_back(e);
             num_files++;
             }
         }
@@ -850,371 +822,153 @@ int main(int argc, char **argv)
         }
 
 //
-// Now create the requested FITS files
+// Models are drawn at the same time, so two models with the same name would
+//   write the same files at once.  Reject the input instead.
 //
 
-    for ( counter=0; counter < num_files; counter++ )
+    for (c=0; c < num_files; c++)
         {
-
-//
-// If the verbose flag is set, print out all input information/assumptions
-//
-
-        if (verbose)
+        if (names.count(models[c].name))
             {
-            printf("Processing File %d: Name=%s, Pitch Angle=%f\n",counter+1,base[counter],pa[counter]);
-
-            printf("    Arms=%d, Hor. Size=%d, Ver. Size=%d, Feather=%d\n",arm[counter],hsize[counter],vsize[counter],feath[counter]);
-
-            printf("    Sweep=%f, Rotation=%f, r0=%f, Core=%d, Bar Semi-Major=%f, Bar Semi-Minor=%f\n",sweep[counter],rot[counter],r0[counter],core[counter],bara[counter],barb[counter]);
-
-            printf("    Margin=%d, Fg=%f, Bg=%f, Delta=%f, Lum=%f\n",mar[counter],fg[counter],bg[counter],delta[counter],lum[counter]);
-
-            printf("    Log=%d, Arm_lum=%d, Noise=%f\n",linear[counter],arm_lum[counter],noise[counter]);
-            }
-
-//
-// Initialize array values and populate it with random noise values, if needed.
-//   PLEASE NOTE: The FITS array ordering is different than C so columns are
-//   major and rows are minor (fastest varying).   The astro_class libraries
-//   expect this as well.
-//
-
-        if (verbose) printf("  --- Generating Arrays\n");
-
-        mat=ast.ArrayAlloc(vsize[counter], hsize[counter]);
-
-        for (x=0; x < hsize[counter]; x++)
-            {
-            for (y=0; y < vsize[counter]; y++)
-                {
-                if (noise[counter] != 0.0)
-                    {
-                    rn=(((float)rand())/((float) RAND_MAX + 1.0))*noise[counter];
-                    mat[y][x]=bg[counter]+rn;
-                    }
-                else
-                    {
-                    mat[y][x]=bg[counter];
-                    }
-                }
-            }
-
-//
-// Set the chirality (direction) value for the equation based on neg/pos p.a.
-//
-
-        if (verbose) printf("  --- Set Chirality\n");
-
-        if ( pa[counter] > 0 )
-            {
-            mod=-1.0;
+            printf("ERROR: Models %d and %d are both named %s\n",names[models[c].name]+1,c+1,models[c].name);
+            dups++;
             }
         else
             {
-            mod=1.0;
+            names[models[c].name]=c;
             }
+        }
 
-//
-// Determine the arm separation.  If arm > 1 set to the angle of separation
-//   between the arms.  If arm=1, then set to zero, which will cause the
-//   separation term in the formula to go to 0.
-//
-
-        if (verbose) printf("  --- Set Arm Separation\n");
-
-        if (arm[counter] > 1) 
-            {
-            separation=360.0/(float)arm[counter];
-            }
-        else
-            {
-            separation=0.0;
-            }
+    if (dups)
+        {
+        printf("Model names must be unique (%d duplicates)\n",dups);
+        exit (1);
+        }
 
 //
-// Determine the radius where the arms will start based on core size and bar
-//   parameters
+// Now create the requested FITS files.  The models are independent, so they
+//   are shared out to the threads.  When there are fewer models than threads
+//   the threads left over draw the rows of each model.  Every model is the
+//   same whatever the number of threads (see spiral_class.h).  A cfitsio
+//   library built without --enable-reentrant writes one model at a time.
 //
 
-        if (bara[counter] > r0[counter])
-            {
-            startf=bara[counter];
-            starti=(int) bara[counter];
-            }
-        else
-            {
-            startf=r0[counter];
-            starti=(int) r0[counter];
-            }
-
-//
-// Calculate the pitch angle rate of change (if any)
-//
+    num=omp_get_max_threads();
+    outer=(num < num_files) ? num : num_files;
+    if (!fits_is_reentrant()) outer=1;
+    inner=num/outer;
+    omp_set_max_active_levels(2);
 
-        longr=1;
-        for (theta=0.0;theta<=sweep[counter];theta+=1.0)
-            {
-            r = startf*expf(tan(fabs(pa[counter]+delta[counter])*(M_PI/180.0))*theta*(M_PI/180.0));
-            x=(hsize[counter]/2)+(int)(r*cos(mod*theta*(M_PI/180.0)));
-            y=(vsize[counter]/2)+(int)(r*sin(mod*theta*(M_PI/180.0)));
+    if (verbose) printf("Generating %d Files With %d x %d Threads...\n",num_files,outer,inner);
 
-            if ( (x > mar[counter]) && (x < (hsize[counter]-mar[counter])) && (y > mar[counter]) && (y < (vsize[counter]-mar[counter])) )
-                {
-                longr=r;
-                }
-            }
+    asts=new astro[outer];
+    sps=new spiral[outer];
+    mats=new Image2D<float>[outer];
 
-        if (verbose) printf("Longest r=%d,  ",longr);
+    for (c=0; c < outer; c++)
+        {
+        asts[c].set_warn(1);
+        sps[c].seed=seed;
+        sps[c].verbose=verbose;
+        sps[c].list=list;
+        sps[c].analytic=analytic;
+        sps[c].psf=psf;
+        sps[c].fwhm=fwhm;
+        sps[c].beta=beta;
+        sps[c].psf_img=&psf_img;
+        sps[c].gain=gain;
+        sps[c].read_noise=read_noise;
+        }
 
-//
-// Check for sanity of parameters
-//
+#pragma omp parallel for num_threads(outer) schedule(dynamic,1) reduction(+:errcnt) if (fits_is_reentrant())
+    for (int it=0; it < num_files; it++)
+        {
+        errcnt+=make_model(it, omp_get_thread_num());
+        }
 
-        if (hsize[counter] < vsize[counter])
-            {
-            outer=hsize[counter]/2-mar[counter]-starti-feath[counter]-1;
-            }
-        else
-            {
-            outer=vsize[counter]/2-mar[counter]-starti-feath[counter]-1;
-            }
-        if (verbose) printf("Outer Arm=%d,  ",outer);
-        if ((outer < 2)||(outer>(hsize[counter]/2))||(outer>(vsize[counter]/2)))
-            {
-            printf("ERROR: Input parameters inconsistent - arm length is %d\n",outer);
-            errcnt++;
-            continue;
-            }
+    delete [] mats;
+    delete [] sps;
+    delete [] asts;
 
-//
-// Calculate the pitch angle change
-//
+    printf("Total Files Processed: %d\n",num_files);
+    printf("Total Errors: %d\n",errcnt);
+    }
 
-        change=delta[counter]/((float)longr-startf);
-        if (verbose) printf("Pitch Angle Incremental Change=%f\n",change);
 
 //
-// Calculate the brightness change for the arms
+// MAKE_MODEL() - Draws one model and writes its files.  Runs in parallel;
+//                everything it changes belongs to thread th.
 //
-
-        if (lum[counter] == 0.0)
-            {
-            lum_rate=0.0;
-            }
-        else
-            {
-            if (linear[counter]==0) lum_rate=(fg[counter]-fabs(fg[counter]*lum[counter]))/((float)longr-startf);
-                else lum_rate=-1.0*logf(fg[counter]/(fg[counter]+(fg[counter]*lum[counter])))/((float)(longr-1)-startf);
-            if ((lum[counter]< 0)&&(linear[counter]==0))
-                {
-                lum_rate= -1.0*lum_rate;
-                }
-            if (verbose) printf("Brightness Incremental Change=%f\n",lum_rate);
-            }
-
-//
-// Start mapping the polar coordinates.  Loop through theta from 1 to sweep.
+// Arguments:
+//      n       - Model number (index into models)
+//      th      - Thread number (selects the per thread state)
 //
-
-        if (verbose) printf("  --- Map Coordinates\n");
-
-        pitch=pa[counter];
-        min_pitch=pitch;
-        max_pitch=pitch;
-        avg_pitch=0;
-        num_pitch=0;
-
-        for (theta=0.0;theta<=sweep[counter];theta+=1.0)
-            {
+// Global Variables:
+//      models          - Model parameters
+//      asts, sps, mats - Per thread state
+//      inner           - Threads for the rows of the model
+//      txt, verbose    - Option flags
 //
-// This loop is needed for multiple arms
+// Return Value:
+//      Number of errors (0 or 1)
 //
 
-            for(mode=0; mode < arm[counter]; mode++)
-                {
-
-//
-// Calculate the true r value.  This is where using consecutively larger
-//   values of theta makes the calculation easier.  Please note tan(3) on 
-//   Linux expects values in radians and not degrees.
-//
+int     make_model(int n, int th)
+    {
+    int     i, j;              /* Index variables                                */
+    int     ctr;               /* Counter for number of entries/line in txt file */
+    int     ret;               /* Result from the model drawing                  */
+    char    fname[80];         /* Output file name                               */
+    char    fname2[80];        /* Output file name with CFITSIO overwrite flag   */
+    char    keys[5][32];       /* FITS header key names                          */
+    char    items[5][80];      /* FITS header key values                         */
+    FILE    *ofile;            /* File stream for output .txt file               */
 
-                r = startf*expf(tan(fabs(pitch)*(M_PI/180.0))*theta*(M_PI/180.0));
+    sp_rec          *e=&models[n];
+    spiral          &sp=sps[th];
+    Image2D<float>  &mat=mats[th];
+    astro           &ast=asts[th];
 
 //
-// Now map r and theta to the Cartesian values.  Note that we map
-//   from the center of the image outward.  Also note, that we vary the actual
-//   theta angle for each arm by the separation.
+// If the verbose flag is set, print out all input information/assumptions
 //
 
-                x=(hsize[counter]/2)+(int)(r*cos(mod*(theta+rot[counter]+((float)mode*separation))*(M_PI/180.0)));
-                y=(vsize[counter]/2)+(int)(r*sin(mod*(theta+rot[counter]+((float)mode*separation))*(M_PI/180.0)));
-
-//
-// Depending on the pitch angle value, X and/or Y can go outside of the array
-//   bounds, so don't plot them if that's the case.  Please note, since the arm
-//   lines are feathered, we need to include the padding.
-//
+    if (verbose)
+        {
+#pragma omp critical (p2spiral_out)
+        {
+        printf("Processing File %d: Name=%s, Pitch Angle=%f\n",n+1,e->name,e->pa);
 
-                if ((x >= (mar[counter]+feath[counter])) && (x < (hsize[counter]-mar[counter]-feath[counter])) && (y >= (mar[counter]+feath[counter])) && (y < (vsize[counter]-mar[counter]-feath[counter])))
-                    {
-                    if (linear[counter]==0)
-                        {
-                        brt=fg[counter]+((r-1.0-startf)*lum_rate);
-                        }
-                    else
-                        {
-                        brt=fg[counter]*expf(lum_rate*(r-1.0-startf));
-                        }
-                    mat[y][x]=brt;
-                    avg_pitch+=pitch;
-                    num_pitch+=1.0;
-                    if (list) printf("Radius: %f\t Pitch: %f Luminosity: %f\n",r,pitch,brt);
-                    newpitch=pa[counter]+((int)(r-startf)*change);
-
-//
-// The pitch angle formula in unstable in the outer regions for variable
-//   pitch angles.  This logic attempts to maintain the growth of the curve.
-//
-
-                    if (pa[counter] > 0.0)
-                        {
-                        if (delta[counter] > 0.0)
-                            {
-                            if (newpitch > pitch)
-                                {
-                                pitch=newpitch;
-                                if (pitch > max_pitch) max_pitch=pitch;
-                                if (pitch < min_pitch) min_pitch=pitch;
-                                }
-                            }
-                        if (delta[counter] < 0.0)
-                            {
-                            if (newpitch < pitch) 
-                                {
-                                pitch=newpitch;
-                                if (pitch > max_pitch) max_pitch=pitch;
-                                if (pitch < min_pitch) min_pitch=pitch;
-                                }
-                            }
-                        }
-
-                    if (pa[counter] < 0.0)
-                        {
-                        if (delta[counter] > 0.0)
-                            {
-                            if (newpitch > pitch) 
-                                {
-                                pitch=newpitch;
-                                if (pitch > max_pitch) max_pitch=pitch;
-                                if (pitch < min_pitch) min_pitch=pitch;
-                                }
-                            }
-                        if (delta[counter] < 0.0)
-                            {
-                            if (newpitch < pitch) 
-                                {
-                                pitch=newpitch;
-                                if (pitch > max_pitch) max_pitch=pitch;
-                                if (pitch < min_pitch) min_pitch=pitch;
-                                }
-                            }
-                        }
-
-//
-// Make the lines thicker with a 2D feathering
-//
-
-                    if (feath[counter] > 0)
-                        {
-                        for ( t=1; t <= feath[counter]; t++)
-                            {
-                            for ( s=1; s <= feath[counter]; s++)
-                                {
-
-//
-// Check the X & Y values again
-//
-
-                                if ((x > mar[counter]) && (x < (hsize[counter]-mar[counter])) && (y > mar[counter]) && (y < (vsize[counter]-mar[counter])))
-                                    {
-                                    mat[y-t][x]=brt;
-                                    mat[y][x-s]=brt;
-                                    mat[y+t][x-s]=brt;
-                                    mat[y-t][x-s]=brt;
-                                    mat[y+t][x]=brt;
-                                    mat[y][x+s]=brt;
-                                    mat[y+t][x+s]=brt;
-                                    mat[y+t][x-s]=brt;
-                                    }
-                                }
-                            }
-                        }
+        printf("    Arms=%d, Hor. Size=%d, Ver. Size=%d, Feather=%d\n",e->arm,e->hsize,e->vsize,e->feath);
 
-                    }
-                }
-            }
+        printf("    Sweep=%f, Rotation=%f, r0=%f, Core=%d, Bar Semi-Major=%f, Bar Semi-Minor=%f\n",e->sweep,e->rot,e->r0,e->core,e->bara,e->barb);
 
-//
-// Calculate average pitch angle and other constants to complete drawing
-//
+        printf("    Margin=%d, Fg=%f, Bg=%f, Delta=%f, Lum=%f\n",e->mar,e->fg,e->bg,e->delta,e->lum);
 
-        avg_pitch=avg_pitch/num_pitch;
-        centerx=hsize[counter]/2;
-        centery=vsize[counter]/2;
-        r2=(int) r0[counter]*r0[counter];
-        si=sin(rot[counter]*(M_PI/180.0));
-        co=cos(rot[counter]*(M_PI/180.0));
-        starti_s=(int) barb[counter];
+        printf("    Log=%d, Arm_lum=%d, Noise=%f\n",e->linear,e->arm_lum,e->noise);
+        }
+        }
 
 //
-// Fill in bar ellipse
+// Draw the model (background and noise, arms, bar and core).  The messages
+//   for the model are printed together.
 //
 
-        if (bara[counter])
-            {
-            brt=fg[counter];
-            for (x=centerx-starti; x <= centerx+starti; x++)
-                {
-                for (y=centery-starti_s; y <= centery+starti_s; y++)
-                    {
-                    ma=(float)(x-centerx)*co+(float)(y-centery)*si;
-                    mb=(float)(y-centery)*co-(float)(x-centerx)*si;
-                    if ((pow(ma/bara[counter],2.0)+pow(mb/barb[counter],2.0)) <= 1.0)
-                        {
-                        mat[y][x]=brt;
-                        }
-                    }
-                }
-            }
+    ret=sp.render(e, &mat, inner);
 
-//
-// Fill in the core.  Cannot use the same polar to cartesian mapping as in
-//   p2dfft because larger cores will have gaps and patterns develop that
-//   can be interpreted as structure.
-//
+    if (!sp.text.empty())
+        {
+#pragma omp critical (p2spiral_out)
+        fputs(sp.text.c_str(), stdout);
+        }
 
-        if (core[counter])
-            {
-            brt=fg[counter]*(float)core[counter];
-            for (x=centerx-r0[counter]; x <= centerx+r0[counter]; x++)
-                {
-                for (y=centery-r0[counter]; y <= centery+r0[counter]; y++)
-                    {
-                    if ((x-centerx)*(x-centerx)+(y-centery)*(y-centery) <= r2)
-                        {
-                        mat[y][x]=brt;
-                        }
-                    }
-                }
-            }
+    if (ret) return(1);
 
 #ifdef DEBUG
 
-    for (i=0;i<vsize[counter];i++)
+    for (i=0;i<e->vsize;i++)
         {
-        for (j=0;j<hsize[counter];j++)
+        for (j=0;j<e->hsize;j++)
             {
             printf("DEBUG: mat[%d][%d]=%f\n",i,j,mat[i][j]);
             }
@@ -1223,19 +977,26 @@ int main(int argc, char **argv)
 #endif
 
 //
-// Now that we have a Cartesian matrix, create a FITS .txt file to write out.
-//   Remove any old version first.
+// Now that we have a Cartesian matrix, create a FITS .txt file to write out
+//   (fopen() replaces any old version).
 //
 
-        if (txt)
+    if (txt)
+        {
+        if (verbose)
             {
-            if (verbose) printf("  --- Write %s.txt File\n",base[counter]);
+#pragma omp critical (p2spiral_out)
+            printf("  --- Write %s.txt File\n",e->name);
+            }
 
-            sprintf(fname,"%s.txt",base[counter]);
-            sprintf(cmd,"rm -f %s",fname);
-            status=system(cmd);
+        snprintf(fname,sizeof(fname),"%s.txt",e->name);
 
-            ofile=fopen(fname,"w");
+        if ((ofile=fopen(fname,"w")) == NULL)
+            {
+#pragma omp critical (p2spiral_out)
+            printf("ERROR: Can't Write %s\n",fname);
+            return(1);
+            }
 
 //
 // Loop through file and write it in .txt format.  2DFFT expect 80 character
@@ -1244,42 +1005,45 @@ int main(int argc, char **argv)
 //   and start a new line.
 //
 
-            fprintf(ofile,"%14f%14f",(double)vsize[counter],(double)hsize[counter]);
-            ctr=0; 
-            for(i=0;i<vsize[counter];i++)
+        fprintf(ofile,"%14f%14f",(double)e->vsize,(double)e->hsize);
+        ctr=0; 
+        for(i=0;i<e->vsize;i++)
+            {
+            for(j=0;j<e->hsize;j++) 
                 {
-                for(j=0;j<hsize[counter];j++) 
+                fprintf(ofile,"%14f",mat[i][j]);
+                ctr++;
+                if (ctr==5)
                     {
-                    fprintf(ofile,"%14f",mat[i][j]);
-                    ctr++;
-                    if (ctr==5)
-                        {
-                        fprintf(ofile,"\n");
-                        ctr=0;
-                        }
+                    fprintf(ofile,"\n");
+                    ctr=0;
                     }
                 }
-
-            fclose(ofile);
             }
 
+        fclose(ofile);
+        }
+
 //
 // Now create a FITS file using the astro_class libraries.  Please note that 
 //   when the new flag is set to 1 it will overwrite any existing file with
 //   with the same name.
 //
   
-        if (verbose) printf("  --- Write %s.fits File\n",base[counter]);
+    if (verbose)
+        {
+#pragma omp critical (p2spiral_out)
+        printf("  --- Write %s.fits File\n",e->name);
+        }
 
-        sprintf(fname,"%s.fits",base[counter]);
-        sprintf(fname2,"!%s.fits",base[counter]);
-        ast.set_warn(1);
-        if (ast.fits_write(fname2, mat[0], hsize[counter], vsize[counter], 1, "p2spiral/",VERSION))
-            {
-            printf("ERROR: fits_write() Failed\n");
-            free(mat);
-            continue;
-            }
+    snprintf(fname,sizeof(fname),"%s.fits",e->name);
+    snprintf(fname2,sizeof(fname2),"!%s.fits",e->name);
+    if (ast.fits_write(fname2, mat.view(), 1, "p2spiral/",VERSION))
+        {
+#pragma omp critical (p2spiral_out)
+        printf("ERROR: fits_write() Failed for %s\n",fname);
+        return(1);
+        }
 
 //
 // Add some extra key values to the FITS header.  The COLORSPC key is used by
@@ -1287,29 +1051,22 @@ int main(int argc, char **argv)
 //   convienience for testing.
 //
 
-        strcpy(keys[0],"COLORSPC");
-        strcpy(items[0],"Grayscale");
-        strcpy(keys[1],"ARMS");
-        sprintf(items[1],"%d", arm[counter]);
-        strcpy(keys[2],"AVGPITCH");
-        sprintf(items[2],"%f", avg_pitch);
-        strcpy(keys[3],"MINPITCH");
-        sprintf(items[3],"%f", min_pitch);
-        strcpy(keys[4],"MAX_PITCH");
-        sprintf(items[4],"%f", max_pitch);
+    strcpy(keys[0],"COLORSPC");
+    strcpy(items[0],"Grayscale");
+    strcpy(keys[1],"ARMS");
+    sprintf(items[1],"%d", e->arm);
+    strcpy(keys[2],"AVGPITCH");
+    sprintf(items[2],"%f", sp.avg_pitch);
+    strcpy(keys[3],"MINPITCH");
+    sprintf(items[3],"%f", sp.min_pitch);
+    strcpy(keys[4],"MAX_PITCH");
+    sprintf(items[4],"%f", sp.max_pitch);
 
-        if (ast.fits_header_write(fname, keys, items, 5))
-            {
-            printf("WARNING: fits_header_write() Failed\n");
-            }
-
-//
-// Deallocate the array for this file
-//
-
-        free(mat);
+    if (ast.fits_header_write(fname, keys, items, 5))
+        {
+#pragma omp critical (p2spiral_out)
+        printf("WARNING: fits_header_write() Failed for %s\n",fname);
         }
 
-    printf("Total Files Processed: %d\n",num_files);
-    printf("Total Errors: %d\n",errcnt);
+    return(0);
     }
@@ -3,7 +3,7 @@
 //                   of the FFT output data from P2DFFT.
 //
 //
-// Version 1.3  07-Apr-2018
+// Version 1.4  17-Oct-2026
 //
 //
 // Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
@@ -44,6 +44,8 @@
 //
 //
 // Revision History:
+//      1.4  17-Oct-2026: - Build pitch_phase(), snr() and fwhm() for each
+//                          instruction set in CPU_PATHS (CPU_CLONES)
 //      1.3  07-Apr-2018: - Change snr() and fwhm() to set calculated values in
 //                          the return structure and just return a staus code
 //      1.2  16-Mar-2018: - Fix bug due to FP rounding error in SNR
@@ -59,7 +61,7 @@
 //      1.0  05-Feb-2018: - Initial version
 //
 
-#define     PITCH_VER   "1.3/20180407"
+#define     PITCH_VER   "1.4/20261017"
 
 #include    <stdio.h>
 #include    <string.h>
@@ -158,6 +160,7 @@ int    pitch::get_err()
 //      PITCH_RET_ERR      - Error encountered, no results returned
 //
 
+CPU_CLONES
 int    pitch::pitch_phase(fft_out *fft, int mode, result_pa *res)
     {
     int     i;
@@ -232,6 +235,7 @@ int    pitch::pitch_phase(fft_out *fft, int mode, result_pa *res)
 //      PITCH_RET_ERR      - Error encountered, no results returned
 //
 
+CPU_CLONES
 int    pitch::snr(fft_out *fft, result_pa *res)
     {
     int     i;
@@ -309,6 +313,7 @@ int    pitch::snr(fft_out *fft, result_pa *res)
 //
 
 
+CPU_CLONES
 int    pitch::fwhm(fft_out *fft, result_pa *res)
     {
     int     i;
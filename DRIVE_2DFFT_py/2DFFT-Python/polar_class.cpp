@@ -0,0 +1,194 @@
+//
+// POLAR_CLASS.CPP - This class builds the logarithmic polar sampling table
+//                   used to map Cartesian images to (theta, ln r) space.
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
+//           NC Museum of Natural Sciences,
+//           Astronomy & Astrophysics Lab,
+//           Raleigh, NC USA.
+//           http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//      North Carolina Museum of Natural Sciences
+//      Astronomy & Astrophysics Laboratory
+//      11 West Jones Street
+//      Raleigh, NC, 27601  USA
+//      +1.919.707.9800
+//
+//      -- or --
+//
+//      patrick.treuthardt@naturalsciences.org
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//
+
+#define     POLAR_VER   "1.0/20261017"
+
+#include    <math.h>
+#include    <stdio.h>
+#include    <stdlib.h>
+
+#include    "polar_class.h"
+#include    "globals.h"
+
+//
+// FUNCTION BLOCK
+//
+
+
+//
+// LOGPOLAR() - Constructor.  The table is not built until build() is called.
+//
+
+logpolar::logpolar()
+    {
+    n_rad=0;
+    dx=NULL;
+    dy=NULL;
+    lnr=NULL;
+    }
+
+
+//
+// ~LOGPOLAR() - Destructor.  Releases the table.
+//
+
+logpolar::~logpolar()
+    {
+    free(dx);
+    free(dy);
+    free(lnr);
+    }
+
+
+//
+// VERSION() - This function will print the current version.
+//
+// Arguments: NONE
+//
+// Return Value: NONE
+//
+
+void    logpolar::version()
+    {
+    printf("  -- Polar Class Include Version:  %s\n",POLAR_H_VER);
+    printf("  -- Polar Class Function Version:  %s\n",POLAR_VER);
+    }
+
+
+//
+// BUILD() - Builds the sampling table.  The theta and ln r values are
+//           stepped exactly the way the original P2DFFT loops step them
+//           (single precision accumulation), so the offsets are bit for bit
+//           the same as calculating expf()/cosf()/sinf() in the loops.
+//
+//           Only ln r values up to ln(MAX_DIM) are kept since no image can
+//           have a larger radius.
+//
+// Arguments: NONE
+//
+// Return Value:
+//      POLAR_SUCCESS  - Table built (or was already built)
+//      POLAR_FAILURE  - Memory allocation failed
+//
+
+int     logpolar::build()
+    {
+    int     t, r;              /* Theta and ln r step counters               */
+    float   step;              /* ln r value for the current step            */
+    float   x, y;              /* Relative cartesian coordinates             */
+    float   theta_degrees;     /* Current theta (polar angle) in degrees     */
+    float   theta_radians;     /* Current theta (polar angle) in radians     */
+
+    const   float   radstep=2.0*PI/STEP_P/DIM_RAD;
+    const   float   theta_step=2.0*PI/GR_RAD/DIM_THT;
+
+    if (dx != NULL) return(POLAR_SUCCESS);
+
+    if ((lnr=(float *) malloc(DIM_RAD*sizeof(float))) == NULL) return(POLAR_FAILURE);
+
+    n_rad=0;
+    step=0.0;
+    for (r=0; r < DIM_RAD; r++)
+        {
+        lnr[r]=step;
+        if (step <= (float) log((double) MAX_DIM)) n_rad=r+1;
+        step+=radstep;
+        }
+
+    dx=(int *) malloc((size_t)DIM_THT*n_rad*sizeof(int));
+    dy=(int *) malloc((size_t)DIM_THT*n_rad*sizeof(int));
+
+    if ((dx == NULL) || (dy == NULL)) return(POLAR_FAILURE);
+
+    theta_degrees=0.0;
+    for (t=0; t < DIM_THT; t++)
+        {
+        theta_radians=theta_degrees*GR_RAD;
+        for (r=0; r < n_rad; r++)
+            {
+            x=expf(lnr[r])*cosf(theta_radians);
+            y=expf(lnr[r])*sinf(theta_radians);
+            dx[t*n_rad+r]=(int)x;
+            dy[t*n_rad+r]=(int)y;
+            }
+        theta_degrees+=theta_step;
+        }
+
+    if (DEBUG) printf("DEBUG: logpolar::build() n_rad=%d\n",n_rad);
+
+    return(POLAR_SUCCESS);
+    }
+
+
+//
+// RAD_RANGE() - Returns the range of ln r steps with lo <= ln r <= hi.
+//               Since ln r increases with the step number, the samples that
+//               are kept for an annulus are always one contiguous range.
+//
+// Arguments:
+//      lo      - Lowest ln r value to keep
+//      hi      - Highest ln r value to keep
+//      first   - Set to first ln r step in the range
+//      last    - Set to one past the last ln r step in the range
+//
+// Return Value:
+//      Number of ln r steps in the range (0 if empty)
+//
+
+int     logpolar::rad_range(float lo, float hi, int *first, int *last)
+    {
+    int     r;
+
+    for (r=0; (r < n_rad) && (lnr[r] < lo); r++);
+    *first=r;
+    for (; (r < n_rad) && (lnr[r] <= hi); r++);
+    *last=r;
+
+    return(*last-*first);
+    }
@@ -0,0 +1,82 @@
+//
+// POLAR_CLASS.H - This class provides the logarithmic polar sampling table
+//                 shared by the P2DFFT programs.
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
+//           NC Museum of Natural Sciences,
+//           Astronomy & Astrophysics Lab,
+//           Raleigh, NC USA.
+//           http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//      North Carolina Museum of Natural Sciences
+//      Astronomy & Astrophysics Laboratory
+//      11 West Jones Street
+//      Raleigh, NC, 27601  USA
+//      +1.919.707.9800
+//
+//      -- or --
+//
+//      patrick.treuthardt@naturalsciences.org
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//
+
+#define     POLAR_H_VER   "1.0/20261017"
+
+#include    <cstddef>
+
+//
+// Class definition values
+//
+//   The table holds, for every (theta, ln r) sample in the order used by
+//   P2DFFT (theta slowest, ln r fastest), the Cartesian offset of the sample
+//   from the image center.  The offsets do not depend on the image, so one
+//   table serves every image, plane and radius in a run.
+//
+
+class   logpolar {
+              public:
+                 logpolar();
+                 ~logpolar();
+                 void    version();
+                 int     build();
+                 int     rad_range(float lo, float hi, int *first, int *last);
+
+                 int     n_rad;      /* Number of ln r steps in the table    */
+                 int     *dx;        /* X offset per sample [DIM_THT][n_rad] */
+                 int     *dy;        /* Y offset per sample [DIM_THT][n_rad] */
+                 float   *lnr;       /* ln r value per ln r step [DIM_RAD]   */
+              };
+
+//
+// Return codes
+//
+
+#define     POLAR_SUCCESS       0
+#define     POLAR_FAILURE       1
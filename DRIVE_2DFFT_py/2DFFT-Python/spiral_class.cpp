@@ -0,0 +1,1458 @@
+//
+// SPIRAL_CLASS.CPP - This class draws the model galaxies made by p2spiral
+//                    (see spiral_class.h and the p2spiral.cpp header for
+//                    the model).
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
+//           NC Museum of Natural Sciences,
+//           Astronomy & Astrophysics Lab,
+//           Raleigh, NC USA.
+//           http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//      North Carolina Museum of Natural Sciences
+//      Astronomy & Astrophysics Laboratory
+//      11 West Jones Street
+//      Raleigh, NC, 27601  USA
+//      +1.919.707.9800
+//
+//      -- or --
+//
+//      patrick.treuthardt@naturalsciences.org
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version (drawing code moved from
+//                          p2spiral.cpp 4.1)
+//                        - Add the analytic arm renderer (paint())
+//                        - Add the PSF convolution (convolve()) and the shot
+//                          and read noise (shot()) stages
+//                        - Move the input line parsing here from p2spiral.cpp
+//                          (parse())
+//                        - Add overlay()
+//                        - Make the PSF plans with FFTW_ESTIMATE so the
+//                          convolved models are reproducible
+//
+
+#define     SPIRAL_VER   "1.0/20261017"
+
+#include    <math.h>
+#include    <stdio.h>
+#include    <stdarg.h>
+#include    <stdlib.h>
+#include    <string.h>
+
+#include    "spiral_class.h"
+#include    "globals.h"
+
+//
+// Philox4x32 constants
+//
+
+#define     PHILOX_M0       0xD2511F53U
+#define     PHILOX_M1       0xCD9E8D57U
+#define     PHILOX_W0       0x9E3779B9U
+#define     PHILOX_W1       0xBB67AE85U
+#define     PHILOX_ROUNDS   10
+
+//
+// Analytic renderer limits.  Pitch angles are kept between SP_MIN_PITCH and
+//   SP_MAX_PITCH degrees so tan(pitch) stays finite and not zero.
+//
+
+#define     SP_MIN_PITCH    0.06
+#define     SP_MAX_PITCH    89.0
+
+//
+// Pixels given to the noise kernels at a time (their scratch arrays are on
+//   the stack)
+//
+
+#define     SP_CHUNK        256
+
+//
+// Values the analytic renderer needs for each row (see paint())
+//
+
+struct  sp_paint
+    {
+    float   cx, cy;        /* Image center                                   */
+    float   rot;           /* Rotation (radians)                             */
+    float   sep;           /* Angle between the arms (radians)               */
+    float   isep;          /* 1/sep                                          */
+    float   mod;           /* Chirality                                      */
+    float   startf;        /* Starting radius of the arms                    */
+    float   lstartf;       /* ln(startf)                                     */
+    float   sweep;         /* Arm sweep (radians)                            */
+    float   r_end;         /* Largest radius of the arms                     */
+    float   width;         /* Largest distance from an arm that is drawn     */
+    float   fg;            /* Foreground value                               */
+    float   lin_rate;      /* Linear luminosity change (0 if logarithmic)    */
+    float   log_rate;      /* Logarithmic luminosity change (0 if linear)    */
+    int     x_lo, x_hi;    /* Columns inside the margin                      */
+    int     n_step;        /* Entries in the slope tables                    */
+    const float *slope;    /* tan(pitch) by radius step                      */
+    const float *islope;   /* 1/tan(pitch) by radius step                    */
+    const float *cpitch;   /* cos(pitch) by radius step                      */
+    };
+
+//
+// Branch free float versions of the math functions used by the analytic
+//   renderer, so its row loop vectorizes without a vector math library.
+//   They are accurate to about 1e-6 (relative) for sp_log() and sp_exp() and
+//   1e-5 radians for sp_atan2(), far below a pixel for the largest images.
+//   Choices are made between constants that are then added or multiplied
+//   in (a choice between two calculated floats is a branch to the compiler).
+//
+
+#if defined(__GNUC__)
+#define     SP_INLINE   static inline __attribute__((always_inline))
+#else
+#define     SP_INLINE   static inline
+#endif
+
+SP_INLINE float sp_floor(float v)
+    {
+    float   t=(float)(int) v;
+
+    t=t-((t > v) ? 1.0f : 0.0f);
+    return(t);
+    }
+
+SP_INLINE float sp_log(float v)
+    {
+    int32_t i, e;
+    float   m, h, z, z2;
+
+    memcpy(&i, &v, sizeof(i));
+    e=((i >> 23) & 0xff)-127;
+    i=(i & 0x007fffff) | 0x3f800000;
+    memcpy(&m, &i, sizeof(m));
+
+    h=m*0.5f;
+    e=(m > 1.41421356f) ? e+1 : e;
+    m=(m > 1.41421356f) ? h : m;
+
+    z=(m-1.0f)/(m+1.0f);
+    z2=z*z;
+
+    return(2.0f*z*(1.0f+z2*(0.33333333f+z2*(0.2f+z2*(0.14285714f+z2*0.11111111f))))+(float) e*0.69314718f);
+    }
+
+SP_INLINE float sp_exp(float v)
+    {
+    int32_t k;
+    float   n, f, s, lo, hi;
+
+    lo=(v < -87.0f) ? 1.0f : 0.0f;
+    hi=(v > 88.0f) ? 1.0f : 0.0f;
+    v=v*(1.0f-lo-hi)-87.0f*lo+88.0f*hi;
+
+    n=sp_floor(v*1.44269504f+0.5f);
+    f=v-n*0.69314718f;
+
+    k=((int32_t) n+127) << 23;
+    memcpy(&s, &k, sizeof(s));
+
+    return(s*(1.0f+f*(1.0f+f*(0.5f+f*(0.16666667f+f*(0.041666668f+f*(0.0083333338f+f*(0.0013888889f+f*0.00019841270f))))))));
+    }
+
+SP_INLINE float sp_atan2(float y, float x)
+    {
+    float   ax=fabsf(x), ay=fabsf(y);
+    float   mx=(ax > ay) ? ax : ay;
+    float   mn=(ax > ay) ? ay : ax;
+    float   a=mn/(mx+1.0e-30f);
+    float   s=a*a;
+    float   r;
+
+    r=a*(0.99997726f+s*(-0.33262347f+s*(0.19354346f+s*(-0.11643287f+s*(0.05265332f+s*(-0.01172120f))))));
+    r=((ay > ax) ? 1.57079633f : 0.0f)+((ay > ax) ? -1.0f : 1.0f)*r;
+    r=((x < 0.0f) ? 3.14159265f : 0.0f)+((x < 0.0f) ? -1.0f : 1.0f)*r;
+    r=((y < 0.0f) ? -1.0f : 1.0f)*r;
+
+    return(r);
+    }
+
+SP_INLINE float sp_sqrt(float v)
+    {
+    return(sp_exp(0.5f*sp_log(v+1.0e-30f)));
+    }
+
+//
+// SP_SINCOS() - Sine and cosine of a in [-pi, pi], from the series of a/2
+//               (|a/2| <= pi/2, error below 1e-7) and the double angle
+//               formulas
+//
+
+SP_INLINE void sp_sincos(float a, float *s, float *c)
+    {
+    float   h=0.5f*a, h2=h*h;
+    float   sh, ch;
+
+    sh=h*(1.0f+h2*(-0.16666667f+h2*(0.0083333333f+h2*(-0.00019841270f+h2*(2.7557319e-6f+h2*(-2.5052108e-8f))))));
+    ch=1.0f+h2*(-0.5f+h2*(0.041666667f+h2*(-0.0013888889f+h2*(2.4801587e-5f+h2*(-2.7557319e-7f+h2*2.0876757e-9f)))));
+
+    *s=2.0f*sh*ch;
+    *c=ch*ch-sh*sh;
+    }
+
+//
+// PAINT_ROW() - Analytic arm kernel for one row (see spiral::paint())
+//
+// Arguments:
+//      p       - Renderer values (a copy, so the compiler knows the row
+//                can't change them)
+//      row     - Row of the image
+//      dy      - Row offset from the center
+//
+// Return Value: NONE
+//
+
+CPU_CLONES
+static void paint_row(sp_paint p, float *row, float dy)
+    {
+    int     x;
+
+#pragma omp simd
+    for (x=p.x_lo; x < p.x_hi; x++)
+        {
+        float   dx=(float) x-p.cx;
+        float   lr=0.5f*sp_log(dx*dx+dy*dy+1.0e-6f);
+        float   r=sp_exp(lr);
+        int     k=(int) (r-p.startf);
+        float   u, d, th, dist, brt;
+        int32_t on, vb, vo;
+
+        k=(k < 0) ? 0 : k;
+        k=(k >= p.n_step) ? p.n_step-1 : k;
+
+//
+// u is the arm angle (theta) at which an arm reaches radius r, and d is how
+//   far the pixel is from the nearest arm in theta at that radius
+//
+
+        u=(lr-p.lstartf)*p.islope[k];
+        d=u-(p.mod*sp_atan2(dy, dx)-p.rot);
+        d=d-p.sep*sp_floor(d*p.isep+0.5f);
+        th=u-d;
+
+//
+// Distance to the arm across its direction, from the difference in ln r
+//
+
+        dist=fabsf(r*(1.0f-sp_exp(-p.slope[k]*d)))*p.cpitch[k];
+
+//
+// Only one of the luminosity rates is used, the other is 0
+//
+
+        brt=(p.fg+((r-1.0f-p.startf)*p.lin_rate))*sp_exp(p.log_rate*(r-1.0f-p.startf));
+
+//
+// Keep the old value unless the pixel is on an arm (a bit mask, for the
+//   same reason as above)
+//
+
+        on=-(int32_t) ((dist <= p.width) & (th >= 0.0f) & (th <= p.sweep) & (r <= p.r_end));
+        memcpy(&vb, &brt, sizeof(vb));
+        memcpy(&vo, &row[x], sizeof(vo));
+        vo=(vb & on) | (vo & ~on);
+        memcpy(&row[x], &vo, sizeof(vo));
+        }
+    }
+
+//
+// PHILOX_RUN() - Philox4x32-10 of the counters (c0+i, c1, c2, c3) for i=0 to
+//                n-1, written as four arrays so the blocks are made side by
+//                side in vector registers (see philox::fill())
+//
+// Arguments:
+//      k0, k1  - Key
+//      c0..c3  - First counter
+//      n       - Number of blocks
+//      w0..w3  - Words 0 to 3 of each block
+//
+// Return Value: NONE
+//
+
+CPU_CLONES
+static void philox_run(uint32_t k0, uint32_t k1, uint32_t c0, int n, uint32_t c1, uint32_t c2, uint32_t c3,
+                       uint32_t *w0, uint32_t *w1, uint32_t *w2, uint32_t *w3)
+    {
+    int     i;
+
+#pragma omp simd
+    for (i=0; i < n; i++)
+        {
+        uint32_t    x0=c0+(uint32_t) i, x1=c1, x2=c2, x3=c3;
+        uint32_t    a=k0, b=k1;
+        uint64_t    p0, p1;
+        int         j;
+
+        for (j=0; j < PHILOX_ROUNDS; j++)
+            {
+            p0=(uint64_t) PHILOX_M0*x0;
+            p1=(uint64_t) PHILOX_M1*x2;
+
+            x0=(uint32_t) (p1 >> 32)^x1^a;
+            x2=(uint32_t) (p0 >> 32)^x3^b;
+            x1=(uint32_t) p1;
+            x3=(uint32_t) p0;
+
+            a+=PHILOX_W0;
+            b+=PHILOX_W1;
+            }
+
+        w0[i]=x0;
+        w1[i]=x1;
+        w2[i]=x2;
+        w3[i]=x3;
+        }
+    }
+
+//
+// SHOT_ROW() - Shot and read noise kernel for up to SP_CHUNK pixels (see
+//              spiral::shot()).  Every pixel gets the normal approximation
+//              of its Poisson count; the caller redoes the ones below
+//              SPIRAL_POISSON_GAUSS electrons.
+//
+// Arguments:
+//      row     - Pixels (counts), replaced by the noisy counts
+//      n       - Number of pixels
+//      g, ig   - Gain (electrons per count) and 1/gain
+//      rn      - Read noise (electrons)
+//      w0, w1  - Random words for the two normal values of each pixel
+//      lam     - Set to the expected electrons of each pixel
+//      rd      - Set to the read noise (electrons) of each pixel
+//
+// Return Value: NONE
+//
+
+CPU_CLONES
+static void shot_row(float *row, int n, float g, float ig, float rn, const uint32_t *w0, const uint32_t *w1, float *lam, float *rd)
+    {
+    int     i;
+
+#pragma omp simd
+    for (i=0; i < n; i++)
+        {
+        float   v=row[i];
+        float   l=((v > 0.0f) ? 1.0f : 0.0f)*v*g;
+        float   u=1.0f-philox::uniform(w0[i]);
+        float   a=6.28318531f*philox::uniform(w1[i])-3.14159265f;
+        float   m=sp_sqrt(-2.0f*sp_log(u));
+        float   s, c, k;
+
+        sp_sincos(a, &s, &c);
+
+        k=sp_floor(l+sp_sqrt(l)*m*c+0.5f);
+        k=((k > 0.0f) ? 1.0f : 0.0f)*k;
+
+        lam[i]=l;
+        rd[i]=rn*m*s;
+        row[i]=(k+rd[i])*ig;
+        }
+    }
+
+//
+// SP_POISSON() - Poisson value of mean lam from the uniform value u, by
+//                searching the cumulative distribution (for small lam)
+//
+
+static int sp_poisson(double lam, double u)
+    {
+    int     k=0;
+    double  p=exp(-lam);
+    double  f=p;
+
+    while ((u > f) && (k < 1000))
+        {
+        k++;
+        p*=lam/k;
+        f+=p;
+        }
+
+    return(k);
+    }
+
+//
+// CMUL_ROW() - Multiplies n complex values of a by those of b
+//
+
+CPU_CLONES
+static void cmul_row(fftw_complex *a, const fftw_complex *b, size_t n)
+    {
+    size_t  i;
+
+#pragma omp simd
+    for (i=0; i < n; i++)
+        {
+        double  re=a[i][0]*b[i][0]-a[i][1]*b[i][1];
+        double  im=a[i][0]*b[i][1]+a[i][1]*b[i][0];
+
+        a[i][0]=re;
+        a[i][1]=im;
+        }
+    }
+
+//
+// FUNCTION BLOCK
+//
+
+
+//
+// BLOCK() - Philox4x32-10 bijection of one counter value
+//
+// Arguments:
+//      c0..c3  - Counter words
+//      out     - The four random words
+//
+// Return Value: NONE
+//
+
+void    philox::block(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t out[4]) const
+    {
+    int         i;
+    uint32_t    a=k0, b=k1;    /* Round keys                                 */
+    uint64_t    p0, p1;        /* Products                                   */
+    uint32_t    t0, t2;
+
+    for (i=0; i < PHILOX_ROUNDS; i++)
+        {
+        p0=(uint64_t) PHILOX_M0*c0;
+        p1=(uint64_t) PHILOX_M1*c2;
+
+        t0=(uint32_t) (p1 >> 32)^c1^a;
+        t2=(uint32_t) (p0 >> 32)^c3^b;
+        c1=(uint32_t) p1;
+        c3=(uint32_t) p0;
+        c0=t0;
+        c2=t2;
+
+        a+=PHILOX_W0;
+        b+=PHILOX_W1;
+        }
+
+    out[0]=c0;
+    out[1]=c1;
+    out[2]=c2;
+    out[3]=c3;
+    }
+
+
+//
+// FILL() - Same as block() for the n counters (c0+i, c1, c2, c3), with the
+//          words of the blocks in four arrays (w0[i] is word 0 of block i).
+//          The blocks are made in a vector loop.
+//
+// Arguments:
+//      c0..c3  - First counter
+//      n       - Number of blocks
+//      w0..w3  - Words of the blocks
+//
+// Return Value: NONE
+//
+
+void    philox::fill(uint32_t c0, int n, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t *w0, uint32_t *w1, uint32_t *w2, uint32_t *w3) const
+    {
+    philox_run(k0, k1, c0, n, c1, c2, c3, w0, w1, w2, w3);
+    }
+
+
+//
+// SPIRAL() - Constructor
+//
+
+spiral::spiral()
+    {
+    seed=0;
+    verbose=0;
+    list=0;
+    analytic=0;
+    avg_pitch=0.0;
+    min_pitch=0.0;
+    max_pitch=0.0;
+    startf=0.0;
+    starti=0;
+    mod=0.0;
+    separation=0.0;
+    change=0.0;
+    lum_rate=0.0;
+    r_end=0.0;
+    psf=PSF_NONE;
+    fwhm=0.0;
+    beta=PSF_BETA;
+    psf_img=NULL;
+    gain=0.0;
+    read_noise=0.0;
+    fwd=NULL;
+    bwd=NULL;
+    p_rows=0;
+    p_cols=0;
+    o_psf=PSF_NONE;
+    o_fwhm=0.0;
+    o_beta=0.0;
+    o_img=NULL;
+    re=NULL;
+    spec=NULL;
+    otf=NULL;
+    }
+
+
+//
+// Destructor (FFTW plans are made and destroyed one thread at a time)
+//
+
+spiral::~spiral()
+    {
+#pragma omp critical (fftw_planner)
+    {
+    if (fwd) fftw_destroy_plan(fwd);
+    if (bwd) fftw_destroy_plan(bwd);
+    }
+    fftw_free(re);
+    fftw_free(spec);
+    fftw_free(otf);
+    }
+
+
+//
+// VERSION() - This function will print the current version.
+//
+// Arguments: NONE
+//
+// Return Value: NONE
+//
+
+void    spiral::version()
+    {
+    printf("  -- Spiral Class Include Version:  %s\n",SPIRAL_H_VER);
+    printf("  -- Spiral Class Function Version:  %s\n",SPIRAL_VER);
+    }
+
+
+//
+// KEY() - Makes the generator key of a model (FNV-1a hash of the name,
+//         mixed with the seed)
+//
+// Arguments:
+//      name    - Model (base file) name
+//      seed    - Run seed (p2spiral -s)
+//
+// Return Value:
+//      64 bit key
+//
+
+uint64_t    spiral::key(const char *name, uint64_t seed)
+    {
+    uint64_t    h=0xCBF29CE484222325ULL;
+
+    while (*name) h=(h^(unsigned char) *name++)*0x100000001B3ULL;
+
+    return(h^(seed*0x9E3779B97F4A7C15ULL));
+    }
+
+
+//
+// SAY() - Adds a printf() formatted message to text
+//
+
+void    spiral::say(const char *fmt, ...)
+    {
+    char    buf[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    text+=buf;
+    }
+
+
+//
+// TOKEN() - Parses the next field of an input line (strtok() must have been
+//           run on the line) and checks that it is between min and max
+//
+// Arguments:
+//      fname   - Base name of the file (for the messages)
+//      name    - Name of the field (for the messages)
+//      min     - Minimum value for any valid input
+//      max     - Maximum value for any valid input
+//
+// Return Value:
+//      Value of the field, or -2048.0 if missing or out of range (with a
+//        message in text)
+//
+
+float   spiral::token(const char *fname, const char *name, float min, float max)
+    {
+    char    *item;         /* Token parsed from the line                     */
+    float   ret;
+
+    if ((item=strtok(NULL,",\t ")) == NULL)
+        {
+        say("ERROR: No %s for File %s\n",name,fname);
+        return(-2048.0);
+        }
+
+    ret=(float)atof(item);
+
+    if ((ret < min) || (ret > max))
+        {
+        say("WARNING: Invalid %s %f for File %s\n",name,ret,fname);
+        return(-2048.0);
+        }
+
+    return(ret);
+    }
+
+
+//
+// PARSE() - Reads the model parameters from one line of a p2spiral input file
+//           (see INPUT FILE FORMAT in p2spiral.cpp).  Comment and blank lines
+//           must be skipped by the caller.  Messages are left in text.
+//
+// Arguments:
+//      line    - Input line (changed by strtok())
+//      e       - Set to the model parameters
+//
+// Return Value:
+//      SPIRAL_SUCCESS  - e is set (possibly without its bar, see text)
+//      SPIRAL_FAILURE  - Line is not valid (see text)
+//
+
+int     spiral::parse(char *line, sp_rec *e)
+    {
+    char    *item;         /* Token parsed from the line                     */
+
+    text.clear();
+    *e=sp_rec();
+
+    if ((item=strtok(line,", \t")) == NULL)
+        {
+        say("WARNING: Invalid Keyword\n");
+        return(SPIRAL_FAILURE);
+        }
+
+    snprintf(e->name,sizeof(e->name),"%s",item);
+
+    if ((e->pa=token(e->name,"Pitch Angle",MIN_PA,MAX_PA)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->arm=(int)token(e->name,"Arm Number",MIN_ARM,MAX_ARM)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->hsize=(int)token(e->name,"Horizontal File Size",MIN_SIZE,MAX_SIZE)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->vsize=(int)token(e->name,"Vertical File Size",MIN_SIZE,MAX_SIZE)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->feath=(int)token(e->name,"Feather",MIN_FTHR,MAX_FTHR)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->sweep=token(e->name,"Sweep Angle",MIN_SWEEP,MAX_SWEEP)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->rot=token(e->name,"Rotation Angle",MIN_ROT,MAX_ROT)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->r0=token(e->name,"Initial Radius",MIN_R0,MAX_R0)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->core=(int)token(e->name,"Core Setting",MIN_CORE,MAX_CORE)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->bara=token(e->name,"Bar Semi-Major Axis",MIN_BARA,MAX_BARA)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->barb=token(e->name,"Bar Semi-Minor Axis",MIN_BARB,MAX_BARB)) < -2000.0) return(SPIRAL_FAILURE);
+
+    if (e->bara && (e->barb < 1.0))
+        {
+        say("WARNING: Semi-Minor Axis Must Be At Least 1.0...Ignoring\n");
+        e->bara=0.0;
+        e->barb=0.0;
+        }
+
+    if (e->barb > e->bara)
+        {
+        say("WARNING: Semi-Major Axis Must Be >= Than Semi-Minor Axis...Skipping\n");
+        return(SPIRAL_FAILURE);
+        }
+
+    if (e->bara && (e->r0 >= e->bara))
+        {
+        say("WARNING: Semi-Major Axis Must Be > Than Initial Radius...Ingoring Bar Values\n");
+        e->bara=0.0;
+        e->barb=0.0;
+        }
+
+    if ((e->mar=(int)token(e->name,"Outer Margin",MIN_MAR,MAX_MAR)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->fg=token(e->name,"Foreground",MIN_PIXEL,MAX_PIXEL)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->bg=token(e->name,"Background (Bias)",MIN_PIXEL,MAX_PIXEL)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->delta=token(e->name,"Pitch Angle Change",MIN_DELTA,MAX_DELTA)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->lum=token(e->name,"Luminosity Change",MIN_LUM,MAX_LUM)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->linear=(int)token(e->name,"Brightness Algorithm",MIN_LOG,MAX_LOG)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->arm_lum=(int)token(e->name,"Arm Width Luminosity Change",MIN_ARM_LUM,MAX_ARM_LUM)) < -2000.0) return(SPIRAL_FAILURE);
+    if ((e->noise=token(e->name,"Noise (Shot)",MIN_NOISE,MAX_NOISE)) < -2000.0) return(SPIRAL_FAILURE);
+
+    return(SPIRAL_SUCCESS);
+    }
+
+
+//
+// RENDER() - Draws one model.  The image is sized for the model, then the
+//            background, arms, bar and core are drawn in that order.
+//            Messages (and the -p listing) are left in text so the caller
+//            can print them together.  With analytic set the arms are still
+//            traced (without drawing) for the pitch values and listing.
+//            The PSF and the shot noise, if set, come last.
+//
+// Arguments:
+//      e        - Model parameters
+//      mat      - Image to draw in ([y][x])
+//      nthreads - Threads used for the image rows
+//
+// Return Value:
+//      SPIRAL_SUCCESS  - Model drawn, avg/min/max_pitch are set
+//      SPIRAL_FAILURE  - No memory or parameters inconsistent (see text)
+//
+
+int     spiral::render(const sp_rec *e, Image2D<float> *mat, int nthreads)
+    {
+    text.clear();
+
+    if (mat->fit(e->vsize, e->hsize))
+        {
+        say("ERROR: Memory allocation failed for %s...Skipping\n",e->name);
+        return(SPIRAL_FAILURE);
+        }
+
+    if (verbose) say("  --- Generating Arrays\n");
+
+    background(e, mat->view(), nthreads);
+
+    if (arms(e, (analytic) ? ImageView<float>() : mat->view())) return(SPIRAL_FAILURE);
+
+    if (analytic) paint(e, mat->view(), nthreads);
+
+    bar(e, mat->view());
+    core(e, mat->view());
+
+    if ((psf != PSF_NONE) && convolve(e, mat)) return(SPIRAL_FAILURE);
+
+    if (gain > 0.0) shot(e, mat->view(), nthreads);
+
+    return(SPIRAL_SUCCESS);
+    }
+
+
+//
+// OVERLAY() - Draws the arms of a model onto an image that is already filled.
+//             Only the arms are drawn (with paint(), whatever analytic is
+//             set to); the other pixels are left as they are.
+//
+// Arguments:
+//      e        - Model parameters (hsize and vsize must be those of m)
+//      m        - Image ([y][x])
+//      nthreads - Threads used for the image rows
+//
+// Return Value:
+//      SPIRAL_SUCCESS  - Arms drawn
+//      SPIRAL_FAILURE  - Arm length inconsistent with the other parameters
+//
+
+int     spiral::overlay(const sp_rec *e, ImageView<float> m, int nthreads)
+    {
+    text.clear();
+
+    if (arms(e, ImageView<float>())) return(SPIRAL_FAILURE);
+
+    paint(e, m, nthreads);
+
+    return(SPIRAL_SUCCESS);
+    }
+
+
+//
+// BACKGROUND() - Fills the image with the background value plus noise up to
+//                e->noise.  The rows are independent (the noise of a pixel
+//                only depends on its position), so they are split over
+//                nthreads threads.
+//
+// Arguments:
+//      e        - Model parameters
+//      m        - Image ([y][x])
+//      nthreads - Threads used for the rows
+//
+// Return Value: NONE
+//
+
+void    spiral::background(const sp_rec *e, ImageView<float> m, int nthreads)
+    {
+    philox  rng(key(e->name, seed)); /* Noise generator for this model       */
+    float   bg=e->bg;
+    float   noise=e->noise;
+    int     hsize=e->hsize;
+
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (int y=0; y < e->vsize; y++)
+        {
+        float       *row=m[y];
+        uint32_t    u[4];
+        int         x, k;
+
+        if (noise == 0.0)
+            {
+            for (x=0; x < hsize; x++) row[x]=bg;
+            continue;
+            }
+
+        for (x=0; x < hsize; x+=4)
+            {
+            rng.block((uint32_t) x/4, (uint32_t) y, SPIRAL_NOISE, 0, u);
+            for (k=0; (k < 4) && (x+k < hsize); k++) row[x+k]=bg+philox::uniform(u[k])*noise;
+            }
+        }
+    }
+
+
+//
+// ARMS() - Draws the arms.  Each arm is a logarithmic spiral stepped one
+//          degree at a time, and the pitch of later points depends on the
+//          earlier ones, so this is done in order by one thread.  It also
+//          sets the arm values used by paint().
+//
+// Arguments:
+//      e       - Model parameters
+//      m       - Image ([y][x]), or an empty view to only trace the arms
+//
+// Return Value:
+//      SPIRAL_SUCCESS  - Arms drawn
+//      SPIRAL_FAILURE  - Arm length inconsistent with the other parameters
+//
+
+int     spiral::arms(const sp_rec *e, ImageView<float> m)
+    {
+    int     s, t;          /* Feathering index variables                     */
+    int     x, y;          /* Array index variables                          */
+    int     mode;          /* Index used in the formula to process each arm  */
+    int     outer;         /* Estimate of arm length                         */
+    int     longr;         /* Estimate of longest radius                     */
+    int     draw=!m.empty(); /* Draw the points (not only trace them)        */
+    float   r;             /* R value for the polar coordinates              */
+    float   brt;           /* Current pixel value for foreground             */
+    float   theta;         /* Loop variable for theta angles                 */
+    float   pitch;         /* Loop variable for changing pitch angle         */
+    float   newpitch;      /* Updated pitch value                            */
+    float   num_pitch;     /* Number of pitch values used                    */
+
+//
+// Set the chirality (direction) value for the equation based on neg/pos p.a.
+//
+
+    if (verbose) say("  --- Set Chirality\n");
+
+    if ( e->pa > 0 )
+        {
+        mod=-1.0;
+        }
+    else
+        {
+        mod=1.0;
+        }
+
+//
+// Determine the arm separation.  If arm > 1 set to the angle of separation
+//   between the arms.  If arm=1, then set to zero, which will cause the
+//   separation term in the formula to go to 0.
+//
+
+    if (verbose) say("  --- Set Arm Separation\n");
+
+    if (e->arm > 1) 
+        {
+        separation=360.0/(float)e->arm;
+        }
+    else
+        {
+        separation=0.0;
+        }
+
+//
+// Determine the radius where the arms will start based on core size and bar
+//   parameters
+//
+
+    if (e->bara > e->r0)
+        {
+        startf=e->bara;
+        starti=(int) e->bara;
+        }
+    else
+        {
+        startf=e->r0;
+        starti=(int) e->r0;
+        }
+
+//
+// Calculate the pitch angle rate of change (if any)
+//
+
+    longr=1;
+    for (theta=0.0;theta<=e->sweep;theta+=1.0)
+        {
+        r = startf*expf(tan(fabs(e->pa+e->delta)*(M_PI/180.0))*theta*(M_PI/180.0));
+        x=(e->hsize/2)+(int)(r*cos(mod*theta*(M_PI/180.0)));
+        y=(e->vsize/2)+(int)(r*sin(mod*theta*(M_PI/180.0)));
+
+        if ( (x > e->mar) && (x < (e->hsize-e->mar)) && (y > e->mar) && (y < (e->vsize-e->mar)) )
+            {
+            longr=r;
+            }
+        }
+
+    if (verbose) say("Longest r=%d,  ",longr);
+
+//
+// Check for sanity of parameters
+//
+
+    if (e->hsize < e->vsize)
+        {
+        outer=e->hsize/2-e->mar-starti-e->feath-1;
+        }
+    else
+        {
+        outer=e->vsize/2-e->mar-starti-e->feath-1;
+        }
+    if (verbose) say("Outer Arm=%d,  ",outer);
+    if ((outer < 2)||(outer>(e->hsize/2))||(outer>(e->vsize/2)))
+        {
+        say("ERROR: Input parameters inconsistent - arm length is %d\n",outer);
+        return(SPIRAL_FAILURE);
+        }
+
+//
+// Calculate the pitch angle change
+//
+
+    change=e->delta/((float)longr-startf);
+    if (verbose) say("Pitch Angle Incremental Change=%f\n",change);
+
+//
+// Calculate the brightness change for the arms
+//
+
+    if (e->lum == 0.0)
+        {
+        lum_rate=0.0;
+        }
+    else
+        {
+        if (e->linear==0) lum_rate=(e->fg-fabs(e->fg*e->lum))/((float)longr-startf);
+            else lum_rate=-1.0*logf(e->fg/(e->fg+(e->fg*e->lum)))/((float)(longr-1)-startf);
+        if ((e->lum< 0)&&(e->linear==0))
+            {
+            lum_rate= -1.0*lum_rate;
+            }
+        if (verbose) say("Brightness Incremental Change=%f\n",lum_rate);
+        }
+
+//
+// Start mapping the polar coordinates.  Loop through theta from 1 to sweep.
+//
+
+    if (verbose) say("  --- Map Coordinates\n");
+
+    pitch=e->pa;
+    r_end=startf;
+    min_pitch=pitch;
+    max_pitch=pitch;
+    avg_pitch=0;
+    num_pitch=0;
+
+    for (theta=0.0;theta<=e->sweep;theta+=1.0)
+        {
+//
+// This loop is needed for multiple arms
+//
+
+        for(mode=0; mode < e->arm; mode++)
+            {
+
+//
+// Calculate the true r value.  This is where using consecutively larger
+//   values of theta makes the calculation easier.  Please note tan(3) on 
+//   Linux expects values in radians and not degrees.
+//
+
+            r = startf*expf(tan(fabs(pitch)*(M_PI/180.0))*theta*(M_PI/180.0));
+
+//
+// Now map r and theta to the Cartesian values.  Note that we map
+//   from the center of the image outward.  Also note, that we vary the actual
+//   theta angle for each arm by the separation.
+//
+
+            x=(e->hsize/2)+(int)(r*cos(mod*(theta+e->rot+((float)mode*separation))*(M_PI/180.0)));
+            y=(e->vsize/2)+(int)(r*sin(mod*(theta+e->rot+((float)mode*separation))*(M_PI/180.0)));
+
+//
+// Depending on the pitch angle value, X and/or Y can go outside of the array
+//   bounds, so don't plot them if that's the case.  Please note, since the arm
+//   lines are feathered, we need to include the padding.
+//
+
+            if ((x >= (e->mar+e->feath)) && (x < (e->hsize-e->mar-e->feath)) && (y >= (e->mar+e->feath)) && (y < (e->vsize-e->mar-e->feath)))
+                {
+                if (e->linear==0)
+                    {
+                    brt=e->fg+((r-1.0-startf)*lum_rate);
+                    }
+                else
+                    {
+                    brt=e->fg*expf(lum_rate*(r-1.0-startf));
+                    }
+                if (draw) m[y][x]=brt;
+                if (r > r_end) r_end=r;
+                avg_pitch+=pitch;
+                num_pitch+=1.0;
+                if (list) say("Radius: %f\t Pitch: %f Luminosity: %f\n",r,pitch,brt);
+                newpitch=e->pa+((int)(r-startf)*change);
+
+//
+// The pitch angle formula in unstable in the outer regions for variable
+//   pitch angles.  This logic attempts to maintain the growth of the curve.
+//
+
+                if (((e->delta > 0.0) && (newpitch > pitch)) || ((e->delta < 0.0) && (newpitch < pitch)))
+                    {
+                    if (e->pa != 0.0)
+                        {
+                        pitch=newpitch;
+                        if (pitch > max_pitch) max_pitch=pitch;
+                        if (pitch < min_pitch) min_pitch=pitch;
+                        }
+                    }
+
+//
+// Make the lines thicker with a 2D feathering
+//
+
+                if ((draw) && (e->feath > 0))
+                    {
+                    for ( t=1; t <= e->feath; t++)
+                        {
+                        for ( s=1; s <= e->feath; s++)
+                            {
+
+//
+// Check the X & Y values again
+//
+
+                            if ((x > e->mar) && (x < (e->hsize-e->mar)) && (y > e->mar) && (y < (e->vsize-e->mar)))
+                                {
+                                m[y-t][x]=brt;
+                                m[y][x-s]=brt;
+                                m[y+t][x-s]=brt;
+                                m[y-t][x-s]=brt;
+                                m[y+t][x]=brt;
+                                m[y][x+s]=brt;
+                                m[y+t][x+s]=brt;
+                                m[y+t][x-s]=brt;
+                                }
+                            }
+                        }
+                    }
+
+                }
+            }
+        }
+
+    avg_pitch=avg_pitch/num_pitch;
+
+    return(SPIRAL_SUCCESS);
+    }
+
+
+//
+// PAINT() - Draws the arms analytically (see spiral_class.h).  arms() must
+//           have been run for the model first.  The pitch at each whole
+//           radius step past the arm start follows the traced arms
+//           (pa+step*change, kept between pa and pa+delta), and is looked
+//           up by the row kernel.  The arms end at the largest radius the
+//           traced arms plotted (r_end).  With a pitch change the traced
+//           points jump between curves, so the two renderers then agree on
+//           the shape of the arms but not pixel for pixel.
+//
+// Arguments:
+//      e        - Model parameters
+//      m        - Image ([y][x])
+//      nthreads - Threads used for the image rows
+//
+// Return Value: NONE
+//
+
+void    spiral::paint(const sp_rec *e, ImageView<float> m, int nthreads)
+    {
+    int     i;
+    int     n_step;        /* Radius steps from the arm start to a corner    */
+    float   p;             /* Pitch angle of a step (degrees)                */
+    float   p_lo, p_hi;    /* Range of the pitch angle (degrees)             */
+    sp_paint    pp;        /* Values for the row kernel                      */
+
+    n_step=(int) (0.5*sqrt((double) e->hsize*e->hsize+(double) e->vsize*e->vsize)-startf)+2;
+    if (n_step < 1) n_step=1;
+
+    slope.resize(n_step);
+    islope.resize(n_step);
+    cpitch.resize(n_step);
+
+    p_lo=(e->delta < 0.0) ? e->pa+e->delta : e->pa;
+    p_hi=(e->delta < 0.0) ? e->pa : e->pa+e->delta;
+
+    for (i=0; i < n_step; i++)
+        {
+        p=e->pa+(float) i*change;
+        if (p < p_lo) p=p_lo;
+        if (p > p_hi) p=p_hi;
+
+        p=fabs(p);
+        if (p < SP_MIN_PITCH) p=SP_MIN_PITCH;
+        if (p > SP_MAX_PITCH) p=SP_MAX_PITCH;
+
+        slope[i]=tan(p*(M_PI/180.0));
+        islope[i]=1.0/slope[i];
+        cpitch[i]=cos(p*(M_PI/180.0));
+        }
+
+    pp.cx=(float) (e->hsize/2);
+    pp.cy=(float) (e->vsize/2);
+    pp.rot=e->rot*(M_PI/180.0);
+    pp.sep=(e->arm > 1) ? separation*(M_PI/180.0) : 2.0*M_PI;
+    pp.isep=1.0/pp.sep;
+    pp.mod=mod;
+    pp.startf=startf;
+    pp.lstartf=log(startf);
+    pp.sweep=e->sweep*(M_PI/180.0);
+    pp.r_end=r_end+(float) e->feath+1.0;
+    pp.width=(float) e->feath+0.5;
+    pp.fg=e->fg;
+    pp.lin_rate=(e->linear == 0) ? lum_rate : 0.0;
+    pp.log_rate=(e->linear == 0) ? 0.0 : lum_rate;
+    pp.x_lo=e->mar;
+    pp.x_hi=e->hsize-e->mar;
+    pp.n_step=n_step;
+    pp.slope=&slope[0];
+    pp.islope=&islope[0];
+    pp.cpitch=&cpitch[0];
+
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (int y=e->mar; y < e->vsize-e->mar; y++)
+        {
+        paint_row(pp, m[y], (float) y-pp.cy);
+        }
+    }
+
+
+//
+// BAR() - Fills in the bar ellipse (if any)
+//
+// Arguments:
+//      e       - Model parameters
+//      m       - Image ([y][x])
+//
+// Return Value: NONE
+//
+
+void    spiral::bar(const sp_rec *e, ImageView<float> m)
+    {
+    int     x, y;          /* Array index variables                          */
+    int     centerx=e->hsize/2; /* Center coordinate for x axis              */
+    int     centery=e->vsize/2; /* Center coordinate for y axis              */
+    int     starti_s=(int) e->barb; /* Starting radius for semi-minor axis   */
+    float   mb,ma;         /* Bar (ellipse) mapping coordinates              */
+    float   si=sin(e->rot*(M_PI/180.0)); /* Sine of the rotation             */
+    float   co=cos(e->rot*(M_PI/180.0)); /* Cosine of the rotation           */
+    float   brt=e->fg;     /* Bar pixel value                                */
+
+    if (!e->bara) return;
+
+    for (x=centerx-starti; x <= centerx+starti; x++)
+        {
+        for (y=centery-starti_s; y <= centery+starti_s; y++)
+            {
+            ma=(float)(x-centerx)*co+(float)(y-centery)*si;
+            mb=(float)(y-centery)*co-(float)(x-centerx)*si;
+            if ((pow(ma/e->bara,2.0)+pow(mb/e->barb,2.0)) <= 1.0)
+                {
+                m[y][x]=brt;
+                }
+            }
+        }
+    }
+
+
+//
+// CORE() - Fills in the core (if any).  Cannot use the same polar to
+//          cartesian mapping as in p2dfft because larger cores will have
+//          gaps and patterns develop that can be interpreted as structure.
+//
+// Arguments:
+//      e       - Model parameters
+//      m       - Image ([y][x])
+//
+// Return Value: NONE
+//
+
+void    spiral::core(const sp_rec *e, ImageView<float> m)
+    {
+    int     x, y;          /* Array index variables                          */
+    int     centerx=e->hsize/2; /* Center coordinate for x axis              */
+    int     centery=e->vsize/2; /* Center coordinate for y axis              */
+    int     r2=(int) e->r0*e->r0; /* Initial core radius squared             */
+    float   brt=e->fg*(float)e->core; /* Core pixel value                    */
+
+    if (!e->core) return;
+
+    for (x=(int) (centerx-e->r0); x <= centerx+e->r0; x++)
+        {
+        for (y=(int) (centery-e->r0); y <= centery+e->r0; y++)
+            {
+            if ((x-centerx)*(x-centerx)+(y-centery)*(y-centery) <= r2)
+                {
+                m[y][x]=brt;
+                }
+            }
+        }
+    }
+
+
+//
+// PLAN() - Makes the FFTW plans, arrays and PSF transform for rows x cols
+//          images.  The plans are kept while the size does not change, and
+//          the PSF transform while neither the size nor the PSF change.
+//          The planner is not thread safe, so the plans are made one thread
+//          at a time.  FFTW_ESTIMATE picks the same algorithm on every run
+//          (FFTW_MEASURE picks it by timing), so the rounding of the
+//          convolved model does not depend on the run or thread count.
+//
+// Arguments:
+//      rows    - Image rows
+//      cols    - Image columns
+//
+// Return Value:
+//      SPIRAL_SUCCESS  - Plans and PSF transform ready
+//      SPIRAL_FAILURE  - No memory, no plan, or the PSF sums to 0
+//
+
+int     spiral::plan(long rows, long cols)
+    {
+    long    x, y;          /* Array index variables                          */
+    long    dx, dy;        /* Offsets from the PSF center                    */
+    long    hc=cols/2+1;   /* Complex values per row of the transform        */
+    size_t  n=(size_t)rows*hc;
+    double  sum=0.0;       /* Sum of the PSF                                 */
+    double  s2, a2;        /* Gaussian 2 sigma^2 and Moffat alpha^2          */
+    int     bad=0;
+    int     same=(fwd != NULL) && (rows == p_rows) && (cols == p_cols);
+
+    if (same && (psf == o_psf) && (fwhm == o_fwhm) && (beta == o_beta) && (psf_img == o_img)) return(SPIRAL_SUCCESS);
+
+    if (!same)
+        {
+#pragma omp critical (fftw_planner)
+        {
+        if (fwd) fftw_destroy_plan(fwd);
+        if (bwd) fftw_destroy_plan(bwd);
+        fwd=bwd=NULL;
+        fftw_free(re);
+        fftw_free(spec);
+        fftw_free(otf);
+        p_rows=p_cols=0;
+
+        re=(double *) fftw_malloc((size_t)rows*cols*sizeof(double));
+        spec=(fftw_complex *) fftw_malloc(n*sizeof(fftw_complex));
+        otf=(fftw_complex *) fftw_malloc(n*sizeof(fftw_complex));
+
+        if (re && spec && otf)
+            {
+            fwd=fftw_plan_dft_r2c_2d((int) rows, (int) cols, re, spec, FFTW_ESTIMATE);
+            bwd=fftw_plan_dft_c2r_2d((int) rows, (int) cols, spec, re, FFTW_ESTIMATE);
+            }
+
+        if ((fwd == NULL) || (bwd == NULL)) bad=1;
+        }
+
+        if (bad) return(SPIRAL_FAILURE);
+
+        p_rows=rows;
+        p_cols=cols;
+        }
+
+    o_psf=PSF_NONE;
+
+//
+// Lay the PSF out with its center on pixel (0,0), wrapping around the edges
+//
+
+    memset(re, 0, (size_t)rows*cols*sizeof(double));
+
+    if (psf == PSF_IMAGE)
+        {
+        for (y=0; y < psf_img->rows(); y++)
+            {
+            dy=(((y-psf_img->rows()/2)%rows)+rows)%rows;
+            for (x=0; x < psf_img->cols(); x++)
+                {
+                dx=(((x-psf_img->cols()/2)%cols)+cols)%cols;
+                re[dy*cols+dx]+=(*psf_img)[y][x];
+                }
+            }
+        }
+    else
+        {
+        s2=2.0*pow(fwhm/(2.0*sqrt(2.0*log(2.0))), 2.0);
+        a2=pow(fwhm/(2.0*sqrt(pow(2.0, 1.0/beta)-1.0)), 2.0);
+
+        for (y=0; y < rows; y++)
+            {
+            dy=(y <= rows/2) ? y : y-rows;
+            for (x=0; x < cols; x++)
+                {
+                dx=(x <= cols/2) ? x : x-cols;
+                if (psf == PSF_GAUSS)
+                    re[y*cols+x]=exp(-(double)(dx*dx+dy*dy)/s2);
+                else
+                    re[y*cols+x]=pow(1.0+(double)(dx*dx+dy*dy)/a2, -beta);
+                }
+            }
+        }
+
+    for (x=0; x < rows*cols; x++) sum+=re[x];
+    if (sum <= 0.0) return(SPIRAL_FAILURE);
+
+//
+// The transform of the PSF is kept divided by its sum and by the size (FFTW
+//   transforms are not normalized)
+//
+
+    fftw_execute_dft_r2c(fwd, re, otf);
+
+    sum*=(double)rows*cols;
+    for (x=0; x < (long) n; x++)
+        {
+        otf[x][0]/=sum;
+        otf[x][1]/=sum;
+        }
+
+    o_psf=psf;
+    o_fwhm=fwhm;
+    o_beta=beta;
+    o_img=psf_img;
+    return(SPIRAL_SUCCESS);
+    }
+
+
+//
+// CONVOLVE() - Convolves the image with the PSF (see spiral_class.h)
+//
+// Arguments:
+//      e       - Model parameters
+//      mat     - Image ([y][x])
+//
+// Return Value:
+//      SPIRAL_SUCCESS  - Image convolved
+//      SPIRAL_FAILURE  - PSF could not be set up (see text)
+//
+
+int     spiral::convolve(const sp_rec *e, Image2D<float> *mat)
+    {
+    long    x, y;          /* Array index variables                          */
+    long    rows=mat->rows();
+    long    cols=mat->cols();
+    float   *row;
+
+    if (plan(rows, cols))
+        {
+        say("ERROR: PSF setup failed for %s (%ld x %ld)...Skipping\n",e->name,rows,cols);
+        return(SPIRAL_FAILURE);
+        }
+
+    if (verbose) say("  --- Convolving With PSF\n");
+
+    for (y=0; y < rows; y++)
+        {
+        row=(*mat)[y];
+        for (x=0; x < cols; x++) re[y*cols+x]=row[x];
+        }
+
+    fftw_execute(fwd);
+    cmul_row(spec, otf, (size_t)rows*(cols/2+1));
+    fftw_execute(bwd);
+
+    for (y=0; y < rows; y++)
+        {
+        row=(*mat)[y];
+        for (x=0; x < cols; x++) row[x]=(float) re[y*cols+x];
+        }
+
+    return(SPIRAL_SUCCESS);
+    }
+
+
+//
+// SHOT() - Replaces each pixel by a Poisson number of electrons (mean: the
+//          pixel value times gain) plus normal read noise, divided by gain.
+//          The random values of a pixel come from counter (x, y,
+//          SPIRAL_SHOT), so the rows are split over nthreads threads.
+//
+// Arguments:
+//      e        - Model parameters
+//      m        - Image ([y][x])
+//      nthreads - Threads used for the rows
+//
+// Return Value: NONE
+//
+
+void    spiral::shot(const sp_rec *e, ImageView<float> m, int nthreads)
+    {
+    philox  rng(key(e->name, seed)); /* Generator for this model             */
+    float   g=gain;
+    float   ig=1.0/gain;
+    float   rn=read_noise;
+    int     hsize=e->hsize;
+
+    if (verbose) say("  --- Adding Shot Noise\n");
+
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (int y=0; y < e->vsize; y++)
+        {
+        uint32_t    w0[SP_CHUNK], w1[SP_CHUNK], w2[SP_CHUNK], w3[SP_CHUNK];
+        float       lam[SP_CHUNK], rd[SP_CHUNK];
+        float       *row;
+        int         x, i, n;
+
+        for (x=0; x < hsize; x+=SP_CHUNK)
+            {
+            n=(hsize-x < SP_CHUNK) ? hsize-x : SP_CHUNK;
+            row=m[y]+x;
+
+            rng.fill((uint32_t) x, n, (uint32_t) y, SPIRAL_SHOT, 0, w0, w1, w2, w3);
+            shot_row(row, n, g, ig, rn, w0, w1, lam, rd);
+
+            for (i=0; i < n; i++)
+                {
+                if (lam[i] < SPIRAL_POISSON_GAUSS)
+                    row[i]=((float) sp_poisson(lam[i], philox::uniform(w2[i]))+rd[i])*ig;
+                }
+            }
+        }
+    }
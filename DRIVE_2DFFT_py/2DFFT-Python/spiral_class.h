@@ -0,0 +1,300 @@
+//
+// SPIRAL_CLASS.H - This class draws the model galaxies made by p2spiral and
+//                  provides the counter based random number generator used
+//                  for their noise.
+//
+//
+// Version 1.0: 17-Oct-2026
+//
+//
+// Authors:  Ian Hewitt & Dr. Patrick Treuthardt,
+//           NC Museum of Natural Sciences,
+//           Astronomy & Astrophysics Lab,
+//           Raleigh, NC USA.
+//           http://github.com/treuthardt/P2DFFT
+//
+//
+// LICENSE
+//
+// P2DFFT Spiral Galaxy Arm Pitch Angle Analysis Suite
+// Copyright (c) 2016-2019  Ian B. Hewitt & Dr. Patrick Treuthardt
+//
+// The program is free software:  you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY, without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see < https://www.gnu.org/licenses >.
+//
+// The authors can be contacted at:
+//
+//      North Carolina Museum of Natural Sciences
+//      Astronomy & Astrophysics Laboratory
+//      11 West Jones Street
+//      Raleigh, NC, 27601  USA
+//      +1.919.707.9800
+//
+//      -- or --
+//
+//      patrick.treuthardt@naturalsciences.org
+//
+//
+// Revision History:
+//      1.0  17-Oct-2026: - Initial version
+//                        - Add the analytic arm renderer (paint())
+//                        - Add the PSF convolution (convolve()) and the shot
+//                          and read noise (shot()) stages
+//                        - Move the input line parsing and parameter limits
+//                          here from p2spiral.cpp (parse())
+//                        - Add overlay() to draw only the arms of a model on
+//                          an existing image (p2overlay)
+//
+
+#define     SPIRAL_H_VER   "1.0/20261017"
+
+#include    <stdint.h>
+#include    <string>
+#include    <vector>
+#include    <fftw3.h>
+
+#include    "image_class.h"
+
+//
+// Class definition values
+//
+//   A model is drawn from one sp_rec (one line of the p2spiral input file)
+//   into an Image2D of vsize rows by hsize columns ([y][x]).  Every random
+//   value is a function of the model key and the position it is used for
+//   (Philox4x32-10, see philox below), not of the order the values are
+//   drawn in.  A model is therefore the same whatever the number of threads
+//   and whichever thread draws it.
+//
+//   The key is made from the model name and the p2spiral -s seed, so a model
+//   keeps its noise when it is moved in the input file, and models with
+//   different names get different noise.
+//
+//   The arms are drawn one of two ways:
+//
+//     traced   - (default) Each arm is stepped one degree at a time and a
+//                square of feath pixels is stamped around every point, as
+//                p2spiral always has.  The steps leave gaps on large images.
+//     analytic - (analytic=1) Every pixel inside the margin finds its
+//                distance to the nearest arm in closed form (the arms are
+//                straight lines in ln r, theta) and is set if it is within
+//                feath+0.5 pixels of one.  The arms are continuous at any
+//                size.  The brightness and pitch change rules are those of
+//                the traced arms, taken at the radius of the pixel.  The
+//                rows are split over threads and each row is one vector
+//                loop (CPU_CLONES).
+//
+//   Two optional stages then make the model look like an observation:
+//
+//     convolve - The image is convolved with a point spread function (psf):
+//                a Gaussian or Moffat of fwhm pixels, or a PSF image (its
+//                center pixel is the center of the PSF).  The PSF is
+//                normalized to a sum of 1.  This is a circular convolution
+//                done with FFTW real to complex transforms; light that
+//                crosses one edge comes back on the other, which the
+//                margin keeps to the background.  The plans and the PSF
+//                transform are kept and used again while the image size
+//                and the PSF do not change.
+//     shot     - With a gain (electrons per count) the image values are
+//                taken as the expected counts, and each pixel is replaced by
+//                a Poisson number of electrons plus Gaussian read noise,
+//                divided by the gain.  Above SPIRAL_POISSON_GAUSS electrons
+//                the Poisson value is taken from a normal distribution (in a
+//                vector loop), below it the exact inverse is used.
+//
+//   overlay() draws only the arms, with the analytic renderer, onto an image
+//   that is already filled (no background, bar, core or noise).  p2overlay
+//   uses it to mark the arms measured by p2dfft on the galaxy image.
+//
+
+struct  sp_rec
+    {
+    char    name[64];       /* Base name of the files to generate            */
+    float   pa;             /* Pitch angle (degrees)                         */
+    int     arm;            /* Number of arms                                */
+    int     hsize;          /* Horizontal size in pixels                     */
+    int     vsize;          /* Vertical size in pixels                       */
+    int     feath;          /* Feathering/fuzziness value                    */
+    float   sweep;          /* Arm sweep (degrees)                           */
+    float   rot;            /* Rotation (degrees) of the arm start           */
+    float   r0;             /* Initial radius at 0 degrees                   */
+    int     core;           /* Flag for filling in the core area             */
+    float   bara;           /* Bar semi-major axis (0 = no bar)              */
+    float   barb;           /* Bar semi-minor axis                           */
+    int     mar;            /* Outer margin value                            */
+    float   fg;             /* Foreground FITS pixel value                   */
+    float   bg;             /* Background FITS pixel value                   */
+    float   delta;          /* Pitch angle change over the arm               */
+    float   lum;            /* Brightness change over radius                 */
+    int     linear;         /* Brightness change algorithm flag              */
+    int     arm_lum;        /* Flag for changing brightness over arm width   */
+    float   noise;          /* Maximum noise ceiling value                   */
+
+    sp_rec() : pa(0.0), arm(0), hsize(0), vsize(0), feath(0), sweep(0.0), rot(0.0), r0(0.0),
+               core(0), bara(0.0), barb(0.0), mar(0), fg(0.0), bg(0.0), delta(0.0), lum(0.0),
+               linear(0), arm_lum(0), noise(0.0) { name[0]='\0'; }
+    };
+
+//
+// Limits of the model parameters (see spiral::parse() and p2spiral)
+//
+
+#define     MIN_PA   -75.0 /* Minimum pitch angle (floating point value)     */
+#define     MAX_PA    75.0 /* Maximum pitch angle (floating point value)     */
+#define     MIN_ARM      1 /* Minimum number of spiral arms                  */
+#define     MAX_ARM      6 /* Maximum number of spiral arms                  */
+#define     MIN_SIZE    50 /* Minimum file size (should be at least 50)      */
+#define     MAX_SIZE  2048 /* Maximum files size ( < 2049 for 2DFFT)         */
+#define     MIN_FTHR     0 /* Minimum feather setting (integer value)        */
+#define     MAX_FTHR    15 /* Maximum feather setting (integer value)        */
+#define     MIN_SWEEP 90.0 /* Minimum arm sweep (< 45 is not meaningful)     */
+#define     MAX_SWEEP 720.0 /* Maximum arm mapping angle                     */
+#define     MIN_ROT  -90.0 /* Minimum rotation angle (floating point value)  */
+#define     MAX_ROT   90.0 /* Maximum rotation angle (floating point value)  */
+#define     MIN_R0     1.0 /* Minimum initial radius (floating point value)  */
+#define     MAX_R0  1000.0 /* Maximum initial radius (floating point value)  */
+#define     MIN_CORE     0 /* Lowest core mapping value                      */
+#define     MAX_CORE     2 /* Highest core mapping value                     */
+#define     MIN_BARA     0 /* Minimum bar semi-major axis                    */
+#define     MAX_BARA 1024.0 /* Maximum bar semi-major axis                   */
+#define     MIN_BARB     0 /* Minimum bar semi-minor axis                    */
+#define     MAX_BARB 1024.0 /* Maximum bar semi-minor axis                   */
+#define     MIN_MAR      0 /* Minimum outer margin of blank space            */
+#define     MAX_MAR    200 /* Maximum outer margin of blank space            */
+#define     MIN_PIXEL -1024.0 /* The minimum value for fg and bg variables   */
+#define     MAX_PIXEL  1024.0 /* The maximum value for fg and bg variables   */
+#define     MIN_DELTA -60.0 /* Minimum pitch angle change (floating point)   */
+#define     MAX_DELTA  60.0 /* Maximum pitch angle change (floating point)   */
+#define     MIN_LUM   -0.99 /* Minimum brightness change (floating point)    */
+#define     MAX_LUM    0.99 /* Maximum brightness change (floating point)    */
+#define     MIN_LOG      0 /* Lowest brightness option                       */
+#define     MAX_LOG      1 /* Highest brightness option                      */
+#define     MIN_ARM_LUM  0 /* Lowest arm width luminosity change value       */
+#define     MAX_ARM_LUM  1 /* Highest arm width luminosity change value      */
+#define     MIN_NOISE -512.0 /* The minimum value for fg and bg variables    */
+#define     MAX_NOISE  512.0 /* The maximum value for fg and bg variables    */
+
+//
+// Philox4x32-10 counter based generator (Salmon et al. 2011, "Parallel
+//   Random Numbers: As Easy as 1, 2, 3").  block() turns a 128 bit counter
+//   into four independent 32 bit values; nothing is kept between calls, so
+//   one generator can be shared by any number of threads.
+//
+
+class   philox {
+              public:
+                 philox(uint64_t key) : k0((uint32_t) key), k1((uint32_t) (key >> 32)) {}
+
+                 void    block(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t out[4]) const;
+                 void    fill(uint32_t c0, int n, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t *w0, uint32_t *w1, uint32_t *w2, uint32_t *w3) const;
+
+                 static float uniform(uint32_t v) { return((float)(v >> 8)*(1.0f/16777216.0f)); }
+
+              private:
+                 uint32_t    k0, k1; /* Key                                  */
+              };
+
+//
+// Counter streams (third counter word).  Each use of random values in a
+//   model has its own stream so adding one does not change the others.
+//
+
+#define     SPIRAL_NOISE    0       /* Background noise, counter (x/4, y)    */
+#define     SPIRAL_SHOT     1       /* Shot and read noise, counter (x, y)   */
+
+//
+// Point spread functions (spiral::psf)
+//
+
+#define     PSF_NONE        0
+#define     PSF_GAUSS       1
+#define     PSF_MOFFAT      2
+#define     PSF_IMAGE       3
+
+#define     PSF_BETA        4.765   /* Default Moffat beta (Trujillo 2001)   */
+
+#define     SPIRAL_POISSON_GAUSS  30.0  /* Electrons above which Poisson     */
+                                        /*   values are drawn as normal      */
+
+class   spiral {
+              public:
+                 spiral();
+                 ~spiral();
+                 void    version();
+                 int     render(const sp_rec *e, Image2D<float> *mat, int nthreads);
+                 int     parse(char *line, sp_rec *e);
+                 int     overlay(const sp_rec *e, ImageView<float> m, int nthreads);
+                 static  uint64_t key(const char *name, uint64_t seed);
+
+                 uint64_t    seed;   /* Seed mixed into every model key      */
+                 int     verbose;    /* Add status messages to text          */
+                 int     list;       /* Add the pitch angle listing to text  */
+                 int     analytic;   /* Draw the arms with paint()           */
+
+                 int     psf;        /* PSF_NONE, _GAUSS, _MOFFAT or _IMAGE  */
+                 float   fwhm;       /* FWHM (pixels) of _GAUSS and _MOFFAT  */
+                 float   beta;       /* Moffat beta                          */
+                 const Image2D<float> *psf_img; /* PSF for _IMAGE (not owned, */
+                                                /*   must not change)         */
+                 float   gain;       /* Electrons per count (0 = no shot())  */
+                 float   read_noise; /* Read noise (electrons RMS)           */
+
+                 float   avg_pitch;  /* Average pitch of the last model      */
+                 float   min_pitch;  /* Minimum pitch of the last model      */
+                 float   max_pitch;  /* Maximum pitch of the last model      */
+                 std::string text;   /* Messages for the last model          */
+
+              private:
+                 spiral(const spiral &);
+                 spiral &operator=(const spiral &);
+
+                 void    background(const sp_rec *e, ImageView<float> m, int nthreads);
+                 int     arms(const sp_rec *e, ImageView<float> m);
+                 void    paint(const sp_rec *e, ImageView<float> m, int nthreads);
+                 void    bar(const sp_rec *e, ImageView<float> m);
+                 void    core(const sp_rec *e, ImageView<float> m);
+                 int     convolve(const sp_rec *e, Image2D<float> *mat);
+                 int     plan(long rows, long cols);
+                 void    shot(const sp_rec *e, ImageView<float> m, int nthreads);
+                 void    say(const char *fmt, ...);
+                 float   token(const char *fname, const char *name, float min, float max);
+
+                 float   startf;     /* Starting radius for arms (float)     */
+                 int     starti;     /* Starting radius for arms (integer)   */
+                 float   mod;        /* Chirality (direction) of the arms    */
+                 float   separation; /* Angle between the arms (degrees)     */
+                 float   change;     /* Pitch angle change per pixel radius  */
+                 float   lum_rate;   /* Luminosity change per radius step    */
+                 float   r_end;      /* Largest radius of the traced arms    */
+
+                 std::vector<float>  slope;  /* tan(pitch) by radius step    */
+                 std::vector<float>  islope; /* 1/tan(pitch) by radius step  */
+                 std::vector<float>  cpitch; /* cos(pitch) by radius step    */
+
+                 fftw_plan   fwd;    /* Real to complex plan (p_rows x p_cols) */
+                 fftw_plan   bwd;    /* Complex to real plan                 */
+                 long    p_rows;     /* Image size the plans are for         */
+                 long    p_cols;
+                 int     o_psf;      /* PSF the transform (otf) is for       */
+                 float   o_fwhm;
+                 float   o_beta;
+                 const Image2D<float> *o_img;
+                 double  *re;        /* Image (p_rows x p_cols)              */
+                 fftw_complex *spec; /* Its transform (p_rows x p_cols/2+1)  */
+                 fftw_complex *otf;  /* PSF transform divided by the size    */
+              };
+
+//
+// Return codes
+//
+
+#define     SPIRAL_SUCCESS      0
+#define     SPIRAL_FAILURE      1